@@ -0,0 +1,637 @@
+/******************************************************************************
+/* @file Contains the KNNGraph class, an approximate k-nearest-neighbor graph
+/*       built with NN-descent and searched with a best-first beam search.
+/*
+/* NN-descent by Dong, Moses & Li: "Efficient K-Nearest Neighbor Graph Construction
+/* for Generic Similarity Measures" starts with random neighbors and repeatedly
+/* compares the neighbors of neighbors, since a neighbor of a neighbor is likely
+/* a neighbor, too. Only pairs with at least one new neighbor are compared, so
+/* the work drops as the graph converges.
+/*
+/* Unlike the original, every point pulls the candidates of its own list
+/* instead of pushing the pairs of a shared neighbor into two lists. So every
+/* point writes only its own list and the iterations run in parallel without locks.
+/*
+/*
+/* @author langenhagen
+/* @version 150715
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "VisitedSet.hpp"
+#include "../OPTICS/ClusterOrdering.hpp" // OPTICS::fnv1a_hash()
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace ANN {
+
+    /// The first bytes of every k-nearest-neighbor graph file.
+    const char KNN_GRAPH_FILE_MAGIC[] = "KNG1";
+
+
+    /** @brief An approximate k-nearest-neighbor graph over a point set.
+     * Answers k-nearest-neighbor and radius queries approximately. The search width of a query
+     * trades time for recall: the beam search keeps that many closest points found so far and
+     * stops when none of their neighbors is closer. Queries are thread-safe.
+     * @see OPTICS::PointMatrix for the methods a point set must provide; it must provide row(), too.
+     */
+    template<typename Points>
+    class KNNGraph {
+
+    public: // types
+
+        /// The number of points from which queries that are no indexed points start.
+        enum { N_ENTRY_POINTS = 64 };
+
+    private: // vars
+
+        const Points& _points;                  ///< The indexed points.
+        unsigned int _n_neighbors;              ///< The number of neighbors per point.
+        IdVector _ids;                          ///< The neighbors of every point, _n_neighbors per point, closest first.
+        std::vector<real> _distances;           ///< The squared distances of the neighbors, parallel to _ids.
+        std::vector<std::size_t> _offsets;      ///< The first position of every point's search edges in _edges, plus the end.
+        IdVector _edges;                        ///< The search edges of every point: its neighbors and the closest points that have it as a neighbor.
+        IdVector _entry_points;                 ///< The points from which queries that are no indexed points start.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * Creates an empty graph; use build() or from_file().
+         * @param points The points to be indexed. Must outlive the graph.
+         */
+        KNNGraph( const Points& points) : _points( points), _n_neighbors( 0)
+        {}
+
+    public: // methods
+
+        /** Builds the graph with NN-descent.
+         * @param n_neighbors The number of neighbors per point. Is reduced to the number of points - 1.
+         * @param parallel_for Runs the parallel loops, e.g. on a thread pool. Use serial_for() to run them serially.
+         * @param sample_rate The fraction of every point's new neighbors that an iteration compares el. ]0,1].
+         * @param termination The fraction of updated neighbors below which the iterations stop.
+         * @param max_iterations The maximum number of iterations.
+         * @param seed The seed of the random initial neighbors.
+         * @return The number of iterations.
+         */
+        unsigned int build( const unsigned int n_neighbors,
+                            const ParallelFor& parallel_for,
+                            const real sample_rate = real(0.5),
+                            const real termination = real(0.001),
+                            const unsigned int max_iterations = 16,
+                            const unsigned long long seed = 0) {
+            assert( sample_rate > 0 && sample_rate <= 1 && "the sample rate must be el. ]0,1]");
+            const std::size_t n_points = _points.size();
+            _n_neighbors = n_points > 1 ? static_cast<unsigned int>(std::min<std::size_t>( n_neighbors, n_points - 1)) : 0;
+            _ids.assign( n_points * _n_neighbors, 0);
+            _distances.assign( n_points * _n_neighbors, UNDEFINED);
+            std::vector<char> is_new( n_points * _n_neighbors, 1);
+
+            unsigned int ret = 0;
+            if( _n_neighbors > 0) {
+                initialize_randomly( seed, parallel_for);
+
+                const unsigned int n_samples = std::max( 1u, static_cast<unsigned int>(sample_rate * _n_neighbors));
+                std::vector<IdVector> new_candidates;
+                std::vector<IdVector> old_candidates;
+                std::vector<unsigned int> n_updates( n_points);
+                while( ret < max_iterations) {
+                    ++ret;
+                    sample_candidates( n_samples, is_new, new_candidates, old_candidates);
+                    parallel_for( n_points, [this, &is_new, &new_candidates, &old_candidates, &n_updates]( const std::size_t begin, const std::size_t end) {
+                        VisitedSet visited;
+                        for( std::size_t p=begin; p<end; ++p)
+                            n_updates[p] = this->join( static_cast<point_id>(p), new_candidates, old_candidates, is_new, visited);
+                    });
+
+                    unsigned long long n_total_updates = 0;
+                    for( std::size_t p=0; p<n_points; ++p)
+                        n_total_updates += n_updates[p];
+                    if( n_total_updates <= termination * n_points * _n_neighbors)
+                        break;
+                }
+            }
+            build_search_edges();
+            return ret;
+        }
+
+
+        /** Writes the graph to a binary file.
+         * The format is: magic number, fingerprint, number of points, number of neighbors,
+         * followed by the neighbor ids and their squared distances.
+         * @param fname The name of the file to be written to.
+         * @param fingerprint Identifies the points the graph was built for, see fingerprint().
+         * @return TRUE in case of success,
+         *         FALSE in case of error.
+         */
+        bool to_file( const std::string& fname, const uint64_t fingerprint) const {
+            std::ofstream out_file( fname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+            if( !out_file.is_open())
+                return false;
+
+            const uint64_t header[] = { fingerprint, _points.size(), _n_neighbors };
+            out_file.write( KNN_GRAPH_FILE_MAGIC, 4);
+            out_file.write( reinterpret_cast<const char*>(header), sizeof(header));
+            if( !_ids.empty()) {
+                out_file.write( reinterpret_cast<const char*>(&_ids[0]), _ids.size() * sizeof(point_id));
+                out_file.write( reinterpret_cast<const char*>(&_distances[0]), _distances.size() * sizeof(real));
+            }
+            return !out_file.bad();
+        }
+
+
+        /** Reads a graph from a binary file written by to_file().
+         * Rejects files whose size does not match the header.
+         * @param fname The path to the file where the graph is stored.
+         * @param fingerprint The fingerprint of the points, see fingerprint().
+         * @return TRUE in case of success,
+         *         FALSE in case of error or if the graph was built for other points. The graph is empty then.
+         */
+        bool from_file( const std::string& fname, const uint64_t fingerprint) {
+            _n_neighbors = 0;
+            _ids.clear();
+            _distances.clear();
+            build_search_edges();
+
+            std::ifstream in_file( fname.c_str(), std::ios::in | std::ios::binary);
+            char magic[4];
+            uint64_t header[3]; // fingerprint, n_points, n_neighbors
+            if( !in_file.is_open() ||
+                !in_file.read( magic, 4) ||
+                std::memcmp( magic, KNN_GRAPH_FILE_MAGIC, 4) != 0 ||
+                !in_file.read( reinterpret_cast<char*>(header), sizeof(header)) ||
+                header[0] != fingerprint ||
+                header[1] != _points.size() ||
+                header[2] >= std::max<uint64_t>( _points.size(), 1)) {
+                return false;
+            }
+
+            // the neighbor lists must account for the whole file, before anything is allocated
+            const uint64_t bytes_per_value = sizeof(point_id) + sizeof(real);
+            in_file.seekg( 0, std::ios::end);
+            const uint64_t actual_size = static_cast<uint64_t>(in_file.tellg());
+            in_file.seekg( static_cast<std::streamoff>(4 + sizeof(header)), std::ios::beg);
+            if( actual_size < 4 + sizeof(header) ||
+                (header[1] > 0 && header[2] > (actual_size - 4 - sizeof(header)) / bytes_per_value / header[1]) ||
+                actual_size != 4 + sizeof(header) + header[1] * header[2] * bytes_per_value) {
+                return false;
+            }
+
+            const std::size_t n_values = static_cast<std::size_t>(header[1] * header[2]);
+            IdVector ids( n_values);
+            std::vector<real> distances( n_values);
+            if( n_values > 0 &&
+                !(in_file.read( reinterpret_cast<char*>(&ids[0]), n_values * sizeof(point_id)) &&
+                  in_file.read( reinterpret_cast<char*>(&distances[0]), n_values * sizeof(real)))) {
+                return false;
+            }
+            for( IdVector::const_iterator it=ids.begin(); it!=ids.end(); ++it)
+                if( *it >= _points.size())
+                    return false;
+
+            _n_neighbors = static_cast<unsigned int>(header[2]);
+            _ids.swap( ids);
+            _distances.swap( distances);
+            build_search_edges();
+            return true;
+        }
+
+
+        /** Retrieves the indexed points.
+         * @return The points.
+         */
+        const Points& points() const { return _points; }
+
+        /** Retrieves the number of neighbors per point.
+         * @return The number of neighbors per point.
+         */
+        unsigned int n_neighbors() const { return _n_neighbors; }
+
+        /** Retrieves the neighbors of a point.
+         * @param p The id of the point.
+         * @return A pointer to the n_neighbors() ids of the point's neighbors, closest first.
+         */
+        const point_id* neighbor_ids( const point_id p) const { return &_ids[p * _n_neighbors]; }
+
+        /** Retrieves the squared distances of the neighbors of a point.
+         * @param p The id of the point.
+         * @return A pointer to the n_neighbors() squared distances, ascending.
+         */
+        const real* neighbor_distances( const point_id p) const { return &_distances[p * _n_neighbors]; }
+
+
+        /** Finds the approximate k nearest neighbors of a vector.
+         * @param query The coordinates of the vector, points().dims() values.
+         * @param k The number of neighbors.
+         * @param search_width The number of closest points the search keeps, at least k.
+         * @return The up to k nearest points found with their squared distances, closest first.
+         */
+        NeighborVector search( const real* query, const unsigned int k, const unsigned int search_width) const {
+            VisitedSet visited( 4 * search_width);
+            NeighborVector ret = beam_search( query, entry_seeds( query, visited), std::max( 1u, std::max( k, search_width)), visited);
+            if( ret.size() > k)
+                ret.erase( ret.begin() + k, ret.end());
+            return ret;
+        }
+
+
+        /** Finds the approximate k nearest neighbors of an indexed point, without the point itself.
+         * Starts at the point's neighbors in the graph.
+         * @param p The id of the point.
+         * @param k The number of neighbors.
+         * @param search_width The number of closest points the search keeps, at least k.
+         * @return The up to k nearest points found with their squared distances, closest first.
+         */
+        NeighborVector knn( const point_id p, const unsigned int k, const unsigned int search_width) const {
+            VisitedSet visited( 4 * search_width);
+            NeighborVector ret = beam_search( _points.row( p), point_seeds( p, visited), std::max( 1u, std::max( k, search_width)), visited);
+            if( ret.size() > k)
+                ret.erase( ret.begin() + k, ret.end());
+            return ret;
+        }
+
+
+        /** Finds the points within a radius around a vector.
+         * Searches the closest points, then expands over the edges of every point found within the radius.
+         * Points of the radius that are not connected to the others by such a path are missed.
+         * @param query The coordinates of the vector, points().dims() values.
+         * @param squared_radius The squared radius.
+         * @param search_width The number of closest points the initial search keeps.
+         * @return The points found within the radius with their squared distances, closest first.
+         */
+        NeighborVector radius_search( const real* query, const real squared_radius, const unsigned int search_width) const {
+            VisitedSet visited( 4 * search_width);
+            const NeighborVector seeds = entry_seeds( query, visited);
+            return expand_radius( query, squared_radius, seeds, search_width, visited);
+        }
+
+
+        /** Finds the points within a radius around an indexed point, without the point itself.
+         * @param p The id of the point.
+         * @param squared_radius The squared radius.
+         * @param search_width The number of closest points the initial search keeps.
+         * @return The points found within the radius with their squared distances, closest first.
+         * @see radius_search()
+         */
+        NeighborVector radius_neighbors( const point_id p, const real squared_radius, const unsigned int search_width) const {
+            VisitedSet visited( 4 * search_width);
+            const NeighborVector seeds = point_seeds( p, visited);
+            return expand_radius( _points.row( p), squared_radius, seeds, search_width, visited);
+        }
+
+    private: // helpers
+
+        /** Gives every point random distinct neighbors.
+         * @param seed The seed of the random numbers.
+         * @param parallel_for Runs the parallel loop.
+         */
+        void initialize_randomly( const unsigned long long seed, const ParallelFor& parallel_for) {
+            const std::size_t n_points = _points.size();
+            parallel_for( n_points, [this, seed, n_points]( const std::size_t begin, const std::size_t end) {
+                VisitedSet chosen( this->_n_neighbors + 1);
+                NeighborVector row;
+                for( std::size_t p=begin; p<end; ++p) {
+                    unsigned long long state = seed ^ (p * 0xD1B54A32D192ED03ULL);
+                    chosen.clear();
+                    chosen.insert( static_cast<point_id>(p));
+                    row.clear();
+                    while( row.size() < this->_n_neighbors) {
+                        const point_id q = static_cast<point_id>(split_mix( state) % n_points);
+                        if( chosen.insert( q))
+                            row.push_back( Neighbor( q, this->_points.squared_distance( static_cast<point_id>(p), q)));
+                    }
+                    std::sort( row.begin(), row.end(), is_closer);
+                    for( unsigned int j=0; j<this->_n_neighbors; ++j) {
+                        this->_ids[p * this->_n_neighbors + j] = row[j].id;
+                        this->_distances[p * this->_n_neighbors + j] = row[j].squared_distance;
+                    }
+                }
+            });
+        }
+
+
+        /** Collects the candidates that the next iteration joins.
+         * Every point samples up to n_samples of its new neighbors, which become old, and takes all of its old ones.
+         * The points that have a point as sampled new or old neighbor are added as reverse candidates, again up to n_samples.
+         * @param n_samples The maximum number of new and of reverse candidates per point.
+         * @param[in,out] io_is_new The flag per neighbor that tells whether it was never compared.
+         * @param[out] o_new_candidates The new candidates of every point.
+         * @param[out] o_old_candidates The old candidates of every point.
+         */
+        void sample_candidates( const unsigned int n_samples,
+                                std::vector<char>& io_is_new,
+                                std::vector<IdVector>& o_new_candidates,
+                                std::vector<IdVector>& o_old_candidates) const {
+            const std::size_t n_points = _points.size();
+            o_new_candidates.assign( n_points, IdVector());
+            o_old_candidates.assign( n_points, IdVector());
+            std::vector<unsigned int> n_forward_new( n_points, 0);
+            std::vector<unsigned int> n_forward_old( n_points, 0);
+
+            for( std::size_t p=0; p<n_points; ++p) {
+                for( unsigned int j=0; j<_n_neighbors; ++j) {
+                    const std::size_t i = p * _n_neighbors + j;
+                    if( !io_is_new[i]) {
+                        o_old_candidates[p].push_back( _ids[i]);
+                    } else if( o_new_candidates[p].size() < n_samples) {
+                        o_new_candidates[p].push_back( _ids[i]);
+                        io_is_new[i] = 0;
+                    }
+                }
+                n_forward_new[p] = static_cast<unsigned int>(o_new_candidates[p].size());
+                n_forward_old[p] = static_cast<unsigned int>(o_old_candidates[p].size());
+            }
+
+            std::vector<unsigned int> n_reverse_new( n_points, 0);
+            std::vector<unsigned int> n_reverse_old( n_points, 0);
+            for( std::size_t p=0; p<n_points; ++p) {
+                for( unsigned int j=0; j<n_forward_new[p]; ++j) {
+                    const point_id q = o_new_candidates[p][j];
+                    if( n_reverse_new[q] < n_samples) {
+                        o_new_candidates[q].push_back( static_cast<point_id>(p));
+                        ++n_reverse_new[q];
+                    }
+                }
+                for( unsigned int j=0; j<n_forward_old[p]; ++j) {
+                    const point_id q = o_old_candidates[p][j];
+                    if( n_reverse_old[q] < n_samples) {
+                        o_old_candidates[q].push_back( static_cast<point_id>(p));
+                        ++n_reverse_old[q];
+                    }
+                }
+            }
+        }
+
+
+        /** Compares a point with the candidates of its candidates and updates its neighbors.
+         * A candidate of a candidate is compared if at least one of the two candidates is new,
+         * since the other pairs were already compared in an earlier iteration.
+         * Writes only the point's own neighbors, so all points can be joined concurrently.
+         * @param p The id of the point.
+         * @param new_candidates The new candidates of every point.
+         * @param old_candidates The old candidates of every point.
+         * @param[in,out] io_is_new The flag per neighbor that tells whether it was never compared.
+         * @param visited A set for the compared points; is cleared first.
+         * @return The number of new neighbors of the point.
+         */
+        unsigned int join( const point_id p,
+                           const std::vector<IdVector>& new_candidates,
+                           const std::vector<IdVector>& old_candidates,
+                           std::vector<char>& io_is_new,
+                           VisitedSet& visited) {
+            point_id* ids = &_ids[p * _n_neighbors];
+            real* distances = &_distances[p * _n_neighbors];
+            char* is_new = &io_is_new[p * _n_neighbors];
+            unsigned int ret = 0;
+
+            visited.clear();
+            visited.insert( p);
+            for( unsigned int j=0; j<_n_neighbors; ++j)
+                visited.insert( ids[j]);
+
+            // tries a candidate and inserts it in the sorted neighbors if it is closer than the farthest one
+            auto consider = [&]( const point_id q) {
+                if( !visited.insert( q))
+                    return;
+                const Neighbor candidate( q, _points.squared_distance( p, q));
+                const Neighbor farthest( ids[_n_neighbors-1], distances[_n_neighbors-1]);
+                if( !is_closer( candidate, farthest))
+                    return;
+                unsigned int j = _n_neighbors - 1;
+                for( ; j>0 && is_closer( candidate, Neighbor( ids[j-1], distances[j-1])); --j) {
+                    ids[j] = ids[j-1];
+                    distances[j] = distances[j-1];
+                    is_new[j] = is_new[j-1];
+                }
+                ids[j] = candidate.id;
+                distances[j] = candidate.squared_distance;
+                is_new[j] = 1;
+                ++ret;
+            };
+
+            const IdVector& new_p = new_candidates[p];
+            const IdVector& old_p = old_candidates[p];
+            for( IdVector::const_iterator u=new_p.begin(); u!=new_p.end(); ++u) {
+                consider( *u); // reverse candidates need not be neighbors
+                for( IdVector::const_iterator v=new_candidates[*u].begin(); v!=new_candidates[*u].end(); ++v)
+                    consider( *v);
+                for( IdVector::const_iterator v=old_candidates[*u].begin(); v!=old_candidates[*u].end(); ++v)
+                    consider( *v);
+            }
+            for( IdVector::const_iterator u=old_p.begin(); u!=old_p.end(); ++u) {
+                consider( *u);
+                for( IdVector::const_iterator v=new_candidates[*u].begin(); v!=new_candidates[*u].end(); ++v)
+                    consider( *v);
+            }
+            return ret;
+        }
+
+
+        /** Builds the search edges and chooses the entry points.
+         * A point's search edges are its neighbors, followed by up to n_neighbors() of the closest points that
+         * have it as a neighbor. The reverse edges connect outliers and let searches leave dense regions.
+         */
+        void build_search_edges() {
+            const std::size_t n_points = _points.size();
+            std::vector<NeighborVector> reverse( n_points);
+            for( std::size_t p=0; p<n_points; ++p)
+                for( unsigned int j=0; j<_n_neighbors; ++j)
+                    reverse[_ids[p * _n_neighbors + j]].push_back( Neighbor( static_cast<point_id>(p), _distances[p * _n_neighbors + j]));
+
+            _offsets.clear();
+            _offsets.reserve( n_points + 1);
+            _offsets.push_back( 0);
+            _edges.clear();
+            _edges.reserve( 2 * n_points * _n_neighbors);
+            for( std::size_t p=0; p<n_points; ++p) {
+                if( _n_neighbors == 0) {
+                    _offsets.push_back( 0);
+                    continue;
+                }
+                const point_id* ids = &_ids[p * _n_neighbors];
+                _edges.insert( _edges.end(), ids, ids + _n_neighbors);
+
+                NeighborVector& rev = reverse[p];
+                std::sort( rev.begin(), rev.end(), is_closer);
+                unsigned int n_added = 0;
+                for( NeighborVector::const_iterator it=rev.begin(); it!=rev.end() && n_added < _n_neighbors; ++it) {
+                    if( std::find( ids, ids + _n_neighbors, it->id) == ids + _n_neighbors) {
+                        _edges.push_back( it->id);
+                        ++n_added;
+                    }
+                }
+                NeighborVector().swap( rev);
+                _offsets.push_back( _edges.size());
+            }
+
+            _entry_points.clear();
+            const std::size_t n_entry_points = std::min<std::size_t>( N_ENTRY_POINTS, n_points);
+            for( std::size_t i=0; i<n_entry_points; ++i)
+                _entry_points.push_back( static_cast<point_id>(i * n_points / n_entry_points));
+        }
+
+
+        /** Computes the distances of a vector to the entry points.
+         * @param query The coordinates of the vector.
+         * @param[in,out] io_visited Gets the entry points.
+         * @return The entry points with their squared distances to the vector.
+         */
+        NeighborVector entry_seeds( const real* query, VisitedSet& io_visited) const {
+            NeighborVector ret;
+            for( IdVector::const_iterator it=_entry_points.begin(); it!=_entry_points.end(); ++it)
+                if( io_visited.insert( *it))
+                    ret.push_back( Neighbor( *it, squared_distance( query, _points.row( *it), _points.dims())));
+            return ret;
+        }
+
+
+        /** Takes the neighbors of an indexed point as seeds of a search around it.
+         * @param p The id of the point.
+         * @param[in,out] io_visited Gets the point and its neighbors, so that the point itself is never found.
+         * @return The neighbors of the point with their squared distances.
+         */
+        NeighborVector point_seeds( const point_id p, VisitedSet& io_visited) const {
+            NeighborVector ret;
+            io_visited.insert( p);
+            for( unsigned int j=0; j<_n_neighbors; ++j) {
+                const std::size_t i = p * _n_neighbors + j;
+                if( io_visited.insert( _ids[i]))
+                    ret.push_back( Neighbor( _ids[i], _distances[i]));
+            }
+            return ret;
+        }
+
+
+        /** Searches the closest points to a vector, best first.
+         * Expands the closest unexpanded point found so far until the search_width closest points found are all expanded.
+         * @param query The coordinates of the vector.
+         * @param seeds The points to start from with their squared distances to the vector. Must be in visited.
+         * @param search_width The number of closest points the search keeps, at least 1.
+         * @param[in,out] io_visited The points whose distances were computed.
+         * @param squared_radius Points within this squared radius are collected in o_within.
+         * @param[out] o_within If not nullptr, gets every point found within the radius, unsorted.
+         * @return The up to search_width closest points found, closest first.
+         */
+        NeighborVector beam_search( const real* query,
+                                    const NeighborVector& seeds,
+                                    const unsigned int search_width,
+                                    VisitedSet& io_visited,
+                                    const real squared_radius = 0,
+                                    NeighborVector* o_within = nullptr) const {
+            assert( search_width > 0 && "the search must keep at least one point");
+            // heaps: the candidates with the closest on top, the results with the farthest on top
+            const auto farther = []( const Neighbor& a, const Neighbor& b) { return is_closer( b, a); };
+            NeighborVector candidates;
+            NeighborVector ret;
+            for( NeighborVector::const_iterator it=seeds.begin(); it!=seeds.end(); ++it) {
+                if( o_within != nullptr && it->squared_distance <= squared_radius)
+                    o_within->push_back( *it);
+                candidates.push_back( *it);
+                std::push_heap( candidates.begin(), candidates.end(), farther);
+                ret.push_back( *it);
+                std::push_heap( ret.begin(), ret.end(), is_closer);
+                if( ret.size() > search_width) {
+                    std::pop_heap( ret.begin(), ret.end(), is_closer);
+                    ret.pop_back();
+                }
+            }
+
+            while( !candidates.empty()) {
+                const Neighbor current = candidates.front();
+                if( ret.size() >= search_width && is_closer( ret.front(), current))
+                    break;
+                std::pop_heap( candidates.begin(), candidates.end(), farther);
+                candidates.pop_back();
+
+                for( std::size_t e=_offsets[current.id]; e<_offsets[current.id+1]; ++e) {
+                    const point_id q = _edges[e];
+                    if( !io_visited.insert( q))
+                        continue;
+                    const Neighbor n( q, squared_distance( query, _points.row( q), _points.dims()));
+                    if( o_within != nullptr && n.squared_distance <= squared_radius)
+                        o_within->push_back( n);
+                    if( ret.size() < search_width || is_closer( n, ret.front())) {
+                        candidates.push_back( n);
+                        std::push_heap( candidates.begin(), candidates.end(), farther);
+                        ret.push_back( n);
+                        std::push_heap( ret.begin(), ret.end(), is_closer);
+                        if( ret.size() > search_width) {
+                            std::pop_heap( ret.begin(), ret.end(), is_closer);
+                            ret.pop_back();
+                        }
+                    }
+                }
+            }
+            std::sort_heap( ret.begin(), ret.end(), is_closer);
+            return ret;
+        }
+
+
+        /** Searches the closest points to a vector, then collects the connected points within a radius.
+         * @param query The coordinates of the vector.
+         * @param squared_radius The squared radius.
+         * @param seeds The points to start from with their squared distances to the vector. Must be in visited.
+         * @param search_width The number of closest points the initial search keeps.
+         * @param[in,out] io_visited The points whose distances were computed.
+         * @return The points found within the radius with their squared distances, closest first.
+         */
+        NeighborVector expand_radius( const real* query,
+                                      const real squared_radius,
+                                      const NeighborVector& seeds,
+                                      const unsigned int search_width,
+                                      VisitedSet& io_visited) const {
+            NeighborVector ret;
+            beam_search( query, seeds, std::max( 1u, search_width), io_visited, squared_radius, &ret);
+
+            for( std::size_t i=0; i<ret.size(); ++i) { // ret grows while it is walked
+                const point_id current = ret[i].id;
+                for( std::size_t e=_offsets[current]; e<_offsets[current+1]; ++e) {
+                    const point_id q = _edges[e];
+                    if( !io_visited.insert( q))
+                        continue;
+                    const real d = squared_distance( query, _points.row( q), _points.dims());
+                    if( d <= squared_radius)
+                        ret.push_back( Neighbor( q, d));
+                }
+            }
+            std::sort( ret.begin(), ret.end(), is_closer);
+            return ret;
+        }
+
+    private:
+        /// Not assignable.
+        KNNGraph& operator=( const KNNGraph&);
+    };
+
+
+    /** Computes a 64 bit FNV-1a hash of the coordinates of the points and the graph parameters.
+     * Graphs with equal fingerprints were built from the same points with the same parameters.
+     * @param points The points.
+     * @param n_neighbors The number of neighbors per point.
+     * @return The fingerprint.
+     */
+    template<typename Points>
+    uint64_t fingerprint( const Points& points, const unsigned int n_neighbors) {
+        uint64_t ret = 0xCBF29CE484222325ULL;
+        const uint64_t shape[] = { points.size(), points.dims(), n_neighbors };
+        OPTICS::fnv1a_hash( shape, sizeof(shape), ret);
+        const point_id n_points = static_cast<point_id>(points.size());
+        for( point_id p=0; p<n_points; ++p)
+            OPTICS::fnv1a_hash( points.row( p), points.dims() * sizeof(real), ret);
+        return ret;
+    }
+
+} // END namespace ANN
@@ -0,0 +1,114 @@
+/******************************************************************************
+/* @file Contains the VisitedSet class, a hash set of the points that a graph
+/*       search has already visited.
+/*
+/*
+/* @author langenhagen
+/* @version 150715
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "common.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace ANN {
+
+    /** @brief A set of point ids with open addressing.
+     * A search visits a tiny fraction of the points, so unlike a flag per point,
+     * clearing and allocating the set costs time proportional to the visited points.
+     * This matters since every query of a parallel loop may get its own set.
+     * The set remembers its occupied slots, so that clearing resets only these.
+     * The capacity never shrinks, which bounds a reused set by its largest search.
+     */
+    class VisitedSet {
+
+    private: // vars
+
+        /// Marks empty slots.
+        enum { EMPTY = ~0u };
+
+        IdVector _slots;                        ///< The slots; a power of two of them.
+        std::vector<std::size_t> _used_slots;   ///< The indices of the occupied slots, one per id in the set.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param expected_size The expected number of ids.
+         */
+        VisitedSet( const std::size_t expected_size = 256) {
+            std::size_t capacity = 16;
+            while( capacity < 2 * expected_size)
+                capacity *= 2;
+            _slots.assign( capacity, static_cast<point_id>(EMPTY));
+            _used_slots.reserve( capacity / 2);
+        }
+
+    public: // methods
+
+        /** Inserts a point id.
+         * @param p The id of the point.
+         * @return TRUE if the id was not in the set before, FALSE otherwise.
+         */
+        bool insert( const point_id p) {
+            if( 2 * (_used_slots.size() + 1) > _slots.size())
+                grow();
+            const std::size_t mask = _slots.size() - 1;
+            for( std::size_t i=hash( p) & mask; ; i=(i+1) & mask) {
+                if( _slots[i] == p)
+                    return false;
+                if( _slots[i] == static_cast<point_id>(EMPTY)) {
+                    _slots[i] = p;
+                    _used_slots.push_back( i);
+                    return true;
+                }
+            }
+        }
+
+        /** Removes all ids, keeping the capacity.
+         * Costs time proportional to the number of ids, not to the capacity.
+         */
+        void clear() {
+            for( std::vector<std::size_t>::const_iterator it=_used_slots.begin(); it!=_used_slots.end(); ++it)
+                _slots[*it] = static_cast<point_id>(EMPTY);
+            _used_slots.clear();
+        }
+
+        /** Retrieves the number of ids in the set.
+         * @return The number of ids.
+         */
+        std::size_t size() const { return _used_slots.size(); }
+
+    private: // helpers
+
+        /** Scatters the bits of a point id.
+         * @param p The id of the point.
+         * @return The hash of the id.
+         */
+        static std::size_t hash( const point_id p) {
+            return static_cast<std::size_t>(p * 0x9E3779B1u) ^ (p >> 16);
+        }
+
+        /** Doubles the number of slots and reinserts the ids.
+         */
+        void grow() {
+            IdVector old_slots( _slots.size() * 2, static_cast<point_id>(EMPTY));
+            old_slots.swap( _slots);
+            std::vector<std::size_t> old_used_slots;
+            old_used_slots.reserve( _slots.size() / 2);
+            old_used_slots.swap( _used_slots);
+            for( std::vector<std::size_t>::const_iterator it=old_used_slots.begin(); it!=old_used_slots.end(); ++it)
+                insert( old_slots[*it]);
+        }
+    };
+
+} // END namespace ANN
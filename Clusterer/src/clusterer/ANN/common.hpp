@@ -0,0 +1,79 @@
+/******************************************************************************
+/* @file Contains common elements, constants and typedefs of the ANN module,
+/*       the approximate nearest neighbor search on a k-nearest-neighbor graph.
+/*
+/* The module shares the point sets, the neighbors and the parallel loops
+/* with the OPTICS module and, like it, depends on nothing but the STL and
+/* the distance kernels.
+/*
+/*
+/* @author langenhagen
+/* @version 150715
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "../OPTICS/PointMatrix.hpp"
+#include "../OPTICS/poptics.hpp" // RangeBody, ParallelFor, serial_for()
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <cstddef>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+/// Namespace of the ANN module
+namespace ANN {
+
+    using OPTICS::real;
+    using OPTICS::UNDEFINED;
+    using OPTICS::point_id;
+    using OPTICS::IdVector;
+    using OPTICS::PointMatrix;
+    using OPTICS::Neighbor;
+    using OPTICS::NeighborVector;
+    using OPTICS::RangeBody;
+    using OPTICS::ParallelFor;
+    using OPTICS::serial_for;
+
+
+    /** Orders neighbors by their distances, then by their ids.
+     * @param a The one neighbor.
+     * @param b The other neighbor.
+     * @return TRUE if a is closer than b, FALSE otherwise.
+     */
+    inline bool is_closer( const Neighbor& a, const Neighbor& b) {
+        return a.squared_distance < b.squared_distance || (a.squared_distance == b.squared_distance && a.id < b.id);
+    }
+
+
+    /** Computes the squared euclidean distance between two coordinate vectors.
+     * @param a The coordinates of the one vector.
+     * @param b The coordinates of the other vector.
+     * @param n_dims The dimensionality of the vectors.
+     * @return The squared euclidean distance.
+     */
+    inline real squared_distance( const real* a, const real* b, const std::size_t n_dims) {
+        return distances::squared_l2( a, b, n_dims);
+    }
+
+
+    /** Draws the next number of a 64 bit SplitMix sequence.
+     * Gives every point its own reproducible random numbers, independent of the thread that processes it.
+     * @param[in,out] io_state The state of the sequence.
+     * @return A pseudo random number.
+     */
+    inline unsigned long long split_mix( unsigned long long& io_state) {
+        io_state += 0x9E3779B97F4A7C15ULL;
+        unsigned long long z = io_state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+} // END namespace ANN
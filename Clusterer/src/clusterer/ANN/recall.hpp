@@ -0,0 +1,170 @@
+/******************************************************************************
+/* @file Contains functions that measure the recall of the approximate
+/*       k-nearest-neighbor search against an exhaustive search, and that
+/*       choose the search width for a targeted recall.
+/*
+/*
+/* @author langenhagen
+/* @version 150715
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "KNNGraph.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm>
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace ANN {
+
+    /** The relative tolerance by which a found point may be farther away than the k-th exact neighbor and still count as found.
+     * A loaded graph may hold distances that the distance kernels of another instruction set level computed and rounded differently.
+     */
+    const real RECALL_DISTANCE_TOLERANCE = real(1e-5);
+
+
+    /** Finds the exact k nearest neighbors of an indexed point by comparing it with all other points.
+     * @param points The points.
+     * @param p The id of the point.
+     * @param k The number of neighbors.
+     * @return The up to k nearest points with their squared distances, closest first.
+     */
+    template<typename Points>
+    NeighborVector exhaustive_knn( const Points& points, const point_id p, const unsigned int k) {
+        NeighborVector ret;
+        const point_id n_points = static_cast<point_id>(points.size());
+        for( point_id q=0; q<n_points; ++q) {
+            if( q == p)
+                continue;
+            const Neighbor n( q, points.squared_distance( p, q));
+            if( ret.size() < k) {
+                ret.push_back( n);
+                std::push_heap( ret.begin(), ret.end(), is_closer);
+            } else if( k > 0 && is_closer( n, ret.front())) {
+                std::pop_heap( ret.begin(), ret.end(), is_closer);
+                ret.back() = n;
+                std::push_heap( ret.begin(), ret.end(), is_closer);
+            }
+        }
+        std::sort_heap( ret.begin(), ret.end(), is_closer);
+        return ret;
+    }
+
+
+    /** Chooses evenly spread indexed points whose neighbors the recall is measured on.
+     * @param n_points The number of points.
+     * @param n_samples The number of sample points.
+     * @return The ids of the up to n_samples sample points.
+     */
+    inline IdVector recall_samples( const std::size_t n_points, const std::size_t n_samples) {
+        IdVector ret;
+        const std::size_t n = std::min( n_points, n_samples);
+        for( std::size_t i=0; i<n; ++i)
+            ret.push_back( static_cast<point_id>(i * n_points / n));
+        return ret;
+    }
+
+
+    /** @brief The exact nearest neighbors of sample points, against which the approximate search is measured.
+     * Computing them costs a scan of all points per sample, so they are computed once for all search widths.
+     */
+    struct RecallReference {
+        IdVector samples;                       ///< The ids of the sample points.
+        std::vector<real> kth_distances;        ///< The squared distance of every sample point to its k-th nearest neighbor.
+        unsigned int k;                         ///< The number of neighbors.
+    };
+
+
+    /** Computes the exact k nearest neighbors of sample points in parallel.
+     * @param points The points.
+     * @param samples The ids of the sample points.
+     * @param k The number of neighbors.
+     * @param parallel_for Runs the parallel loop.
+     * @return The squared k-th nearest neighbor distances of the samples.
+     */
+    template<typename Points>
+    RecallReference recall_reference( const Points& points, const IdVector& samples, const unsigned int k, const ParallelFor& parallel_for) {
+        RecallReference ret;
+        ret.samples = samples;
+        ret.k = k;
+        ret.kth_distances.assign( samples.size(), UNDEFINED);
+        parallel_for( samples.size(), [&points, &ret, k]( const std::size_t begin, const std::size_t end) {
+            for( std::size_t i=begin; i<end; ++i) {
+                const NeighborVector exact = exhaustive_knn( points, ret.samples[i], k);
+                if( !exact.empty())
+                    ret.kth_distances[i] = exact.back().squared_distance;
+            }
+        });
+        return ret;
+    }
+
+
+    /** Measures the recall of the approximate k-nearest-neighbor search of a graph.
+     * The recall is the fraction of the exact k nearest neighbors that the search finds.
+     * A point found at the distance of the k-th exact neighbor counts as found, so that ties do not matter.
+     * @see RECALL_DISTANCE_TOLERANCE
+     * @param graph The graph.
+     * @param reference The exact neighbors of the sample points.
+     * @param search_width The number of closest points the search keeps.
+     * @param parallel_for Runs the parallel loop.
+     * @return The recall el. [0,1], 1 if there are no samples.
+     */
+    template<typename Points>
+    double measure_recall( const KNNGraph<Points>& graph, const RecallReference& reference, const unsigned int search_width, const ParallelFor& parallel_for) {
+        std::vector<unsigned int> n_found( reference.samples.size(), 0);
+        std::vector<unsigned int> n_expected( reference.samples.size(), 0);
+        parallel_for( reference.samples.size(), [&graph, &reference, &n_found, &n_expected, search_width]( const std::size_t begin, const std::size_t end) {
+            for( std::size_t i=begin; i<end; ++i) {
+                const NeighborVector approximate = graph.knn( reference.samples[i], reference.k, search_width);
+                n_expected[i] = static_cast<unsigned int>(std::min<std::size_t>( reference.k, graph.points().size() - 1));
+                const real max_squared_distance = reference.kth_distances[i] + reference.kth_distances[i] * RECALL_DISTANCE_TOLERANCE;
+                for( NeighborVector::const_iterator it=approximate.begin(); it!=approximate.end(); ++it)
+                    if( it->squared_distance <= max_squared_distance)
+                        ++n_found[i];
+            }
+        });
+
+        unsigned long long found = 0;
+        unsigned long long expected = 0;
+        for( std::size_t i=0; i<n_found.size(); ++i) {
+            found += std::min( n_found[i], n_expected[i]);
+            expected += n_expected[i];
+        }
+        return expected > 0 ? static_cast<double>(found) / expected : 1.0;
+    }
+
+
+    /** Finds the smallest power-of-two multiple of k as search width that reaches a targeted recall.
+     * @param graph The graph.
+     * @param reference The exact neighbors of the sample points.
+     * @param target_recall The targeted recall el. [0,1].
+     * @param parallel_for Runs the parallel loops.
+     * @param[out] o_recall The measured recall of the returned search width.
+     * @return The search width. Is at most the number of points, where the search becomes exhaustive
+     *         for every point that is connected to the sample points.
+     */
+    template<typename Points>
+    unsigned int tune_search_width( const KNNGraph<Points>& graph,
+                                    const RecallReference& reference,
+                                    const double target_recall,
+                                    const ParallelFor& parallel_for,
+                                    double& o_recall) {
+        const unsigned int max_search_width = static_cast<unsigned int>(std::max<std::size_t>( graph.points().size(), 1));
+        unsigned int ret = std::min( std::max( 1u, reference.k), max_search_width);
+        o_recall = measure_recall( graph, reference, ret, parallel_for);
+        while( o_recall < target_recall && ret < max_search_width) {
+            ret = std::min( 2 * ret, max_search_width);
+            o_recall = measure_recall( graph, reference, ret, parallel_for);
+        }
+        return ret;
+    }
+
+} // END namespace ANN
@@ -10,6 +10,8 @@
 // INCLUDES project headers
 
 #include <program_options.hpp>
+#include <quantization.hpp>
+#include "assignment.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
@@ -48,16 +50,9 @@ namespace app {
          * @return Returns a vector of indices that indicate the cluster index el. {0, .., probabilities.rows}.
          */
         static vector<uint> assign( const Mat1r& probabilities) {
-            vector<uint> ret;
-            ret.reserve( probabilities.rows);
-            
-            for( int r=0; r<probabilities.rows; ++r) {
-                double min, max;
-                cv::Point min_loc, max_loc;
-
-                cv::minMaxLoc( probabilities.row(r), &min, &max, &min_loc, &max_loc);
-                ret.push_back( max_loc.x);
-            }
+            vector<uint> ret( probabilities.rows);
+            if( probabilities.rows > 0)
+                cv::parallel_for_( cv::Range( 0, probabilities.rows), RowArgmax( probabilities, &ret[0]));
             return ret;
         }
 
@@ -75,6 +70,18 @@ namespace app {
         }
 
 
+        /** Clusters the given quantized features, calls a private implementation of do_cluster_quantized.
+         * @param features The row-wise quantized feature vectors to be clustered.
+         * @return A matrix that contains row-wise probabilities for each feature 
+         *         to belong to one class el. [0,1]. The matrix has as much rows 
+         *         as the given features and as much colums as clusters created.
+         * @see Clusterer::do_cluster_quantized( const QuantizedMat&)
+         */
+        Mat1r cluster( const QuantizedMat& features) const {
+            return this->do_cluster_quantized( features);
+        }
+
+
     private: // virtual interface
 
 
@@ -86,6 +93,22 @@ namespace app {
          * @see Clusterer::cluster( const Mat31&)
          */
         virtual Mat1r do_cluster( const Mat1r& features) const = 0;
+
+
+        /** Does the actual clustering on quantized features.
+         * The default implementation dequantizes the features and calls do_cluster().
+         * Clusterers that can work on the quantized representation directly override this.
+         * @param features The row-wise quantized feature vectors to be clustered.
+         * @return A matrix that contains row-wise probabilities for each feature 
+         *         to belong to one class el. [0,1]. The matrix has as much rows 
+         *         as the given features and as much colums as clusters created.
+         * @see Clusterer::cluster( const QuantizedMat&)
+         */
+        virtual Mat1r do_cluster_quantized( const QuantizedMat& features) const {
+            Mat1r dequantized_features;
+            features.dequantize( dequantized_features);
+            return this->do_cluster( dequantized_features);
+        }
     };
 
 
@@ -0,0 +1,651 @@
+/******************************************************************************
+/* @file An on-disk store of the pairwise distances of a feature set that is
+/*       built once and memory mapped by every later run on the same features.
+/*
+/* uses:
+/*          - boost.interprocess    memory mapping of the cache files
+/*
+/* @author langenhagen
+/* @version 150713
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include <common.hpp>
+#include "OPTICS/ClusterOrdering.hpp" // OPTICS::fnv1a_hash()
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    namespace bip = boost::interprocess;
+
+    /// The first bytes of every distance cache file.
+    const char DISTANCE_CACHE_FILE_MAGIC[] = "DCC2";
+
+    /// The maximum size of a condensed distance matrix; larger feature sets get a nearest neighbor list.
+    const uint64_t MAX_CONDENSED_DISTANCE_CACHE_BYTES = 1ULL << 30;
+
+
+    /// describes how the distances are stored in a distance cache
+    namespace distance_cache_layout {
+        enum distance_cache_layout {
+            CONDENSED         = 0,  ///< the nearest neighbor distances and the upper triangle of the distance matrix as half precision floats
+            NEAREST_NEIGHBORS = 1   ///< the ids and distances of the k nearest neighbors of every point
+        };
+    }
+
+
+    /** Converts a float to a half precision float, rounding to nearest even.
+     * @param f The float.
+     * @return The bits of the half precision float.
+     */
+    inline uint16_t float_to_half( const float f) {
+        uint32_t x;
+        std::memcpy( &x, &f, sizeof(x));
+        const uint32_t sign = (x >> 16) & 0x8000u;
+        const uint32_t abs = x & 0x7FFFFFFFu;
+
+        if( abs >= 0x7F800000u)                         // inf or nan
+            return static_cast<uint16_t>(sign | 0x7C00u | (abs > 0x7F800000u ? 0x200u : 0u));
+        if( abs >= 0x47800000u)                         // too large, 2^16 and above
+            return static_cast<uint16_t>(sign | 0x7C00u);
+        if( abs < 0x38800000u) {                        // subnormal or zero, below 2^-14
+            if( abs < 0x33000000u)                      // below 2^-25 rounds to zero
+                return static_cast<uint16_t>(sign);
+            const uint32_t shift = 126 - (abs >> 23);
+            const uint32_t mantissa = (abs & 0x7FFFFFu) | 0x800000u;
+            const uint32_t rest = mantissa & ((1u << shift) - 1);
+            const uint32_t halfway = 1u << (shift - 1);
+            uint32_t h = mantissa >> shift;
+            if( rest > halfway || (rest == halfway && (h & 1)))
+                ++h;
+            return static_cast<uint16_t>(sign | h);
+        }
+        uint32_t h = (abs - 0x38000000u) >> 13;         // rebias the exponent from 127 to 15
+        const uint32_t rest = abs & 0x1FFFu;
+        if( rest > 0x1000u || (rest == 0x1000u && (h & 1)))
+            ++h;                                        // may carry into the exponent, up to inf
+        return static_cast<uint16_t>(sign | h);
+    }
+
+
+    /** Converts a half precision float to a float.
+     * @param h The bits of the half precision float.
+     * @return The float.
+     */
+    inline float half_to_float( const uint16_t h) {
+        const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+        uint32_t exponent = (h >> 10) & 0x1Fu;
+        uint32_t mantissa = h & 0x3FFu;
+        uint32_t x;
+
+        if( exponent == 0x1Fu) {                        // inf or nan
+            x = sign | 0x7F800000u | (mantissa << 13);
+        } else if( exponent != 0) {
+            x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        } else if( mantissa == 0) {
+            x = sign;
+        } else {                                        // subnormal, normalize it
+            exponent = 113;
+            while( (mantissa & 0x400u) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            x = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+        float ret;
+        std::memcpy( &ret, &x, sizeof(ret));
+        return ret;
+    }
+
+
+    /** @brief The pairwise distances of a feature set, stored in a memory mapped file.
+     * Density based clusterers that run repeatedly on the same features with different parameters
+     * compute the same distances over and over. The cache computes them once, in parallel, and
+     * later runs map the file into memory instead. Files are identified by a hash of the features.
+     * Moderate feature sets get the condensed upper triangle of the distance matrix in half
+     * precision, which has a relative error of about 1/2048, preceded by the distance of every
+     * point to its nearest neighbor. Larger ones get the k nearest neighbors of every point,
+     * which is all that kNN based methods need.
+     */
+    class DistanceCache {
+
+    private: // types
+
+        /// The header of a cache file, followed by the distances, see distance_cache_layout.
+        struct Header {
+            char magic[4];              ///< DISTANCE_CACHE_FILE_MAGIC.
+            uint32_t layout;            ///< The distance_cache_layout.
+            uint64_t features_hash;     ///< The hash of the features, see features_hash().
+            uint64_t n_points;          ///< The number of points.
+            uint64_t n_neighbors;       ///< The number of neighbors per point for NEAREST_NEIGHBORS, 0 otherwise.
+            double scale;               ///< The factor from the stored half precision values to the distances.
+        };
+
+
+        /// Computes the rows of the condensed distance matrix.
+        class CondensedRows : public cv::ParallelLoopBody {
+
+            const Mat1r& _features;     ///< The row-wise feature vectors.
+            const float _inv_scale;     ///< The factor from the distances to the stored values.
+            uint16_t* _distances;       ///< Output: the condensed distance matrix.
+
+        public:
+
+            /** Main constructor.
+             * @param features The row-wise feature vectors.
+             * @param scale The factor from the stored half precision values to the distances.
+             * @param[out] o_distances The condensed distance matrix.
+             */
+            CondensedRows( const Mat1r& features, const double scale, uint16_t* o_distances)
+                : _features( features), _inv_scale( static_cast<float>(1 / scale)), _distances( o_distances)
+            {}
+
+            /** Computes the distances of the given rows to all following rows.
+             * The rows are compared in blocks of MANY_TO_MANY_TILE_ROWS with the rows that follow the
+             * block's first row, so that every tile of following rows is loaded once per block.
+             * Ranges should span whole blocks, see n_stripes().
+             * @param range A range of row indices.
+             */
+            virtual void operator()( const cv::Range& range) const {
+                const uint64_t n = static_cast<uint64_t>(_features.rows);
+                const int block_size = static_cast<int>(distances::MANY_TO_MANY_TILE_ROWS);
+                if( range.start + 1 >= _features.rows)
+                    return;
+                // the first block has the most following rows
+                Vec1r squared_distances( static_cast<std::size_t>(std::min( block_size, range.size())) * (_features.rows - range.start - 1));
+                for( int block=range.start; block<range.end; block+=block_size) {
+                    const int block_end = std::min( block + block_size, range.end);
+                    const int n_following = _features.rows - block - 1;
+                    if( n_following == 0)
+                        continue;
+                    distances::many_to_many( distances::metric::SQUARED_L2,
+                                             _features[block], block_end - block, _features.step1(),
+                                             _features[block+1], n_following, _features.step1(),
+                                             _features.cols, &squared_distances[0], n_following);
+                    for( int i=block; i<block_end && i+1<_features.rows; ++i) {
+                        const real* row = &squared_distances[static_cast<std::size_t>(i - block) * n_following];
+                        uint16_t* out = _distances + condensed_index( n, i, i+1);
+                        for( int j=i-block; j<n_following; ++j)
+                            *out++ = float_to_half( std::sqrt( row[j]) * _inv_scale);
+                    }
+                }
+            }
+
+            /** Computes the number of stripes for cv::parallel_for_ so that every stripe holds one block of rows.
+             * @param n_rows The number of rows.
+             * @return The number of stripes.
+             */
+            static double n_stripes( const int n_rows) {
+                const int block_size = static_cast<int>(distances::MANY_TO_MANY_TILE_ROWS);
+                return static_cast<double>((n_rows + block_size - 1) / block_size);
+            }
+
+        private:
+            /// Not assignable.
+            CondensedRows& operator=( const CondensedRows&);
+        };
+
+
+        /// Finds the nearest neighbor distances in a filled condensed distance matrix.
+        class CondensedNearestNeighbors : public cv::ParallelLoopBody {
+
+            const uint64_t _n;              ///< The number of points.
+            const uint16_t* _distances;     ///< The condensed distance matrix.
+            const double _scale;            ///< The factor from the stored half precision values to the distances.
+            float* _nearest;                ///< Output: the distance of every point to its nearest neighbor.
+
+        public:
+
+            /** Main constructor.
+             * @param n The number of points.
+             * @param distances The condensed distance matrix.
+             * @param scale The factor from the stored half precision values to the distances.
+             * @param[out] o_nearest The distance of every point to its nearest neighbor.
+             */
+            CondensedNearestNeighbors( const uint64_t n, const uint16_t* distances, const double scale, float* o_nearest)
+                : _n( n), _distances( distances), _scale( scale), _nearest( o_nearest)
+            {}
+
+            /** Scans the column and the row of the given points in the condensed matrix.
+             * @param range A range of row indices.
+             */
+            virtual void operator()( const cv::Range& range) const {
+                for( int i=range.start; i<range.end; ++i) {
+                    const uint64_t p = static_cast<uint64_t>(i);
+                    float ret = std::numeric_limits<float>::max();
+                    for( uint64_t q=0; q<p; ++q)
+                        ret = std::min( ret, half_to_float( _distances[condensed_index( _n, q, p)]));
+                    const uint16_t* row = _distances + (p+1 < _n ? condensed_index( _n, p, p+1) : 0);
+                    for( uint64_t q=p+1; q<_n; ++q)
+                        ret = std::min( ret, half_to_float( *row++));
+                    _nearest[p] = ret < std::numeric_limits<float>::max() ? static_cast<float>(ret * _scale) : ret;
+                }
+            }
+
+        private:
+            /// Not assignable.
+            CondensedNearestNeighbors& operator=( const CondensedNearestNeighbors&);
+        };
+
+
+        /// Computes the nearest neighbor lists.
+        class NearestNeighborRows : public cv::ParallelLoopBody {
+
+            const Mat1r& _features;     ///< The row-wise feature vectors.
+            const uint _k;              ///< The number of neighbors per point.
+            uint32_t* _ids;             ///< Output: the ids of the k nearest neighbors per point.
+            float* _distances;          ///< Output: the distances of the k nearest neighbors per point.
+
+        public:
+
+            /** Main constructor.
+             * @param features The row-wise feature vectors.
+             * @param k The number of neighbors per point, smaller than the number of points.
+             * @param[out] o_ids The ids of the k nearest neighbors per point.
+             * @param[out] o_distances The distances of the k nearest neighbors per point.
+             */
+            NearestNeighborRows( const Mat1r& features, const uint k, uint32_t* o_ids, float* o_distances)
+                : _features( features), _k( k), _ids( o_ids), _distances( o_distances)
+            {}
+
+            /** Finds the nearest neighbors of the given rows by a linear scan.
+             * @param range A range of row indices.
+             */
+            virtual void operator()( const cv::Range& range) const {
+                std::vector<std::pair<real,uint32_t>> candidates;
+                candidates.reserve( _features.rows);
+                Vec1r squared_distances( _features.rows);
+                for( int i=range.start; i<range.end; ++i) {
+                    distances::one_to_many( distances::metric::SQUARED_L2, _features[i], _features[0], _features.rows, _features.step1(), _features.cols, &squared_distances[0]);
+                    candidates.clear();
+                    for( int j=0; j<_features.rows; ++j)
+                        if( j != i)
+                            candidates.push_back( std::make_pair( squared_distances[j], static_cast<uint32_t>(j)));
+                    std::partial_sort( candidates.begin(), candidates.begin() + _k, candidates.end());
+
+                    const std::size_t offset = static_cast<std::size_t>(i) * _k;
+                    for( uint n=0; n<_k; ++n) {
+                        _ids[offset+n] = candidates[n].second;
+                        _distances[offset+n] = std::sqrt( candidates[n].first);
+                    }
+                }
+            }
+
+        private:
+            /// Not assignable.
+            NearestNeighborRows& operator=( const NearestNeighborRows&);
+        };
+
+    private: // vars
+
+        bip::mapped_region _region;     ///< The mapped cache file.
+        const Header* _header;          ///< The header of the mapped file, nullptr if no cache is open.
+
+    public: // constructor & destructor
+
+        /** Default constructor.
+         * Creates a cache that is not open.
+         */
+        DistanceCache() : _header( nullptr)
+        {}
+
+    public: // static methods
+
+        /** Computes a 64 bit FNV-1a hash of the shape and the values of the features.
+         * @param features The row-wise feature vectors.
+         * @return The hash.
+         */
+        static uint64_t features_hash( const Mat1r& features) {
+            uint64_t ret = 0xCBF29CE484222325ULL;
+            const uint64_t shape[] = { static_cast<uint64_t>(features.rows), static_cast<uint64_t>(features.cols) };
+            OPTICS::fnv1a_hash( shape, sizeof(shape), ret);
+            for( int r=0; r<features.rows; ++r)
+                OPTICS::fnv1a_hash( features[r], features.cols * sizeof(real), ret);
+            return ret;
+        }
+
+
+        /** Tells whether the condensed distance matrix of the given number of points is small enough.
+         * @param n_points The number of points.
+         * @return TRUE if a cache of the points has the CONDENSED layout.
+         */
+        static bool fits_condensed( const uint64_t n_points) {
+            return n_points * (n_points > 0 ? n_points-1 : 0) / 2 * sizeof(uint16_t) <= MAX_CONDENSED_DISTANCE_CACHE_BYTES;
+        }
+
+
+        /** Composes the name of the cache file of a feature set.
+         * @param directory The directory of the cache files.
+         * @param features_hash The hash of the features.
+         * @param layout The layout of the cache.
+         * @param n_neighbors The number of neighbors per point for NEAREST_NEIGHBORS.
+         * @return The path of the cache file.
+         */
+        static std::string file_name( const std::string& directory,
+                                      const uint64_t features_hash,
+                                      const distance_cache_layout::distance_cache_layout layout,
+                                      const uint n_neighbors) {
+            std::stringstream ss;
+            ss << "distances_" << std::hex << std::setw(16) << std::setfill('0') << features_hash;
+            if( layout == distance_cache_layout::NEAREST_NEIGHBORS)
+                ss << std::dec << "_k" << n_neighbors;
+            ss << ".bin";
+            return (bfs::path( directory) / ss.str()).string();
+        }
+
+    public: // methods
+
+        /** Maps a cache file into memory.
+         * @param fname The path to the cache file.
+         * @param features_hash The hash of the features the cache must have been built for.
+         * @param n_points The number of points the cache must have been built for.
+         * @return TRUE in case of success,
+         *         FALSE if the file does not exist or does not match. The cache is not open then.
+         */
+        bool open( const std::string& fname, const uint64_t features_hash, const uint64_t n_points) {
+            close();
+            if( !bfs::exists( fname))
+                return false;
+
+            bip::mapped_region region;
+            try {
+                const bip::file_mapping mapping( fname.c_str(), bip::read_only);
+                bip::mapped_region( mapping, bip::read_only).swap( region);
+            } catch( const bip::interprocess_exception&) {
+                on_open_file_error( fname);
+                return false;
+            }
+
+            const Header* header = static_cast<const Header*>(region.get_address());
+            if( region.get_size() < sizeof(Header) ||
+                std::memcmp( header->magic, DISTANCE_CACHE_FILE_MAGIC, 4) != 0 ||
+                header->layout > distance_cache_layout::NEAREST_NEIGHBORS ||
+                header->features_hash != features_hash ||
+                header->n_points != n_points ||
+                region.get_size() != file_size( static_cast<distance_cache_layout::distance_cache_layout>(header->layout), n_points, header->n_neighbors)) {
+                return false;
+            }
+
+            _region.swap( region);
+            _header = static_cast<const Header*>(_region.get_address());
+            return true;
+        }
+
+
+        /** Computes the distances of the features in parallel, writes them to a cache file and maps it.
+         * The file is written under a temporary name first, so that concurrent runs never map a half written cache.
+         * @param fname The path to the cache file.
+         * @param features The row-wise feature vectors.
+         * @param layout The layout of the cache.
+         * @param n_neighbors The number of neighbors per point for NEAREST_NEIGHBORS.
+         *        Will be reduced to the number of points - 1.
+         * @return TRUE in case of success,
+         *         FALSE in case of error. The cache is not open then.
+         */
+        bool build( const std::string& fname,
+                    const Mat1r& features,
+                    const distance_cache_layout::distance_cache_layout layout,
+                    uint n_neighbors) {
+            close();
+            const uint64_t n_points = static_cast<uint64_t>(features.rows);
+            if( layout == distance_cache_layout::CONDENSED)
+                n_neighbors = 0;
+            else
+                n_neighbors = static_cast<uint>(std::min<uint64_t>( n_neighbors, n_points > 0 ? n_points-1 : 0));
+
+            Header header;
+            std::memcpy( header.magic, DISTANCE_CACHE_FILE_MAGIC, 4);
+            header.layout = layout;
+            header.features_hash = features_hash( features);
+            header.n_points = n_points;
+            header.n_neighbors = n_neighbors;
+            header.scale = layout == distance_cache_layout::CONDENSED ? condensed_scale( features) : 1.0;
+
+            const std::string tmp_fname = fname + ".tmp";
+            {
+                std::ofstream out_file( tmp_fname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+                if( !out_file.is_open() || !out_file.write( reinterpret_cast<const char*>(&header), sizeof(header))) {
+                    on_write_file_error( tmp_fname);
+                    return false;
+                }
+            }
+
+            try {
+                bfs::resize_file( tmp_fname, file_size( layout, n_points, n_neighbors));
+                const bip::file_mapping mapping( tmp_fname.c_str(), bip::read_write);
+                bip::mapped_region region( mapping, bip::read_write);
+                char* data = static_cast<char*>(region.get_address()) + sizeof(Header);
+
+                if( n_points > 1) {
+                    if( layout == distance_cache_layout::CONDENSED) {
+                        float* nearest = reinterpret_cast<float*>(data);
+                        uint16_t* distances = reinterpret_cast<uint16_t*>(nearest + n_points);
+                        cv::parallel_for_( cv::Range( 0, features.rows), CondensedRows( features, header.scale, distances), CondensedRows::n_stripes( features.rows));
+                        cv::parallel_for_( cv::Range( 0, features.rows), CondensedNearestNeighbors( n_points, distances, header.scale, nearest));
+                    } else if( n_neighbors > 0) {
+                        uint32_t* ids = reinterpret_cast<uint32_t*>(data);
+                        float* distances = reinterpret_cast<float*>(data + n_points * n_neighbors * sizeof(uint32_t));
+                        cv::parallel_for_( cv::Range( 0, features.rows), NearestNeighborRows( features, n_neighbors, ids, distances));
+                    }
+                }
+                region.flush();
+            } catch( const bip::interprocess_exception&) {
+                on_write_file_error( tmp_fname);
+                return false;
+            } catch( const bfs::filesystem_error&) {
+                on_write_file_error( tmp_fname);
+                return false;
+            }
+
+            boost::system::error_code ec;
+            bfs::remove( fname, ec);
+            bfs::rename( tmp_fname, fname, ec);
+            if( ec) {
+                on_write_file_error( fname);
+                return false;
+            }
+            return open( fname, header.features_hash, n_points);
+        }
+
+
+        /** Unmaps the cache file.
+         */
+        void close() {
+            bip::mapped_region().swap( _region);
+            _header = nullptr;
+        }
+
+
+        /** Tells whether a cache file is mapped.
+         * @return TRUE if the cache is open.
+         */
+        bool is_open() const {
+            return _header != nullptr;
+        }
+
+
+        /** Retrieves the layout of the open cache.
+         * @return The layout.
+         */
+        distance_cache_layout::distance_cache_layout layout() const {
+            assert( is_open());
+            return static_cast<distance_cache_layout::distance_cache_layout>(_header->layout);
+        }
+
+
+        /** Retrieves the number of points of the open cache.
+         * @return The number of points.
+         */
+        uint64_t size() const {
+            assert( is_open());
+            return _header->n_points;
+        }
+
+
+        /** Retrieves the number of neighbors per point of an open NEAREST_NEIGHBORS cache.
+         * @return The number of neighbors per point.
+         */
+        uint n_neighbors() const {
+            assert( is_open());
+            return static_cast<uint>(_header->n_neighbors);
+        }
+
+
+        /** Retrieves the distance between two points from an open CONDENSED cache.
+         * @param a The index of the one point.
+         * @param b The index of the other point.
+         * @return The distance, up to half precision.
+         */
+        real distance( const uint64_t a, const uint64_t b) const {
+            assert( is_open() && layout() == distance_cache_layout::CONDENSED && a < size() && b < size());
+            if( a == b)
+                return 0;
+            const uint16_t* distances = reinterpret_cast<const uint16_t*>(reinterpret_cast<const float*>(_header + 1) + _header->n_points);
+            const uint16_t h = a < b ? distances[condensed_index( _header->n_points, a, b)]
+                                     : distances[condensed_index( _header->n_points, b, a)];
+            return static_cast<real>(half_to_float( h) * _header->scale);
+        }
+
+
+        /** Retrieves the ids of the nearest neighbors of a point from an open NEAREST_NEIGHBORS cache.
+         * @param p The index of the point.
+         * @return n_neighbors() ids, ordered by ascending distance.
+         */
+        const uint32_t* neighbor_ids( const uint64_t p) const {
+            assert( is_open() && layout() == distance_cache_layout::NEAREST_NEIGHBORS && p < size());
+            return reinterpret_cast<const uint32_t*>(_header + 1) + p * _header->n_neighbors;
+        }
+
+
+        /** Retrieves the distances to the nearest neighbors of a point from an open NEAREST_NEIGHBORS cache.
+         * @param p The index of the point.
+         * @return n_neighbors() distances in ascending order.
+         */
+        const float* neighbor_distances( const uint64_t p) const {
+            assert( is_open() && layout() == distance_cache_layout::NEAREST_NEIGHBORS && p < size());
+            const uint32_t* ids_end = reinterpret_cast<const uint32_t*>(_header + 1) + _header->n_points * _header->n_neighbors;
+            return reinterpret_cast<const float*>(ids_end) + p * _header->n_neighbors;
+        }
+
+
+        /** Retrieves the distance of a point to its nearest neighbor, for either layout.
+         * Both layouts store it, so the lookup takes constant time.
+         * @param p The index of the point.
+         * @return The distance or std::numeric_limits<real>::max() if there is no other point.
+         */
+        real nearest_neighbor_distance( const uint64_t p) const {
+            assert( is_open() && p < size());
+            real ret = std::numeric_limits<real>::max();
+            if( layout() == distance_cache_layout::NEAREST_NEIGHBORS) {
+                if( _header->n_neighbors > 0)
+                    ret = neighbor_distances( p)[0];
+            } else if( _header->n_points > 1) {
+                ret = reinterpret_cast<const float*>(_header + 1)[p];
+            }
+            return ret;
+        }
+
+    private: // helpers
+
+        /** Computes the position of a distance in the condensed matrix.
+         * @param n The number of points.
+         * @param a The smaller index.
+         * @param b The greater index.
+         * @return The position of the distance between a and b.
+         */
+        static uint64_t condensed_index( const uint64_t n, const uint64_t a, const uint64_t b) {
+            return a * (2*n - a - 1) / 2 + (b - a - 1);
+        }
+
+
+        /** Computes the size of a cache file.
+         * @param layout The layout of the cache.
+         * @param n_points The number of points.
+         * @param n_neighbors The number of neighbors per point for NEAREST_NEIGHBORS.
+         * @return The size in bytes.
+         */
+        static uint64_t file_size( const distance_cache_layout::distance_cache_layout layout, const uint64_t n_points, const uint64_t n_neighbors) {
+            if( layout == distance_cache_layout::CONDENSED)
+                return sizeof(Header) + n_points * sizeof(float) + n_points * (n_points > 0 ? n_points-1 : 0) / 2 * sizeof(uint16_t);
+            return sizeof(Header) + n_points * n_neighbors * (sizeof(uint32_t) + sizeof(float));
+        }
+
+
+        /** Chooses the scale of the stored half precision values, so that the diagonal
+         * of the bounding box of the features maps well into the range of half precision.
+         * @param features The row-wise feature vectors.
+         * @return The factor from the stored values to the distances.
+         */
+        static double condensed_scale( const Mat1r& features) {
+            if( features.rows == 0)
+                return 1;
+            Mat1r min_values, max_values;
+            cv::reduce( features, min_values, 0, CV_REDUCE_MIN);
+            cv::reduce( features, max_values, 0, CV_REDUCE_MAX);
+            const double diagonal = cv::norm( min_values, max_values, cv::NORM_L2);
+            return diagonal > 0 ? diagonal / 32768 : 1;
+        }
+
+    private:
+        /// Not copyable.
+        DistanceCache( const DistanceCache&);
+        /// Not assignable.
+        DistanceCache& operator=( const DistanceCache&);
+    };
+
+
+    /** Maps the distance cache of the given features from the cache directory and builds it if it does not exist.
+     * The layout is CONDENSED if the condensed distance matrix fits into MAX_CONDENSED_DISTANCE_CACHE_BYTES
+     * and NEAREST_NEIGHBORS otherwise.
+     * @param directory The directory of the cache files. Empty for no cache.
+     * @param n_neighbors The number of neighbors per point for NEAREST_NEIGHBORS.
+     * @param features The row-wise feature vectors.
+     * @param[out] o_cache The cache.
+     * @return TRUE if the cache is open,
+     *         FALSE if the directory is empty or the cache could not be built.
+     */
+    inline bool load_or_build_distance_cache( const std::string& directory,
+                                              const uint n_neighbors,
+                                              const Mat1r& features,
+                                              DistanceCache& o_cache) {
+        if( directory.empty())
+            return false;
+
+        const uint64_t hash = DistanceCache::features_hash( features);
+        const distance_cache_layout::distance_cache_layout layout = DistanceCache::fits_condensed( features.rows) ? distance_cache_layout::CONDENSED
+                                                                                                                : distance_cache_layout::NEAREST_NEIGHBORS;
+        const std::string fname = DistanceCache::file_name( directory, hash, layout, n_neighbors);
+        if( o_cache.open( fname, hash, features.rows)) {
+            LOG(info) << "Mapped the distance cache \"" << fname << "\".";
+            return true;
+        }
+
+        boost::system::error_code ec;
+        bfs::create_directories( directory, ec);
+        LOG(info) << "Building the distance cache \"" << fname << "\"...";
+        return o_cache.build( fname, features, layout, n_neighbors);
+    }
+
+}
@@ -0,0 +1,577 @@
+/******************************************************************************
+/* @file Exact k means clusterer, accelerated with the triangle inequality.
+/*
+/* @author langenhagen
+/* @version 150703
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "Clusterer.hpp"
+#include "kmeans_initialization.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /** @brief Exact k means clusterer.
+     * Runs Lloyd's algorithm, but keeps an upper bound of every feature vector's distance
+     * to its center and lower bounds of its distances to the other centers, so that most
+     * distance computations can be skipped by means of the triangle inequality.
+     * Hamerly's variant keeps one lower bound per feature vector and suits few clusters,
+     * Elkan's variant keeps one lower bound per feature vector and cluster and suits many clusters.
+     * Ties are broken towards the lowest center index, so all variants produce the same
+     * assignments as plain Lloyd for the same initialization.
+     * @see C. Elkan: Using the Triangle Inequality to Accelerate k-Means. ICML 2003.
+     * @see G. Hamerly: Making k-means even faster. SDM 2010.
+     */
+    class ExactKMeansClusterer : public Clusterer {
+
+    public: // types
+
+        /// The k means variant.
+        enum kmeans_algorithm {
+            AUTO    = 0,    ///< Elkan for many clusters if the bounds fit into memory, Hamerly otherwise
+            HAMERLY = 1,    ///< one lower bound per feature vector
+            ELKAN   = 2,    ///< one lower bound per feature vector and cluster
+            LLOYD   = 3     ///< plain Lloyd, computes all distances in every iteration
+        };
+
+    private: // types
+
+        /** @brief State of one k means run, shared by the parallel loop bodies.
+         */
+        struct kmeans_state {
+            const Mat1r& features;              ///< The row-wise feature vectors.
+            kmeans_algorithm algorithm;         ///< The variant. Never AUTO.
+            int n_clusters;                     ///< The number of clusters.
+            vector<double> centers;             ///< The row-wise centers.
+            vector<double> center_distances;    ///< The distances between all centers (Elkan).
+            vector<double> half_min_center_distances; ///< Half the distance of each center to its nearest other center.
+            vector<double> drifts;              ///< How far each center moved in the last update.
+            vector<int> labels;                 ///< The index of the center of each feature vector.
+            vector<double> upper_bounds;        ///< Upper bound of each feature vector's distance to its center.
+            vector<double> lower_bounds;        ///< Lower bounds, one per feature vector (Hamerly) or per feature vector and center (Elkan).
+
+            /** Main constructor.
+             * @param f The row-wise feature vectors.
+             */
+            kmeans_state( const Mat1r& f)
+                : features(f)
+            {}
+
+        private:
+            /// Not assignable.
+            kmeans_state& operator=( const kmeans_state&);
+        };
+
+
+        /** @brief Assigns blocks of feature vectors to their nearest centers.
+         */
+        class Assignment : public cv::ParallelLoopBody {
+
+            kmeans_state& _state;               ///< The k means state.
+            const bool _is_initial;             ///< Whether there are no valid bounds yet.
+            vector<int>& _n_changed_per_block;  ///< Output: the number of changed labels per block.
+
+        public:
+
+            /// The number of feature vectors per block.
+            enum { BLOCK_SIZE = 1024 };
+
+            /** Main constructor.
+             * @param state The k means state.
+             * @param is_initial Whether there are no valid bounds yet.
+             * @param[out] o_n_changed_per_block The number of changed labels per block.
+             */
+            Assignment( kmeans_state& state, const bool is_initial, vector<int>& o_n_changed_per_block)
+                : _state(state), _is_initial(is_initial), _n_changed_per_block(o_n_changed_per_block)
+            {}
+
+            /** Assigns the feature vectors of the given blocks.
+             * @param range A range of block indices.
+             */
+            virtual void operator()( const cv::Range& range) const {
+                for( int b=range.start; b<range.end; ++b) {
+                    const int end = std::min( (b+1) * static_cast<int>(BLOCK_SIZE), _state.features.rows);
+                    int n_changed = 0;
+                    for( int i=b*BLOCK_SIZE; i<end; ++i) {
+                        const int old_label = _state.labels[i];
+                        if( _is_initial || _state.algorithm == LLOYD)
+                            assign_by_all_distances( _state, i);
+                        else if( _state.algorithm == HAMERLY)
+                            assign_hamerly( _state, i);
+                        else
+                            assign_elkan( _state, i);
+                        n_changed += _state.labels[i] != old_label;
+                    }
+                    _n_changed_per_block[b] = n_changed;
+                }
+            }
+
+        private:
+            /// Not assignable.
+            Assignment& operator=( const Assignment&);
+        };
+
+
+        /** @brief Sums up the feature vectors of each cluster and counts them, for blocks of feature vectors.
+         * Every block has its own partial sums and counts, which are added up afterwards.
+         */
+        class CenterSums : public cv::ParallelLoopBody {
+
+            const kmeans_state& _state;         ///< The k means state.
+            const int _block_size;              ///< The number of feature vectors per block.
+            vector<double>& _sums;              ///< Output: the row-wise sums of the feature vectors per block and cluster.
+            vector<int>& _counts;               ///< Output: the number of feature vectors per block and cluster.
+
+        public:
+
+            /** Main constructor.
+             * @param state The k means state.
+             * @param block_size The number of feature vectors per block.
+             * @param[out] o_sums The row-wise sums of the feature vectors per block and cluster, preallocated with zeros.
+             * @param[out] o_counts The number of feature vectors per block and cluster, preallocated with zeros.
+             */
+            CenterSums( const kmeans_state& state, const int block_size, vector<double>& o_sums, vector<int>& o_counts)
+                : _state(state), _block_size(block_size), _sums(o_sums), _counts(o_counts)
+            {}
+
+            /** Sums up the feature vectors of the given blocks.
+             * @param range A range of block indices.
+             */
+            virtual void operator()( const cv::Range& range) const {
+                const int k = _state.n_clusters;
+                const int n_dims = _state.features.cols;
+                for( int b=range.start; b<range.end; ++b) {
+                    double* block_sums = &_sums[static_cast<size_t>(b) * k * n_dims];
+                    int* block_counts = &_counts[b * k];
+                    const int end = std::min( (b+1) * _block_size, _state.features.rows);
+                    for( int i=b*_block_size; i<end; ++i) {
+                        const real* feature = _state.features[i];
+                        const int label = _state.labels[i];
+                        double* sum = block_sums + label * n_dims;
+                        for( int d=0; d<n_dims; ++d)
+                            sum[d] += feature[d];
+                        ++block_counts[label];
+                    }
+                }
+            }
+
+        private:
+            /// Not assignable.
+            CenterSums& operator=( const CenterSums&);
+        };
+
+
+        /** @brief Moves the bounds of blocks of feature vectors by the center drifts.
+         */
+        class BoundsUpdate : public cv::ParallelLoopBody {
+
+            kmeans_state& _state;               ///< The k means state.
+            const int _max_drift_center;        ///< The center that moved farthest.
+            const double _max_drift;            ///< The farthest drift.
+            const double _second_max_drift;     ///< The farthest drift of all other centers.
+
+        public:
+
+            /** Main constructor.
+             * @param state The k means state with the new drifts.
+             */
+            BoundsUpdate( kmeans_state& state)
+                : _state(state),
+                _max_drift_center( static_cast<int>( std::max_element( state.drifts.begin(), state.drifts.end()) - state.drifts.begin())),
+                _max_drift( state.drifts[_max_drift_center]),
+                _second_max_drift( second_max_drift( state.drifts, _max_drift_center))
+            {}
+
+            /** Updates the bounds of the given blocks.
+             * @param range A range of block indices.
+             */
+            virtual void operator()( const cv::Range& range) const {
+                const int k = _state.n_clusters;
+                for( int b=range.start; b<range.end; ++b) {
+                    const int end = std::min( (b+1) * static_cast<int>(Assignment::BLOCK_SIZE), _state.features.rows);
+                    for( int i=b*Assignment::BLOCK_SIZE; i<end; ++i) {
+                        const int label = _state.labels[i];
+                        _state.upper_bounds[i] += _state.drifts[label];
+                        if( _state.algorithm == HAMERLY) {
+                            _state.lower_bounds[i] -= label == _max_drift_center ? _second_max_drift : _max_drift;
+                        } else if( _state.algorithm == ELKAN) {
+                            double* lower = &_state.lower_bounds[i * k];
+                            for( int c=0; c<k; ++c)
+                                lower[c] = std::max( 0.0, lower[c] - _state.drifts[c]);
+                        }
+                    }
+                }
+            }
+
+        private:
+            /// Not assignable.
+            BoundsUpdate& operator=( const BoundsUpdate&);
+        };
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param d The description of the clusterer instance.
+         */
+        ExactKMeansClusterer( clusterer_description& d)
+            : Clusterer(d) {
+            check_and_resolve_input_errors();
+        }
+
+        /** Destructor.
+         */
+        ~ExactKMeansClusterer()
+        {}
+
+    private: // methods
+
+        /** @see Clusterer::do_cluster()
+         */
+        virtual Mat1r do_cluster( const Mat1r& features) const {
+            check_and_resolve_input_errors();
+            const Vec1r& tweak = this->description.tweak_vector;
+            const int n_clusters = std::min( static_cast<int>(tweak[0]), features.rows);
+            const int max_iterations = static_cast<int>(tweak[1]);
+            const kmeans_algorithm algorithm = resolve_algorithm( static_cast<kmeans_algorithm>( static_cast<int>(tweak[2])), features.rows, n_clusters);
+            cv::RNG rng( static_cast<uint64>(tweak[3]));
+            const center_initialization::center_initialization initialization = static_cast<center_initialization::center_initialization>( static_cast<int>(tweak[4]));
+
+            if( n_clusters == 0)
+                return Mat1r( features.rows, 0);
+
+            kmeans_state state( features);
+            state.algorithm = algorithm;
+            state.n_clusters = n_clusters;
+            Mat1r initial_centers;
+            init_centers( features, n_clusters, initialization, rng, initial_centers);
+            state.centers.assign( initial_centers.begin(), initial_centers.end());
+            const int n_iterations = run( state, max_iterations);
+
+            LOG(info) << "ExactKMeansClusterer: " << (algorithm == HAMERLY ? "Hamerly" : algorithm == ELKAN ? "Elkan" : "Lloyd")
+                      << " k means converged after " << n_iterations << " iterations.";
+            return hard_membership_probabilities( state.labels, n_clusters);
+        }
+
+    protected: // helpers
+
+        /** Chooses the k means variant if AUTO is given.
+         * @param algorithm The requested variant.
+         * @param n_features The number of feature vectors.
+         * @param n_clusters The number of clusters.
+         * @return The variant to use.
+         */
+        static kmeans_algorithm resolve_algorithm( const kmeans_algorithm algorithm, const int n_features, const int n_clusters) {
+            const double max_elkan_bounds = 1 << 26; // 512 MB of lower bounds
+            if( algorithm != AUTO)
+                return algorithm;
+            return n_clusters >= 20 && static_cast<double>(n_features) * n_clusters <= max_elkan_bounds ? ELKAN : HAMERLY;
+        }
+
+
+        /** Runs k means until no assignment changes.
+         * @param[in,out] state The k means state with initialized centers.
+         * @param max_iterations The maximum number of center updates.
+         * @return The number of center updates.
+         */
+        static int run( kmeans_state& state, const int max_iterations) {
+            const int n = state.features.rows;
+            const int k = state.n_clusters;
+            const int n_blocks = (n + Assignment::BLOCK_SIZE - 1) / Assignment::BLOCK_SIZE;
+
+            state.labels.assign( n, 0);
+            state.upper_bounds.assign( n, 0);
+            state.lower_bounds.assign( state.algorithm == ELKAN ? static_cast<size_t>(n) * k : n, 0);
+            vector<int> n_changed_per_block( n_blocks);
+
+            cv::parallel_for_( cv::Range( 0, n_blocks), Assignment( state, true, n_changed_per_block));
+
+            int iteration = 0;
+            while( iteration < max_iterations) {
+                ++iteration;
+                if( !update_centers( state))
+                    break;
+                cv::parallel_for_( cv::Range( 0, n_blocks), BoundsUpdate( state));
+                update_center_distances( state);
+
+                cv::parallel_for_( cv::Range( 0, n_blocks), Assignment( state, false, n_changed_per_block));
+                if( std::accumulate( n_changed_per_block.begin(), n_changed_per_block.end(), 0) == 0)
+                    break;
+            }
+            return iteration;
+        }
+
+
+        /** Moves every center to the mean of its feature vectors. Empty clusters keep their center.
+         * The sums are taken over at most 64 blocks of feature vectors in parallel, fewer if the
+         * partial sums would exceed 128 MB. The blocks depend on the data size only, so the
+         * result does not depend on the number of threads.
+         * @param[in,out] state The k means state.
+         * @return TRUE if any center moved, FALSE otherwise.
+         */
+        static bool update_centers( kmeans_state& state) {
+            const int max_sum_blocks = 64;
+            const size_t max_partial_sums = 1 << 24;
+            const int n = state.features.rows;
+            const int k = state.n_clusters;
+            const int n_dims = state.features.cols;
+            const size_t sums_per_block = std::max<size_t>( static_cast<size_t>(k) * n_dims, 1);
+
+            const int n_blocks = std::max( 1, std::min( max_sum_blocks, static_cast<int>( std::min<size_t>( n, max_partial_sums / sums_per_block))));
+            const int block_size = (n + n_blocks - 1) / n_blocks;
+            vector<double> partial_sums( n_blocks * sums_per_block, 0.0);
+            vector<int> partial_counts( n_blocks * k, 0);
+            cv::parallel_for_( cv::Range( 0, n_blocks), CenterSums( state, block_size, partial_sums, partial_counts));
+
+            vector<double> sums( partial_sums.begin(), partial_sums.begin() + k * n_dims);
+            vector<int> n_elems_per_cluster( partial_counts.begin(), partial_counts.begin() + k);
+            for( int b=1; b<n_blocks; ++b) {
+                const double* block_sums = &partial_sums[b * sums_per_block];
+                for( size_t j=0; j<sums.size(); ++j)
+                    sums[j] += block_sums[j];
+                const int* block_counts = &partial_counts[b * k];
+                for( int c=0; c<k; ++c)
+                    n_elems_per_cluster[c] += block_counts[c];
+            }
+
+            bool has_moved = false;
+            state.drifts.assign( k, 0.0);
+            for( int c=0; c<k; ++c) {
+                if( n_elems_per_cluster[c] == 0)
+                    continue;
+                double* center = &state.centers[c * n_dims];
+                const double* sum = &sums[c * n_dims];
+                double squared_drift = 0;
+                for( int d=0; d<n_dims; ++d) {
+                    const double mean = sum[d] / n_elems_per_cluster[c];
+                    squared_drift += (mean - center[d]) * (mean - center[d]);
+                    center[d] = mean;
+                }
+                state.drifts[c] = std::sqrt( squared_drift);
+                has_moved |= squared_drift > 0;
+            }
+            return has_moved;
+        }
+
+
+        /** Computes the distances between the centers and half the distance of each center to its nearest other center.
+         * @param[in,out] state The k means state.
+         */
+        static void update_center_distances( kmeans_state& state) {
+            const int k = state.n_clusters;
+            const int n_dims = state.features.cols;
+            state.center_distances.assign( k * k, 0.0);
+            state.half_min_center_distances.assign( k, std::numeric_limits<double>::max());
+            for( int a=0; a<k; ++a) {
+                for( int b=a+1; b<k; ++b) {
+                    const double d = distance( &state.centers[a * n_dims], &state.centers[b * n_dims], n_dims);
+                    state.center_distances[a * k + b] = state.center_distances[b * k + a] = d;
+                    state.half_min_center_distances[a] = std::min( state.half_min_center_distances[a], d / 2);
+                    state.half_min_center_distances[b] = std::min( state.half_min_center_distances[b], d / 2);
+                }
+            }
+        }
+
+
+        /** Assigns a feature vector by computing its distance to all centers.
+         * Sets the upper bound and the lower bound(s) exactly.
+         * @param[in,out] state The k means state.
+         * @param i The row index of the feature vector.
+         */
+        static void assign_by_all_distances( kmeans_state& state, const int i) {
+            const int k = state.n_clusters;
+            const int n_dims = state.features.cols;
+            const real* feature = state.features[i];
+
+            int label = 0;
+            double min_dist = std::numeric_limits<double>::max();
+            double second_min_dist = std::numeric_limits<double>::max();
+            for( int c=0; c<k; ++c) {
+                const double d = distance( feature, &state.centers[c * n_dims], n_dims);
+                if( state.algorithm == ELKAN)
+                    state.lower_bounds[static_cast<size_t>(i) * k + c] = d;
+                if( d < min_dist) {
+                    second_min_dist = min_dist;
+                    min_dist = d;
+                    label = c;
+                } else if( d < second_min_dist) {
+                    second_min_dist = d;
+                }
+            }
+            state.labels[i] = label;
+            state.upper_bounds[i] = min_dist;
+            if( state.algorithm == HAMERLY)
+                state.lower_bounds[i] = second_min_dist;
+        }
+
+
+        /** Assigns a feature vector with Hamerly's bounds.
+         * @param[in,out] state The k means state.
+         * @param i The row index of the feature vector.
+         */
+        static void assign_hamerly( kmeans_state& state, const int i) {
+            const int label = state.labels[i];
+            const double bound = std::max( state.half_min_center_distances[label], state.lower_bounds[i]);
+            if( is_safely_greater( bound, state.upper_bounds[i]))
+                return;
+
+            // tighten the upper bound
+            const int n_dims = state.features.cols;
+            state.upper_bounds[i] = distance( state.features[i], &state.centers[label * n_dims], n_dims);
+            if( is_safely_greater( bound, state.upper_bounds[i]))
+                return;
+
+            assign_by_all_distances( state, i);
+        }
+
+
+        /** Assigns a feature vector with Elkan's bounds.
+         * @param[in,out] state The k means state.
+         * @param i The row index of the feature vector.
+         */
+        static void assign_elkan( kmeans_state& state, const int i) {
+            const int k = state.n_clusters;
+            const int n_dims = state.features.cols;
+            const real* feature = state.features[i];
+            double* lower = &state.lower_bounds[static_cast<size_t>(i) * k];
+            int label = state.labels[i];
+            double upper = state.upper_bounds[i];
+
+            if( is_safely_greater( state.half_min_center_distances[label], upper))
+                return;
+
+            bool is_tight = false;
+            for( int c=0; c<k; ++c) {
+                if( c == label ||
+                    is_safely_greater( lower[c], upper) ||
+                    is_safely_greater( state.center_distances[label * k + c] / 2, upper))
+                    continue;
+
+                if( !is_tight) {
+                    upper = lower[label] = distance( feature, &state.centers[label * n_dims], n_dims);
+                    is_tight = true;
+                    if( is_safely_greater( lower[c], upper) ||
+                        is_safely_greater( state.center_distances[label * k + c] / 2, upper))
+                        continue;
+                }
+
+                const double d = lower[c] = distance( feature, &state.centers[c * n_dims], n_dims);
+                if( d < upper || d == upper && c < label) {
+                    label = c;
+                    upper = d;
+                }
+            }
+            state.labels[i] = label;
+            state.upper_bounds[i] = upper;
+        }
+
+
+        /** Checks whether a bound excludes a candidate, i.e. is greater than the upper bound
+         * by more than the accumulated rounding error of the bounds.
+         * Equal values never exclude a candidate, because ties must be broken by the center index.
+         * @param bound A lower bound of the candidate's distance.
+         * @param upper_bound The upper bound of the current center's distance.
+         * @return TRUE if the bound is definitely greater, FALSE otherwise.
+         */
+        static bool is_safely_greater( const double bound, const double upper_bound) {
+            return bound - upper_bound > 1e-10 * (std::abs( bound) + std::abs( upper_bound));
+        }
+
+
+        /** Computes the euclidean distance between a feature vector and a center.
+         * @param feature The feature vector.
+         * @param center The center.
+         * @param n_dims The dimensionality.
+         * @return The euclidean distance.
+         */
+        template< typename T>
+        static double distance( const T* feature, const double* center, const int n_dims) {
+            double ret = 0;
+            for( int d=0; d<n_dims; ++d) {
+                const double diff = feature[d] - center[d];
+                ret += diff * diff;
+            }
+            return std::sqrt( ret);
+        }
+
+
+        /** Finds the greatest value of a vector, except for the value at the given index.
+         * @param values The values. Must not be empty.
+         * @param excluded The index of the value to exclude.
+         * @return The greatest value except for the excluded one, or 0 if there is no other value.
+         */
+        static double second_max_drift( const vector<double>& values, const int excluded) {
+            double ret = 0;
+            for( int i=0; i<static_cast<int>(values.size()); ++i)
+                if( i != excluded)
+                    ret = std::max( ret, values[i]);
+            return ret;
+        }
+
+
+        /** Helper function that checks the description for errors
+         * and logs and corrects them.
+         */
+        void check_and_resolve_input_errors() const {
+            Vec1r& tweak = this->description.tweak_vector;
+
+            if( tweak.size() < 5 ||
+                tweak[0] < 1 ||                     // n_clusters (el. N+)
+                tweak[1] < 1 ||                     // max iterations (el. N+)
+                tweak[2] < AUTO || tweak[2] > LLOYD ||  // algorithm (el. {0,1,2,3})
+                tweak[3] < 0 ||                     // random seed (el. N)
+                tweak[4] < center_initialization::RANDOM || tweak[4] > center_initialization::KMEANS_PARALLEL // initialization (el. {0,1})
+                ) {
+
+                LOG(warn) << "ExactKMeansClusterer: Tweak vector must contain 5 parameters:\n"
+                             "0: the number of clusters\n"
+                             "1: the maximum number of iterations\n"
+                             "2: the algorithm: 0: auto, 1: Hamerly (few clusters), 2: Elkan (many clusters), 3: plain Lloyd\n"
+                             "3: the seed for the random number generator\n"
+                             "4: the center initialization: 0: random feature vectors, 1: k-means||";
+
+                tweak.resize(5, -1);  // if too few parameters where given
+
+                // n_clusters
+                if( tweak[0] < 1) {
+                    tweak[0] = 100;
+                    LOG(notify) << "Setting number of clusters to " << tweak[0] << ".";
+                }
+                // max iterations
+                if( tweak[1] < 1) {
+                    tweak[1] = 100;
+                    LOG(notify) << "Setting maximum number of iterations to " << tweak[1] << ".";
+                }
+                // algorithm
+                if( tweak[2] < AUTO || tweak[2] > LLOYD) {
+                    tweak[2] = AUTO;
+                    LOG(notify) << "Setting algorithm to AUTO aka " << tweak[2] << ".";
+                }
+                // random seed
+                if( tweak[3] < 0) {
+                    tweak[3] = 0;
+                    LOG(notify) << "Setting random seed to " << tweak[3] << ".";
+                }
+                // initialization
+                if( tweak[4] < center_initialization::RANDOM || tweak[4] > center_initialization::KMEANS_PARALLEL) {
+                    tweak[4] = center_initialization::KMEANS_PARALLEL;
+                    LOG(notify) << "Setting center initialization to KMEANS_PARALLEL aka " << tweak[4] << ".";
+                }
+            }
+        }
+
+    };
+
+}
@@ -0,0 +1,244 @@
+/******************************************************************************
+/* @file Contains a KD-tree with bounding boxes that answers the k-nearest-neighbor
+/*       queries of the core distances and bounds the distances between whole nodes
+/*       for the dual-tree Boruvka algorithm.
+/*
+/*
+/* @author langenhagen
+/* @version 150714
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "common.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // nth_element, push_heap, pop_heap
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace HDBSCAN {
+
+    /** @brief KD-tree whose nodes know the bounding boxes of their points.
+     * Every inner node splits the dimension with the largest spread at its median.
+     * Unlike OPTICS::KDTreeIndex, the boxes give lower bounds of the distances from a point
+     * to a node and between two nodes. Prunes well up to about a dozen dimensions.
+     * @see OPTICS::PointMatrix for the methods a point set must provide.
+     */
+    template<typename Points>
+    class KDTree {
+
+    public: // types
+
+        /// A node of the tree. Owns a contiguous range of the permuted points.
+        struct node {
+            int begin;          ///< The first position of the node's points in the permuted points.
+            int end;            ///< One past the last position of the node's points in the permuted points.
+            int left;           ///< The index of the left child, -1 for leaves.
+            int right;          ///< The index of the right child, -1 for leaves.
+            int parent;         ///< The index of the parent, -1 for the root.
+        };
+
+        /// The maximum number of points per leaf.
+        enum { LEAF_SIZE = 16 };
+
+    private: // vars
+
+        const Points& _points;          ///< The indexed points.
+        std::vector<node> _nodes;       ///< The nodes, the root first.
+        std::vector<real> _lower;       ///< The lower corners of the bounding boxes, dims() values per node.
+        std::vector<real> _upper;       ///< The upper corners of the bounding boxes, dims() values per node.
+        IdVector _ids;                  ///< The point ids, permuted so that every node owns a contiguous range.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Builds the tree.
+         * @param points The points to be indexed. Must outlive the tree.
+         */
+        KDTree( const Points& points) : _points( points), _ids( points.size()) {
+            for( std::size_t i=0; i<_ids.size(); ++i)
+                _ids[i] = static_cast<point_id>(i);
+            if( !_ids.empty())
+                build( 0, static_cast<int>(_ids.size()), -1);
+        }
+
+    public: // methods
+
+        /** Retrieves the indexed points.
+         * @return The points.
+         */
+        const Points& points() const { return _points; }
+
+        /** Retrieves the number of nodes.
+         * @return The number of nodes, 0 for an empty point set.
+         */
+        int n_nodes() const { return static_cast<int>(_nodes.size()); }
+
+        /** Retrieves a node.
+         * @param n The index of the node, 0 for the root.
+         * @return The node.
+         */
+        const node& get_node( const int n) const { return _nodes[n]; }
+
+        /** Tells whether a node is a leaf.
+         * @param n The index of the node.
+         * @return TRUE if the node has no children.
+         */
+        bool is_leaf( const int n) const { return _nodes[n].left < 0; }
+
+        /** Retrieves the id of the point at a position of the permuted points.
+         * @param i The position.
+         * @return The point id.
+         */
+        point_id id( const int i) const { return _ids[i]; }
+
+
+        /** Computes a lower bound of the squared distances between a point and the points of a node.
+         * @param p The id of the point.
+         * @param n The index of the node.
+         * @return The squared distance between the point and the node's bounding box.
+         */
+        real min_squared_distance( const point_id p, const int n) const {
+            const std::size_t n_dims = _points.dims();
+            const real* lower = &_lower[n * n_dims];
+            const real* upper = &_upper[n * n_dims];
+            real ret = 0;
+            for( std::size_t d=0; d<n_dims; ++d) {
+                const real c = _points.coordinate( p, d);
+                const real diff = c < lower[d] ? lower[d] - c : c > upper[d] ? c - upper[d] : 0;
+                ret += diff * diff;
+            }
+            return ret;
+        }
+
+
+        /** Computes a lower bound of the squared distances between the points of two nodes.
+         * @param a The index of the one node.
+         * @param b The index of the other node.
+         * @return The squared distance between the nodes' bounding boxes.
+         */
+        real min_squared_distance( const int a, const int b) const {
+            const std::size_t n_dims = _points.dims();
+            const real* lower_a = &_lower[a * n_dims];
+            const real* upper_a = &_upper[a * n_dims];
+            const real* lower_b = &_lower[b * n_dims];
+            const real* upper_b = &_upper[b * n_dims];
+            real ret = 0;
+            for( std::size_t d=0; d<n_dims; ++d) {
+                const real diff = std::max( real(0), std::max( lower_b[d] - upper_a[d], lower_a[d] - upper_b[d]));
+                ret += diff * diff;
+            }
+            return ret;
+        }
+
+
+        /** Finds the squared distance of a point to its k-th nearest neighbor, the point itself being the first.
+         * Thread-safe as long as the distance of the points is.
+         * @param p The id of the point.
+         * @param k The number of neighbors, greater than 0.
+         * @return The squared distance to the k-th nearest neighbor,
+         *         or the one to the farthest point if there are less than k points.
+         */
+        real squared_knn_distance( const point_id p, const unsigned int k) const {
+            assert( k > 0 && "k must be greater than 0");
+            std::vector<real> heap; // max-heap of the k smallest squared distances so far
+            heap.reserve( k);
+            if( !_nodes.empty())
+                knn_query( 0, p, k, heap);
+            return heap.empty() ? 0 : heap.front();
+        }
+
+    private: // helpers
+
+        /** Builds the subtree over the given range of the permuted points.
+         * @param begin The first position of the range.
+         * @param end One past the last position of the range.
+         * @param parent The index of the parent node, -1 for the root.
+         * @return The index of the subtree's root node.
+         */
+        int build( const int begin, const int end, const int parent) {
+            const int ret = static_cast<int>(_nodes.size());
+            const node n = { begin, end, -1, -1, parent };
+            _nodes.push_back( n);
+
+            // bounding box
+            const Points& points = _points;
+            const std::size_t n_dims = points.dims();
+            _lower.resize( _lower.size() + n_dims);
+            _upper.resize( _upper.size() + n_dims);
+            int split_dim = -1;
+            real max_spread = 0;
+            for( std::size_t d=0; d<n_dims; ++d) {
+                real min_value = points.coordinate( _ids[begin], d);
+                real max_value = min_value;
+                for( int i=begin+1; i<end; ++i) {
+                    min_value = std::min( min_value, points.coordinate( _ids[i], d));
+                    max_value = std::max( max_value, points.coordinate( _ids[i], d));
+                }
+                _lower[ret * n_dims + d] = min_value;
+                _upper[ret * n_dims + d] = max_value;
+                if( max_value - min_value > max_spread) {
+                    max_spread = max_value - min_value;
+                    split_dim = static_cast<int>(d);
+                }
+            }
+            if( end - begin <= LEAF_SIZE || split_dim < 0)
+                return ret; // small enough or all points are equal
+
+            const int mid = begin + (end - begin) / 2;
+            std::nth_element( _ids.begin() + begin,
+                              _ids.begin() + mid,
+                              _ids.begin() + end,
+                              [&points, split_dim]( const point_id a, const point_id b){ return points.coordinate( a, split_dim) < points.coordinate( b, split_dim); } );
+
+            const int left = build( begin, mid, ret);
+            const int right = build( mid, end, ret);
+            _nodes[ret].left = left;
+            _nodes[ret].right = right;
+            return ret;
+        }
+
+
+        /** Collects the k nearest neighbors within the given subtree.
+         * @param n The index of the subtree's root node.
+         * @param p The id of the query point.
+         * @param k The number of neighbors.
+         * @param[in,out] io_heap A max-heap of the at most k smallest squared distances found so far.
+         */
+        void knn_query( const int n, const point_id p, const unsigned int k, std::vector<real>& io_heap) const {
+            const node& current = _nodes[n];
+            if( current.left < 0) {
+                for( int i=current.begin; i<current.end; ++i) {
+                    const real sq_dist = _ids[i] == p ? 0 : _points.squared_distance( p, _ids[i]);
+                    if( io_heap.size() < k) {
+                        io_heap.push_back( sq_dist);
+                        std::push_heap( io_heap.begin(), io_heap.end());
+                    } else if( sq_dist < io_heap.front()) {
+                        std::pop_heap( io_heap.begin(), io_heap.end());
+                        io_heap.back() = sq_dist;
+                        std::push_heap( io_heap.begin(), io_heap.end());
+                    }
+                }
+                return;
+            }
+            // visit the closer child first, it shrinks the heap's top
+            const real left_dist = min_squared_distance( p, current.left);
+            const real right_dist = min_squared_distance( p, current.right);
+            const int first = left_dist <= right_dist ? current.left : current.right;
+            const int second = left_dist <= right_dist ? current.right : current.left;
+            const real second_dist = std::max( left_dist, right_dist);
+
+            if( io_heap.size() < k || std::min( left_dist, right_dist) < io_heap.front())
+                knn_query( first, p, k, io_heap);
+            if( io_heap.size() < k || second_dist < io_heap.front())
+                knn_query( second, p, k, io_heap);
+        }
+    };
+
+} // END namespace HDBSCAN
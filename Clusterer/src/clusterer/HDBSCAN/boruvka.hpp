@@ -0,0 +1,259 @@
+/******************************************************************************
+/* @file Contains the dual-tree Boruvka algorithm that finds the minimum spanning tree
+/*       of the mutual reachability graph, based on
+/*       "Fast Euclidean Minimum Spanning Tree: Algorithm, Analysis, and Applications"
+/*       by March, Ram & Gray, and its HDBSCAN adaption by McInnes & Healy.
+/*
+/* Boruvka's algorithm adds the lightest edge leaving every component in rounds.
+/* The dual-tree traversal finds these edges for whole nodes of a KD-tree at once:
+/* a pair of nodes is skipped if both lie in the same component, or if the mutual
+/* reachability distance of any two of their points exceeds the lightest edge found
+/* so far for every component of the query node. This takes roughly O(N log N)
+/* distance evaluations in low dimensions instead of the O(N²) of the full graph.
+/*
+/*
+/* @author langenhagen
+/* @version 150714
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "KDTree.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm>
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace HDBSCAN {
+
+    /** @brief Finds the minimum spanning tree of the mutual reachability graph with the dual-tree Boruvka algorithm.
+     * The mutual reachability distance of two points is the maximum of their distance and their core distances.
+     * Ties are broken by the point ids, so the tree is unique.
+     */
+    template<typename Points>
+    class DualTreeBoruvka {
+
+    private: // types
+
+        /// Marks nodes whose points belong to more than one component.
+        enum { MIXED = ~0u };
+
+    private: // vars
+
+        const KDTree<Points>& _tree;                    ///< The KD-tree over the points.
+        const std::vector<real>& _core_distances;       ///< The squared core distance of every point.
+
+        std::vector<point_id> _parents;                 ///< The union-find forest of the components.
+        std::vector<point_id> _point_components;        ///< The component of every point, i.e. its root in the forest.
+        std::vector<point_id> _node_components;         ///< The component of every node's points, or MIXED.
+        std::vector<real> _node_min_cores;              ///< The smallest squared core distance of every node's points.
+        std::vector<real> _node_bounds;                 ///< The heaviest lightest edge of the components of every node's points.
+        ForestEdgeVector _candidates;                   ///< The lightest edge leaving every component, indexed by component.
+        unsigned long long _n_distances;                ///< The number of distance evaluations so far.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param tree A KD-tree over the points. Must outlive the object.
+         * @param core_distances The squared core distance of every point, indexed by point id. Must outlive the object.
+         */
+        DualTreeBoruvka( const KDTree<Points>& tree, const std::vector<real>& core_distances)
+            : _tree( tree), _core_distances( core_distances), _n_distances( 0) {
+            assert( core_distances.size() == tree.points().size() && "one core distance per point");
+        }
+
+    public: // methods
+
+        /** Computes the minimum spanning tree.
+         * @return The n-1 edges of the tree, weighted by their squared mutual reachability distances,
+         *         in the order in which they were found.
+         */
+        ForestEdgeVector run() {
+            const std::size_t n_points = _core_distances.size();
+            const int n_nodes = _tree.n_nodes();
+            ForestEdgeVector ret;
+            if( n_points < 2)
+                return ret;
+            ret.reserve( n_points - 1);
+
+            _parents.resize( n_points);
+            for( std::size_t p=0; p<n_points; ++p)
+                _parents[p] = static_cast<point_id>(p);
+            _point_components = _parents;
+            _node_components.resize( n_nodes);
+            _node_bounds.resize( n_nodes);
+            _node_min_cores.resize( n_nodes);
+            for( int n=n_nodes-1; n>=0; --n) { // children have greater indices than their parents
+                const typename KDTree<Points>::node& current = _tree.get_node( n);
+                if( _tree.is_leaf( n)) {
+                    real min_core = OPTICS::UNDEFINED;
+                    for( int i=current.begin; i<current.end; ++i)
+                        min_core = std::min( min_core, _core_distances[_tree.id( i)]);
+                    _node_min_cores[n] = min_core;
+                } else {
+                    _node_min_cores[n] = std::min( _node_min_cores[current.left], _node_min_cores[current.right]);
+                }
+            }
+            update_node_components();
+
+            const ForestEdge no_edge = { 0, 0, OPTICS::UNDEFINED };
+            while( ret.size() < n_points - 1) {
+                _candidates.assign( n_points, no_edge);
+                std::fill( _node_bounds.begin(), _node_bounds.end(), OPTICS::UNDEFINED);
+                traverse( 0, 0);
+
+                const std::size_t n_edges = ret.size();
+                for( std::size_t c=0; c<n_points; ++c) {
+                    const ForestEdge& e = _candidates[c];
+                    if( e.weight == OPTICS::UNDEFINED)
+                        continue;
+                    const point_id root_a = find_root( _parents, e.a);
+                    const point_id root_b = find_root( _parents, e.b);
+                    if( root_a != root_b) { // both components may have found the same edge
+                        _parents[root_b] = root_a;
+                        ret.push_back( e);
+                    }
+                }
+                if( ret.size() == n_edges)
+                    break; // should never happen
+
+                for( std::size_t p=0; p<n_points; ++p)
+                    _point_components[p] = find_root( _parents, static_cast<point_id>(p));
+                update_node_components();
+            }
+            return ret;
+        }
+
+
+        /** Retrieves the number of distance evaluations.
+         * @return The number of distance evaluations so far.
+         */
+        unsigned long long n_distance_evaluations() const {
+            return _n_distances;
+        }
+
+    private: // helpers
+
+        /** Finds the component of every node's points, children before their parents.
+         */
+        void update_node_components() {
+            for( int n=_tree.n_nodes()-1; n>=0; --n) {
+                const typename KDTree<Points>::node& current = _tree.get_node( n);
+                point_id component;
+                if( _tree.is_leaf( n)) {
+                    component = _point_components[_tree.id( current.begin)];
+                    for( int i=current.begin+1; i<current.end && component != MIXED; ++i)
+                        if( _point_components[_tree.id( i)] != component)
+                            component = MIXED;
+                } else {
+                    component = _node_components[current.left] == _node_components[current.right] ? _node_components[current.left] : MIXED;
+                }
+                _node_components[n] = component;
+            }
+        }
+
+
+        /** Searches the lightest edges leaving the components of the query node's points towards the reference node's points.
+         * @param q The index of the query node.
+         * @param r The index of the reference node.
+         */
+        void traverse( const int q, const int r) {
+            if( _node_components[q] != MIXED && _node_components[q] == _node_components[r])
+                return;
+            const real lower_bound = std::max( _tree.min_squared_distance( q, r), std::max( _node_min_cores[q], _node_min_cores[r]));
+            if( lower_bound > _node_bounds[q])
+                return;
+
+            const typename KDTree<Points>::node& query = _tree.get_node( q);
+            const bool is_query_leaf = _tree.is_leaf( q);
+            const bool is_reference_leaf = _tree.is_leaf( r);
+
+            if( is_query_leaf && is_reference_leaf) {
+                search_leaves( q, r);
+            } else if( is_query_leaf) {
+                descend_reference( q, r);
+            } else {
+                // descend the query node, so that its leaves tighten their bounds early
+                if( is_reference_leaf) {
+                    traverse( query.left, r);
+                    traverse( query.right, r);
+                } else {
+                    descend_reference( query.left, r);
+                    descend_reference( query.right, r);
+                }
+                _node_bounds[q] = std::min( _node_bounds[q], std::max( _node_bounds[query.left], _node_bounds[query.right]));
+            }
+        }
+
+
+        /** Traverses the children of the reference node, the one closer to the query node first.
+         * @param q The index of the query node.
+         * @param r The index of the reference node, no leaf.
+         */
+        void descend_reference( const int q, const int r) {
+            const typename KDTree<Points>::node& reference = _tree.get_node( r);
+            const real left_dist = _tree.min_squared_distance( q, reference.left);
+            const real right_dist = _tree.min_squared_distance( q, reference.right);
+            traverse( q, left_dist <= right_dist ? reference.left : reference.right);
+            traverse( q, left_dist <= right_dist ? reference.right : reference.left);
+        }
+
+
+        /** Compares all points of two leaves and updates the bounds of the query leaf and its ancestors.
+         * @param q The index of the query leaf.
+         * @param r The index of the reference leaf.
+         */
+        void search_leaves( const int q, const int r) {
+            const Points& points = _tree.points();
+            const typename KDTree<Points>::node& query = _tree.get_node( q);
+            const typename KDTree<Points>::node& reference = _tree.get_node( r);
+
+            real bound = 0;
+            for( int i=query.begin; i<query.end; ++i) {
+                const point_id p = _tree.id( i);
+                const point_id component = _point_components[p];
+                ForestEdge& candidate = _candidates[component];
+                const real core_p = _core_distances[p];
+
+                if( core_p <= candidate.weight) {
+                    for( int j=reference.begin; j<reference.end; ++j) {
+                        const point_id s = _tree.id( j);
+                        const real core_s = _core_distances[s];
+                        if( _point_components[s] == component || core_s > candidate.weight)
+                            continue;
+                        ++_n_distances;
+                        const real weight = std::max( points.squared_distance( p, s), std::max( core_p, core_s));
+                        if( is_lighter( weight, p, s, candidate.weight, candidate.a, candidate.b)) {
+                            candidate.a = p;
+                            candidate.b = s;
+                            candidate.weight = weight;
+                        }
+                    }
+                }
+                bound = std::max( bound, candidate.weight);
+            }
+
+            // a smaller bound of the leaf may tighten the ones of its ancestors
+            _node_bounds[q] = std::min( _node_bounds[q], bound);
+            for( int parent=query.parent; parent >= 0; parent=_tree.get_node( parent).parent) {
+                const typename KDTree<Points>::node& n = _tree.get_node( parent);
+                const real parent_bound = std::max( _node_bounds[n.left], _node_bounds[n.right]);
+                if( parent_bound >= _node_bounds[parent])
+                    break;
+                _node_bounds[parent] = parent_bound;
+            }
+        }
+
+    private:
+        /// Not assignable.
+        DualTreeBoruvka& operator=( const DualTreeBoruvka&);
+    };
+
+} // END namespace HDBSCAN
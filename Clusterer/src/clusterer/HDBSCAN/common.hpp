@@ -0,0 +1,108 @@
+/******************************************************************************
+/* @file Contains common elements, constants and typedefs of the HDBSCAN module.
+/*
+/* The module shares the point sets, the union-find forest and the edge order
+/* with the OPTICS module, whose parallel variant also spans a forest with Boruvka's algorithm.
+/*
+/*
+/* @author langenhagen
+/* @version 150714
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "../OPTICS/PointMatrix.hpp"
+#include "../OPTICS/poptics.hpp" // ForestEdge, ParallelFor, find_root(), is_lighter()
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <limits>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+/// Namespace of the HDBSCAN module
+namespace HDBSCAN {
+
+    using OPTICS::real;
+    using OPTICS::point_id;
+    using OPTICS::IdVector;
+    using OPTICS::PointMatrix;
+    using OPTICS::ForestEdge;
+    using OPTICS::ForestEdgeVector;
+    using OPTICS::RangeBody;
+    using OPTICS::ParallelFor;
+    using OPTICS::serial_for;
+    using OPTICS::is_lighter;
+    using OPTICS::find_root;
+
+    /// The lambda value of points that coincide, i.e. that are 0 apart.
+    const real INFINITE_LAMBDA = std::numeric_limits<real>::max();
+
+    /// Scales the soft membership of a point in another cluster that ties with the one in its own cluster.
+    const real TIE_FACTOR = real(1) - real(1) / 1024;
+
+    /// The label of points that belong to no cluster.
+    const int NOISE = -1;
+
+
+    /// Possible cluster selection methods wrapping namespace.
+    namespace cluster_selection {
+        /// Possible cluster selection methods.
+        enum cluster_selection {
+            EXCESS_OF_MASS = 0,     ///< the clusters with the highest stability, no cluster is a descendant of another
+            LEAF           = 1      ///< the leaves of the condensed tree, many small homogeneous clusters
+        };
+    }
+
+
+    /** @brief A merge of the single linkage hierarchy.
+     * Nodes 0 to n-1 are the points, node n+i is the cluster created by the i-th merge.
+     */
+    struct Merge {
+        unsigned int left;      ///< The one merged node.
+        unsigned int right;     ///< The other merged node.
+        real distance;          ///< The mutual reachability distance at which the nodes merge.
+        unsigned int size;      ///< The number of points of the merged cluster.
+    };
+
+    /// A vector of merges.
+    typedef std::vector<Merge> MergeVector;
+
+
+    /** @brief An edge of the condensed cluster tree.
+     * Clusters are labeled from n on, the root being n, so children have greater labels than their parents.
+     * The children are either clusters or single points that fall out of their parent cluster.
+     */
+    struct CondensedEdge {
+        unsigned int parent;    ///< The label of the parent cluster.
+        unsigned int child;     ///< The label of the child cluster or the id of the point.
+        real lambda;            ///< 1 / the distance at which the child leaves the parent.
+        unsigned int size;      ///< The number of points of the child.
+    };
+
+    /// A vector of condensed edges.
+    typedef std::vector<CondensedEdge> CondensedTree;
+
+
+    /** @brief The result of an HDBSCAN run.
+     */
+    struct Result {
+        std::vector<int> labels;            ///< The cluster of every point el. {0, .., n_clusters-1} or NOISE, indexed by point id.
+        std::vector<real> strengths;        ///< The strength of the membership of every point in its cluster el. [0,1], 0 for noise.
+        std::vector<real> outlier_scores;   ///< The GLOSH outlier score of every point el. [0,1].
+        std::vector<real> memberships;      ///< Row-wise n_points x n_clusters soft membership probabilities; rows of noise are 0.
+        unsigned int n_clusters;            ///< The number of clusters.
+
+        /** Default constructor.
+         * Creates an empty result.
+         */
+        Result() : n_clusters( 0)
+        {}
+    };
+
+} // END namespace HDBSCAN
@@ -0,0 +1,376 @@
+/******************************************************************************
+/* @file Contains the HDBSCAN algorithm implementation based on the paper
+/*       "Density-Based Clustering Based on Hierarchical Density Estimates"
+/*       by Campello, Moulavi & Sander, and on
+/*       "Accelerated Hierarchical Density Based Clustering" by McInnes & Healy.
+/*
+/* The core distance of a point is the distance to its min_samples-th nearest neighbor.
+/* The minimum spanning tree of the mutual reachability distances is the single linkage
+/* hierarchy of the density levels. Condensing it, every split that leaves less than
+/* min_cluster_size points on one side is a loss of points rather than a new cluster.
+/* The clusters are selected from the condensed tree by their stability, so neither the
+/* number of clusters nor a density threshold has to be picked.
+/*
+/* The module depends on nothing but the STL and the OPTICS module: the caller decides
+/* how the parallel loops are run by passing a ParallelFor function.
+/*
+/*
+/* @author langenhagen
+/* @version 150714
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "boruvka.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace HDBSCAN {
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    template<typename Points> Result hdbscan( const Points& points,
+                                              const unsigned int min_cluster_size,
+                                              const unsigned int min_samples,
+                                              const cluster_selection::cluster_selection selection,
+                                              const ParallelFor& parallel_for);
+
+    // steps
+    template<typename Points> std::vector<real> compute_core_distances( const KDTree<Points>& tree, const unsigned int min_samples, const ParallelFor& parallel_for);
+    MergeVector single_linkage( const std::size_t n_points, ForestEdgeVector edges);
+    CondensedTree condense_tree( const MergeVector& merges, const unsigned int min_cluster_size);
+    std::vector<unsigned int> select_clusters( const std::size_t n_points, const CondensedTree& tree, const cluster_selection::cluster_selection selection);
+    void label_points( const std::size_t n_points, const CondensedTree& tree, const std::vector<unsigned int>& clusters, Result& o_result);
+
+
+
+    // HDBSCAN ####################################################################################
+
+
+    /** Clusters the points with HDBSCAN.
+     * @param points All points that are to be considered by the algorithm.
+     *        Their distance must be thread-safe.
+     * @param min_cluster_size The minimum number of points of a cluster, at least 2.
+     * @param min_samples The number of nearest neighbors that define the core distance, the point itself included.
+     * @param selection The method that selects the clusters from the condensed tree.
+     * @param parallel_for Runs the parallel loops, e.g. on a thread pool. Use serial_for() to run them serially.
+     * @return The labels, membership strengths, outlier scores and soft membership probabilities of the points.
+     */
+    template<typename Points>
+    Result hdbscan( const Points& points,
+                    const unsigned int min_cluster_size,
+                    const unsigned int min_samples,
+                    const cluster_selection::cluster_selection selection,
+                    const ParallelFor& parallel_for) {
+        assert( min_cluster_size >= 2 && "min_cluster_size must be at least 2");
+        assert( min_samples > 0 && "min_samples must be greater than 0");
+
+        const KDTree<Points> tree( points);
+        const std::vector<real> core_distances = compute_core_distances( tree, min_samples, parallel_for);
+        const ForestEdgeVector edges = DualTreeBoruvka<Points>( tree, core_distances).run();
+
+        const MergeVector merges = single_linkage( points.size(), edges);
+        const CondensedTree condensed = condense_tree( merges, min_cluster_size);
+        const std::vector<unsigned int> clusters = select_clusters( points.size(), condensed, selection);
+
+        Result ret;
+        label_points( points.size(), condensed, clusters, ret);
+        return ret;
+    }
+
+
+
+    // STEPS ######################################################################################
+
+
+    /** Computes the squared core distance of every point in parallel.
+     * @param tree A KD-tree over all points that are to be considered by the algorithm.
+     * @param min_samples The number of nearest neighbors that define the core distance, the point itself included.
+     * @param parallel_for Runs the parallel loop.
+     * @return The squared distance of every point to its min_samples-th nearest neighbor, indexed by point id.
+     */
+    template<typename Points>
+    std::vector<real> compute_core_distances( const KDTree<Points>& tree, const unsigned int min_samples, const ParallelFor& parallel_for) {
+        std::vector<real> ret( tree.points().size());
+        parallel_for( ret.size(), [&tree, &ret, min_samples]( const std::size_t begin, const std::size_t end) {
+            for( std::size_t p=begin; p<end; ++p)
+                ret[p] = tree.squared_knn_distance( static_cast<point_id>(p), min_samples);
+        });
+        return ret;
+    }
+
+
+    /** Builds the single linkage hierarchy from a minimum spanning tree.
+     * @param n_points The number of points.
+     * @param edges The n_points-1 edges of the minimum spanning tree, weighted by squared distances.
+     * @return The n_points-1 merges, ordered by ascending distance.
+     */
+    inline MergeVector single_linkage( const std::size_t n_points, ForestEdgeVector edges) {
+        std::sort( edges.begin(), edges.end(), []( const ForestEdge& a, const ForestEdge& b) {
+            return is_lighter( a.weight, a.a, a.b, b.weight, b.a, b.b);
+        });
+
+        std::vector<point_id> parents( n_points);
+        std::vector<unsigned int> nodes( n_points);     // the hierarchy node of every component, indexed by its root
+        std::vector<unsigned int> sizes( n_points, 1);  // the number of points of every component, indexed by its root
+        for( std::size_t p=0; p<n_points; ++p)
+            parents[p] = nodes[p] = static_cast<unsigned int>(p);
+
+        MergeVector ret;
+        ret.reserve( edges.size());
+        for( ForestEdgeVector::const_iterator it=edges.begin(); it!=edges.end(); ++it) {
+            const point_id root_a = find_root( parents, it->a);
+            const point_id root_b = find_root( parents, it->b);
+            assert( root_a != root_b && "the edges must form a tree");
+
+            const Merge m = { nodes[root_a], nodes[root_b], std::sqrt( it->weight), sizes[root_a] + sizes[root_b] };
+            ret.push_back( m);
+            parents[root_b] = root_a;
+            nodes[root_a] = static_cast<unsigned int>(n_points + ret.size() - 1);
+            sizes[root_a] = m.size;
+        }
+        return ret;
+    }
+
+
+    /** Condenses the single linkage hierarchy.
+     * Walking down from the root, a split into two parts of at least min_cluster_size points
+     * creates two child clusters. A smaller part is no cluster: its points fall out of the parent,
+     * which lives on in the larger part.
+     * @param merges The single linkage hierarchy.
+     * @param min_cluster_size The minimum number of points of a cluster.
+     * @return The edges of the condensed tree, every parent before its children.
+     */
+    inline CondensedTree condense_tree( const MergeVector& merges, const unsigned int min_cluster_size) {
+        CondensedTree ret;
+        if( merges.empty())
+            return ret;
+
+        const unsigned int n_points = static_cast<unsigned int>(merges.size() + 1);
+        const unsigned int root = 2 * n_points - 2;
+        std::vector<unsigned int> labels( root + 1);    // the cluster label of every hierarchy node that is a cluster
+        unsigned int next_label = n_points + 1;
+        labels[root] = n_points;
+
+        // the number of points below a hierarchy node
+        auto node_size = [&merges, n_points]( const unsigned int node) { return node < n_points ? 1u : merges[node - n_points].size; };
+
+        // adds the points below a hierarchy node to a cluster, as points that fall out of it
+        std::vector<unsigned int> stack;
+        auto fall_out = [&merges, &ret, &stack, n_points]( const unsigned int node, const unsigned int cluster, const real lambda) {
+            stack.push_back( node);
+            while( !stack.empty()) {
+                const unsigned int current = stack.back();
+                stack.pop_back();
+                if( current < n_points) {
+                    const CondensedEdge e = { cluster, current, lambda, 1 };
+                    ret.push_back( e);
+                } else {
+                    stack.push_back( merges[current - n_points].left);
+                    stack.push_back( merges[current - n_points].right);
+                }
+            }
+        };
+
+        std::vector<unsigned int> queue( 1, root);
+        for( std::size_t i=0; i<queue.size(); ++i) {
+            const unsigned int node = queue[i];
+            const Merge& m = merges[node - n_points];
+            const unsigned int cluster = labels[node];
+            const real lambda = m.distance > 0 ? 1 / m.distance : INFINITE_LAMBDA;
+            const bool is_left_cluster = node_size( m.left) >= min_cluster_size;
+            const bool is_right_cluster = node_size( m.right) >= min_cluster_size;
+
+            if( is_left_cluster && is_right_cluster) {
+                labels[m.left] = next_label++;
+                labels[m.right] = next_label++;
+                const CondensedEdge left = { cluster, labels[m.left], lambda, node_size( m.left) };
+                const CondensedEdge right = { cluster, labels[m.right], lambda, node_size( m.right) };
+                ret.push_back( left);
+                ret.push_back( right);
+                queue.push_back( m.left);
+                queue.push_back( m.right);
+            } else {
+                if( is_left_cluster) {
+                    labels[m.left] = cluster;
+                    queue.push_back( m.left);
+                } else {
+                    fall_out( m.left, cluster, lambda);
+                }
+                if( is_right_cluster) {
+                    labels[m.right] = cluster;
+                    queue.push_back( m.right);
+                } else {
+                    fall_out( m.right, cluster, lambda);
+                }
+            }
+        }
+        return ret;
+    }
+
+
+    /** Selects the clusters of the condensed tree. The root is never selected.
+     * EXCESS_OF_MASS selects a cluster instead of its descendants if its stability is at least the sum of
+     * theirs. The stability of a cluster sums up how long, in lambda, each of its points stays in it.
+     * @param n_points The number of points.
+     * @param tree The condensed tree.
+     * @param selection The selection method.
+     * @return The labels of the selected clusters in ascending order.
+     */
+    inline std::vector<unsigned int> select_clusters( const std::size_t n_points, const CondensedTree& tree, const cluster_selection::cluster_selection selection) {
+        std::vector<unsigned int> ret;
+        unsigned int n_labels = 0;
+        for( CondensedTree::const_iterator it=tree.begin(); it!=tree.end(); ++it)
+            n_labels = std::max( n_labels, std::max( it->parent, it->child) + 1);
+        if( n_labels <= n_points + 1)
+            return ret; // the root is the only cluster
+
+        const unsigned int root = static_cast<unsigned int>(n_points);
+        std::vector<unsigned int> parents( n_labels, root);
+        std::vector<real> births( n_labels, 0);
+        std::vector<double> stabilities( n_labels, 0);
+        std::vector<char> has_children( n_labels, 0);
+        for( CondensedTree::const_iterator it=tree.begin(); it!=tree.end(); ++it) {
+            if( it->child >= n_points) {
+                parents[it->child] = it->parent;
+                births[it->child] = it->lambda;
+                has_children[it->parent] = 1;
+            }
+        }
+        for( CondensedTree::const_iterator it=tree.begin(); it!=tree.end(); ++it) // parents before children
+            stabilities[it->parent] += (static_cast<double>(it->lambda) - births[it->parent]) * it->size;
+
+        // children have greater labels than their parents
+        std::vector<char> is_selected( n_labels, 0);
+        if( selection == cluster_selection::LEAF) {
+            for( unsigned int c=root+1; c<n_labels; ++c)
+                is_selected[c] = !has_children[c];
+        } else {
+            std::vector<double> subtree_stabilities( n_labels, 0);
+            for( unsigned int c=n_labels-1; c>root; --c) {
+                if( has_children[c] && subtree_stabilities[c] > stabilities[c]) {
+                    stabilities[c] = subtree_stabilities[c];
+                } else {
+                    is_selected[c] = 1;
+                }
+                subtree_stabilities[parents[c]] += stabilities[c];
+            }
+            // unselect the descendants of selected clusters
+            std::vector<char> is_covered( n_labels, 0);
+            for( unsigned int c=root+1; c<n_labels; ++c) {
+                if( is_covered[parents[c]])
+                    is_selected[c] = 0;
+                is_covered[c] = is_covered[parents[c]] || is_selected[c];
+            }
+        }
+
+        for( unsigned int c=root+1; c<n_labels; ++c)
+            if( is_selected[c])
+                ret.push_back( c);
+        return ret;
+    }
+
+
+    /** Labels the points by the selected clusters and computes the membership strengths,
+     * the GLOSH outlier scores and the soft membership probabilities.
+     * A point belongs to the selected cluster it falls out of, or that one of its ancestors is.
+     * Its soft membership in a cluster is the lambda up to which it stays connected to that cluster:
+     * its own lambda for its cluster, the lambda of the split that separates the two clusters otherwise.
+     * A point that falls out right at such a split is connected to both clusters equally long;
+     * the tie goes to its own cluster, so that the greatest membership is always the label.
+     * @param n_points The number of points.
+     * @param tree The condensed tree.
+     * @param clusters The labels of the selected clusters in ascending order.
+     * @param[out] o_result The labels, strengths, outlier scores and memberships.
+     */
+    inline void label_points( const std::size_t n_points, const CondensedTree& tree, const std::vector<unsigned int>& clusters, Result& o_result) {
+        const unsigned int n_clusters = static_cast<unsigned int>(clusters.size());
+        o_result.n_clusters = n_clusters;
+        o_result.labels.assign( n_points, NOISE);
+        o_result.strengths.assign( n_points, 0);
+        o_result.outlier_scores.assign( n_points, 0);
+        o_result.memberships.assign( n_points * n_clusters, 0);
+        if( tree.empty())
+            return;
+
+        const unsigned int root = static_cast<unsigned int>(n_points);
+        unsigned int n_labels = root + 1;
+        for( CondensedTree::const_iterator it=tree.begin(); it!=tree.end(); ++it)
+            n_labels = std::max( n_labels, it->child + 1);
+
+        std::vector<unsigned int> parents( n_labels, root);   // the parent cluster of every point and cluster
+        std::vector<real> lambdas( n_labels, 0);              // the lambda at which every point and cluster leaves its parent
+        for( CondensedTree::const_iterator it=tree.begin(); it!=tree.end(); ++it) {
+            parents[it->child] = it->parent;
+            lambdas[it->child] = it->lambda;
+        }
+
+        // the index of every selected cluster, or of its selected ancestor
+        std::vector<int> selected( n_labels, NOISE);
+        for( unsigned int i=0; i<n_clusters; ++i)
+            selected[clusters[i]] = static_cast<int>(i);
+        for( unsigned int c=root+1; c<n_labels; ++c)
+            if( selected[c] == NOISE)
+                selected[c] = selected[parents[c]];
+
+        // the greatest lambda of the points below every cluster
+        std::vector<real> max_lambdas( n_labels, 0);
+        for( std::size_t p=0; p<n_points; ++p)
+            max_lambdas[parents[p]] = std::max( max_lambdas[parents[p]], lambdas[p]);
+        for( unsigned int c=n_labels-1; c>root; --c)
+            max_lambdas[parents[c]] = std::max( max_lambdas[parents[c]], max_lambdas[c]);
+
+        // the lambda of the split that separates every two selected clusters
+        std::vector<unsigned int> depths( n_labels, 0);
+        for( unsigned int c=root+1; c<n_labels; ++c)
+            depths[c] = depths[parents[c]] + 1;
+        std::vector<real> split_lambdas( n_clusters * n_clusters, 0);
+        for( unsigned int i=0; i<n_clusters; ++i) {
+            for( unsigned int j=i+1; j<n_clusters; ++j) {
+                unsigned int a = clusters[i], b = clusters[j];
+                while( depths[a] > depths[b])
+                    a = parents[a];
+                while( depths[b] > depths[a])
+                    b = parents[b];
+                while( parents[a] != parents[b]) { // neither cluster is an ancestor of the other
+                    a = parents[a];
+                    b = parents[b];
+                }
+                split_lambdas[i * n_clusters + j] = split_lambdas[j * n_clusters + i] = lambdas[a];
+            }
+        }
+
+        for( std::size_t p=0; p<n_points; ++p) {
+            const unsigned int parent = parents[p];
+            if( max_lambdas[parent] > 0)
+                o_result.outlier_scores[p] = (max_lambdas[parent] - lambdas[p]) / max_lambdas[parent];
+
+            const int label = selected[parent];
+            if( label == NOISE)
+                continue;
+            o_result.labels[p] = label;
+            const real max_lambda = max_lambdas[clusters[label]];
+            o_result.strengths[p] = max_lambda > 0 ? std::min( lambdas[p], max_lambda) / max_lambda : 1;
+
+            real* membership = &o_result.memberships[p * n_clusters];
+            double sum = 0;
+            for( unsigned int c=0; c<n_clusters; ++c) {
+                membership[c] = static_cast<int>(c) == label ? lambdas[p] : std::min( split_lambdas[label * n_clusters + c], lambdas[p] * TIE_FACTOR);
+                sum += membership[c];
+            }
+            for( unsigned int c=0; c<n_clusters; ++c)
+                membership[c] = sum > 0 ? static_cast<real>(membership[c] / sum) : static_cast<int>(c) == label;
+        }
+    }
+
+} // END namespace HDBSCAN
@@ -0,0 +1,138 @@
+/******************************************************************************
+/* @file HDBSCAN clusterer. Uses the hierarchical density based clustering
+/*       presented by Campello, Moulavi & Sander to cluster the dataset.
+/*       (http://link.springer.com/chapter/10.1007/978-3-642-37456-2_14)
+/*
+/* @author langenhagen
+/* @version 150714
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "Clusterer.hpp"
+#include "parallel_for.hpp"
+#include "HDBSCAN/hdbscan.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /** @brief HDBSCAN clusterer. Density based clustering.
+     * Unlike the OPTICS clusterer, it needs neither the number of clusters nor a persistence value:
+     * the clusters are the most stable ones of the condensed single linkage hierarchy
+     * of the mutual reachability distances. The minimum spanning tree is found with the
+     * dual-tree Boruvka algorithm on a KD-tree, so the clusterer suits low dimensional features.
+     */
+    class HDBSCANClusterer : public Clusterer {
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param d The description of the clusterer instance.
+         */
+        HDBSCANClusterer( clusterer_description& d)
+            : Clusterer(d)
+        {}
+
+        /** Destructor.
+         */
+        ~HDBSCANClusterer()
+        {}
+
+    public: // methods
+
+        /** @see Clusterer::do_cluster()
+         * Works directly on the rows of the feature matrix, without copying them.
+         * The first column of the returned matrix holds the noise, the others the soft
+         * memberships of the points in the clusters. Writes the membership strengths
+         * and the GLOSH outlier scores of the points to text files.
+         */
+        virtual Mat1r do_cluster( const Mat1r& features) const {
+            check_and_resolve_input_errors( features.rows);
+            const Vec1r& tweak = this->description.tweak_vector;
+
+            const uint min_cluster_size = static_cast<uint>(tweak[0]);
+            const uint min_samples      = static_cast<uint>(tweak[1]);
+            const HDBSCAN::cluster_selection::cluster_selection selection = tweak[2] == HDBSCAN::cluster_selection::LEAF ? HDBSCAN::cluster_selection::LEAF
+                                                                                                                         : HDBSCAN::cluster_selection::EXCESS_OF_MASS;
+            const OPTICS::PointMatrix points( features.ptr<real>(),
+                                              features.rows,
+                                              features.cols,
+                                              features.step1());
+
+            LOG(info) << "HDBSCANClusterer: Running HDBSCAN...";
+            const HDBSCAN::Result result = HDBSCAN::hdbscan( points, min_cluster_size, min_samples, selection, &parallel_for);
+            LOG(info) << "HDBSCANClusterer: Found " << result.n_clusters << " clusters and "
+                      << std::count( result.labels.begin(), result.labels.end(), HDBSCAN::NOISE) << " noise points.";
+
+            const string strengths_fname = "hdbscan_membership_strengths.txt";
+            const string outlier_scores_fname = "hdbscan_outlier_scores.txt";
+            LOG(info) << "HDBSCANClusterer: Writing membership strengths to \"" << strengths_fname << "\"...";
+            to_file( strengths_fname, result.strengths);
+            LOG(info) << "HDBSCANClusterer: Writing outlier scores to \"" << outlier_scores_fname << "\"...";
+            to_file( outlier_scores_fname, result.outlier_scores);
+
+            // noise in the first column, the soft memberships in the others
+            Mat1r ret( features.rows, static_cast<int>(result.n_clusters) + 1, real(0));
+            for( int r=0; r<features.rows; ++r) {
+                if( result.labels[r] == HDBSCAN::NOISE) {
+                    ret( r, 0) = 1;
+                } else {
+                    const HDBSCAN::real* membership = &result.memberships[r * result.n_clusters];
+                    std::copy( membership, membership + result.n_clusters, ret[r] + 1);
+                }
+            }
+            return ret;
+        }
+
+
+    protected: // helpers
+
+        /** Helper function that checks the description for errors
+         * and logs and corrects them.
+         * @param n_features The number of features that will be processed by the clustering method.
+         */
+        void check_and_resolve_input_errors( const uint n_features) const {
+            Vec1r& tweak = this->description.tweak_vector;
+
+            if( tweak.size() < 3 ||
+                tweak[0] < 2 ||     // min_cluster_size (el. N, >= 2)
+                tweak[1] <= 0 ||    // min_samples (el. N+)
+                tweak[2] != HDBSCAN::cluster_selection::EXCESS_OF_MASS && tweak[2] != HDBSCAN::cluster_selection::LEAF    // cluster selection (EXCESS_OF_MASS or LEAF)
+                ) {
+
+                const real min_cluster_size_default_percentage = 1;
+
+                LOG(warn) << "HDBSCANClusterer: Tweak vector must contain 3 parameters:\n"
+                             "0: the minimum cluster size, an integer >= 2; will otherwise be set to " << min_cluster_size_default_percentage << "% of the size of the input data set, at least 2\n"
+                             "1: the number of nearest neighbors that define the core distance, the point itself included, a positive integer; will otherwise be set to the minimum cluster size\n"
+                             "2: the cluster selection: 0: excess of mass, the most stable clusters    1: leaf, the leaves of the condensed cluster tree";
+
+                if( tweak.size() < 3)
+                    tweak.resize(3, -1);  // if too few parameters where given
+
+                // min_cluster_size
+                if( tweak[0] < 2) {
+                    tweak[0] = std::max( real(2), std::floor( static_cast<real>(n_features) / 100 * min_cluster_size_default_percentage));
+                    LOG(notify) << "Setting min_cluster_size to " << tweak[0] << ".";
+                }
+                // min_samples
+                if( tweak[1] <= 0) {
+                    tweak[1] = tweak[0];
+                    LOG(notify) << "Setting min_samples to " << tweak[1] << ".";
+                }
+                // cluster selection
+                if( tweak[2] != HDBSCAN::cluster_selection::EXCESS_OF_MASS && tweak[2] != HDBSCAN::cluster_selection::LEAF) {
+                    tweak[2] = HDBSCAN::cluster_selection::EXCESS_OF_MASS;
+                    LOG(notify) << "Setting cluster selection to EXCESS_OF_MASS aka " << tweak[2] << ".";
+                }
+
+            } // END IF
+        }
+
+    };
+
+}
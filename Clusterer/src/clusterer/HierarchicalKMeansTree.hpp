@@ -0,0 +1,573 @@
+/******************************************************************************
+/* @file Hierarchical k means tree that is built in parallel and can be persisted.
+/*
+/* @author langenhagen
+/* @version 150705
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "kmeans_initialization.hpp"
+#include "OPTICS/ClusterOrdering.hpp" // OPTICS::fnv1a_hash()
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <queue>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /// Magic number at the beginning of hierarchical k means tree files.
+    const char KMEANS_TREE_FILE_MAGIC[4] = { 'H', 'K', 'T', '2' };
+
+
+    /** @brief Hierarchical k means tree.
+     * Every node splits its feature vectors with k means into at most branching children,
+     * until a node holds no more than branching feature vectors.
+     * The tree is built level by level, and all nodes of one level are split concurrently,
+     * so that the subtrees grow in parallel; the k means kernels within one split run in
+     * parallel, too, which keeps the machine busy near the root where there are few nodes.
+     * The whole tree is kept, so cluster memberships at any granularity can be read off
+     * by cutting the tree, without clustering again.
+     */
+    class HierarchicalKMeansTree {
+
+    public: // types
+
+        /// A node of the tree.
+        struct node {
+            int parent;         ///< The index of the parent node, -1 for the root.
+            int first_child;    ///< The index of the first child. The children are contiguous.
+            int n_children;     ///< The number of children, 0 for leaves.
+            int level;          ///< The depth of the node, 0 for the root.
+            int begin;          ///< The first position of the node's feature vectors in the index permutation.
+            int end;            ///< One past the last position of the node's feature vectors in the index permutation.
+            double sse;         ///< The sum of the squared distances of the node's feature vectors to its center.
+        };
+
+    private: // types
+
+        /// The result of splitting one node.
+        struct split {
+            Mat1r centers;              ///< The row-wise centers of the non-empty children.
+            vector<int> sizes;          ///< The number of feature vectors per child.
+            vector<double> sses;        ///< The sum of the squared distances to the center per child.
+        };
+
+
+        /** @brief Splits the nodes of one level of the tree concurrently.
+         */
+        class LevelSplitter : public cv::ParallelLoopBody {
+
+            const Mat1r& _features;             ///< The row-wise feature vectors.
+            const vector<node>& _nodes;         ///< The nodes of the tree.
+            const vector<int>& _frontier;       ///< The indices of the nodes to be split.
+            const int _branching;               ///< The maximum number of children per node.
+            const int _max_iterations;          ///< The maximum number of k means iterations per split.
+            const uint64_t _seed;               ///< The seed of the tree.
+            vector<int>& _indices;              ///< In/Output: the index permutation, reordered by child within every split node.
+            vector<split>& _splits;             ///< Output: the split of every frontier node.
+
+        public:
+
+            /** Main constructor.
+             * @param features The row-wise feature vectors.
+             * @param nodes The nodes of the tree.
+             * @param frontier The indices of the nodes to be split.
+             * @param branching The maximum number of children per node.
+             * @param max_iterations The maximum number of k means iterations per split.
+             * @param seed The seed of the tree.
+             * @param[in,out] io_indices The index permutation.
+             * @param[out] o_splits The split of every frontier node, preallocated.
+             */
+            LevelSplitter( const Mat1r& features,
+                           const vector<node>& nodes,
+                           const vector<int>& frontier,
+                           const int branching,
+                           const int max_iterations,
+                           const uint64_t seed,
+                           vector<int>& io_indices,
+                           vector<split>& o_splits)
+                : _features(features), _nodes(nodes), _frontier(frontier), _branching(branching), _max_iterations(max_iterations),
+                  _seed(seed), _indices(io_indices), _splits(o_splits)
+            {}
+
+            /** Splits the frontier nodes in the given range.
+             * The nodes own disjoint ranges of the index permutation.
+             * @param range A range of frontier indices.
+             */
+            virtual void operator()( const cv::Range& range) const {
+                for( int i=range.start; i<range.end; ++i) {
+                    const node& n = _nodes[_frontier[i]];
+                    cv::RNG rng( _seed ^ (static_cast<uint64_t>(_frontier[i]) * 0x9E3779B97F4A7C15ULL));
+                    split_node( _features, _branching, _max_iterations, rng, &_indices[n.begin], n.end - n.begin, _splits[i]);
+                }
+            }
+
+        private:
+            /// Not assignable.
+            LevelSplitter& operator=( const LevelSplitter&);
+        };
+
+    private: // vars
+
+        vector<node> _nodes;            ///< The nodes, the root first. The children of a node are contiguous.
+        Mat1r _centers;                 ///< The row-wise centers of the nodes.
+        vector<int> _indices;           ///< The feature vector indices, permuted so that every node owns a contiguous range.
+        int _branching;                 ///< The maximum number of children per node.
+        int _max_iterations;            ///< The maximum number of k means iterations per split.
+        uint64_t _seed;                 ///< The seed the tree was built with.
+        uint64_t _fingerprint;          ///< The fingerprint of the feature vectors the tree was built for, see fingerprint().
+
+    public: // constructor & destructor
+
+        /** Main constructor. Creates an empty tree.
+         */
+        HierarchicalKMeansTree()
+            : _branching(0), _max_iterations(0), _seed(0), _fingerprint(0)
+        {}
+
+    public: // static methods
+
+        /** Computes a 64 bit FNV-1a hash of the shape and the values of the feature vectors.
+         * Trees with equal fingerprints and parameters were built from the same feature vectors.
+         * @param features The row-wise feature vectors.
+         * @return The fingerprint.
+         */
+        static uint64_t fingerprint( const Mat1r& features) {
+            uint64_t ret = 0xCBF29CE484222325ULL;
+            const uint64_t shape[] = { static_cast<uint64_t>(features.rows), static_cast<uint64_t>(features.cols) };
+            OPTICS::fnv1a_hash( shape, sizeof(shape), ret);
+            for( int r=0; r<features.rows; ++r)
+                OPTICS::fnv1a_hash( features[r], features.cols * sizeof(real), ret);
+            return ret;
+        }
+
+    public: // methods
+
+        /** Builds the tree.
+         * @param features The row-wise feature vectors.
+         * @param branching The maximum number of children per node. Must be at least 2.
+         * @param max_iterations The maximum number of k means iterations per split.
+         * @param seed The seed for the center initializations.
+         */
+        void build( const Mat1r& features, const int branching, const int max_iterations, const uint64_t seed) {
+            assert( branching >= 2 && "a node must be splittable into at least two children");
+            _branching = branching;
+            _max_iterations = max_iterations;
+            _seed = seed;
+            _fingerprint = fingerprint( features);
+            _nodes.clear();
+            _centers.release();
+            _indices.resize( features.rows);
+            for( int i=0; i<features.rows; ++i)
+                _indices[i] = i;
+            if( features.rows == 0)
+                return;
+
+            // root
+            node root = { -1, 0, 0, 0, 0, features.rows, 0.0 };
+            Mat1r mean;
+            cv::reduce( features, mean, 0, CV_REDUCE_AVG);
+            for( int r=0; r<features.rows; ++r)
+                root.sse += distances::squared_l2( features[r], mean[0], features.cols);
+            _nodes.push_back( root);
+            _centers.push_back( mean);
+
+            vector<int> frontier;
+            if( is_splittable( root))
+                frontier.push_back( 0);
+
+            vector<split> splits;
+            vector<int> next_frontier;
+            while( !frontier.empty()) {
+                splits.assign( frontier.size(), split());
+                cv::parallel_for_( cv::Range( 0, static_cast<int>(frontier.size())),
+                                   LevelSplitter( features, _nodes, frontier, _branching, _max_iterations, _seed, _indices, splits));
+
+                // append the children level by level, so that the children of a node are contiguous
+                next_frontier.clear();
+                for( size_t i=0; i<frontier.size(); ++i) {
+                    const split& s = splits[i];
+                    if( s.centers.rows < 2)
+                        continue; // all feature vectors are equal, keep the node as a leaf
+
+                    node& parent = _nodes[frontier[i]];
+                    parent.first_child = static_cast<int>(_nodes.size());
+                    parent.n_children = s.centers.rows;
+                    const int parent_index = frontier[i];
+                    const int child_level = parent.level + 1;
+                    int begin = parent.begin;
+                    for( int c=0; c<s.centers.rows; ++c) {
+                        const node child = { parent_index, 0, 0, child_level, begin, begin + s.sizes[c], s.sses[c] };
+                        if( is_splittable( child))
+                            next_frontier.push_back( static_cast<int>(_nodes.size()));
+                        _nodes.push_back( child);
+                        begin = child.end;
+                    }
+                    _centers.push_back( s.centers);
+                }
+                frontier.swap( next_frontier);
+            }
+            LOG(info) << "HierarchicalKMeansTree: Built a tree with " << _nodes.size() << " nodes and " << depth() << " levels.";
+        }
+
+
+        /** Cuts the tree into at most n_clusters clusters with a low sum of squared distances.
+         * Greedily replaces the node with the highest sum of squared distances by its children,
+         * as long as the number of clusters does not exceed n_clusters.
+         * @param n_clusters The maximum number of clusters.
+         * @param[out] o_cut The indices of the nodes that form the clusters.
+         */
+        void cut( const int n_clusters, vector<int>& o_cut) const {
+            o_cut.clear();
+            if( _nodes.empty())
+                return;
+
+            std::priority_queue< std::pair<double,int>> candidates;
+            candidates.push( std::make_pair( _nodes[0].sse, 0));
+            int n_cut_clusters = 1;
+            while( !candidates.empty()) {
+                const int n = candidates.top().second;
+                candidates.pop();
+                const node& current = _nodes[n];
+                if( current.n_children == 0 || n_cut_clusters - 1 + current.n_children > n_clusters) {
+                    o_cut.push_back( n);
+                    continue;
+                }
+                n_cut_clusters += current.n_children - 1;
+                for( int c=current.first_child; c<current.first_child+current.n_children; ++c)
+                    candidates.push( std::make_pair( _nodes[c].sse, c));
+            }
+            std::sort( o_cut.begin(), o_cut.end());
+        }
+
+
+        /** Cuts the tree at the given depth.
+         * Leaves above that depth become clusters on their own.
+         * @param level The depth, 0 for the root.
+         * @param[out] o_cut The indices of the nodes that form the clusters.
+         */
+        void cut_at_level( const int level, vector<int>& o_cut) const {
+            o_cut.clear();
+            for( int n=0; n<static_cast<int>(_nodes.size()); ++n)
+                if( _nodes[n].level == level || (_nodes[n].level < level && _nodes[n].n_children == 0))
+                    o_cut.push_back( n);
+        }
+
+
+        /** Reads off the cluster memberships of a cut.
+         * @param cut The indices of the nodes that form the clusters, e.g. from cut().
+         * @param[out] o_labels The index into the cut of every feature vector's cluster.
+         */
+        void labels( const vector<int>& cut, vector<int>& o_labels) const {
+            o_labels.assign( _indices.size(), -1);
+            for( int c=0; c<static_cast<int>(cut.size()); ++c) {
+                const node& n = _nodes[cut[c]];
+                for( int i=n.begin; i<n.end; ++i)
+                    o_labels[_indices[i]] = c;
+            }
+        }
+
+
+        /** Gathers the centers of a cut.
+         * @param cut The indices of the nodes that form the clusters, e.g. from cut().
+         * @param[out] o_centers The row-wise centers of the clusters.
+         */
+        void centers( const vector<int>& cut, Mat1r& o_centers) const {
+            o_centers.create( static_cast<int>(cut.size()), _centers.cols);
+            for( int c=0; c<o_centers.rows; ++c)
+                _centers.row( cut[c]).copyTo( o_centers.row(c));
+        }
+
+
+        /** @return The number of levels of the tree.
+         */
+        int depth() const {
+            int ret = 0;
+            for( auto it=_nodes.begin(); it!=_nodes.end(); ++it)
+                ret = std::max( ret, it->level + 1);
+            return ret;
+        }
+
+
+        /** Checks whether the tree was built for the given feature vectors with the given parameters.
+         * Hashes all feature vectors, so that a tree of other feature vectors of the same shape does not match.
+         * @param features The row-wise feature vectors.
+         * @param branching The maximum number of children per node.
+         * @param max_iterations The maximum number of k means iterations per split.
+         * @param seed The seed for the center initializations.
+         * @return TRUE if the tree matches, FALSE otherwise.
+         */
+        bool matches( const Mat1r& features, const int branching, const int max_iterations, const uint64_t seed) const {
+            return !_nodes.empty() &&
+                   static_cast<int>(_indices.size()) == features.rows &&
+                   _centers.cols == features.cols &&
+                   _branching == branching &&
+                   _max_iterations == max_iterations &&
+                   _seed == seed &&
+                   _fingerprint == fingerprint( features);
+        }
+
+
+        /** Writes the tree to a binary file.
+         * The format is: magic number, the number of feature vectors, dimensions and nodes, the branching,
+         * the maximum number of iterations, the seed and the fingerprint of the feature vectors,
+         * followed by the nodes, the node centers and the index permutation.
+         * @param fname The name of the file to be written to.
+         * @return TRUE in case of success,
+         *         FALSE in case of error.
+         */
+        bool to_file( const std::string& fname) const {
+            std::ofstream fstream( fname, std::ios::out | std::ios::trunc | std::ios::binary);
+            if(!fstream.is_open() || fstream.bad()) {
+                on_open_file_error(fname);
+                return false;
+            }
+            const uint64_t header[] = { _indices.size(), static_cast<uint64_t>(_centers.cols), _nodes.size(),
+                                        static_cast<uint64_t>(_branching), static_cast<uint64_t>(_max_iterations), _seed, _fingerprint };
+            fstream.write( KMEANS_TREE_FILE_MAGIC, 4);
+            fstream.write( reinterpret_cast<const char*>(header), sizeof(header));
+            for( auto it=_nodes.begin(); it!=_nodes.end() && !fstream.bad(); ++it) {
+                const int32_t fields[] = { it->parent, it->first_child, it->n_children, it->level, it->begin, it->end };
+                fstream.write( reinterpret_cast<const char*>(fields), sizeof(fields));
+                fstream.write( reinterpret_cast<const char*>(&it->sse), sizeof(it->sse));
+            }
+            for( int r=0; r<_centers.rows && !fstream.bad(); ++r)
+                fstream.write( reinterpret_cast<const char*>(_centers[r]), _centers.cols * sizeof(real));
+            if( !_indices.empty())
+                fstream.write( reinterpret_cast<const char*>(&_indices[0]), _indices.size() * sizeof(int));
+
+            if( fstream.bad()) {
+                on_write_file_error(fname);
+                return false;
+            }
+            return true;
+        }
+
+
+        /** Reads a tree from a binary file written by to_file().
+         * Rejects files whose size does not match the header and trees whose nodes
+         * or index permutation are out of range or inconsistent.
+         * @param fname The path to the file where the tree is stored.
+         * @return TRUE in case of success,
+         *         FALSE in case of error. The tree is empty then.
+         */
+        bool from_file( const std::string& fname) {
+            *this = HierarchicalKMeansTree();
+            std::ifstream in_file( fname, std::ios::in | std::ios::binary);
+            if( !in_file.is_open()) {
+                on_open_file_error( fname);
+                return false;
+            }
+
+            char magic[4];
+            uint64_t header[7]; // n_features, n_dims, n_nodes, branching, max_iterations, seed, fingerprint
+            if( !in_file.read( magic, 4) ||
+                std::memcmp( magic, KMEANS_TREE_FILE_MAGIC, 4) != 0 ||
+                !in_file.read( reinterpret_cast<char*>(header), sizeof(header))) {
+
+                LOG(error) << "HierarchicalKMeansTree: \"" << fname << "\" is no valid k means tree file.";
+                return false;
+            }
+
+            // the sizes must fit into ints and account for the whole file, before anything is allocated
+            in_file.seekg( 0, std::ios::end);
+            const uint64_t actual_size = static_cast<uint64_t>(in_file.tellg());
+            in_file.seekg( static_cast<std::streamoff>(4 + sizeof(header)), std::ios::beg);
+            if( header[0] > INT_MAX || header[1] > INT_MAX || header[2] > INT_MAX || header[3] > INT_MAX || header[4] > INT_MAX ||
+                (header[2] > 0 && header[1] > actual_size / (header[2] * sizeof(real))) || // the centers alone would exceed the file
+                actual_size != file_size( header[0], header[1], header[2])) {
+
+                LOG(error) << "HierarchicalKMeansTree: The size of \"" << fname << "\" does not match its header.";
+                return false;
+            }
+
+            HierarchicalKMeansTree tree;
+            tree._branching = static_cast<int>(header[3]);
+            tree._max_iterations = static_cast<int>(header[4]);
+            tree._seed = header[5];
+            tree._fingerprint = header[6];
+            tree._nodes.resize( static_cast<size_t>(header[2]));
+            bool is_valid = true;
+            for( auto it=tree._nodes.begin(); it!=tree._nodes.end() && is_valid; ++it) {
+                int32_t fields[6];
+                is_valid = in_file.read( reinterpret_cast<char*>(fields), sizeof(fields)) &&
+                           in_file.read( reinterpret_cast<char*>(&it->sse), sizeof(it->sse));
+                it->parent = fields[0];
+                it->first_child = fields[1];
+                it->n_children = fields[2];
+                it->level = fields[3];
+                it->begin = fields[4];
+                it->end = fields[5];
+            }
+            tree._centers.create( static_cast<int>(header[2]), static_cast<int>(header[1]));
+            for( int r=0; r<tree._centers.rows && is_valid; ++r)
+                is_valid = !!in_file.read( reinterpret_cast<char*>(tree._centers[r]), tree._centers.cols * sizeof(real));
+            tree._indices.resize( static_cast<size_t>(header[0]));
+            if( is_valid && !tree._indices.empty())
+                is_valid = !!in_file.read( reinterpret_cast<char*>(&tree._indices[0]), tree._indices.size() * sizeof(int));
+
+            if( !is_valid) {
+                LOG(error) << "HierarchicalKMeansTree: \"" << fname << "\" is truncated.";
+                return false;
+            }
+            if( !tree.is_consistent()) {
+                LOG(error) << "HierarchicalKMeansTree: \"" << fname << "\" holds an inconsistent tree.";
+                return false;
+            }
+            *this = tree;
+            return true;
+        }
+
+    private: // helpers
+
+        /** Computes the size of a tree file written by to_file().
+         * @param n_features The number of feature vectors.
+         * @param n_dims The dimensionality of the feature vectors.
+         * @param n_nodes The number of nodes.
+         * @return The size of the file in bytes.
+         */
+        static uint64_t file_size( const uint64_t n_features, const uint64_t n_dims, const uint64_t n_nodes) {
+            return 4 + 7 * sizeof(uint64_t) +
+                   n_nodes * (6 * sizeof(int32_t) + sizeof(double)) +
+                   n_nodes * n_dims * sizeof(real) +
+                   n_features * sizeof(int);
+        }
+
+
+        /** Checks that the nodes and the index permutation are in range and form a tree as build() creates it:
+         * the root owns all feature vectors, the children of a node follow it, are contiguous and point back to it,
+         * and every node's range of the index permutation lies within the range of its parent.
+         * @return TRUE if the tree is consistent, FALSE otherwise.
+         */
+        bool is_consistent() const {
+            const int n_nodes = static_cast<int>(_nodes.size());
+            const int n_features = static_cast<int>(_indices.size());
+            if( n_nodes == 0)
+                return n_features == 0;
+            if( _nodes[0].parent != -1 || _nodes[0].begin != 0 || _nodes[0].end != n_features)
+                return false;
+
+            for( int n=0; n<n_nodes; ++n) {
+                const node& current = _nodes[n];
+                if( current.begin < 0 || current.begin > current.end || current.end > n_features || current.level < 0)
+                    return false;
+                if( n > 0) {
+                    if( current.parent < 0 || current.parent >= n)
+                        return false;
+                    const node& parent = _nodes[current.parent];
+                    if( n < parent.first_child || n >= parent.first_child + parent.n_children ||
+                        current.begin < parent.begin || current.end > parent.end || current.level != parent.level + 1)
+                        return false;
+                }
+                if( current.n_children < 0 ||
+                    (current.n_children > 0 && (current.first_child <= n || current.first_child > n_nodes - current.n_children)))
+                    return false;
+                for( int c=current.first_child; c<current.first_child+current.n_children; ++c)
+                    if( _nodes[c].parent != n)
+                        return false;
+            }
+
+            vector<char> is_indexed( n_features, 0);
+            for( int i=0; i<n_features; ++i) {
+                const int index = _indices[i];
+                if( index < 0 || index >= n_features || is_indexed[index])
+                    return false;
+                is_indexed[index] = 1;
+            }
+            return true;
+        }
+
+
+        /** Checks whether a node holds enough feature vectors to be split.
+         * @param n The node.
+         * @return TRUE if the node is to be split, FALSE if it is a leaf.
+         */
+        bool is_splittable( const node& n) const {
+            return n.end - n.begin > _branching;
+        }
+
+
+        /** Splits the feature vectors of a node with k means.
+         * @param features The row-wise feature vectors.
+         * @param branching The maximum number of children.
+         * @param max_iterations The maximum number of k means iterations.
+         * @param rng The random number generator.
+         * @param[in,out] indices The indices of the node's feature vectors. Reordered by child.
+         * @param n_indices The number of the node's feature vectors. Must exceed branching.
+         * @param[out] o_split The split.
+         */
+        static void split_node( const Mat1r& features,
+                                const int branching,
+                                const int max_iterations,
+                                cv::RNG& rng,
+                                int* indices,
+                                const int n_indices,
+                                split& o_split) {
+            Mat1r points( n_indices, features.cols);
+            for( int i=0; i<n_indices; ++i)
+                features.row( indices[i]).copyTo( points.row(i));
+
+            Mat1r centers;
+            init_centers( points, branching, center_initialization::KMEANS_PARALLEL, rng, centers);
+            vector<int> labels;
+            vector<int> old_labels;
+            Mat1r means;
+            for( int it=0; it<max_iterations; ++it) {
+                assign_to_nearest_centers( points, centers, labels);
+                if( labels == old_labels)
+                    break;
+                vector<int> sizes( branching, 0);
+                for( int i=0; i<n_indices; ++i)
+                    ++sizes[labels[i]];
+                compute_cluster_means( points, labels, branching, means);
+                for( int c=0; c<branching; ++c)
+                    if( sizes[c] > 0)
+                        means.row(c).copyTo( centers.row(c)); // empty clusters keep their center
+                old_labels = labels;
+            }
+            if( labels.empty())
+                assign_to_nearest_centers( points, centers, labels);
+
+            // drop empty children, reorder the indices by child
+            vector<int> sizes( branching, 0);
+            for( int i=0; i<n_indices; ++i)
+                ++sizes[labels[i]];
+            vector<int> child_of_cluster( branching, -1);
+            vector<int> offsets;
+            int offset = 0;
+            for( int c=0; c<branching; ++c) {
+                if( sizes[c] == 0)
+                    continue;
+                child_of_cluster[c] = static_cast<int>(o_split.sizes.size());
+                o_split.sizes.push_back( sizes[c]);
+                offsets.push_back( offset);
+                offset += sizes[c];
+            }
+            const int n_children = static_cast<int>(o_split.sizes.size());
+
+            vector<int> reordered( n_indices);
+            for( int i=0; i<n_indices; ++i)
+                reordered[offsets[child_of_cluster[labels[i]]]++] = indices[i];
+            std::copy( reordered.begin(), reordered.end(), indices);
+
+            // the children's centers are the means of their feature vectors
+            vector<int> child_labels( n_indices);
+            for( int i=0; i<n_indices; ++i)
+                child_labels[i] = child_of_cluster[labels[i]];
+            compute_cluster_means( points, child_labels, n_children, o_split.centers);
+            o_split.sses.assign( n_children, 0.0);
+            for( int i=0; i<n_indices; ++i)
+                o_split.sses[child_labels[i]] += distances::squared_l2( points[i], o_split.centers[child_labels[i]], points.cols);
+        }
+    };
+}
@@ -0,0 +1,333 @@
+/******************************************************************************
+/* @file Isolation forest clusterer. Finds the n feature vectors that random
+/*       axis-parallel splits isolate fastest, after Liu, Ting & Zhou:
+/*       "Isolation Forest" (http://dx.doi.org/10.1109/ICDM.2008.17).
+/*
+/* @author langenhagen
+/* @version 150716
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "Clusterer.hpp"
+#include "parallel_for.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /** @brief Isolation forest clusterer. Finds orphanized elements without computing distances.
+     * Every tree splits a small random subsample of the feature vectors at random values of random
+     * dimensions until each vector is isolated. Outliers are isolated after few splits, so the
+     * mean depth at which a feature vector ends up in the trees is its outlier score.
+     * Building the forest costs O(n_trees * subsample_size * log(subsample_size) * dims), since every
+     * node scans its subsample feature vectors for the dimensions in which they vary. Scoring costs
+     * O(N * n_trees * log(subsample_size)), independent of the dimensionality; quantized
+     * features are dequantized row by row.
+     * Returns the same two columns as the OutlierClusterer: inliers and outliers.
+     */
+    class IsolationForestClusterer : public Clusterer {
+
+    private: // types
+
+        /// Retrieves the feature vector with the given row index.
+        typedef std::function< void( const int row, real* o_feature)> row_getter;
+
+        /// A node of an isolation tree.
+        struct node {
+            int dim;            ///< The split dimension, -1 for leaves.
+            real value;         ///< The split value; coordinates up to it go left.
+            int left;           ///< The index of the left child.
+            int right;          ///< The index of the right child.
+            int size;           ///< The number of subsample feature vectors that end up in the leaf.
+        };
+
+        /// An isolation tree, the root first.
+        typedef vector<node> tree;
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param d The description of the clusterer instance.
+         */
+        IsolationForestClusterer( clusterer_description& d)
+            : Clusterer(d) {
+            check_and_resolve_input_errors();
+        }
+
+        /** Destructor.
+         */
+        ~IsolationForestClusterer()
+        {}
+
+    private: // methods
+
+        /** @see Clusterer::do_cluster()
+         */
+        virtual Mat1r do_cluster( const Mat1r& features) const {
+            return find_outliers( features.rows,
+                                  features.cols,
+                                  [&features]( const int row, real* o_feature) {
+                                      std::copy( features[row], features[row] + features.cols, o_feature);
+                                  });
+        }
+
+
+        /** @see Clusterer::do_cluster_quantized()
+         * Dequantizes only the subsamples and, one at a time, the scored feature vectors.
+         */
+        virtual Mat1r do_cluster_quantized( const QuantizedMat& features) const {
+            return find_outliers( features.rows(),
+                                  features.cols(),
+                                  [&features]( const int row, real* o_feature) {
+                                      features.dequantize_row( row, o_feature);
+                                  });
+        }
+
+    protected: // helpers
+
+        /** Builds the forest, scores all feature vectors and marks the ones with the highest scores as outliers.
+         * Writes the scores of the feature vectors to a text file.
+         * @param n_features The number of feature vectors.
+         * @param n_dims The dimensionality of the feature vectors.
+         * @param get_row Retrieves a feature vector by its row index. Must be thread-safe.
+         * @return A matrix whose first column is 1 for inliers and whose second column is 1 for outliers.
+         */
+        Mat1r find_outliers( const int n_features, const int n_dims, const row_getter& get_row) const {
+            check_and_resolve_input_errors();
+            const Vec1r& tweak = this->description.tweak_vector;
+            const int n_outliers = std::min( static_cast<int>(tweak[0]), n_features);
+            const int n_trees = static_cast<int>(tweak[1]);
+            const int subsample_size = std::min( static_cast<int>(tweak[2]), n_features);
+            const uint64 seed = static_cast<uint64>(tweak[3]);
+
+            LOG(info) << "IsolationForestClusterer: Building " << n_trees << " trees on subsamples of " << subsample_size << " feature vectors...";
+            vector<tree> forest( n_trees);
+            parallel_for( n_trees, [&]( const std::size_t begin, const std::size_t end) {
+                for( std::size_t t=begin; t<end; ++t) {
+                    cv::RNG rng( (seed + 1) * 0x9E3779B97F4A7C15ULL + t);
+                    build_tree( n_features, n_dims, subsample_size, get_row, rng, forest[t]);
+                }
+            });
+
+            LOG(info) << "IsolationForestClusterer: Scoring " << n_features << " feature vectors...";
+            const real normalization = average_path_length( subsample_size);
+            Vec1r scores( n_features);
+            parallel_for( n_features, [&]( const std::size_t begin, const std::size_t end) {
+                Vec1r feature( n_dims);
+                for( std::size_t r=begin; r<end; ++r) {
+                    get_row( static_cast<int>(r), &feature[0]);
+                    real mean_path_length = 0;
+                    for( vector<tree>::const_iterator it=forest.begin(); it!=forest.end(); ++it)
+                        mean_path_length += path_length( *it, &feature[0]);
+                    mean_path_length /= std::max( n_trees, 1);
+                    scores[r] = normalization > 0 ? std::pow( real(2), -mean_path_length / normalization) : real(0.5);
+                }
+            });
+
+            const string scores_fname = "isolation_forest_scores.txt";
+            LOG(info) << "IsolationForestClusterer: Writing outlier scores to \"" << scores_fname << "\"...";
+            to_file( scores_fname, scores);
+
+            // the outliers are the feature vectors with the highest scores, ties broken by the row
+            vector<int> rows( n_features);
+            for( int r=0; r<n_features; ++r)
+                rows[r] = r;
+            std::partial_sort( rows.begin(), rows.begin() + n_outliers, rows.end(), [&scores]( const int a, const int b) {
+                return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+            });
+
+            Mat1r ret( n_features, 2);
+            ret.col(0) = 1;
+            ret.col(1) = 0;
+            for( int i=0; i<n_outliers; ++i) {
+                ret( rows[i], 0) = 0;
+                ret( rows[i], 1) = 1;
+            }
+            if( n_outliers > 0)
+                LOG(info) << "IsolationForestClusterer: The outlier scores range from " << scores[rows[n_outliers-1]] << " to " << scores[rows[0]] << ".";
+            return ret;
+        }
+
+
+        /** Builds an isolation tree on a random subsample of the feature vectors.
+         * @param n_features The number of feature vectors.
+         * @param n_dims The dimensionality of the feature vectors.
+         * @param subsample_size The number of feature vectors of the subsample, at most n_features.
+         * @param get_row Retrieves a feature vector by its row index.
+         * @param rng The random number generator of the tree.
+         * @param[out] o_tree The tree.
+         */
+        static void build_tree( const int n_features, const int n_dims, const int subsample_size, const row_getter& get_row, cv::RNG& rng, tree& o_tree) {
+            // distinct random rows with Floyd's algorithm
+            vector<int> rows;
+            rows.reserve( subsample_size);
+            for( int j=n_features-subsample_size; j<n_features; ++j) {
+                const int r = rng.uniform( 0, j+1);
+                rows.push_back( std::find( rows.begin(), rows.end(), r) == rows.end() ? r : j);
+            }
+
+            Mat1r subsample( subsample_size, n_dims);
+            for( int i=0; i<subsample_size; ++i)
+                get_row( rows[i], subsample[i]);
+
+            vector<int> ids( subsample_size);
+            for( int i=0; i<subsample_size; ++i)
+                ids[i] = i;
+            const int max_depth = static_cast<int>(std::ceil( std::log( std::max( 2.0, static_cast<double>(subsample_size))) / std::log( 2.0)));
+            o_tree.clear();
+            build_node( subsample, ids, 0, subsample_size, 0, max_depth, rng, o_tree);
+        }
+
+
+        /** Builds a node and its descendants.
+         * Splits the node at a random value between the minimum and the maximum of a random dimension
+         * in which its feature vectors differ, which costs O((end - begin) * dims). Nodes deeper than the expected height of a random tree
+         * stay leaves, since only the short paths of the outliers matter.
+         * @param subsample The row-wise subsample feature vectors.
+         * @param[in,out] io_ids The subsample rows, of which the node's range gets partitioned.
+         * @param begin The first position of the node's rows in io_ids.
+         * @param end One past the last position of the node's rows in io_ids.
+         * @param depth The depth of the node.
+         * @param max_depth The maximum depth of the tree.
+         * @param rng The random number generator of the tree.
+         * @param[in,out] io_tree The tree that gets the node.
+         * @return The index of the node.
+         */
+        static int build_node( const Mat1r& subsample, vector<int>& io_ids, const int begin, const int end, const int depth, const int max_depth, cv::RNG& rng, tree& io_tree) {
+            const int ret = static_cast<int>(io_tree.size());
+            const node leaf = { -1, 0, -1, -1, end - begin };
+            io_tree.push_back( leaf);
+            if( end - begin <= 1 || depth >= max_depth)
+                return ret;
+
+            // sparse histograms are constant in many dimensions, so choose among the varying ones only
+            int dim = -1;
+            real value = 0;
+            {
+                const int n_dims = subsample.cols;
+                vector<real> min_values( subsample[io_ids[begin]], subsample[io_ids[begin]] + n_dims);
+                vector<real> max_values( min_values);
+                for( int i=begin+1; i<end; ++i) {
+                    const real* feature = subsample[io_ids[i]];
+                    for( int d=0; d<n_dims; ++d) {
+                        min_values[d] = std::min( min_values[d], feature[d]);
+                        max_values[d] = std::max( max_values[d], feature[d]);
+                    }
+                }
+                Vec1i varying_dims;
+                for( int d=0; d<n_dims; ++d)
+                    if( min_values[d] < max_values[d])
+                        varying_dims.push_back( d);
+                if( varying_dims.empty())
+                    return ret;
+
+                dim = varying_dims[rng.uniform( 0, static_cast<int>(varying_dims.size()))];
+                value = rng.uniform( min_values[dim], max_values[dim]); // not below the minimum, so the left side gets rows
+            }
+
+            const int middle = static_cast<int>(std::partition( io_ids.begin() + begin, io_ids.begin() + end, [&]( const int id) {
+                return subsample( id, dim) <= value;
+            }) - io_ids.begin());
+            const int left = build_node( subsample, io_ids, begin, middle, depth+1, max_depth, rng, io_tree);
+            const int right = build_node( subsample, io_ids, middle, end, depth+1, max_depth, rng, io_tree);
+            node& n = io_tree[ret];
+            n.dim = dim;
+            n.value = value;
+            n.left = left;
+            n.right = right;
+            return ret;
+        }
+
+
+        /** Computes the path length of a feature vector in an isolation tree.
+         * @param t The tree.
+         * @param feature The feature vector.
+         * @return The depth of the leaf the feature vector ends up in, plus the expected
+         *         remaining depth of the leaf's subsample feature vectors.
+         */
+        static real path_length( const tree& t, const real* feature) {
+            int n = 0;
+            int depth = 0;
+            while( t[n].dim >= 0) {
+                n = feature[t[n].dim] <= t[n].value ? t[n].left : t[n].right;
+                ++depth;
+            }
+            return depth + average_path_length( t[n].size);
+        }
+
+
+        /** Computes the average path length of an unsuccessful search in a binary search tree.
+         * Normalizes the path lengths and estimates the depth of the unbuilt subtree below a leaf.
+         * @param n The number of elements of the tree.
+         * @return The average path length.
+         */
+        static real average_path_length( const int n) {
+            const double euler_mascheroni = 0.5772156649015329;
+            if( n <= 1)
+                return 0;
+            if( n == 2)
+                return 1;
+            return static_cast<real>( 2 * (std::log( n - 1.0) + euler_mascheroni) - 2.0 * (n - 1) / n);
+        }
+
+
+        /** Helper function that checks the description for errors
+         * and logs and corrects them.
+         */
+        void check_and_resolve_input_errors() const {
+            Vec1r& tweak = this->description.tweak_vector;
+
+            if( tweak.size() < 4 ||
+                tweak[0] < 0 ||     // n_outliers (el. N)
+                tweak[1] < 1 ||     // n_trees (el. N+)
+                tweak[2] < 2 ||     // subsample_size (el. N, >= 2)
+                tweak[3] < 0        // seed (el. N)
+                ) {
+
+                LOG(warn) << "IsolationForestClusterer: Tweak vector must contain 4 parameters:\n"
+                             "0: the number of outliers to be found, a non-negative integer; will otherwise be set to 100\n"
+                             "1: the number of isolation trees, a positive integer; will otherwise be set to 100\n"
+                             "2: the number of feature vectors that every tree is built on, an integer >= 2; will otherwise be set to 256\n"
+                             "3: the seed of the random subsamples and splits, a non-negative integer; will otherwise be set to 0";
+
+                if( tweak.size() < 4)
+                    tweak.resize(4, -1);  // if too few parameters where given
+
+                // n_outliers
+                if( tweak[0] < 0) {
+                    tweak[0] = 100;
+                    LOG(notify) << "Setting number of outliers to " << tweak[0] << ".";
+                }
+                // n_trees
+                if( tweak[1] < 1) {
+                    tweak[1] = 100;
+                    LOG(notify) << "Setting number of trees to " << tweak[1] << ".";
+                }
+                // subsample_size
+                if( tweak[2] < 2) {
+                    tweak[2] = 256;
+                    LOG(notify) << "Setting subsample size to " << tweak[2] << ".";
+                }
+                // seed
+                if( tweak[3] < 0) {
+                    tweak[3] = 0;
+                    LOG(notify) << "Setting seed to " << tweak[3] << ".";
+                }
+
+            } // END IF
+        }
+
+    };
+
+}
@@ -10,17 +10,8 @@
 // INCLUDES project headers
 
 #include "Clusterer.hpp"
-
-///////////////////////////////////////////////////////////////////////////////
-//INCLUDES C/C++ standard library (and other external libraries)
-
-#include <limits>
-
-#pragma warning(push)
-#pragma warning(disable:4996) // fopen may be unsafe...
-#pragma warning(disable:4267) // size_t to int..
-#include <opencv2/flann/flann.hpp>
-#pragma warning(pop)
+#include "HierarchicalKMeansTree.hpp"
+#include "parallel_for.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
@@ -28,7 +19,10 @@
 namespace app {
 
     /** @brief KMeans clusterer
-     * Uses opencv flann hierarchical k means.
+     * Uses a hierarchical k means tree and cuts it into at most the given number of clusters.
+     * If the description names a model file, the tree is persisted there and reused by
+     * later runs on the same features with the same tree parameters, so that clusterings
+     * of other granularities are read off the tree without clustering again.
      */
     class KMeansClusterer : public Clusterer {
 
@@ -53,48 +47,136 @@ namespace app {
          */
         virtual Mat1r do_cluster( const Mat1r& features) const {
             check_and_resolve_input_errors();
-            Mat1r ret;
-            int n_clusters;
-            Mat1r cluster_means( static_cast<int>(description.tweak_vector[0]), features.cols);
-
-            cvflann::KMeansIndexParams kmeans_index_params( 32, -1,  cvflann::CENTERS_KMEANSPP, 0.2f);
-            n_clusters = cv::flann::hierarchicalClustering<cv::flann::L2<real>>( features, cluster_means, kmeans_index_params);
-            ret = Mat1r( features.rows, n_clusters, real(0));
-
-            for( int r=0; r<features.rows; ++r) {
-                // assign the probility of each feature to one cluster. k means is hard assignment.
-                const cv::Mat_<real> &feat = features.row(r);
-                    
-                // get nearest cluster
-                real min_dist = real( norm( feat, cluster_means.row(0), cv::NORM_L2));
-                int nearest_cluster(0);
-                for( int c=1; c<n_clusters; ++c) {
-                    const real dist = real( norm( feat, cluster_means.row(c), cv::NORM_L2));
-                    if( dist < min_dist) {
-                        min_dist = dist;
-                        nearest_cluster = c;
+            HierarchicalKMeansTree tree;
+            load_or_build_tree( features, tree);
+
+            // k means is hard assignment, every feature belongs to the cluster of its node in the cut
+            vector<int> cut;
+            tree.cut( static_cast<int>(description.tweak_vector[0]), cut);
+            vector<int> labels;
+            tree.labels( cut, labels);
+            return hard_membership_probabilities( labels, static_cast<int>(cut.size()));
+        }
+
+
+        /** @see Clusterer::do_cluster_quantized()
+         * The tree is built on the dequantized features, since the center updates need full precision.
+         * The assignment works on the quantized features, with the asymmetric quantized distance
+         * of every feature vector to the centers of the cut.
+         */
+        virtual Mat1r do_cluster_quantized( const QuantizedMat& features) const {
+            check_and_resolve_input_errors();
+            vector<int> cut;
+            Mat1r cluster_means;
+            {
+                Mat1r dequantized_features;
+                features.dequantize( dequantized_features);
+                HierarchicalKMeansTree tree;
+                load_or_build_tree( dequantized_features, tree);
+                tree.cut( static_cast<int>(description.tweak_vector[0]), cut);
+                tree.centers( cut, cluster_means);
+            }
+            const int n_clusters = cluster_means.rows;
+
+            vector<int> labels( features.rows());
+            parallel_for( features.rows(), [&]( const std::size_t begin, const std::size_t end) {
+                for( std::size_t r=begin; r<end; ++r) {
+                    // get nearest cluster with the asymmetric quantized distance
+                    const int row = static_cast<int>(r);
+                    real min_dist = features.squared_distance( row, cluster_means[0]);
+                    int nearest_cluster(0);
+                    for( int c=1; c<n_clusters; ++c) {
+                        const real dist = features.squared_distance( row, cluster_means[c]);
+                        if( dist < min_dist) {
+                            min_dist = dist;
+                            nearest_cluster = c;
+                        }
                     }
+                    labels[r] = nearest_cluster;
                 }
+            });
+            return hard_membership_probabilities( labels, n_clusters);
+        }
 
-                // assign probability 1 to nearest cluster
-                ret(r, nearest_cluster) = 1;
+    protected: // helpers
+
+        /** Reads the hierarchical k means tree from the model file if it was built
+         * for the given features and parameters, builds and persists it otherwise.
+         * @param features The row-wise feature vectors to be clustered.
+         * @param[out] o_tree The tree.
+         */
+        void load_or_build_tree( const Mat1r& features, HierarchicalKMeansTree& o_tree) const {
+            const Vec1r& tweak = this->description.tweak_vector;
+            const int branching = static_cast<int>(tweak[1]);
+            const int max_iterations = static_cast<int>(tweak[2]);
+            const uint64_t seed = static_cast<uint64_t>(tweak[3]);
+            const string& model_file = this->description.model_file;
+
+            if( !model_file.empty() && bfs::exists( model_file)) {
+                if( o_tree.from_file( model_file) && o_tree.matches( features, branching, max_iterations, seed)) {
+                    LOG(info) << "KMeansClusterer: Reusing the k means tree from \"" << model_file << "\".";
+                    return;
+                }
+                LOG(notify) << "KMeansClusterer: The k means tree in \"" << model_file << "\" does not match the features or parameters.";
             }
 
-            return ret;
+            o_tree.build( features, branching, max_iterations, seed);
+            if( !model_file.empty()) {
+                LOG(info) << "KMeansClusterer: Writing the k means tree to \"" << model_file << "\"...";
+                o_tree.to_file( model_file);
+            }
         }
 
-    protected: // helpers
 
         /** Helper function that checks the description for errors 
          * and logs and corrects them.
          */
         void check_and_resolve_input_errors() const {
-            if( this->description.tweak_vector.size() == 0 || this->description.tweak_vector[0] < 0) {
-                const unsigned int n_clusters_hint = 100;
-                LOG(warn) << "KMeansClusterer: Tweak vector must at least contain one positive integer hint for the number of clusters.";
-                LOG(notify) << "Setting hint of cluster count to " << n_clusters_hint << ".";
-                this->description.tweak_vector.clear();
-                this->description.tweak_vector.push_back( (const real)n_clusters_hint);
+            Vec1r& tweak = this->description.tweak_vector;
+
+            // the former layout holds the cluster count hint only
+            if( tweak.size() == 1 && tweak[0] >= 1) {
+                LOG(info) << "KMeansClusterer: Using the default branching factor 32, 11 iterations per node and the random seed 0.";
+                tweak.push_back( 32);
+                tweak.push_back( 11);
+                tweak.push_back( 0);
+            }
+
+            if( tweak.size() < 4 ||
+                tweak[0] < 1 ||     // n_clusters (el. N+)
+                tweak[1] < 2 ||     // branching (el. N+ >= 2)
+                tweak[2] < 1 ||     // max iterations (el. N+)
+                tweak[3] < 0        // random seed (el. N)
+                ) {
+
+                LOG(warn) << "KMeansClusterer: Tweak vector must contain 4 parameters:\n"
+                             "0: a hint for the maximum number of clusters\n"
+                             "1: the branching factor of the k means tree\n"
+                             "2: the maximum number of k means iterations per tree node\n"
+                             "3: the seed for the random number generator";
+
+                tweak.resize(4, -1);  // if too few parameters where given
+
+                // n_clusters
+                if( tweak[0] < 1) {
+                    tweak[0] = 100;
+                    LOG(notify) << "Setting hint of cluster count to " << tweak[0] << ".";
+                }
+                // branching
+                if( tweak[1] < 2) {
+                    tweak[1] = 32;
+                    LOG(notify) << "Setting branching factor to " << tweak[1] << ".";
+                }
+                // max iterations
+                if( tweak[2] < 1) {
+                    tweak[2] = 11;
+                    LOG(notify) << "Setting maximum number of iterations per node to " << tweak[2] << ".";
+                }
+                // random seed
+                if( tweak[3] < 0) {
+                    tweak[3] = 0;
+                    LOG(notify) << "Setting random seed to " << tweak[3] << ".";
+                }
             }
         }
 
@@ -0,0 +1,280 @@
+/******************************************************************************
+/* @file Mini-batch k means clusterer.
+/*
+/* @author langenhagen
+/* @version 150703
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "Clusterer.hpp"
+#include "kmeans_initialization.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <functional>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /** @brief Mini-batch k means clusterer.
+     * Updates the centers from small random batches of feature vectors with a per-center
+     * learning rate of 1 / (number of feature vectors assigned to the center so far)
+     * and stops early when the centers stop moving. Finally, all feature vectors
+     * are assigned to their nearest center.
+     * Needs only a fraction of the passes over the data of full k means, for the price
+     * of a slightly worse clustering, which is logged as the mean squared distance
+     * of the feature vectors to their centers.
+     * @see D. Sculley: Web-Scale K-Means Clustering. WWW 2010.
+     */
+    class MiniBatchKMeansClusterer : public Clusterer {
+
+    private: // types
+
+        /// Retrieves the feature vector with the given row index.
+        typedef std::function< void( const int row, real* o_feature)> row_getter;
+
+        /// The number of feature vectors that are assigned at once in the final assignment of quantized features.
+        enum { ASSIGNMENT_CHUNK_SIZE = 1 << 16 };
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param d The description of the clusterer instance.
+         */
+        MiniBatchKMeansClusterer( clusterer_description& d)
+            : Clusterer(d) {
+            check_and_resolve_input_errors();
+        }
+
+        /** Destructor.
+         */
+        ~MiniBatchKMeansClusterer()
+        {}
+
+    private: // methods
+
+        /** @see Clusterer::do_cluster()
+         */
+        virtual Mat1r do_cluster( const Mat1r& features) const {
+            check_and_resolve_input_errors();
+            Mat1r centers;
+            fit_centers( features.rows,
+                         features.cols,
+                         [&features]( const int row, real* o_feature) {
+                             std::copy( features[row], features[row] + features.cols, o_feature);
+                         },
+                         centers);
+
+            vector<int> labels;
+            Vec1r squared_distances;
+            assign_to_nearest_centers( features, centers, labels, &squared_distances);
+            log_mean_squared_distance( squared_distances);
+            return hard_membership_probabilities( labels, centers.rows);
+        }
+
+
+        /** @see Clusterer::do_cluster_quantized()
+         * Dequantizes only the sampled batches and chunks of the final assignment.
+         */
+        virtual Mat1r do_cluster_quantized( const QuantizedMat& features) const {
+            check_and_resolve_input_errors();
+            const row_getter get_row = [&features]( const int row, real* o_feature) {
+                features.dequantize_row( row, o_feature);
+            };
+            Mat1r centers;
+            fit_centers( features.rows(), features.cols(), get_row, centers);
+
+            vector<int> labels( features.rows());
+            Vec1r squared_distances( features.rows());
+            Mat1r chunk;
+            vector<int> chunk_labels;
+            Vec1r chunk_squared_distances;
+            for( int begin=0; begin<features.rows(); begin+=ASSIGNMENT_CHUNK_SIZE) {
+                const int end = std::min( begin + static_cast<int>(ASSIGNMENT_CHUNK_SIZE), features.rows());
+                chunk.create( end - begin, features.cols());
+                for( int r=begin; r<end; ++r)
+                    get_row( r, chunk[r-begin]);
+                assign_to_nearest_centers( chunk, centers, chunk_labels, &chunk_squared_distances);
+                std::copy( chunk_labels.begin(), chunk_labels.end(), labels.begin() + begin);
+                std::copy( chunk_squared_distances.begin(), chunk_squared_distances.end(), squared_distances.begin() + begin);
+            }
+            log_mean_squared_distance( squared_distances);
+            return hard_membership_probabilities( labels, centers.rows);
+        }
+
+    protected: // helpers
+
+        /** Finds the cluster centers with mini-batch k means.
+         * @param n_features The number of feature vectors.
+         * @param n_dims The dimensionality of the feature vectors.
+         * @param get_row Retrieves a feature vector by its row index.
+         * @param[out] o_centers The row-wise cluster centers.
+         */
+        void fit_centers( const int n_features, const int n_dims, const row_getter& get_row, Mat1r& o_centers) const {
+            const Vec1r& tweak = this->description.tweak_vector;
+            const int n_clusters = std::min( static_cast<int>(tweak[0]), n_features);
+            const int batch_size = static_cast<int>(tweak[1]);
+            const int max_iterations = static_cast<int>(tweak[2]);
+            const real tolerance = tweak[3];
+            cv::RNG rng( static_cast<uint64>(tweak[4]));
+
+            o_centers.create( n_clusters, n_dims);
+            if( n_clusters == 0)
+                return;
+
+            const center_initialization::center_initialization initialization = static_cast<center_initialization::center_initialization>( static_cast<int>(tweak[5]));
+            if( initialization == center_initialization::KMEANS_PARALLEL) {
+                // k-means|| on a sample of the feature vectors
+                const int n_samples = std::max( 10 * n_clusters, 3 * batch_size);
+                Mat1r sample( std::min( n_samples, n_features), n_dims);
+                for( int r=0; r<sample.rows; ++r)
+                    get_row( n_samples < n_features ? rng.uniform( 0, n_features) : r, sample[r]);
+                init_centers_kmeans_parallel( sample, n_clusters, rng, o_centers);
+            } else {
+                // distinct random feature vectors
+                vector<int> indices( n_features);
+                for( int i=0; i<n_features; ++i)
+                    indices[i] = i;
+                for( int c=0; c<n_clusters; ++c) {
+                    std::swap( indices[c], indices[c + rng.uniform( 0, n_features - c)]);
+                    get_row( indices[c], o_centers[c]);
+                }
+            }
+
+            // the tolerance is relative to the variance of the data, estimated on one batch
+            Mat1r batch( batch_size, n_dims);
+            sample_batch( n_features, get_row, rng, batch);
+            Mat1r batch_mean;
+            cv::reduce( batch, batch_mean, 0, CV_REDUCE_AVG);
+            real variance(0);
+            for( int r=0; r<batch.rows; ++r)
+                variance += distances::squared_l2( batch[r], batch_mean[0], n_dims);
+            variance /= batch.rows;
+            const real max_squared_shift = tolerance * variance;
+
+            vector<uint> n_assigned( n_clusters, 0);
+            vector<int> labels;
+            Mat1r old_centers;
+            int iteration = 0;
+            for( ; iteration<max_iterations; ++iteration) {
+                if( iteration > 0)
+                    sample_batch( n_features, get_row, rng, batch);
+                o_centers.copyTo( old_centers);
+
+                assign_to_nearest_centers( batch, o_centers, labels);
+                for( int r=0; r<batch.rows; ++r) {
+                    const int c = labels[r];
+                    const real eta = real(1) / ++n_assigned[c];
+                    real* center = o_centers[c];
+                    const real* feature = batch[r];
+                    for( int d=0; d<n_dims; ++d)
+                        center[d] += eta * (feature[d] - center[d]);
+                }
+
+                // mean squared center shift
+                real squared_shift(0);
+                for( int c=0; c<n_clusters; ++c)
+                    squared_shift += distances::squared_l2( o_centers[c], old_centers[c], n_dims);
+                squared_shift /= n_clusters;
+                if( squared_shift <= max_squared_shift) {
+                    ++iteration;
+                    break;
+                }
+            }
+            LOG(info) << "MiniBatchKMeansClusterer: Found " << n_clusters << " centers after " << iteration << " batches of " << batch_size << ".";
+        }
+
+
+        /** Fills a batch with feature vectors that are drawn uniformly with replacement.
+         * @param n_features The number of feature vectors.
+         * @param get_row Retrieves a feature vector by its row index.
+         * @param rng The random number generator.
+         * @param[in,out] batch The batch. Its size stays unchanged.
+         */
+        static void sample_batch( const int n_features, const row_getter& get_row, cv::RNG& rng, Mat1r& batch) {
+            for( int r=0; r<batch.rows; ++r)
+                get_row( rng.uniform( 0, n_features), batch[r]);
+        }
+
+
+        /** Logs the mean squared distance of the feature vectors to their centers,
+         * i.e. the k means objective, as a measure of the clustering quality.
+         * @param squared_distances The squared distances of the feature vectors to their centers.
+         */
+        static void log_mean_squared_distance( const Vec1r& squared_distances) {
+            double sum(0);
+            for( auto it=squared_distances.begin(); it!=squared_distances.end(); ++it)
+                sum += *it;
+            LOG(info) << "MiniBatchKMeansClusterer: Mean squared distance to the centers: "
+                      << (squared_distances.empty() ? 0 : sum / squared_distances.size()) << ".";
+        }
+
+
+        /** Helper function that checks the description for errors
+         * and logs and corrects them.
+         */
+        void check_and_resolve_input_errors() const {
+            Vec1r& tweak = this->description.tweak_vector;
+
+            if( tweak.size() < 6 ||
+                tweak[0] < 1 ||     // n_clusters (el. N+)
+                tweak[1] < 1 ||     // batch size (el. N+)
+                tweak[2] < 1 ||     // max iterations (el. N+)
+                tweak[3] < 0 ||     // tolerance (el. R+)
+                tweak[4] < 0 ||     // random seed (el. N)
+                tweak[5] < center_initialization::RANDOM || tweak[5] > center_initialization::KMEANS_PARALLEL // initialization (el. {0,1})
+                ) {
+
+                LOG(warn) << "MiniBatchKMeansClusterer: Tweak vector must contain 6 parameters:\n"
+                             "0: the number of clusters\n"
+                             "1: the number of feature vectors per batch\n"
+                             "2: the maximum number of batches\n"
+                             "3: the convergence tolerance: the algorithm stops when the mean squared center shift of one batch\n"
+                             "   is below this fraction of the variance of the data\n"
+                             "4: the seed for the random number generator\n"
+                             "5: the center initialization: 0: random feature vectors, 1: k-means|| on a sample";
+
+                tweak.resize(6, -1);  // if too few parameters where given
+
+                // n_clusters
+                if( tweak[0] < 1) {
+                    tweak[0] = 100;
+                    LOG(notify) << "Setting number of clusters to " << tweak[0] << ".";
+                }
+                // batch size
+                if( tweak[1] < 1) {
+                    tweak[1] = 1024;
+                    LOG(notify) << "Setting batch size to " << tweak[1] << ".";
+                }
+                // max iterations
+                if( tweak[2] < 1) {
+                    tweak[2] = 1000;
+                    LOG(notify) << "Setting maximum number of batches to " << tweak[2] << ".";
+                }
+                // tolerance
+                if( tweak[3] < 0) {
+                    tweak[3] = static_cast<real>(1e-6);
+                    LOG(notify) << "Setting convergence tolerance to " << tweak[3] << ".";
+                }
+                // random seed
+                if( tweak[4] < 0) {
+                    tweak[4] = 0;
+                    LOG(notify) << "Setting random seed to " << tweak[4] << ".";
+                }
+                // initialization
+                if( tweak[5] < center_initialization::RANDOM || tweak[5] > center_initialization::KMEANS_PARALLEL) {
+                    tweak[5] = center_initialization::KMEANS_PARALLEL;
+                    LOG(notify) << "Setting center initialization to KMEANS_PARALLEL aka " << tweak[5] << ".";
+                }
+            }
+        }
+
+    };
+
+}
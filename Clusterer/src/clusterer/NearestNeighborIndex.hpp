@@ -0,0 +1,141 @@
+/******************************************************************************
+/* @file An approximate nearest neighbor index over the rows of a feature
+/*       matrix that clusterers can opt in to instead of scanning all features.
+/*       Builds or loads the k-nearest-neighbor graph of the ANN module and
+/*       chooses the search width that reaches the targeted recall.
+/*
+/* @author langenhagen
+/* @version 150715
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include <common.hpp>
+#include "parallel_for.hpp"
+#include "ANN/recall.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <cmath>
+#include <limits>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /// The number of features on which the recall of the approximate nearest neighbor search is measured.
+    const uint ANN_RECALL_SAMPLES = 256;
+
+
+    /** @brief Approximate nearest neighbor search over the rows of a feature matrix.
+     * Call prepare() before the first query. The queries are thread-safe.
+     */
+    class NearestNeighborIndex {
+
+    private: // vars
+
+        const OPTICS::PointMatrix _points;                  ///< The rows of the feature matrix.
+        ANN::KNNGraph<OPTICS::PointMatrix> _graph;          ///< The k-nearest-neighbor graph over the rows.
+        uint _search_width;                                 ///< The number of closest features a query keeps.
+        double _recall;                                     ///< The measured recall of the search width.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param features The row-wise feature vectors. Must outlive the index.
+         */
+        NearestNeighborIndex( const Mat1r& features)
+            : _points( features.ptr<real>(), features.rows, features.cols, features.step1()),
+              _graph( _points),
+              _search_width( 1),
+              _recall( 0)
+        {}
+
+    public: // methods
+
+        /** Loads the graph from a file or builds it, and chooses the search width.
+         * The search width is the smallest one whose measured recall of the k nearest neighbors reaches the target.
+         * @param graph_file A file in which the graph is persisted. A graph that was built for other features
+         *        or parameters is rebuilt and overwritten. Empty for none.
+         * @param n_neighbors The number of neighbors per feature of the graph.
+         * @param target_recall The targeted recall el. ]0,1].
+         * @param k The number of nearest neighbors the clusterer queries, for which the recall is measured.
+         */
+        void prepare( const string& graph_file, const uint n_neighbors, const real target_recall, const uint k) {
+            const uint64_t fingerprint = ANN::fingerprint( _points, n_neighbors);
+            if( !graph_file.empty() && _graph.from_file( graph_file, fingerprint)) {
+                LOG(info) << "Loaded the nearest neighbor graph \"" << graph_file << "\".";
+            } else {
+                LOG(info) << "Building the nearest neighbor graph with " << n_neighbors << " neighbors per feature...";
+                const uint n_iterations = _graph.build( n_neighbors, &parallel_for);
+                LOG(info) << "Built the nearest neighbor graph in " << n_iterations << " iterations.";
+                if( !graph_file.empty()) {
+                    if( _graph.to_file( graph_file, fingerprint))
+                        LOG(info) << "Wrote the nearest neighbor graph to \"" << graph_file << "\".";
+                    else
+                        LOG(warn) << "Could not write the nearest neighbor graph to \"" << graph_file << "\".";
+                }
+            }
+
+            const ANN::RecallReference reference = ANN::recall_reference( _points, ANN::recall_samples( _points.size(), ANN_RECALL_SAMPLES), k, &parallel_for);
+            _search_width = ANN::tune_search_width( _graph, reference, target_recall, &parallel_for, _recall);
+            LOG(info) << "Approximate nearest neighbor search: search width " << _search_width
+                      << " has a measured recall of " << _recall << " for " << k << " neighbors on "
+                      << reference.samples.size() << " sample features.";
+            if( _recall < target_recall)
+                LOG(warn) << "The approximate nearest neighbor search misses the targeted recall of " << target_recall << ".";
+        }
+
+
+        /** Finds the approximate k nearest neighbors of a feature, without the feature itself.
+         * @param r The row of the feature.
+         * @param k The number of neighbors.
+         * @return The up to k nearest features found with their squared distances, closest first.
+         */
+        ANN::NeighborVector knn( const int r, const uint k) const {
+            return _graph.knn( static_cast<OPTICS::point_id>(r), k, std::max( k, _search_width));
+        }
+
+
+        /** Finds the features within a radius around a feature, without the feature itself.
+         * @param r The row of the feature.
+         * @param radius The radius.
+         * @return The features found within the radius with their squared distances, closest first.
+         */
+        ANN::NeighborVector radius_neighbors( const int r, const real radius) const {
+            return _graph.radius_neighbors( static_cast<OPTICS::point_id>(r), radius * radius, _search_width);
+        }
+
+
+        /** Finds the approximate distance of a feature to its nearest neighbor.
+         * @param r The row of the feature.
+         * @return The distance or std::numeric_limits<real>::max() if there is no other feature.
+         */
+        real nearest_neighbor_distance( const int r) const {
+            const ANN::NeighborVector nearest = knn( r, 1);
+            return nearest.empty() ? std::numeric_limits<real>::max() : std::sqrt( nearest[0].squared_distance);
+        }
+
+
+        /** Retrieves the search width.
+         * @return The number of closest features a query keeps.
+         */
+        uint search_width() const { return _search_width; }
+
+        /** Retrieves the measured recall.
+         * @return The measured recall of the search width el. [0,1].
+         */
+        double recall() const { return _recall; }
+
+    private:
+        /// Not copyable, since the graph refers to the points.
+        NearestNeighborIndex( const NearestNeighborIndex&);
+        /// Not assignable.
+        NearestNeighborIndex& operator=( const NearestNeighborIndex&);
+    };
+
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+/* @file Contains the ClusterOrdering struct, the persistable result of an OPTICS run.
+/*
+/*
+/* @author langenhagen
+/* @version 150710
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "common.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <assert.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// The first bytes of every cluster ordering file.
+    const char CLUSTER_ORDERING_FILE_MAGIC[] = "OCO1";
+
+
+    /** @brief The cluster ordering of a point set together with the reachability and core distances.
+     * Extracting clusters only needs the ordering and the distances, so an ordering that is stored
+     * on disk lets later runs extract clusters with other parameters without running OPTICS again.
+     * The fingerprint identifies the points and parameters the ordering was computed for.
+     */
+    struct ClusterOrdering {
+        uint64_t fingerprint;                   ///< Identifies the points and the parameters, see fingerprint().
+        IdVector ordered_ids;                   ///< The OPTICS ordered list of point ids.
+        std::vector<real> reachabilities;       ///< The squared reachability distance of every point, indexed by point id.
+        std::vector<real> core_distances;       ///< The squared core distance of every point, indexed by point id.
+
+        /** Default constructor.
+         * Creates an empty ordering.
+         */
+        ClusterOrdering() : fingerprint( 0)
+        {}
+
+        /** Retrieves the reachability distances in the order of the points.
+         * @return The squared reachability distance of every point, in cluster order.
+         */
+        std::vector<real> ordered_reachabilities() const {
+            std::vector<real> ret;
+            ret.reserve( ordered_ids.size());
+            for( IdVector::const_iterator it=ordered_ids.begin(); it!=ordered_ids.end(); ++it)
+                ret.push_back( reachabilities[*it]);
+            return ret;
+        }
+
+        /** Writes the ordering to a binary file.
+         * The format is: magic number, fingerprint, number of points, followed by the ordered ids,
+         * the reachability distances and the core distances.
+         * @param fname The name of the file to be written to.
+         * @return TRUE in case of success,
+         *         FALSE in case of error.
+         */
+        bool to_file( const std::string& fname) const {
+            assert( reachabilities.size() == ordered_ids.size() && core_distances.size() == ordered_ids.size() && "one distance per point");
+            std::ofstream out_file( fname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+            if( !out_file.is_open())
+                return false;
+
+            const uint64_t header[] = { fingerprint, ordered_ids.size() };
+            out_file.write( CLUSTER_ORDERING_FILE_MAGIC, 4);
+            out_file.write( reinterpret_cast<const char*>(header), sizeof(header));
+            if( !ordered_ids.empty()) {
+                out_file.write( reinterpret_cast<const char*>(&ordered_ids[0]), ordered_ids.size() * sizeof(point_id));
+                out_file.write( reinterpret_cast<const char*>(&reachabilities[0]), reachabilities.size() * sizeof(real));
+                out_file.write( reinterpret_cast<const char*>(&core_distances[0]), core_distances.size() * sizeof(real));
+            }
+            return !out_file.bad();
+        }
+
+        /** Reads an ordering from a binary file written by to_file().
+         * Rejects files whose size does not match the header and orderings that are no permutation of the point ids.
+         * @param fname The path to the file where the ordering is stored.
+         * @return TRUE in case of success,
+         *         FALSE in case of error. The ordering is empty then.
+         */
+        bool from_file( const std::string& fname) {
+            *this = ClusterOrdering();
+            std::ifstream in_file( fname.c_str(), std::ios::in | std::ios::binary);
+            char magic[4];
+            uint64_t header[2]; // fingerprint, n_points
+            if( !in_file.is_open() ||
+                !in_file.read( magic, 4) ||
+                std::memcmp( magic, CLUSTER_ORDERING_FILE_MAGIC, 4) != 0 ||
+                !in_file.read( reinterpret_cast<char*>(header), sizeof(header))) {
+                return false;
+            }
+
+            // the number of points must account for the whole file, before anything is allocated
+            const uint64_t bytes_per_point = sizeof(point_id) + 2 * sizeof(real);
+            in_file.seekg( 0, std::ios::end);
+            const uint64_t actual_size = static_cast<uint64_t>(in_file.tellg());
+            in_file.seekg( static_cast<std::streamoff>(4 + sizeof(header)), std::ios::beg);
+            if( actual_size < 4 + sizeof(header) ||
+                header[1] != (actual_size - 4 - sizeof(header)) / bytes_per_point ||
+                actual_size != 4 + sizeof(header) + header[1] * bytes_per_point) {
+                return false;
+            }
+
+            ClusterOrdering ordering;
+            ordering.fingerprint = header[0];
+            const std::size_t n_points = static_cast<std::size_t>(header[1]);
+            ordering.ordered_ids.resize( n_points);
+            ordering.reachabilities.resize( n_points);
+            ordering.core_distances.resize( n_points);
+            if( n_points > 0 &&
+                !(in_file.read( reinterpret_cast<char*>(&ordering.ordered_ids[0]), n_points * sizeof(point_id)) &&
+                  in_file.read( reinterpret_cast<char*>(&ordering.reachabilities[0]), n_points * sizeof(real)) &&
+                  in_file.read( reinterpret_cast<char*>(&ordering.core_distances[0]), n_points * sizeof(real)))) {
+                return false;
+            }
+            // every point must appear exactly once
+            std::vector<bool> is_ordered( n_points, false);
+            for( IdVector::const_iterator it=ordering.ordered_ids.begin(); it!=ordering.ordered_ids.end(); ++it) {
+                if( *it >= n_points || is_ordered[*it])
+                    return false;
+                is_ordered[*it] = true;
+            }
+
+            std::swap( *this, ordering);
+            return true;
+        }
+    };
+
+
+    /** Feeds bytes into a 64 bit FNV-1a hash.
+     * @param data The bytes.
+     * @param n_bytes The number of bytes.
+     * @param[in,out] io_hash The hash so far.
+     */
+    inline void fnv1a_hash( const void* data, const std::size_t n_bytes, uint64_t& io_hash) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for( std::size_t i=0; i<n_bytes; ++i) {
+            io_hash ^= bytes[i];
+            io_hash *= 0x100000001B3ULL;
+        }
+    }
+
+
+    /** Computes a 64 bit FNV-1a hash of the coordinates of the points and the OPTICS parameters.
+     * Orderings with equal fingerprints were computed from the same points with the same parameters.
+     * @param points The points.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param variant Distinguishes algorithms that yield different orderings for the same parameters.
+     * @return The fingerprint.
+     */
+    template<typename Points>
+    uint64_t fingerprint( const Points& points, const real eps, const unsigned int min_pts, const uint64_t variant) {
+        uint64_t ret = 0xCBF29CE484222325ULL;
+        const uint64_t shape[] = { points.size(), points.dims(), min_pts, variant };
+        fnv1a_hash( shape, sizeof(shape), ret);
+        fnv1a_hash( &eps, sizeof(eps), ret);
+
+        const point_id n_points = static_cast<point_id>(points.size());
+        for( point_id p=0; p<n_points; ++p) {
+            for( std::size_t d=0; d<points.dims(); ++d) {
+                const real c = points.coordinate( p, d);
+                fnv1a_hash( &c, sizeof(c), ret);
+            }
+        }
+        return ret;
+    }
+
+} // END namespace OPTICS
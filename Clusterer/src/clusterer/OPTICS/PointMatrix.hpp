@@ -0,0 +1,95 @@
+/******************************************************************************
+/* @file Contains the PointMatrix class, a view of multi-dimensional points
+/*       that are stored contiguously in row-major order.
+/*
+/*
+/* @author langenhagen
+/* @version 150707
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "common.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <assert.h>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** @brief A view of points that are stored row by row in one contiguous block of memory,
+     * e.g. the rows of a feature matrix. Does not own or copy the data.
+     *
+     * The OPTICS functions are templates on the type of the point set. Other point sets,
+     * e.g. over compressed data, can be used if they provide the same methods:
+     * size(), dims(), coordinate() and squared_distance().
+     */
+    class PointMatrix {
+
+    private: // vars
+
+        const real* _data;          ///< The first coordinate of the first point.
+        std::size_t _n_points;      ///< The number of points.
+        std::size_t _n_dims;        ///< The dimensionality of the points.
+        std::size_t _stride;        ///< The distance between the first coordinates of two subsequent points, in elements.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param data The first coordinate of the first point. Must outlive the view.
+         * @param n_points The number of points.
+         * @param n_dims The dimensionality of the points.
+         * @param stride The distance between the first coordinates of two subsequent points, in elements.
+         *        Must not be smaller than n_dims.
+         */
+        PointMatrix( const real* data, const std::size_t n_points, const std::size_t n_dims, const std::size_t stride)
+            : _data( data), _n_points( n_points), _n_dims( n_dims), _stride( stride) {
+            assert( stride >= n_dims && "the rows must not overlap");
+        }
+
+    public: // methods
+
+        /** Retrieves the number of points.
+         * @return The number of points.
+         */
+        inline std::size_t size() const { return _n_points; }
+
+        /** Retrieves the dimensionality of the points.
+         * @return The dimensionality of the points.
+         */
+        inline std::size_t dims() const { return _n_dims; }
+
+        /** Retrieves the coordinates of a point.
+         * @param p The id of the point.
+         * @return A pointer to the dims() coordinates of the point.
+         */
+        inline const real* row( const point_id p) const {
+            assert( p < _n_points && "point id out of range");
+            return _data + p * _stride;
+        }
+
+        /** Retrieves one coordinate of a point.
+         * @param p The id of the point.
+         * @param d The dimension. Must be smaller than dims().
+         * @return The d-th coordinate of the point.
+         */
+        inline real coordinate( const point_id p, const std::size_t d) const { return row( p)[d]; }
+
+        /** Retrieves the squared euclidean distance of two points.
+         * @param a The id of the first point.
+         * @param b The id of the second point.
+         * @return The squared euclidean distance.
+         */
+        inline real squared_distance( const point_id a, const point_id b) const {
+            return distances::squared_l2( row( a), row( b), _n_dims);
+        }
+    };
+
+} // END namespace OPTICS
@@ -0,0 +1,459 @@
+/******************************************************************************
+/* @file Contains spatial indexes that answer the epsilon-range queries of OPTICS
+/*       without scanning the whole database.
+/*
+/*
+/* @author langenhagen
+/* @version 150708
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "common.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // nth_element
+#include <assert.h>
+#include <cmath>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// Possible range index types wrapping namespace.
+    namespace range_index_type {
+        /// Possible range index types.
+        enum range_index_type {
+            AUTO        = 0,    ///< KD_TREE for low dimensional data, VP_TREE otherwise
+            LINEAR_SCAN = 1,    ///< no index, compares with every point
+            KD_TREE     = 2,    ///< kd-tree on the coordinates, for low dimensional data
+            VP_TREE     = 3     ///< vantage point tree, needs nothing but the distance; suits high dimensional data
+        };
+    }
+
+
+    /** @brief Interface for indexes that retrieve the epsilon-neighborhood of a point.
+     * An index is built once over the point set and does not change it.
+     * It counts the distance evaluations, so that its speedup over a linear scan can be reported.
+     * Concurrent queries must use concurrent_range_query(), which leaves the counters alone.
+     * @see PointMatrix for the methods a point set must provide.
+     */
+    template<typename Points>
+    class RangeIndex {
+
+    protected: // vars
+
+        const Points& _points;                          ///< The indexed points.
+        mutable unsigned long long _n_distances;        ///< The number of distance evaluations so far, including the build.
+        mutable unsigned long long _n_queries;          ///< The number of range queries so far.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param points The points to be indexed. Must outlive the index.
+         */
+        RangeIndex( const Points& points) : _points( points), _n_distances( 0), _n_queries( 0)
+        {}
+
+        /// Destructor.
+        virtual ~RangeIndex()
+        {}
+
+    public: // methods
+
+        /** Retrieves all points in the epsilon-surrounding of the given point, including the point itself.
+         * @param p The id of the point which represents the center of the epsilon surrounding.
+         * @param eps The epsilon value that represents the radius for the neigborhood search.
+         * @param[out] o_neighbors The points within the epsilon-neighborhood of p together with their squared
+         *             distances to p, in no particular order.
+         */
+        void range_query( const point_id p, const real eps, NeighborVector& o_neighbors) const {
+            assert( eps >= 0 && "eps must not be negative");
+            o_neighbors.clear();
+            ++_n_queries;
+            do_range_query( p, eps, o_neighbors, _n_distances);
+        }
+
+        /** Like range_query(), but does not touch the statistics of the index,
+         * so that several threads can query the index at the same time.
+         * @param p The id of the point which represents the center of the epsilon surrounding.
+         * @param eps The epsilon value that represents the radius for the neigborhood search.
+         * @param[out] o_neighbors The points within the epsilon-neighborhood of p together with their squared
+         *             distances to p, in no particular order.
+         * @return The number of distance evaluations of the query.
+         * @see add_concurrent_queries()
+         */
+        unsigned long long concurrent_range_query( const point_id p, const real eps, NeighborVector& o_neighbors) const {
+            assert( eps >= 0 && "eps must not be negative");
+            o_neighbors.clear();
+            unsigned long long ret = 0;
+            do_range_query( p, eps, o_neighbors, ret);
+            return ret;
+        }
+
+        /** Adds the queries that were done with concurrent_range_query() to the statistics.
+         * @param n_queries The number of queries.
+         * @param n_distances The number of distance evaluations of these queries.
+         */
+        void add_concurrent_queries( const unsigned long long n_queries, const unsigned long long n_distances) const {
+            _n_queries += n_queries;
+            _n_distances += n_distances;
+        }
+
+        /** Retrieves the number of distance evaluations so far, including the ones for building the index.
+         * @return The number of distance evaluations.
+         */
+        inline unsigned long long n_distance_evaluations() const { return _n_distances; }
+
+        /** Retrieves the number of distance evaluations a linear scan would have needed for the queries so far.
+         * @return The number of distance evaluations of a linear scan.
+         */
+        inline unsigned long long n_linear_scan_distance_evaluations() const { return _n_queries * _points.size(); }
+
+        /** Retrieves the indexed points.
+         * @return The indexed points.
+         */
+        inline const Points& points() const { return _points; }
+
+    protected: // helpers
+
+        /** Retrieves the squared distance of two points and counts the evaluation.
+         * @param a The id of the first point.
+         * @param b The id of the second point.
+         * @param[in,out] io_n_distances The counter of distance evaluations.
+         * @return The squared euclidean distance.
+         */
+        inline real counted_squared_distance( const point_id a, const point_id b, unsigned long long& io_n_distances) const {
+            ++io_n_distances;
+            return _points.squared_distance( a, b);
+        }
+
+    private: // virtual interface
+
+        /** Does the actual range query.
+         * @param p The id of the point which represents the center of the epsilon surrounding.
+         * @param eps The epsilon value that represents the radius for the neigborhood search.
+         * @param[out] o_neighbors The points within the epsilon-neighborhood of p and their squared distances. Empty on entry.
+         * @param[in,out] io_n_distances The counter of distance evaluations.
+         */
+        virtual void do_range_query( const point_id p, const real eps, NeighborVector& o_neighbors, unsigned long long& io_n_distances) const = 0;
+    };
+
+
+
+
+
+
+    /// Compares a query point with every point.
+    template<typename Points>
+    class LinearScanIndex : public RangeIndex<Points> {
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param points The points to be indexed. Must outlive the index.
+         */
+        LinearScanIndex( const Points& points) : RangeIndex<Points>( points)
+        {}
+
+    private: // methods
+
+        /// @see RangeIndex::do_range_query()
+        virtual void do_range_query( const point_id p, const real eps, NeighborVector& o_neighbors, unsigned long long& io_n_distances) const {
+            const real eps_sq = eps*eps;
+            const point_id n_points = static_cast<point_id>(this->_points.size());
+            for( point_id q=0; q<n_points; ++q) {
+                const real sq_dist = this->counted_squared_distance( p, q, io_n_distances);
+                if( sq_dist <= eps_sq)
+                    o_neighbors.push_back( Neighbor( q, sq_dist));
+            }
+        }
+    };
+
+
+
+
+
+
+    /** @brief KD-tree over the coordinates of the points.
+     * Splits at the median of the dimension with the largest spread and visits
+     * a subtree only if the query ball crosses its splitting plane.
+     * Prunes well up to about a dozen dimensions.
+     */
+    template<typename Points>
+    class KDTreeIndex : public RangeIndex<Points> {
+
+    private: // types
+
+        /// A node of the tree. Leaves hold a range of points, inner nodes a splitting plane.
+        struct node {
+            int begin;          ///< The first position of the node's points in the permuted points.
+            int end;            ///< One past the last position of the node's points in the permuted points.
+            int split_dim;      ///< The splitting dimension, -1 for leaves.
+            real split_value;   ///< The splitting value. Points left of the plane are in the left child.
+            int left;           ///< The index of the left child.
+            int right;          ///< The index of the right child.
+        };
+
+        /// The maximum number of points per leaf.
+        enum { LEAF_SIZE = 16 };
+
+    private: // vars
+
+        std::vector<node> _nodes;       ///< The nodes, the root first.
+        IdVector _ids;                  ///< The point ids, permuted so that every node owns a contiguous range.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Builds the tree.
+         * @param points The points to be indexed. Must outlive the index.
+         */
+        KDTreeIndex( const Points& points) : RangeIndex<Points>( points), _ids( points.size()) {
+            for( std::size_t i=0; i<_ids.size(); ++i)
+                _ids[i] = static_cast<point_id>(i);
+            if( !_ids.empty())
+                build( 0, static_cast<int>(_ids.size()));
+        }
+
+    private: // methods
+
+        /** Builds the subtree over the given range of the permuted points.
+         * @param begin The first position of the range.
+         * @param end One past the last position of the range.
+         * @return The index of the subtree's root node.
+         */
+        int build( const int begin, const int end) {
+            const int ret = static_cast<int>(_nodes.size());
+            node n = { begin, end, -1, 0, -1, -1 };
+            _nodes.push_back( n);
+            if( end - begin <= LEAF_SIZE)
+                return ret;
+
+            // split the dimension with the largest spread at its median
+            const Points& points = this->_points;
+            const std::size_t n_dims = points.dims();
+            int split_dim = -1;
+            real max_spread = 0;
+            for( std::size_t d=0; d<n_dims; ++d) {
+                real min_value = points.coordinate( _ids[begin], d);
+                real max_value = min_value;
+                for( int i=begin+1; i<end; ++i) {
+                    min_value = std::min( min_value, points.coordinate( _ids[i], d));
+                    max_value = std::max( max_value, points.coordinate( _ids[i], d));
+                }
+                if( max_value - min_value > max_spread) {
+                    max_spread = max_value - min_value;
+                    split_dim = static_cast<int>(d);
+                }
+            }
+            if( split_dim < 0)
+                return ret; // all points are equal
+
+            const int mid = begin + (end - begin) / 2;
+            std::nth_element( _ids.begin() + begin,
+                              _ids.begin() + mid,
+                              _ids.begin() + end,
+                              [&points, split_dim]( const point_id a, const point_id b){ return points.coordinate( a, split_dim) < points.coordinate( b, split_dim); } );
+
+            const real split_value = points.coordinate( _ids[mid], split_dim);
+            const int left = build( begin, mid);
+            const int right = build( mid, end);
+            _nodes[ret].split_dim = split_dim;
+            _nodes[ret].split_value = split_value;
+            _nodes[ret].left = left;
+            _nodes[ret].right = right;
+            return ret;
+        }
+
+
+        /// @see RangeIndex::do_range_query()
+        virtual void do_range_query( const point_id p, const real eps, NeighborVector& o_neighbors, unsigned long long& io_n_distances) const {
+            if( !_nodes.empty())
+                query( 0, p, eps*eps, o_neighbors, io_n_distances);
+        }
+
+
+        /** Collects the neighbors within the given subtree.
+         * @param n The index of the subtree's root node.
+         * @param p The id of the query point.
+         * @param eps_sq The squared epsilon.
+         * @param[out] o_neighbors The neighbors found so far.
+         * @param[in,out] io_n_distances The counter of distance evaluations.
+         */
+        void query( const int n, const point_id p, const real eps_sq, NeighborVector& o_neighbors, unsigned long long& io_n_distances) const {
+            const node& current = _nodes[n];
+            if( current.split_dim < 0) {
+                for( int i=current.begin; i<current.end; ++i) {
+                    const real sq_dist = this->counted_squared_distance( p, _ids[i], io_n_distances);
+                    if( sq_dist <= eps_sq)
+                        o_neighbors.push_back( Neighbor( _ids[i], sq_dist));
+                }
+                return;
+            }
+            // points on the plane may lie in both children
+            const real diff = this->_points.coordinate( p, current.split_dim) - current.split_value;
+            if( diff <= 0 || diff*diff <= eps_sq)
+                query( current.left, p, eps_sq, o_neighbors, io_n_distances);
+            if( diff >= 0 || diff*diff <= eps_sq)
+                query( current.right, p, eps_sq, o_neighbors, io_n_distances);
+        }
+    };
+
+
+
+
+
+
+    /** @brief Vantage point tree.
+     * Every node picks a vantage point and splits the other points at their median distance to it;
+     * the triangle inequality tells which halves a query ball can reach.
+     * Needs nothing but the distance and prunes better than a KD-tree in high dimensions.
+     * @see P. N. Yianilos: Data Structures and Algorithms for Nearest Neighbor Search in General Metric Spaces. SODA 1993.
+     */
+    template<typename Points>
+    class VPTreeIndex : public RangeIndex<Points> {
+
+    private: // types
+
+        /// A node of the tree. Leaves hold a range of points, inner nodes a vantage point.
+        struct node {
+            int begin;          ///< The first position of the node's points in the permuted points. Inner nodes: the vantage point.
+            int end;            ///< One past the last position of the node's points in the permuted points.
+            real radius;        ///< The median distance to the vantage point. Points up to it are in the inside child.
+            int inside;         ///< The index of the inside child, -1 for leaves.
+            int outside;        ///< The index of the outside child, -1 for leaves.
+        };
+
+        /// The maximum number of points per leaf.
+        enum { LEAF_SIZE = 8 };
+
+    private: // vars
+
+        std::vector<node> _nodes;       ///< The nodes, the root first.
+        IdVector _ids;                  ///< The point ids, permuted so that every node owns a contiguous range.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Builds the tree.
+         * @param points The points to be indexed. Must outlive the index.
+         */
+        VPTreeIndex( const Points& points) : RangeIndex<Points>( points), _ids( points.size()) {
+            for( std::size_t i=0; i<_ids.size(); ++i)
+                _ids[i] = static_cast<point_id>(i);
+            if( !_ids.empty())
+                build( 0, static_cast<int>(_ids.size()));
+        }
+
+    private: // methods
+
+        /** Builds the subtree over the given range of the permuted points.
+         * @param begin The first position of the range.
+         * @param end One past the last position of the range.
+         * @return The index of the subtree's root node.
+         */
+        int build( const int begin, const int end) {
+            const int ret = static_cast<int>(_nodes.size());
+            node n = { begin, end, 0, -1, -1 };
+            _nodes.push_back( n);
+            if( end - begin <= LEAF_SIZE)
+                return ret;
+
+            // the vantage point is the middle point of the range, which is arbitrary but deterministic
+            std::swap( _ids[begin], _ids[begin + (end - begin) / 2]);
+            const point_id vp = _ids[begin];
+
+            // order the other points by their distance to the vantage point around the median
+            const int mid = begin + 1 + (end - begin - 1) / 2;
+            std::vector<std::pair<real,point_id>> by_distance;
+            by_distance.reserve( end - begin - 1);
+            for( int i=begin+1; i<end; ++i)
+                by_distance.push_back( std::make_pair( std::sqrt( this->counted_squared_distance( vp, _ids[i], this->_n_distances)), _ids[i]));
+            std::nth_element( by_distance.begin(), by_distance.begin() + (mid - begin - 1), by_distance.end(),
+                              []( const std::pair<real,point_id>& a, const std::pair<real,point_id>& b){ return a.first < b.first; } );
+            for( int i=begin+1; i<end; ++i)
+                _ids[i] = by_distance[i-begin-1].second;
+
+            const real radius = by_distance[mid-begin-1].first;
+            const int inside = build( begin + 1, mid);
+            const int outside = build( mid, end);
+            _nodes[ret].end = begin + 1;
+            _nodes[ret].radius = radius;
+            _nodes[ret].inside = inside;
+            _nodes[ret].outside = outside;
+            return ret;
+        }
+
+
+        /// @see RangeIndex::do_range_query()
+        virtual void do_range_query( const point_id p, const real eps, NeighborVector& o_neighbors, unsigned long long& io_n_distances) const {
+            if( !_nodes.empty())
+                query( 0, p, eps, eps*eps, o_neighbors, io_n_distances);
+        }
+
+
+        /** Collects the neighbors within the given subtree.
+         * @param n The index of the subtree's root node.
+         * @param p The id of the query point.
+         * @param eps The epsilon.
+         * @param eps_sq The squared epsilon.
+         * @param[out] o_neighbors The neighbors found so far.
+         * @param[in,out] io_n_distances The counter of distance evaluations.
+         */
+        void query( const int n, const point_id p, const real eps, const real eps_sq, NeighborVector& o_neighbors, unsigned long long& io_n_distances) const {
+            const node& current = _nodes[n];
+            if( current.inside < 0) {
+                for( int i=current.begin; i<current.end; ++i) {
+                    const real sq_dist = this->counted_squared_distance( p, _ids[i], io_n_distances);
+                    if( sq_dist <= eps_sq)
+                        o_neighbors.push_back( Neighbor( _ids[i], sq_dist));
+                }
+                return;
+            }
+
+            const point_id vp = _ids[current.begin];
+            const real sq_dist = this->counted_squared_distance( p, vp, io_n_distances);
+            if( sq_dist <= eps_sq)
+                o_neighbors.push_back( Neighbor( vp, sq_dist));
+
+            // a little slack, so that rounding never prunes a point right on the ball's border
+            const real dist = std::sqrt( sq_dist);
+            const real slack = 1e-4f * (dist + current.radius);
+            if( dist - eps <= current.radius + slack)
+                query( current.inside, p, eps, eps_sq, o_neighbors, io_n_distances);
+            if( dist + eps >= current.radius - slack)
+                query( current.outside, p, eps, eps_sq, o_neighbors, io_n_distances);
+        }
+    };
+
+
+
+
+    /** Creates a range index over the given points.
+     * @param points The points to be indexed. Must outlive the index.
+     * @param type The type of the index. AUTO chooses a KD_TREE for points with up to 16 dimensions
+     *        and a VP_TREE otherwise.
+     * @return A new range index. The caller takes the ownership.
+     */
+    template<typename Points>
+    RangeIndex<Points>* create_range_index( const Points& points, range_index_type::range_index_type type = range_index_type::AUTO) {
+        const std::size_t max_kd_tree_dims = 16;
+
+        if( type == range_index_type::AUTO)
+            type = points.dims() <= max_kd_tree_dims ? range_index_type::KD_TREE : range_index_type::VP_TREE;
+
+        switch( type) {
+        case range_index_type::LINEAR_SCAN:
+            return new LinearScanIndex<Points>( points);
+        case range_index_type::KD_TREE:
+            return new KDTreeIndex<Points>( points);
+        default:
+            return new VPTreeIndex<Points>( points);
+        }
+    }
+
+} // END namespace OPTICS
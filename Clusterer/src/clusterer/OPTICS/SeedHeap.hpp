@@ -0,0 +1,153 @@
+/******************************************************************************
+/* @file Contains the SeedHeap class, the priority queue of the OPTICS seed list.
+/*
+/*
+/* @author langenhagen
+/* @version 150708
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "common.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <assert.h>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** @brief Binary min-heap of point ids keyed by their reachability distance, with decrease-key.
+     * A position array indexed by point id locates every point in the heap, so that
+     * improving a reachability distance costs O(log n) and no allocation.
+     * Points with equal reachability distances are ordered by their ids.
+     */
+    class SeedHeap {
+
+    private: // types
+
+        /// An element of the heap.
+        typedef std::pair<real,point_id> entry;
+
+    private: // vars
+
+        std::vector<entry> _heap;               ///< The (reachability distance, point id) pairs in heap order.
+        std::vector<unsigned int> _positions;   ///< The position of every point in the heap, NOT_IN_HEAP if it is not.
+
+    public: // constants
+
+        /// Position of points that are not in the heap.
+        enum { NOT_IN_HEAP = ~0u };
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * Allocates the position array once, so the heap can be reused for all expansions of one OPTICS run.
+         * @param n_points The number of points. The ids must be smaller.
+         */
+        SeedHeap( const std::size_t n_points)
+            : _positions( n_points, NOT_IN_HEAP)
+        {}
+
+    public: // methods
+
+        /** Checks whether the heap is empty.
+         * @return TRUE if there are no seeds, FALSE otherwise.
+         */
+        inline bool empty() const { return _heap.empty(); }
+
+        /** Checks whether a point is in the heap.
+         * @param p The id of the point.
+         * @return TRUE if the point is a seed, FALSE otherwise.
+         */
+        inline bool contains( const point_id p) const { return _positions[p] != NOT_IN_HEAP; }
+
+        /** Inserts a point.
+         * @param p The id of the point. Must not be in the heap.
+         * @param reachability The reachability distance of the point.
+         */
+        void push( const point_id p, const real reachability) {
+            assert( !contains( p) && "the point is already a seed");
+            _heap.push_back( entry( reachability, p));
+            _positions[p] = static_cast<unsigned int>(_heap.size() - 1);
+            sift_up( _positions[p]);
+        }
+
+        /** Lowers the reachability distance of a point.
+         * @param p The id of the point. Must be in the heap.
+         * @param reachability The new reachability distance. Must not be greater than the old one.
+         */
+        void decrease( const point_id p, const real reachability) {
+            assert( contains( p) && "the point is no seed");
+            assert( reachability <= _heap[_positions[p]].first && "the reachability distance must not increase");
+            _heap[_positions[p]].first = reachability;
+            sift_up( _positions[p]);
+        }
+
+        /** Removes the point with the smallest reachability distance, or the smallest id among equal distances.
+         * @return The id of the removed point.
+         */
+        point_id pop() {
+            assert( !empty() && "there are no seeds");
+            const point_id ret = _heap.front().second;
+            _positions[ret] = NOT_IN_HEAP;
+            const entry last = _heap.back();
+            _heap.pop_back();
+            if( !_heap.empty()) {
+                _heap.front() = last;
+                _positions[last.second] = 0;
+                sift_down( 0);
+            }
+            return ret;
+        }
+
+    private: // helpers
+
+        /** Moves an element towards the root until its parent is smaller.
+         * @param i The position of the element.
+         */
+        void sift_up( unsigned int i) {
+            const entry e = _heap[i];
+            while( i > 0) {
+                const unsigned int parent = (i - 1) / 2;
+                if( !(e < _heap[parent]))
+                    break;
+                _heap[i] = _heap[parent];
+                _positions[_heap[i].second] = i;
+                i = parent;
+            }
+            _heap[i] = e;
+            _positions[e.second] = i;
+        }
+
+        /** Moves an element towards the leaves until its children are greater.
+         * @param i The position of the element.
+         */
+        void sift_down( unsigned int i) {
+            const entry e = _heap[i];
+            const unsigned int n = static_cast<unsigned int>(_heap.size());
+            for(;;) {
+                unsigned int child = 2*i + 1;
+                if( child >= n)
+                    break;
+                if( child + 1 < n && _heap[child+1] < _heap[child])
+                    ++child;
+                if( !(_heap[child] < e))
+                    break;
+                _heap[i] = _heap[child];
+                _positions[_heap[i].second] = i;
+                i = child;
+            }
+            _heap[i] = e;
+            _positions[e.second] = i;
+        }
+    };
+
+} // END namespace OPTICS
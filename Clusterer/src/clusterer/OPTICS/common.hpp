@@ -3,15 +3,20 @@
 /*
 /*
 /* @author langenhagen
-/* @version 150515
+/* @version 150710
 /******************************************************************************/
 #pragma once
 
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include <distances.hpp>
+
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
 
 #include <limits>
-#include <set>
+#include <utility>
 #include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -19,26 +24,52 @@
 
 namespace OPTICS {
 
-    /// typedef for abstracting single/double precision. Change at will.
-    typedef float real;
-    
+    /// The floating point type, the same as the one of the distance kernels and the clusterers.
+    typedef distances::real real;
+
     /// "Undefined" value for distance measures (which are always >= 0 by nature).
     const real UNDEFINED = std::numeric_limits<real>::max();
 
-    /// The DataPoint class.
-    class DataPoint;
-    
-    /** @brief A comparison functor for comparing DataPoints according to their reachability distance.
-     * Reachability distance values must not be UNDEFINED for both left hand side and right hand side operands.
+    /// Identifies a point by its index in the dataset, e.g. its row in the feature matrix.
+    typedef unsigned int point_id;
+
+    /// A vector of point ids.
+    typedef std::vector<point_id> IdVector;
+
+
+    /** @brief A point of an epsilon-neighborhood together with its squared distance to the neighborhood's center.
+     * The distance is computed once by the range query and then reused for the core distance and the seed update.
      */
-    struct Comp_DataPoint_Ptr_f { 
-        bool operator() (const DataPoint* lhs, const DataPoint* rhs) const; 
+    struct Neighbor {
+        point_id id;            ///< The id of the point.
+        real squared_distance;  ///< The squared distance of the point to the center of the neighborhood.
+
+        /** Main constructor.
+         * @param id The id of the point.
+         * @param squared_distance The squared distance of the point to the center of the neighborhood.
+         */
+        Neighbor( const point_id id, const real squared_distance) : id( id), squared_distance( squared_distance)
+        {}
     };
-    
-    /// A set of data points equipped with a Comp_DataPoint_Ptr_f comparison functor.
-    typedef std::set<DataPoint*, Comp_DataPoint_Ptr_f> DataSet;
 
-    /// A vector of Pointers to DataPoints.
-    typedef std::vector<DataPoint*> DataVector;
+    /// A vector of neighbors.
+    typedef std::vector<Neighbor> NeighborVector;
+
+
+    /** @brief The per-point state of the algorithm, kept in dense arrays indexed by point id.
+     */
+    struct PointStates {
+        std::vector<real> reachability_distances;   ///< The squared reachability distance of every point, OPTICS::UNDEFINED if not yet reached.
+        std::vector<real> core_distances;           ///< The squared core distance of every point, OPTICS::UNDEFINED if it is no core point or not yet processed.
+        std::vector<char> is_processed;             ///< A flag per point indicating if the point is already processed.
+
+        /** Main constructor.
+         * Sets all reachability and core distances to OPTICS::UNDEFINED and all processed-flags to false.
+         * @param n_points The number of points.
+         */
+        PointStates( const std::size_t n_points)
+            : reachability_distances( n_points, UNDEFINED), core_distances( n_points, UNDEFINED), is_processed( n_points, 0)
+        {}
+    };
 
-} // END namespace OPTICS
\ No newline at end of file
+} // END namespace OPTICS
@@ -4,29 +4,37 @@
 /*       by Ankerst, Breunig, Kriegel & Sander.
 /*       (http://fogo.dbs.ifi.lmu.de/Publikationen/Papers/OPTICS.pdf)
 /*
-/* 
+/*
 /* The design & implementation is based on
 /*    - readability
 /*    - ease of use
 /*    - small weight
-/*    - zero dependencies (except for the STL)
+/*    - zero dependencies (except for the STL and the STL-only distance kernels)
+/*
+/* The points are addressed by integer ids into a contiguous point set, e.g. a PointMatrix
+/* over the rows of a feature matrix; the per-point state is kept in dense arrays and the
+/* seed list is an indexed binary heap with decrease-key that is allocated once per run.
 /*
 /*
 /* @author langenhagen
-/* @version 150605
+/* @version 150710
 /******************************************************************************/
 #pragma once
 
 ///////////////////////////////////////////////////////////////////////////////
 // INCLUDES project headers
 
-#include "DataPoint.hpp"
+#include "PointMatrix.hpp"
+#include "RangeIndex.hpp"
+#include "SeedHeap.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
 
 #include <algorithm> // nth_element
+#include <cmath>
 #include <functional>
+#include <memory>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
@@ -35,97 +43,144 @@
 /// Namespace of the OPTICS module
 namespace OPTICS {
 
+    /// A steep down area of a reachability plot, see extract_xi_clusters().
+    struct SteepDownArea {
+        std::size_t start;  ///< The position of the first point of the area in the cluster order.
+        std::size_t end;    ///< The position of the last point of the area in the cluster order.
+        real mib;           ///< The maximum reachability distance between the end of the area and the current position.
+    };
+
 
 
     // FUNCTION DECLARATIONS ######################################################################
 
     // non-callback version
-    DataVector optics( DataVector& db, const real eps, const unsigned int min_pts);
-    void expand_cluster_order( DataVector& db, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector);
-    
+    template<typename Points> IdVector optics( const Points& points, const real eps, const unsigned int min_pts, std::vector<real>& o_reachabilities);
+    template<typename Points> IdVector optics( const Points& points, const real eps, const unsigned int min_pts, const RangeIndex<Points>& index, std::vector<real>& o_reachabilities, std::vector<real>& o_core_distances);
+    template<typename Points> void expand_cluster_order( const RangeIndex<Points>& index, const point_id p, const real eps, const unsigned int min_pts, PointStates& io_states, SeedHeap& io_seeds, IdVector& o_ordered_vector);
+
     // callback version
-    DataVector optics( DataVector& db, 
-                       const real eps, 
-                       const unsigned int min_pts,
-                       std::function<void(const DataPoint* p)> point_processed_callback);
-    void expand_cluster_order( DataVector& db, 
-                               DataPoint* p, 
-                               const real eps, 
-                               const unsigned int min_pts, 
-                               DataVector& o_ordered_vector, 
-                               std::function<void(const DataPoint* p)> point_processed_callback);
-    
+    template<typename Points> IdVector optics( const Points& points,
+                                               const real eps,
+                                               const unsigned int min_pts,
+                                               std::vector<real>& o_reachabilities,
+                                               std::function<void(const point_id p)> point_processed_callback);
+    template<typename Points> IdVector optics( const Points& points,
+                                               const real eps,
+                                               const unsigned int min_pts,
+                                               const RangeIndex<Points>& index,
+                                               std::vector<real>& o_reachabilities,
+                                               std::vector<real>& o_core_distances,
+                                               std::function<void(const point_id p)> point_processed_callback);
+    template<typename Points> void expand_cluster_order( const RangeIndex<Points>& index,
+                                                         const point_id p,
+                                                         const real eps,
+                                                         const unsigned int min_pts,
+                                                         PointStates& io_states,
+                                                         SeedHeap& io_seeds,
+                                                         IdVector& o_ordered_vector,
+                                                         std::function<void(const point_id p)> point_processed_callback);
+
     // utility functions
-    std::vector<DataVector> extract_clusters( const DataVector& result, const std::vector<unsigned int>& cluster_borders, real outlier_threshold);
+    std::vector<IdVector> extract_clusters( const IdVector& result, const std::vector<real>& reachabilities, const std::vector<unsigned int>& cluster_borders, real outlier_threshold);
+    std::vector<IdVector> extract_xi_clusters( const IdVector& result, const std::vector<real>& reachabilities, const real xi, const unsigned int min_pts);
 
     // helpers
-    void update_seeds( const DataVector& N_eps, const DataPoint* center_object, const real c_dist, DataSet& o_seeds);
-    DataVector get_neighbors( const DataPoint* p, const real eps, DataVector& db);
-    real squared_core_distance( const DataPoint* p, const unsigned int min_pts, DataVector& N_eps);
-    real squared_distance( const DataPoint* a, const DataPoint* b);
-    
+    void update_seeds( const NeighborVector& N_eps, const real c_dist, PointStates& io_states, SeedHeap& io_seeds);
+    template<typename Points> NeighborVector get_neighbors( const point_id p, const real eps, const RangeIndex<Points>& index);
+    real squared_core_distance( const unsigned int min_pts, NeighborVector& N_eps);
+    std::size_t extend_steep_area( const std::vector<char>& is_steep, const std::vector<char>& is_against, const std::size_t start, const unsigned int min_pts);
+
 
 
     // NON-CALLBACK VERSION #######################################################################
 
 
     /** Performs the classic OPTICS algorithm.
-     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * Answers the epsilon-range queries with an index of type range_index_type::AUTO.
+     * @param points All points that are to be considered by the algorithm.
      * @param eps The epsilon representing the radius of the epsilon-neighborhood.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
-     * @return Return the OPTICS ordered list of Data points with reachability-distances set.
+     * @param[out] o_reachabilities The squared reachability distance of every point, indexed by point id.
+     * @return Return the OPTICS ordered list of point ids.
      */
-    DataVector optics( DataVector& db, const real eps, const unsigned int min_pts) {
+    template<typename Points>
+    IdVector optics( const Points& points, const real eps, const unsigned int min_pts, std::vector<real>& o_reachabilities) {
+        const std::unique_ptr<RangeIndex<Points>> index( create_range_index( points));
+        std::vector<real> core_distances;
+        return optics( points, eps, min_pts, *index, o_reachabilities, core_distances);
+    }
+
+
+    /** Performs the classic OPTICS algorithm.
+     * @param points All points that are to be considered by the algorithm.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param index A range index over the points that answers the epsilon-range queries.
+     * @param[out] o_reachabilities The squared reachability distance of every point, indexed by point id.
+     * @param[out] o_core_distances The squared core distance of every point, indexed by point id.
+     * @return Return the OPTICS ordered list of point ids.
+     */
+    template<typename Points>
+    IdVector optics( const Points& points, const real eps, const unsigned int min_pts, const RangeIndex<Points>& index, std::vector<real>& o_reachabilities, std::vector<real>& o_core_distances) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
-        DataVector ret;
-
-        for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
-            DataPoint* p = *p_it;
-            
-            if( p->is_processed())
+        IdVector ret;
+        ret.reserve( points.size());
+        PointStates states( points.size());
+        SeedHeap seeds( points.size());
+
+        const point_id n_points = static_cast<point_id>(points.size());
+        for( point_id p=0; p<n_points; ++p) {
+            if( states.is_processed[p])
                 continue;
-            
-            expand_cluster_order( db, p, eps, min_pts, ret);
+
+            expand_cluster_order( index, p, eps, min_pts, states, seeds, ret);
         }
+        o_reachabilities.swap( states.reachability_distances);
+        o_core_distances.swap( states.core_distances);
         return ret;
     }
 
 
     /** Expands the cluster order while adding new neighbor points to the order.
-     * @param db All data points that are to be considered by the algorithm. Changes their values.
-     * @param p The point to be examined.
+     * @param index A range index over all points that are to be considered by the algorithm.
+     * @param p The id of the point to be examined.
      * @param eps The epsilon representing the radius of the epsilon-neighborhood.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
-     * @param[out] o_ordered_vector The ordered vector of data points. Elements will be added to this vector.
+     * @param[in,out] io_states The per-point states of the algorithm.
+     * @param[in,out] io_seeds The seed list. Must be empty and will be empty again on return.
+     * @param[out] o_ordered_vector The ordered vector of point ids. Elements will be added to this vector.
      */
-    void expand_cluster_order( DataVector& db, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector) {
+    template<typename Points>
+    void expand_cluster_order( const RangeIndex<Points>& index, const point_id p, const real eps, const unsigned int min_pts, PointStates& io_states, SeedHeap& io_seeds, IdVector& o_ordered_vector) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
-        
-        DataVector N_eps = get_neighbors( p, eps, db);
-        p->reachability_distance( OPTICS::UNDEFINED);
-        const real core_dist_p = squared_core_distance( p, min_pts, N_eps);
-        p->processed( true);
+        assert( io_seeds.empty() && "the seed list must be empty");
+
+        NeighborVector N_eps = get_neighbors( p, eps, index);
+        io_states.reachability_distances[p] = OPTICS::UNDEFINED;
+        const real core_dist_p = squared_core_distance( min_pts, N_eps);
+        io_states.core_distances[p] = core_dist_p;
+        io_states.is_processed[p] = 1;
         o_ordered_vector.push_back( p);
-    
+
         if( core_dist_p == OPTICS::UNDEFINED)
             return;
 
-        DataSet seeds;
-        update_seeds( N_eps, p, core_dist_p, seeds);
-        
-        while( !seeds.empty()) {
-            DataPoint* q = *seeds.begin();
-            seeds.erase( seeds.begin()); // remove first element from seeds
+        update_seeds( N_eps, core_dist_p, io_states, io_seeds);
 
-            DataVector N_q = get_neighbors( q, eps, db);
-            const real core_dist_q = squared_core_distance( q, min_pts, N_q);
-            q->processed( true);
+        while( !io_seeds.empty()) {
+            const point_id q = io_seeds.pop();
+
+            NeighborVector N_q = get_neighbors( q, eps, index);
+            const real core_dist_q = squared_core_distance( min_pts, N_q);
+            io_states.core_distances[q] = core_dist_q;
+            io_states.is_processed[q] = 1;
             o_ordered_vector.push_back( q);
             if( core_dist_q != OPTICS::UNDEFINED) {
                 // *** q is a core-object ***
-                update_seeds( N_q, q, core_dist_q, seeds);
+                update_seeds( N_q, core_dist_q, io_states, io_seeds);
             }
         }
     }
@@ -138,29 +193,64 @@ namespace OPTICS {
     /** Performs the classic OPTICS algorithm.
      * Because OPTICS can take a while on big data sets or when working with high dimensions,
      * a callback function informs you when a new point is inserted into the OPTICS ordering.
-     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * Answers the epsilon-range queries with an index of type range_index_type::AUTO.
+     * @param points All points that are to be considered by the algorithm.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param[out] o_reachabilities The squared reachability distance of every point, indexed by point id.
+     * @param point_processed_callback Callback function that is called when one point is
+     *        added to the ordered output list. It takes the id of the point as an argument.
+     * @return Return the OPTICS ordered list of point ids.
+     */
+    template<typename Points>
+    IdVector optics( const Points& points,
+                     const real eps,
+                     const unsigned int min_pts,
+                     std::vector<real>& o_reachabilities,
+                     std::function<void(const point_id p)> point_processed_callback) {
+        const std::unique_ptr<RangeIndex<Points>> index( create_range_index( points));
+        std::vector<real> core_distances;
+        return optics( points, eps, min_pts, *index, o_reachabilities, core_distances, point_processed_callback);
+    }
+
+
+    /** Performs the classic OPTICS algorithm.
+     * Because OPTICS can take a while on big data sets or when working with high dimensions,
+     * a callback function informs you when a new point is inserted into the OPTICS ordering.
+     * @param points All points that are to be considered by the algorithm.
      * @param eps The epsilon representing the radius of the epsilon-neighborhood.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
-     * @param point_processed_callback Callback function that is called when one point is 
-     *        added to the ordered output list. It takes the pointer to the data point as an argument.
-     * @return Return the OPTICS ordered list of Data points with reachability-distances set.
+     * @param index A range index over the points that answers the epsilon-range queries.
+     * @param[out] o_reachabilities The squared reachability distance of every point, indexed by point id.
+     * @param[out] o_core_distances The squared core distance of every point, indexed by point id.
+     * @param point_processed_callback Callback function that is called when one point is
+     *        added to the ordered output list. It takes the id of the point as an argument.
+     * @return Return the OPTICS ordered list of point ids.
      */
-    DataVector optics( DataVector& db, 
-                       const real eps, 
-                       const unsigned int min_pts, 
-                       std::function<void(const DataPoint* p)> point_processed_callback) {
+    template<typename Points>
+    IdVector optics( const Points& points,
+                     const real eps,
+                     const unsigned int min_pts,
+                     const RangeIndex<Points>& index,
+                     std::vector<real>& o_reachabilities,
+                     std::vector<real>& o_core_distances,
+                     std::function<void(const point_id p)> point_processed_callback) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
-        DataVector ret;
-
-        for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
-            DataPoint* p = *p_it;
-            
-            if( p->is_processed())
+        IdVector ret;
+        ret.reserve( points.size());
+        PointStates states( points.size());
+        SeedHeap seeds( points.size());
+
+        const point_id n_points = static_cast<point_id>(points.size());
+        for( point_id p=0; p<n_points; ++p) {
+            if( states.is_processed[p])
                 continue;
-            
-            expand_cluster_order( db, p, eps, min_pts, ret, point_processed_callback);
+
+            expand_cluster_order( index, p, eps, min_pts, states, seeds, ret, point_processed_callback);
         }
+        o_reachabilities.swap( states.reachability_distances);
+        o_core_distances.swap( states.core_distances);
         return ret;
     }
 
@@ -168,206 +258,197 @@ namespace OPTICS {
     /** Expands the cluster order while adding new neighbor points to the order.
      * Because OPTICS can take a while on big data sets or when working with high dimensions,
      * a callback function informs you when a new point is inserted into the OPTICS ordering.
-     * @param db All data points that are to be considered by the algorithm. Changes their values.
-     * @param p The point to be examined.
+     * @param index A range index over all points that are to be considered by the algorithm.
+     * @param p The id of the point to be examined.
      * @param eps The epsilon representing the radius of the epsilon-neighborhood.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
-     * @param[out] o_ordered_vector The ordered vector of data points. Elements will be added to this vector.
-     * @param point_processed_callback Callback function that is called when one point is 
-     *        added to the ordered output list. It takes the pointer to the data point as an argument.
+     * @param[in,out] io_states The per-point states of the algorithm.
+     * @param[in,out] io_seeds The seed list. Must be empty and will be empty again on return.
+     * @param[out] o_ordered_vector The ordered vector of point ids. Elements will be added to this vector.
+     * @param point_processed_callback Callback function that is called when one point is
+     *        added to the ordered output list. It takes the id of the point as an argument.
      */
-    void expand_cluster_order( DataVector& db,
-                               DataPoint* p, 
+    template<typename Points>
+    void expand_cluster_order( const RangeIndex<Points>& index,
+                               const point_id p,
                                const real eps,
                                const unsigned int min_pts,
-                               DataVector& o_ordered_vector,
-                               std::function<void(const DataPoint* p)> point_processed_callback) {
+                               PointStates& io_states,
+                               SeedHeap& io_seeds,
+                               IdVector& o_ordered_vector,
+                               std::function<void(const point_id p)> point_processed_callback) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
-        
-        DataVector N_eps = get_neighbors( p, eps, db);
-        p->reachability_distance( OPTICS::UNDEFINED);
-        const real core_dist_p = squared_core_distance( p, min_pts, N_eps);
-        p->processed( true);
+        assert( io_seeds.empty() && "the seed list must be empty");
+
+        NeighborVector N_eps = get_neighbors( p, eps, index);
+        io_states.reachability_distances[p] = OPTICS::UNDEFINED;
+        const real core_dist_p = squared_core_distance( min_pts, N_eps);
+        io_states.core_distances[p] = core_dist_p;
+        io_states.is_processed[p] = 1;
         o_ordered_vector.push_back( p);
         point_processed_callback( p);
-    
+
         if( core_dist_p == OPTICS::UNDEFINED)
             return;
 
-        DataSet seeds;
-        update_seeds( N_eps, p, core_dist_p, seeds);
-        
-        while( !seeds.empty()) {
-            DataPoint* q = *seeds.begin();
-            seeds.erase( seeds.begin()); // remove first element from seeds
+        update_seeds( N_eps, core_dist_p, io_states, io_seeds);
+
+        while( !io_seeds.empty()) {
+            const point_id q = io_seeds.pop();
 
-            DataVector N_q = get_neighbors( q, eps, db);
-            const real core_dist_q = squared_core_distance( q, min_pts, N_q);
-            q->processed( true);
+            NeighborVector N_q = get_neighbors( q, eps, index);
+            const real core_dist_q = squared_core_distance( min_pts, N_q);
+            io_states.core_distances[q] = core_dist_q;
+            io_states.is_processed[q] = 1;
             o_ordered_vector.push_back( q);
-            point_processed_callback( p);
+            point_processed_callback( q);
             if( core_dist_q != OPTICS::UNDEFINED) {
                 // *** q is a core-object ***
-                update_seeds( N_q, q, core_dist_q, seeds);
+                update_seeds( N_q, core_dist_q, io_states, io_seeds);
             }
         }
     }
 
 
-    
+
     // HELPERS ####################################################################################
 
 
-    /** Updates the seeds priority queue with new neighbors or neighbors that now have a better 
+    /** Updates the seeds priority queue with new neighbors or neighbors that now have a better
      * reachability distance than before.
-     * @param N_eps All points in the the epsilon-neighborhood of the center_object, including p itself.
-     * @param center_object The point on which to start the update process.
-     * @param c_dist The core distance of the given center_object.
-     * @param[out] o_seeds The seeds priority queue (aka set with special comparator function) that will be modified.
+     * @param N_eps All points in the the epsilon-neighborhood of the center object, including the center object itself,
+     *        with their squared distances to the center object.
+     * @param c_dist The core distance of the center object.
+     * @param[in,out] io_states The per-point states of the algorithm. The reachability distances will be modified.
+     * @param[in,out] io_seeds The seeds priority queue that will be modified.
      */
-    void update_seeds( const DataVector& N_eps, const DataPoint* center_object, const real c_dist, DataSet& o_seeds) {
+    inline void update_seeds( const NeighborVector& N_eps, const real c_dist, PointStates& io_states, SeedHeap& io_seeds) {
         assert( c_dist != OPTICS::UNDEFINED && "the core distance must be set <> UNDEFINED when entering update_seeds");
-        
-        for( DataVector::const_iterator it=N_eps.begin(); it!=N_eps.end(); ++it) {
-            DataPoint* o = *it;
+        std::vector<real>& reachabilities = io_states.reachability_distances;
+
+        for( NeighborVector::const_iterator it=N_eps.begin(); it!=N_eps.end(); ++it) {
+            const point_id o = it->id;
 
-            if( o->is_processed())
+            if( io_states.is_processed[o])
                 continue;
 
-            const real new_r_dist = std::max( c_dist, squared_distance( center_object, o));
+            const real new_r_dist = std::max( c_dist, it->squared_distance);
             // *** new_r_dist != UNDEFINED ***
-        
-            if( o->reachability_distance() == OPTICS::UNDEFINED) {
+
+            if( reachabilities[o] == OPTICS::UNDEFINED) {
                 // *** o not in seeds ***
-                o->reachability_distance( new_r_dist);
-                o_seeds.insert( o);
+                reachabilities[o] = new_r_dist;
+                io_seeds.push( o, new_r_dist);
 
-            } else if( new_r_dist < o->reachability_distance()) {
+            } else if( new_r_dist < reachabilities[o]) {
                 // *** o already in seeds & can be improved ***
-                o_seeds.erase( o);
-                o->reachability_distance( new_r_dist);
-                o_seeds.insert( o);
+                reachabilities[o] = new_r_dist;
+                io_seeds.decrease( o, new_r_dist);
             }
         }
     }
 
 
-    /** Retrieves all points in the epsilon-surrounding of the given data point, including the point itself.
-     * @param p The datapoint which represents the center of the epsilon surrounding.
+    /** Retrieves all points in the epsilon-surrounding of the given point, including the point itself.
+     * @param p The id of the point which represents the center of the epsilon surrounding.
      * @param eps The epsilon value that represents the radius for the neigborhood search.
-     * @param db The database consisting of all datapoints that are checked for neighborhood.
-     * @param A vector of pointers to datapoints that lie within the epsilon-neighborhood 
-     *        of the given point p, including p itself.
+     * @param index The range index over all points that are checked for neighborhood.
+     * @return A vector of the points that lie within the epsilon-neighborhood
+     *         of the given point p, including p itself, with their squared distances to p.
      */
-    DataVector get_neighbors( const DataPoint* p, const real eps, DataVector& db) {
-        assert( eps >= 0 && "eps must not be negative");
-        DataVector ret;
-
-        const real eps_sq = eps*eps;
-
-        for( auto q_it=db.begin(); q_it!=db.end(); ++q_it) {
-            DataPoint* q = *q_it;
-            if( squared_distance( p, q) <= eps_sq) {
-                ret.push_back( q);
-            }
-        }
+    template<typename Points>
+    NeighborVector get_neighbors( const point_id p, const real eps, const RangeIndex<Points>& index) {
+        NeighborVector ret;
+        index.range_query( p, eps, ret);
         return ret;
     }
 
 
     /** Finds the squared core distance of one given point.
-     * @param p The point to be examined.
+     * Selects on the distances cached in the neighborhood, so no distance is computed again.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
-     * @param N_eps All points in the the epsilon-neighborhood of p, including p itself.
-     * @return The squared core distance of p.
+     * @param N_eps All points in the the epsilon-neighborhood of the examined point, including the point itself,
+     *        with their squared distances to it. Will be partially reordered.
+     * @return The squared core distance of the examined point.
      */
-    real squared_core_distance( const DataPoint* p, const unsigned int min_pts, DataVector& N_eps) {    
+    inline real squared_core_distance( const unsigned int min_pts, NeighborVector& N_eps) {
         assert( min_pts > 0 && "min_pts must be greater than 0");
         real ret( OPTICS::UNDEFINED);
-    
+
         if( N_eps.size() > min_pts) {
-            std::nth_element( N_eps.begin(), 
-                              N_eps.begin()+min_pts, 
-                              N_eps.end(), 
-                              [p]( const DataPoint* a, const DataPoint* b){ return squared_distance( p, a) < squared_distance( p, b); } );
+            std::nth_element( N_eps.begin(),
+                              N_eps.begin()+min_pts,
+                              N_eps.end(),
+                              []( const Neighbor& a, const Neighbor& b){ return a.squared_distance < b.squared_distance; } );
 
-            ret = squared_distance( p, N_eps[min_pts]);
+            ret = N_eps[min_pts].squared_distance;
         }
         return ret;
     }
 
 
-    /** Retrieves the squared euclidean distance of two DataPoints.
-     * @param a The first DataPoint.
-     * @param b The second DataPoint. Both data points must have the same dimensionality.
+    /** Extends a steep area of a reachability plot as far as possible.
+     * The area may contain up to min_pts consecutive points that are not steep,
+     * but none that goes against its direction.
+     * @param is_steep Whether the plot is steep in the direction of the area at every position.
+     * @param is_against Whether the plot goes against the direction of the area at every position.
+     * @param start The position of the first point of the area.
+     * @param min_pts The maximum number of consecutive points that are not steep.
+     * @return The position of the last steep point of the area.
      */
-    real squared_distance( const DataPoint* a, const DataPoint* b) {
-        const std::vector<real>& a_data = a->data();
-        const std::vector<real>& b_data = b->data();
-        const unsigned int vec_size = static_cast<unsigned int>(a_data.size());
-        assert( vec_size == b_data.size() && "Data-vectors of both DataPoints must have same dimensionality");
-        real ret(0);
-    
-        for( unsigned int i=0; i<vec_size; ++i) {
-            ret += std::pow( a_data[i]-b_data[i], 2);
+    inline std::size_t extend_steep_area( const std::vector<char>& is_steep, const std::vector<char>& is_against, const std::size_t start, const unsigned int min_pts) {
+        std::size_t ret = start;
+        unsigned int n_not_steep = 0;
+
+        for( std::size_t i=start; i<is_steep.size(); ++i) {
+            if( is_steep[i]) {
+                n_not_steep = 0;
+                ret = i;
+            } else if( is_against[i] || ++n_not_steep > min_pts) {
+                break;
+            }
         }
-        //return std::sqrt( ret);
         return ret;
     }
 
 
-    /// A Comp_DataPoint_f comparison functor ()-operator implementation.
-    bool Comp_DataPoint_Ptr_f::operator() (const DataPoint* lhs, const DataPoint* rhs) const {
-        assert( lhs != nullptr && "nullptr objects are not allowed");
-        assert( rhs != nullptr && "nullptr objects are not allowed");
-        assert( lhs->data().size() == rhs->data().size() && "Comparing DataPoints requires them to have same dimensionality");
-
-        //return lhs->reachability_distance() < rhs->reachability_distance();    
-        if( lhs->reachability_distance() < rhs->reachability_distance())
-            return true;
-        else if( lhs->reachability_distance() == rhs->reachability_distance() && lhs < rhs)
-            return true;
-        else /*lhs->reachability_distance() == rhs->reachability_distance() && lhs >= rhs || lhs->reachability_distance() > rhs->reachability_distance()*/
-            return false;
-    }
-
 
-    
     // UTILITY FUNCTIONS ##########################################################################
 
 
-    /** Partitions the specified OPTICS ordered data points along the given cluster borders.
+    /** Partitions the specified OPTICS ordered points along the given cluster borders.
      * Points that lie above a specified threshold are put into a separate outlier cluster.
      * @param result The OPTICS ordered result vector of the optics function.
+     * @param reachabilities The reachability distance of every point, indexed by point id.
      * @param cluster_borders A vector of indices specifiying the cluster borders.
      *        IMPORTANT: The vector must be sorted in ascending order.
      * @param outlier_threshold All values above that outlier_threshold are considered outliers
-     *        and will be put in a special outlier cluster. Is the threshold value set 
+     *        and will be put in a special outlier cluster. Is the threshold value set
      *        to 0 or negative no point will be considered as an outlier.
-     * @return A vector of different disjoint data point containers, each making up one cluster. 
-     *         The first container stores the data points that are considered outliers.
+     * @return A vector of different disjoint point id containers, each making up one cluster.
+     *         The first container stores the points that are considered outliers.
      * @see optics()
      */
-    std::vector<DataVector> extract_clusters( const DataVector& result, const std::vector<unsigned int>& cluster_borders, real outlier_threshold) {
-        std::vector<DataVector> ret;
-        ret.push_back( DataVector()); // outlier container
-    
+    std::vector<IdVector> extract_clusters( const IdVector& result, const std::vector<real>& reachabilities, const std::vector<unsigned int>& cluster_borders, real outlier_threshold) {
+        std::vector<IdVector> ret;
+        ret.push_back( IdVector()); // outlier container
+
         if( outlier_threshold <= 0)
             outlier_threshold = std::numeric_limits<real>::max();
-    
-    
+
+
         for( unsigned int i=0; i<=cluster_borders.size(); ++i) {
-            
+
             const unsigned int lower_idx = i == 0                        ? 0                                        : cluster_borders[i-1];
             const unsigned int upper_idx = i == cluster_borders.size()   ? static_cast<unsigned int>(result.size()) : cluster_borders[i];
-        
-            DataVector cluster_i;
+
+            IdVector cluster_i;
 
             for( unsigned int j=lower_idx; j<upper_idx; ++j) {
-               DataPoint* p = result[j];
-           
-               if( p->reachability_distance() > outlier_threshold) {
+               const point_id p = result[j];
+
+               if( reachabilities[p] > outlier_threshold) {
                    ret[0].push_back( p);
                } else {
                    cluster_i.push_back( p);
@@ -378,4 +459,118 @@ namespace OPTICS {
         return ret;
     }
 
+
+    /** Extracts clusters with the xi method from the OPTICS paper.
+     * A cluster starts with a steep down area and ends with a steep up area of the reachability plot,
+     * where steep means that the reachability distance changes by the factor 1-xi from one point to the next.
+     * The clusters are nested; the innermost ones are kept and their points are assigned to them.
+     * Clusters have at least min_pts points.
+     * @param result The OPTICS ordered result vector of the optics function.
+     * @param reachabilities The squared reachability distance of every point, indexed by point id.
+     * @param xi The steepness el. ]0,1[. Small values find more clusters.
+     * @param min_pts The minimum number of points of a cluster. Also the number of points that
+     *        may interrupt a steep area.
+     * @return A vector of different disjoint point id containers, each making up one cluster.
+     *         The first container stores the points that belong to no cluster.
+     * @see optics()
+     */
+    inline std::vector<IdVector> extract_xi_clusters( const IdVector& result, const std::vector<real>& reachabilities, const real xi, const unsigned int min_pts) {
+        assert( xi > 0 && xi < 1 && "xi must be el. ]0,1[");
+        const std::size_t n = result.size();
+        const real xi_complement = 1 - xi;
+
+        // the plot of the reachability distances, not squared, terminated by infinity
+        std::vector<real> plot( n + 1, std::numeric_limits<real>::infinity());
+        for( std::size_t i=0; i<n; ++i) {
+            const real r = reachabilities[result[i]];
+            if( r != OPTICS::UNDEFINED)
+                plot[i] = std::sqrt( r);
+        }
+
+        std::vector<char> is_steep_up( n), is_steep_down( n), is_up( n), is_down( n);
+        for( std::size_t i=0; i<n; ++i) {
+            const real ratio = plot[i] / plot[i+1]; // NaN for two undefined distances, which is neither up nor down
+            is_steep_up[i] = ratio <= xi_complement;
+            is_steep_down[i] = ratio >= 1 / xi_complement;
+            is_up[i] = ratio < 1;
+            is_down[i] = ratio > 1;
+        }
+
+        // find the clusters as intervals of the cluster order, the inner ones of a steep up area first
+        std::vector<SteepDownArea> steep_down_areas;
+        std::vector<std::pair<std::size_t,std::size_t>> intervals;
+        std::size_t index = 0;
+        real mib = 0;
+        for( std::size_t steep=0; steep<n; ++steep) {
+            if( steep < index || (!is_steep_up[steep] && !is_steep_down[steep]))
+                continue;
+
+            for( std::size_t i=index; i<=steep; ++i)
+                mib = std::max( mib, plot[i]);
+
+            // drop the steep down areas that lie below the maximum in between, update the others
+            std::vector<SteepDownArea> kept;
+            if( mib != std::numeric_limits<real>::infinity()) {
+                for( std::vector<SteepDownArea>::const_iterator it=steep_down_areas.begin(); it!=steep_down_areas.end(); ++it) {
+                    if( mib <= plot[it->start] * xi_complement) {
+                        kept.push_back( *it);
+                        kept.back().mib = std::max( kept.back().mib, mib);
+                    }
+                }
+            }
+            steep_down_areas.swap( kept);
+
+            if( is_steep_down[steep]) {
+                const SteepDownArea area = { steep, extend_steep_area( is_steep_down, is_up, steep, min_pts), 0 };
+                steep_down_areas.push_back( area);
+                index = area.end + 1;
+                mib = plot[index];
+                continue;
+            }
+
+            const std::size_t up_start = steep;
+            const std::size_t up_end = extend_steep_area( is_steep_up, is_down, steep, min_pts);
+            index = up_end + 1;
+            mib = plot[index];
+
+            std::vector<std::pair<std::size_t,std::size_t>> up_intervals;
+            for( std::vector<SteepDownArea>::const_iterator it=steep_down_areas.begin(); it!=steep_down_areas.end(); ++it) {
+                std::size_t c_start = it->start;
+                std::size_t c_end = up_end;
+                const real end_level = plot[c_end + 1];
+                if( end_level * xi_complement < it->mib)
+                    continue;
+
+                // cut the longer side to the level of the other one
+                const real start_level = plot[it->start];
+                if( start_level * xi_complement >= end_level) {
+                    while( plot[c_start + 1] > end_level && c_start < it->end)
+                        ++c_start;
+                } else if( end_level * xi_complement >= start_level) {
+                    while( plot[c_end - 1] > start_level && c_end > up_start)
+                        --c_end;
+                }
+
+                if( c_end - c_start + 1 < min_pts || c_start > it->end || c_end < up_start)
+                    continue;
+                up_intervals.push_back( std::make_pair( c_start, c_end));
+            }
+            intervals.insert( intervals.end(), up_intervals.rbegin(), up_intervals.rend());
+        }
+
+        // assign the points to the innermost clusters
+        std::vector<int> labels( n, -1);
+        int n_clusters = 0;
+        for( std::vector<std::pair<std::size_t,std::size_t>>::const_iterator it=intervals.begin(); it!=intervals.end(); ++it) {
+            if( std::count( labels.begin() + it->first, labels.begin() + it->second + 1, -1) != static_cast<std::ptrdiff_t>(it->second - it->first + 1))
+                continue;
+            std::fill( labels.begin() + it->first, labels.begin() + it->second + 1, n_clusters++);
+        }
+
+        std::vector<IdVector> ret( n_clusters + 1); // the first container stores the points of no cluster
+        for( std::size_t i=0; i<n; ++i)
+            ret[labels[i] + 1].push_back( result[i]);
+        return ret;
+    }
+
 } // END namespace OPTICS
@@ -0,0 +1,372 @@
+/******************************************************************************
+/* @file Contains a parallel OPTICS variant in the spirit of POPTICS by
+/*       Patwary, Palsetia, Agrawal, Liao, Manne & Choudhary:
+/*       "Scalable Parallel OPTICS Data Clustering Using Graph Algorithmic Techniques".
+/*
+/* The epsilon-neighborhoods and core distances of all points are computed in parallel.
+/* They define the reachability graph, whose edge between two neighbors weighs the smaller
+/* reachability distance of the two directions. Its minimum spanning forest is found with
+/* Boruvka's algorithm, whose edge search runs in parallel. Walking the forest like OPTICS
+/* walks the points, always continuing at the lightest edge, yields the ordering and the
+/* reachability plot.
+/*
+/* The plot has the cluster structure of the one of optics(). Where two core points meet,
+/* a reachability distance can be smaller, since the forest does not know which of the two
+/* points OPTICS would have processed first.
+/*
+/* The module still depends on nothing but the STL and the distance kernels:
+/* the caller decides how the parallel loops are run by passing a ParallelFor
+/* function.
+/*
+/* Unlike optics(), all epsilon-neighborhoods are held in memory at once,
+/* so epsilon should be finite and reasonably small.
+/*
+/*
+/* @author langenhagen
+/* @version 150709
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "optics.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <functional>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// A loop body that processes the indices [begin, end[.
+    typedef std::function<void(const std::size_t begin, const std::size_t end)> RangeBody;
+
+    /// Runs a loop body on disjoint subranges that together cover [0,n[, possibly concurrently.
+    typedef std::function<void(const std::size_t n, const RangeBody& body)> ParallelFor;
+
+    /// An edge of a spanning forest.
+    struct ForestEdge {
+        point_id a;     ///< The id of one end point.
+        point_id b;     ///< The id of the other end point.
+        real weight;    ///< The weight of the edge, a squared reachability distance.
+    };
+
+    /// A vector of forest edges.
+    typedef std::vector<ForestEdge> ForestEdgeVector;
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    template<typename Points> IdVector parallel_optics( const Points& points,
+                                                        const real eps,
+                                                        const unsigned int min_pts,
+                                                        const RangeIndex<Points>& index,
+                                                        std::vector<real>& o_reachabilities,
+                                                        std::vector<real>& o_core_distances,
+                                                        const ParallelFor& parallel_for);
+
+    // steps
+    template<typename Points> void compute_neighborhoods( const RangeIndex<Points>& index,
+                                                          const real eps,
+                                                          const unsigned int min_pts,
+                                                          const ParallelFor& parallel_for,
+                                                          std::vector<NeighborVector>& o_neighborhoods,
+                                                          std::vector<real>& o_core_distances);
+    void to_reachability_graph( const std::vector<real>& core_distances, const ParallelFor& parallel_for, std::vector<NeighborVector>& io_graph);
+    ForestEdgeVector minimum_spanning_forest( const std::vector<NeighborVector>& graph, const ParallelFor& parallel_for);
+    IdVector order_spanning_forest( const std::size_t n_points, const ForestEdgeVector& edges, std::vector<real>& o_reachabilities);
+
+    // helpers
+    void serial_for( const std::size_t n, const RangeBody& body);
+    bool is_lighter( const real weight_a, const point_id a0, const point_id a1, const real weight_b, const point_id b0, const point_id b1);
+    point_id find_root( std::vector<point_id>& io_parents, point_id p);
+
+
+
+    // PARALLEL OPTICS ############################################################################
+
+
+    /** Performs a parallel variant of the OPTICS algorithm.
+     * The result is a valid OPTICS ordering with its reachability plot and can be processed
+     * like the result of optics(). Ties are broken by the point ids, so the result does not
+     * depend on the number of threads.
+     * @param points All points that are to be considered by the algorithm.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param index A range index over the points that answers the epsilon-range queries.
+     *        Must support concurrent queries on the points, i.e. the points' distance must be thread-safe.
+     * @param[out] o_reachabilities The squared reachability distance of every point, indexed by point id.
+     * @param[out] o_core_distances The squared core distance of every point, indexed by point id.
+     * @param parallel_for Runs the parallel loops, e.g. on a thread pool. Use serial_for() to run them serially.
+     * @return Return the OPTICS ordered list of point ids.
+     */
+    template<typename Points>
+    IdVector parallel_optics( const Points& points,
+                              const real eps,
+                              const unsigned int min_pts,
+                              const RangeIndex<Points>& index,
+                              std::vector<real>& o_reachabilities,
+                              std::vector<real>& o_core_distances,
+                              const ParallelFor& parallel_for) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+
+        std::vector<NeighborVector> graph;
+        compute_neighborhoods( index, eps, min_pts, parallel_for, graph, o_core_distances);
+        to_reachability_graph( o_core_distances, parallel_for, graph);
+
+        const ForestEdgeVector edges = minimum_spanning_forest( graph, parallel_for);
+        return order_spanning_forest( points.size(), edges, o_reachabilities);
+    }
+
+
+
+    // STEPS ######################################################################################
+
+
+    /** Computes the epsilon-neighborhood and the squared core distance of every point in parallel.
+     * The distance evaluations are added to the statistics of the index.
+     * @param index A range index over all points that are to be considered by the algorithm.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param parallel_for Runs the parallel loop.
+     * @param[out] o_neighborhoods The epsilon-neighborhood of every point, indexed by point id.
+     * @param[out] o_core_distances The squared core distance of every point, indexed by point id.
+     */
+    template<typename Points>
+    void compute_neighborhoods( const RangeIndex<Points>& index,
+                                const real eps,
+                                const unsigned int min_pts,
+                                const ParallelFor& parallel_for,
+                                std::vector<NeighborVector>& o_neighborhoods,
+                                std::vector<real>& o_core_distances) {
+        const std::size_t n_points = index.points().size();
+        std::vector<unsigned long long> n_distances( n_points, 0);
+        o_neighborhoods.assign( n_points, NeighborVector());
+        o_core_distances.assign( n_points, OPTICS::UNDEFINED);
+
+        parallel_for( n_points, [&]( const std::size_t begin, const std::size_t end) {
+            for( std::size_t i=begin; i<end; ++i) {
+                const point_id p = static_cast<point_id>(i);
+                n_distances[i] = index.concurrent_range_query( p, eps, o_neighborhoods[i]);
+                o_core_distances[i] = squared_core_distance( min_pts, o_neighborhoods[i]);
+            }
+        });
+
+        unsigned long long sum = 0;
+        for( std::size_t i=0; i<n_points; ++i)
+            sum += n_distances[i];
+        index.add_concurrent_queries( n_points, sum);
+    }
+
+
+    /** Turns the epsilon-neighborhoods into the reachability graph in parallel.
+     * Two neighbors are connected if at least one of them is a core point. The edge weighs
+     * the smaller of the two squared reachability distances max( core distance, distance).
+     * Points are not connected to themselves.
+     * @param core_distances The squared core distance of every point, indexed by point id.
+     * @param parallel_for Runs the parallel loop.
+     * @param[in,out] io_graph On entry, the epsilon-neighborhoods with squared distances.
+     *                On exit, the adjacency lists with the edge weights in place of the distances.
+     */
+    inline void to_reachability_graph( const std::vector<real>& core_distances, const ParallelFor& parallel_for, std::vector<NeighborVector>& io_graph) {
+        parallel_for( io_graph.size(), [&]( const std::size_t begin, const std::size_t end) {
+            for( std::size_t p=begin; p<end; ++p) {
+                NeighborVector& edges = io_graph[p];
+                NeighborVector::iterator out = edges.begin();
+
+                for( NeighborVector::const_iterator it=edges.begin(); it!=edges.end(); ++it) {
+                    if( it->id == p)
+                        continue;
+
+                    real weight = OPTICS::UNDEFINED;
+                    if( core_distances[p] != OPTICS::UNDEFINED)
+                        weight = std::max( core_distances[p], it->squared_distance);
+                    if( core_distances[it->id] != OPTICS::UNDEFINED)
+                        weight = std::min( weight, std::max( core_distances[it->id], it->squared_distance));
+
+                    if( weight != OPTICS::UNDEFINED)
+                        *out++ = Neighbor( it->id, weight);
+                }
+                edges.erase( out, edges.end());
+            }
+        });
+    }
+
+
+    /** Finds the minimum spanning forest of a graph with Boruvka's algorithm.
+     * In every round, each point searches its lightest edge to another tree in parallel,
+     * then each tree adds the lightest edge of its points. Equal weights are ordered by the
+     * ids of the end points, so the forest is unique.
+     * @param graph The symmetric adjacency lists of the graph, with the edge weights as distances.
+     * @param parallel_for Runs the parallel loops.
+     * @return The edges of the minimum spanning forest.
+     */
+    inline ForestEdgeVector minimum_spanning_forest( const std::vector<NeighborVector>& graph, const ParallelFor& parallel_for) {
+        const std::size_t n_points = graph.size();
+        const point_id none = static_cast<point_id>(n_points);
+        ForestEdgeVector ret;
+
+        std::vector<point_id> parents( n_points);      // union-find forest of the trees
+        std::vector<point_id> trees( n_points);        // the root of every point's tree, fixed during a round
+        std::vector<point_id> best_targets( n_points); // the other end of the lightest outgoing edge, of a point or a tree
+        std::vector<real> best_weights( n_points);
+        std::vector<point_id> best_sources( n_points); // the point of a tree the tree's lightest edge starts at
+        for( point_id p=0; p<n_points; ++p)
+            parents[p] = p;
+
+        bool has_merged = true;
+        while( has_merged) {
+            has_merged = false;
+            for( point_id p=0; p<n_points; ++p)
+                trees[p] = find_root( parents, p);
+
+            // the lightest edge of every point that leaves its tree
+            parallel_for( n_points, [&]( const std::size_t begin, const std::size_t end) {
+                for( std::size_t i=begin; i<end; ++i) {
+                    const point_id p = static_cast<point_id>(i);
+                    best_targets[p] = none;
+                    best_weights[p] = OPTICS::UNDEFINED;
+
+                    for( NeighborVector::const_iterator it=graph[p].begin(); it!=graph[p].end(); ++it) {
+                        if( trees[it->id] == trees[p])
+                            continue;
+                        if( best_targets[p] == none || is_lighter( it->squared_distance, p, it->id, best_weights[p], p, best_targets[p])) {
+                            best_targets[p] = it->id;
+                            best_weights[p] = it->squared_distance;
+                        }
+                    }
+                }
+            });
+
+            // the lightest edge of every tree, stored at its root
+            std::vector<point_id> tree_targets( n_points, none);
+            for( point_id p=0; p<n_points; ++p) {
+                if( best_targets[p] == none)
+                    continue;
+                const point_id t = trees[p];
+                if( tree_targets[t] == none || is_lighter( best_weights[p], p, best_targets[p], best_weights[best_sources[t]], best_sources[t], tree_targets[t])) {
+                    tree_targets[t] = best_targets[p];
+                    best_sources[t] = p;
+                }
+            }
+
+            // merge; two trees may have chosen the same edge
+            for( point_id t=0; t<n_points; ++t) {
+                if( tree_targets[t] == none)
+                    continue;
+                const point_id a = best_sources[t];
+                const point_id b = tree_targets[t];
+                const point_id root_a = find_root( parents, a);
+                const point_id root_b = find_root( parents, b);
+                if( root_a == root_b)
+                    continue;
+
+                parents[root_a] = root_b;
+                const ForestEdge e = { a, b, best_weights[a] };
+                ret.push_back( e);
+                has_merged = true;
+            }
+        }
+        return ret;
+    }
+
+
+    /** Walks a spanning forest in the manner of OPTICS: starting at the unprocessed point with
+     * the smallest id, it always continues at the lightest edge to an unprocessed point.
+     * @param n_points The number of points.
+     * @param edges The edges of the spanning forest.
+     * @param[out] o_reachabilities The weight of the edge every point was reached by, indexed by point id.
+     *             OPTICS::UNDEFINED for the first point of every tree.
+     * @return The OPTICS ordered list of point ids.
+     */
+    inline IdVector order_spanning_forest( const std::size_t n_points, const ForestEdgeVector& edges, std::vector<real>& o_reachabilities) {
+        std::vector<NeighborVector> forest( n_points);
+        for( ForestEdgeVector::const_iterator it=edges.begin(); it!=edges.end(); ++it) {
+            forest[it->a].push_back( Neighbor( it->b, it->weight));
+            forest[it->b].push_back( Neighbor( it->a, it->weight));
+        }
+
+        IdVector ret;
+        ret.reserve( n_points);
+        PointStates states( n_points);
+        SeedHeap seeds( n_points);
+
+        // with a core distance of 0, the reachability distances are just the edge weights
+        const real c_dist = 0;
+        for( point_id p=0; p<n_points; ++p) {
+            if( states.is_processed[p])
+                continue;
+
+            states.is_processed[p] = 1;
+            ret.push_back( p);
+            update_seeds( forest[p], c_dist, states, seeds);
+
+            while( !seeds.empty()) {
+                const point_id q = seeds.pop();
+                states.is_processed[q] = 1;
+                ret.push_back( q);
+                update_seeds( forest[q], c_dist, states, seeds);
+            }
+        }
+        o_reachabilities.swap( states.reachability_distances);
+        return ret;
+    }
+
+
+
+    // HELPERS ####################################################################################
+
+
+    /** Runs a loop body on the whole range in the calling thread.
+     * @param n The number of indices.
+     * @param body The loop body.
+     */
+    inline void serial_for( const std::size_t n, const RangeBody& body) {
+        if( n > 0)
+            body( 0, n);
+    }
+
+
+    /** Compares two edges by their weights, then by their end points.
+     * Gives every set of edges a strict total order, which Boruvka's algorithm needs to avoid cycles.
+     * @param weight_a The weight of the first edge.
+     * @param a0 One end point of the first edge.
+     * @param a1 The other end point of the first edge.
+     * @param weight_b The weight of the second edge.
+     * @param b0 One end point of the second edge.
+     * @param b1 The other end point of the second edge.
+     * @return TRUE if the first edge is lighter, FALSE otherwise.
+     */
+    inline bool is_lighter( const real weight_a, const point_id a0, const point_id a1, const real weight_b, const point_id b0, const point_id b1) {
+        if( weight_a != weight_b)
+            return weight_a < weight_b;
+        const std::pair<point_id,point_id> a( std::min( a0, a1), std::max( a0, a1));
+        const std::pair<point_id,point_id> b( std::min( b0, b1), std::max( b0, b1));
+        return a < b;
+    }
+
+
+    /** Finds the root of a point's tree in a union-find forest and compresses the path.
+     * @param[in,out] io_parents The parent of every point; roots are their own parents.
+     * @param p The id of the point.
+     * @return The id of the root.
+     */
+    inline point_id find_root( std::vector<point_id>& io_parents, point_id p) {
+        point_id root = p;
+        while( io_parents[root] != root)
+            root = io_parents[root];
+        while( io_parents[p] != root) {
+            const point_id next = io_parents[p];
+            io_parents[p] = root;
+            p = next;
+        }
+        return root;
+    }
+
+} // END namespace OPTICS
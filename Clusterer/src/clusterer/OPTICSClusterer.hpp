@@ -4,7 +4,7 @@
 /*       (http://fogo.dbs.ifi.lmu.de/Publikationen/Papers/OPTICS.pdf)
 /*
 /* @author langenhagen
-/* @version 150520
+/* @version 150713
 /******************************************************************************/
 #pragma once
 
@@ -12,7 +12,11 @@
 // INCLUDES project headers
 
 #include "Clusterer.hpp"
+#include "DistanceCache.hpp"
+#include "parallel_for.hpp"
+#include "OPTICS/ClusterOrdering.hpp"
 #include "OPTICS/optics.hpp"
+#include "OPTICS/poptics.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
@@ -24,6 +28,13 @@
 
 namespace app {
 
+    /// The maximum estimated size of the epsilon-neighborhoods that parallel OPTICS may hold in memory.
+    const uint64_t MAX_PARALLEL_OPTICS_NEIGHBORHOOD_BYTES = 1ULL << 30;
+
+    /// The number of points whose epsilon-neighborhoods are counted to estimate the size of all of them.
+    const uint PARALLEL_OPTICS_SAMPLE_SIZE = 100;
+
+
     /** @brief OPTCIS clusterer. Density based clustering.
      */
     class OPTICSClusterer : public Clusterer {
@@ -33,7 +44,87 @@ namespace app {
         /// describes the mode that is to be used by optics
         enum optics_mode {
             N_CLUSTERS  = 0,    ///< find exactly n clusters (or less...)
-            PERSISTENCE = 1     ///< find k most persistent clusters
+            PERSISTENCE = 1,    ///< find k most persistent clusters
+            XI          = 2     ///< find the innermost clusters with the xi steep area method
+        };
+
+        /// describes the algorithm that computes the OPTICS ordering
+        enum optics_algorithm {
+            SERIAL   = 0,       ///< the classic, sequential OPTICS algorithm
+            PARALLEL = 1        ///< parallel OPTICS via the minimum spanning forest of the reachability graph
+        };
+
+        /// Points that compute their distances on the quantized features, without dequantizing them.
+        class QuantizedPoints {
+
+            const QuantizedMat& _features; ///< The quantized features. The point ids are the row indices.
+
+        public:
+
+            /** Main constructor.
+             * @param features The quantized features. Must outlive the object.
+             */
+            QuantizedPoints( const QuantizedMat& features)
+                : _features( features)
+            {}
+
+            /// @see OPTICS::PointMatrix::size()
+            std::size_t size() const { return _features.rows(); }
+
+            /// @see OPTICS::PointMatrix::dims()
+            std::size_t dims() const { return _features.cols(); }
+
+            /// @see OPTICS::PointMatrix::coordinate()
+            OPTICS::real coordinate( const OPTICS::point_id p, const std::size_t d) const {
+                return _features.dequantize( static_cast<int>(p), static_cast<int>(d));
+            }
+
+            /// @see OPTICS::PointMatrix::squared_distance()
+            OPTICS::real squared_distance( const OPTICS::point_id a, const OPTICS::point_id b) const {
+                return _features.squared_distance( static_cast<int>(a), static_cast<int>(b));
+            }
+
+        private:
+            /// Not assignable.
+            QuantizedPoints& operator=( const QuantizedPoints&);
+        };
+
+        /// Points that take their distances from a condensed distance cache.
+        class CachedPoints {
+
+            const OPTICS::PointMatrix& _points; ///< The points, for their coordinates.
+            const DistanceCache& _cache;        ///< The open CONDENSED distance cache of the points.
+
+        public:
+
+            /** Main constructor.
+             * @param points The points. Must outlive the object.
+             * @param cache The open CONDENSED distance cache of the points. Must outlive the object.
+             */
+            CachedPoints( const OPTICS::PointMatrix& points, const DistanceCache& cache)
+                : _points( points), _cache( cache)
+            {}
+
+            /// @see OPTICS::PointMatrix::size()
+            std::size_t size() const { return _points.size(); }
+
+            /// @see OPTICS::PointMatrix::dims()
+            std::size_t dims() const { return _points.dims(); }
+
+            /// @see OPTICS::PointMatrix::coordinate()
+            OPTICS::real coordinate( const OPTICS::point_id p, const std::size_t d) const {
+                return _points.coordinate( p, d);
+            }
+
+            /// @see OPTICS::PointMatrix::squared_distance()
+            OPTICS::real squared_distance( const OPTICS::point_id a, const OPTICS::point_id b) const {
+                const OPTICS::real distance = _cache.distance( a, b);
+                return distance * distance;
+            }
+
+        private:
+            /// Not assignable.
+            CachedPoints& operator=( const CachedPoints&);
         };
 
     public: // constructor & destructor
@@ -53,58 +144,66 @@ namespace app {
     public: // methods
 
         /** @see Clusterer::do_cluster()
+         * Works directly on the rows of the feature matrix, without copying them.
+         * Takes the distances from the distance cache if a cache directory is given
+         * and the condensed distance matrix of the features is not too large.
          * XXX maybe opt to put outliers to nearest cluster, instead of its own
          */
         virtual Mat1r do_cluster( const Mat1r& features) const {
-            typedef OPTICS::LabelledDataPoint<int> OPTICSPoint;
-            const uint n_features = features.rows;
-            check_and_resolve_input_errors( n_features);
+            check_and_resolve_input_errors( features.rows);
+            const OPTICS::PointMatrix points( features.ptr<real>(),
+                                              features.rows,
+                                              features.cols,
+                                              features.step1());
+
+            const string& cache_directory = this->description.distance_cache_directory;
+            if( !cache_directory.empty()) {
+                DistanceCache cache;
+                if( !DistanceCache::fits_condensed( features.rows)) {
+                    LOG(notify) << "OPTICSClusterer: The features are too many for a condensed distance cache, computing the distances instead.";
+                } else if( load_or_build_distance_cache( cache_directory, this->description.distance_cache_neighbors, features, cache)) {
+                    return cluster_points( CachedPoints( points, cache));
+                }
+            }
+            return cluster_points( points);
+        }
+
+
+        /** @see Clusterer::do_cluster_quantized()
+         * The points do not dequantize the features but compute their distances on the quantized features.
+         */
+        virtual Mat1r do_cluster_quantized( const QuantizedMat& features) const {
+            check_and_resolve_input_errors( features.rows());
+            return cluster_points( QuantizedPoints( features));
+        }
+
+
+    protected: // helpers
+
+        /** Gets the cluster ordering of the given points, writes the reachability distances
+         * and the ordering to disk and extracts the clusters.
+         * Every tweak parameter after the 7th is another n_clusters, persistence or xi value; the clusters
+         * for each of them are extracted from the same ordering and written to a label file.
+         * @param points The points. Their ids must be the row indices of the features.
+         * @return A matrix that contains row-wise probabilities for each feature 
+         *         to belong to one class el. [0,1].
+         */
+        template< typename Points>
+        Mat1r cluster_points( const Points& points) const {
+            const uint n_features = static_cast<uint>(points.size());
             Mat1r ret;
             
             const Vec1r& tweak = this->description.tweak_vector;
 
-            const optics_mode mode               = tweak[0] == N_CLUSTERS ? N_CLUSTERS : PERSISTENCE; // not schoen but selten
-            const OPTICS::real eps               = tweak[1]; 
-            const uint min_pts                   = static_cast<uint>(tweak[2]);
-            const uint n_clusters                = static_cast<uint>(tweak[3]);
-            const OPTICS::real persistence       = tweak[3];
-            const OPTICS::real outlier_threshold = tweak[4];
-            
-            // assemble data
-            OPTICS::DataVector db;
-            for( int r=0; r<features.rows; ++r) {
-                OPTICSPoint* p = new OPTICSPoint( r);
-                vector<OPTICS::real>& data = p->data();
-                for( int c=0; c<features.cols; ++c)
-                    data.push_back( features(r,c));
-                db.push_back(p);
-            }
-
-            // run optics
-            uint n_processed = 0;
-            OPTICS::DataVector result = 
-                OPTICS::optics( db, 
-                                eps, 
-                                min_pts, 
-                                [&n_processed, &n_features](const OPTICS::DataPoint* p){
-                                    n_processed++;
-                                    if( n_processed % 100 == 0) {
-                                        const real percent = static_cast<int>( 100.0 * n_processed / n_features * 100 + 0.5) / 100.0f;
-                                        LOG(info) << "OPTICSClusterer: " << percent << "% (" << n_processed << '/' << n_features << ") done.";
-                                    }
-                                });
+            OPTICS::ClusterOrdering ordering;
+            load_or_compute_ordering( points, ordering);
 
             // extract reachability distances
-            vector<OPTICS::real> reachabilities;
+            const vector<OPTICS::real> reachabilities = ordering.ordered_reachabilities();
             Vec1i ordered_indices;
-            std::for_each( result.begin(), 
-                           result.end(), 
-                           [&reachabilities, &ordered_indices]( const OPTICS::DataPoint* p) {
-                                const OPTICSPoint* lp = dynamic_cast<const OPTICSPoint*>(p);
-                                reachabilities.push_back( p->reachability_distance());
-                                ordered_indices.push_back( lp->label());
-                           });
-
+            ordered_indices.reserve( ordering.ordered_ids.size());
+            for( auto it=ordering.ordered_ids.begin(); it!=ordering.ordered_ids.end(); ++it)
+                ordered_indices.push_back( static_cast<int>(*it));
 
             const string reachability_distances_fname = "optics_reachability_distances.txt";
             const string ordered_indices_fname = "optics_ordered_feature_indices.txt";
@@ -114,43 +213,170 @@ namespace app {
             to_file(ordered_indices_fname, ordered_indices);
 
 
-            // find clusters
-            Vec1UInt cluster_borders;
-            if( mode == N_CLUSTERS) {
-                cluster_borders = find_k_histogram_peaks( reachabilities, n_clusters);
-            } else if( mode == PERSISTENCE) {
-                cluster_borders = find_histogram_peaks( reachabilities, persistence);
-            } else {
-                //should never happen
-                LOG(error) << "OPTICSClusterer: Not able to handle the mode \"" << mode << "\".";
+            // further parameter values
+            for( uint i=7; i<tweak.size(); ++i) {
+                const vector<OPTICS::IdVector> clusters = extract_clusters( ordering, reachabilities, tweak[i]);
+                Vec1i labels( n_features);
+                for( uint c=0; c<clusters.size(); ++c)
+                    for( auto it=clusters[c].begin(); it!=clusters[c].end(); ++it)
+                        labels[*it] = static_cast<int>(c);
+
+                std::stringstream labels_fname;
+                labels_fname << "optics_labels_" << tweak[i] << ".txt";
+                LOG(info) << "OPTICSClusterer: Writing the labels of " << clusters.size() << " clusters for the value " << tweak[i] << " to \"" << labels_fname.str() << "\"...";
+                to_file( labels_fname.str(), labels);
             }
-            
-            std::sort( cluster_borders.begin(), cluster_borders.end());
-            vector<OPTICS::DataVector> clusters = OPTICS::extract_clusters( result, cluster_borders, outlier_threshold);
 
 
             // set 1 on assigned cluster position
+            const vector<OPTICS::IdVector> clusters = extract_clusters( ordering, reachabilities, tweak[3]);
             ret = Mat1r( n_features, static_cast<int>(clusters.size()), real(0));
             for( uint i=0; i<clusters.size(); ++i) {
-                const OPTICS::DataVector& cluster_i = clusters[i];
-                for( uint j=0; j<cluster_i.size(); ++j) {
-                    const OPTICSPoint* p = dynamic_cast<OPTICSPoint*>(cluster_i[j]);
-                    auto tt = p->label();
-                    ret( p->label(), i) = 1;
+                const OPTICS::IdVector& cluster_i = clusters[i];
+                for( uint j=0; j<cluster_i.size(); ++j)
+                    ret( cluster_i[j], i) = 1;
+            }
+
+            return ret;
+        }
+
+
+        /** Reads the cluster ordering from the model file if it was computed for the given
+         * points and parameters, runs OPTICS and persists the ordering otherwise.
+         * A matching model file thus leaves only the cluster extraction to be done.
+         * @param points The points. Their ids must be the row indices of the features.
+         * @param[out] o_ordering The cluster ordering.
+         */
+        template< typename Points>
+        void load_or_compute_ordering( const Points& points, OPTICS::ClusterOrdering& o_ordering) const {
+            const uint n_features = static_cast<uint>(points.size());
+            const Vec1r& tweak = this->description.tweak_vector;
+
+            const OPTICS::real eps               = tweak[1]; 
+            const uint min_pts                   = static_cast<uint>(tweak[2]);
+            const OPTICS::range_index_type::range_index_type index_type = range_index_for( points, static_cast<OPTICS::range_index_type::range_index_type>( static_cast<int>(tweak[5])));
+            const optics_algorithm algorithm     = tweak[6] == PARALLEL ? affordable_algorithm( points, eps) : SERIAL;
+            const string& model_file             = this->description.model_file;
+
+            LOG(info) << "OPTICSClusterer: Computing the fingerprint of the features and parameters...";
+            const uint64_t fingerprint = OPTICS::fingerprint( points, eps, min_pts, algorithm | distance_variant( points) << 1 | static_cast<uint64_t>(index_type) << 2);
+
+            if( !model_file.empty() && bfs::exists( model_file)) {
+                if( o_ordering.from_file( model_file) && o_ordering.fingerprint == fingerprint) {
+                    LOG(info) << "OPTICSClusterer: Reusing the cluster ordering from \"" << model_file << "\", extracting the clusters only.";
+                    return;
                 }
+                LOG(notify) << "OPTICSClusterer: The cluster ordering in \"" << model_file << "\" does not match the features or parameters.";
             }
 
-            // clean up
-            for( auto it=db.begin(); it!=db.end(); ++it) {
-                delete *it;
+            LOG(info) << "OPTICSClusterer: Building the range index...";
+            const std::unique_ptr<OPTICS::RangeIndex<Points>> index( OPTICS::create_range_index( points, index_type));
+
+            // run optics
+            uint n_processed = 0;
+            o_ordering.fingerprint = fingerprint;
+            if( algorithm == PARALLEL) {
+                LOG(info) << "OPTICSClusterer: Running parallel OPTICS...";
+                o_ordering.ordered_ids = OPTICS::parallel_optics( points, eps, min_pts, *index, o_ordering.reachabilities, o_ordering.core_distances, &parallel_for);
+            } else {
+                o_ordering.ordered_ids = OPTICS::optics( points, 
+                                                         eps, 
+                                                         min_pts, 
+                                                         *index,
+                                                         o_ordering.reachabilities,
+                                                         o_ordering.core_distances,
+                                                         [&n_processed, &n_features](const OPTICS::point_id p){
+                                                             n_processed++;
+                                                             if( n_processed % 100 == 0) {
+                                                                 const real percent = static_cast<int>( 100.0 * n_processed / n_features * 100 + 0.5) / 100.0f;
+                                                                 LOG(info) << "OPTICSClusterer: " << percent << "% (" << n_processed << '/' << n_features << ") done.";
+                                                             }
+                                                         });
             }
 
+            const unsigned long long n_distances = index->n_distance_evaluations();
+            const unsigned long long n_linear_scan_distances = index->n_linear_scan_distance_evaluations();
+            LOG(info) << "OPTICSClusterer: The range index computed " << n_distances << " distances instead of the "
+                      << n_linear_scan_distances << " of a linear scan, a speedup of "
+                      << (n_distances > 0 ? static_cast<double>(n_linear_scan_distances) / n_distances : 1.0) << ".";
 
-            return ret;
+            if( !model_file.empty()) {
+                LOG(info) << "OPTICSClusterer: Writing the cluster ordering to \"" << model_file << "\"...";
+                if( !o_ordering.to_file( model_file))
+                    on_write_file_error( model_file);
+            }
         }
 
 
-    protected: // helpers
+        /** Tells whether the epsilon-neighborhoods of all points, which parallel OPTICS holds in memory
+         * at once, are expected to fit into MAX_PARALLEL_OPTICS_NEIGHBORHOOD_BYTES.
+         * Their size is extrapolated from the neighborhoods of PARALLEL_OPTICS_SAMPLE_SIZE evenly spread points.
+         * @param points The points.
+         * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+         * @return PARALLEL if the neighborhoods fit,
+         *         SERIAL if epsilon is unbounded or the neighborhoods are estimated to be too large.
+         */
+        template< typename Points>
+        static optics_algorithm affordable_algorithm( const Points& points, const OPTICS::real eps) {
+            const OPTICS::real eps_sq = eps*eps;
+            if( !(eps_sq < std::numeric_limits<OPTICS::real>::max())) {
+                LOG(warn) << "OPTICSClusterer: Epsilon is unbounded, so parallel OPTICS would hold all pairs of points in memory. Running serial OPTICS instead.";
+                return SERIAL;
+            }
+
+            const uint64_t n_points = points.size();
+            const uint64_t n_samples = std::min<uint64_t>( n_points, PARALLEL_OPTICS_SAMPLE_SIZE);
+            uint64_t n_sampled_neighbors = 0;
+            for( uint64_t i=0; i<n_samples; ++i) {
+                const OPTICS::point_id p = static_cast<OPTICS::point_id>(i * n_points / n_samples);
+                for( uint64_t q=0; q<n_points; ++q)
+                    if( points.squared_distance( p, static_cast<OPTICS::point_id>(q)) <= eps_sq)
+                        ++n_sampled_neighbors;
+            }
+
+            const double estimated_bytes = n_samples > 0 ? static_cast<double>(n_sampled_neighbors) / n_samples * n_points * sizeof(OPTICS::Neighbor) : 0;
+            if( estimated_bytes > MAX_PARALLEL_OPTICS_NEIGHBORHOOD_BYTES) {
+                LOG(warn) << "OPTICSClusterer: The epsilon-neighborhoods of parallel OPTICS would take about " << static_cast<uint64_t>(estimated_bytes / (1 << 20))
+                          << " MB, more than the " << (MAX_PARALLEL_OPTICS_NEIGHBORHOOD_BYTES >> 20) << " MB allowed. Running serial OPTICS instead.";
+                return SERIAL;
+            }
+            return PARALLEL;
+        }
+
+
+        /** Extracts the clusters from a cluster ordering according to the mode.
+         * @param ordering The cluster ordering.
+         * @param reachabilities The squared reachability distances in cluster order.
+         * @param value The number of clusters, the persistence or xi, depending on the mode.
+         * @return A vector of different disjoint point id containers, each making up one cluster.
+         *         The first container stores the points that are considered outliers.
+         */
+        vector<OPTICS::IdVector> extract_clusters( const OPTICS::ClusterOrdering& ordering,
+                                                   const vector<OPTICS::real>& reachabilities,
+                                                   const real value) const {
+            const Vec1r& tweak = this->description.tweak_vector;
+            const optics_mode mode               = static_cast<optics_mode>( static_cast<int>(tweak[0]));
+            const uint min_pts                   = static_cast<uint>(tweak[2]);
+            const OPTICS::real outlier_threshold = tweak[4];
+
+            if( mode == XI)
+                return OPTICS::extract_xi_clusters( ordering.ordered_ids, ordering.reachabilities, value, min_pts);
+
+            // find clusters
+            Vec1UInt cluster_borders;
+            if( mode == N_CLUSTERS) {
+                cluster_borders = find_k_histogram_peaks( reachabilities, static_cast<uint>(value));
+            } else if( mode == PERSISTENCE) {
+                cluster_borders = find_histogram_peaks( reachabilities, value);
+            } else {
+                //should never happen
+                LOG(error) << "OPTICSClusterer: Not able to handle the mode \"" << mode << "\".";
+            }
+            
+            std::sort( cluster_borders.begin(), cluster_borders.end());
+            return OPTICS::extract_clusters( ordering.ordered_ids, ordering.reachabilities, cluster_borders, outlier_threshold);
+        }
+
 
         /** Helper function that checks the description for errors 
          * and logs and corrects them.
@@ -159,28 +385,37 @@ namespace app {
         void check_and_resolve_input_errors( const uint n_features) const {
             Vec1r& tweak = this->description.tweak_vector;
 
-            if( tweak.size() < 5 || 
-                tweak[0] != N_CLUSTERS && tweak[0] != PERSISTENCE ||    // mode (N_CLUSTERS or PERSISTENCE)
+            if( tweak.size() < 7 || 
+                tweak[0] != N_CLUSTERS && tweak[0] != PERSISTENCE && tweak[0] != XI ||    // mode (N_CLUSTERS, PERSISTENCE or XI)
                 tweak[1] <= 0 ||    // epsilon (el. R+)
                 tweak[2] <= 0 ||    // min_pts (el. N+)
-                tweak[3] <= 0 ||    // n_clusters (el N+) or persistence (el. R+)
-                tweak[4] <= 0       // outlier_threshold (el. R+)
+                tweak[3] <= 0 ||    // n_clusters (el N+) or persistence (el. R+) or xi (el. ]0,1[)
+                tweak[0] == XI && tweak[3] >= 1 ||
+                tweak[4] <= 0 ||    // outlier_threshold (el. R+)
+                tweak[5] < OPTICS::range_index_type::AUTO || tweak[5] > OPTICS::range_index_type::VP_TREE || // range index type (el. {0,1,2,3})
+                tweak[6] != SERIAL && tweak[6] != PARALLEL  // algorithm (SERIAL or PARALLEL)
                 ) {
                 
                 const OPTICS::real max = std::numeric_limits<OPTICS::real>::max();
                 const real min_pts_default_percentage = 1;
 
-                LOG(warn) << "OPTICSClusterer: Tweak vector must contain 5 parameters:\n"
-                             "0: 1 number specifying the behaviour: 0: find n clusters    or    1: find all clusters with high persistence at peaks\n"
+                LOG(warn) << "OPTICSClusterer: Tweak vector must contain 7 parameters:\n"
+                             "0: 1 number specifying the behaviour: 0: find n clusters    or    1: find all clusters with high persistence at peaks    or    2: find the innermost clusters with the xi method\n"
                              "1: the epsilon optics parameter, if zero or negative, epsilon will be set to " << max << "\n"
                              "2: the min_pts optics parameter, a positive integer; will otherwise be set to " << min_pts_default_percentage << "% of the size of the input data set\n"
-                             "3: the number of clusters, if parameter 0 is set to '0'    or    the persistence value if parameter 0 is set to '1'\n"
-                             "4: the outlier threshold: must be positive, will be set to " << max << " otherwise";
+                             "3: the number of clusters, if parameter 0 is set to '0'    or    the persistence value if parameter 0 is set to '1'    or    xi el. ]0,1[ if parameter 0 is set to '2'\n"
+                             "4: the outlier threshold: must be positive, will be set to " << max << " otherwise\n"
+                             "5: the range index: 0: auto    1: linear scan    2: kd-tree for low dimensions    3: vp-tree for high dimensions\n"
+                             "6: the algorithm: 0: serial OPTICS    1: parallel OPTICS; keeps all epsilon-neighborhoods in memory, so epsilon should be small; falls back to serial OPTICS if epsilon is unbounded or the neighborhoods would take more than " << (MAX_PARALLEL_OPTICS_NEIGHBORHOOD_BYTES >> 20) << " MB\n"
+                             "7...: optional further values of parameter 3; the clusters for each of them are written to a label file; values that break the rules of parameter 3 are dropped\n"
+                             "The cluster ordering is stored in the clusterer model file, if given, and reused while parameters 1, 2, 5 and 6 and the features stay the same\n"
+                             "The distances are taken from the distance cache, if a cache directory is given and the features are not too many; the range index is a linear scan then";
                 
-                tweak.resize(5, -1);  // if too few parameters where given
+                if( tweak.size() < 7)
+                    tweak.resize(7, -1);  // if too few parameters where given; keeps further values
 
                 // mode
-                if( tweak[0] != N_CLUSTERS && tweak[0] != PERSISTENCE) {
+                if( tweak[0] != N_CLUSTERS && tweak[0] != PERSISTENCE && tweak[0] != XI) {
                     tweak[0] = N_CLUSTERS;
                     LOG(notify) << "Setting OPTICS mode to N_CLUSTERS aka " << tweak[0] << ".";
                 }
@@ -194,11 +429,14 @@ namespace app {
                     tweak[2] = static_cast<real>(n_features) / 100 * min_pts_default_percentage;
                     LOG(notify) << "Setting min_pts to " << tweak[2] << ".";
                 }
-                // n_clusters / persistence
-                if( tweak[3] <=0) {
+                // n_clusters / persistence / xi
+                if( tweak[3] <=0 || tweak[0] == XI && tweak[3] >= 1) {
                     if( tweak[0] == N_CLUSTERS) {
                         tweak[3] = 1;
                         LOG(notify) << "Setting n_clusters to " << tweak[3] << ".";
+                    } else if( tweak[0] == XI) {
+                        tweak[3] = 0.05f;
+                        LOG(notify) << "Setting xi to " << tweak[3] << ".";
                     } else {
                         tweak[3] = 0;
                         LOG(notify) << "Setting persistence value to " << tweak[3] << ".";
@@ -209,14 +447,71 @@ namespace app {
                     tweak[4] = max;
                     LOG(notify) << "Setting outlier threshold value to " << tweak[4] << ".";
                 }
+                // range index
+                if( tweak[5] < OPTICS::range_index_type::AUTO || tweak[5] > OPTICS::range_index_type::VP_TREE) {
+                    tweak[5] = OPTICS::range_index_type::AUTO;
+                    LOG(notify) << "Setting range index type to AUTO aka " << tweak[5] << ".";
+                }
+                // algorithm
+                if( tweak[6] != SERIAL && tweak[6] != PARALLEL) {
+                    tweak[6] = SERIAL;
+                    LOG(notify) << "Setting OPTICS algorithm to SERIAL aka " << tweak[6] << ".";
+                }
                 
             } // END IF
+
+            // further n_clusters / persistence / xi values, subject to the rules of parameter 3
+            for( auto it=tweak.begin()+7; it!=tweak.end(); ) {
+                if( *it <= 0 || tweak[0] == XI && *it >= 1) {
+                    LOG(warn) << "OPTICSClusterer: Dropping the invalid further value " << *it << " of parameter 3.";
+                    it = tweak.erase( it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+
+        /** Distinguishes the cluster orderings of points whose distances are looked up in the
+         * distance cache, and thus slightly rounded, from the ones whose distances are computed.
+         * @param points The points.
+         * @return 1 for CachedPoints, 0 otherwise.
+         */
+        static uint64_t distance_variant( const CachedPoints&) {
+            return 1;
+        }
+
+        /// @see distance_variant( const CachedPoints&)
+        template< typename Points>
+        static uint64_t distance_variant( const Points&) {
+            return 0;
+        }
+
+
+        /** Chooses the range index for points whose distances are looked up in the distance cache.
+         * The kd-tree prunes on the exact coordinates and the vp-tree by the triangle inequality
+         * with a slack far below the half precision error of the cached distances, so both may miss
+         * neighbors near epsilon. Only the linear scan is consistent with the cached distances.
+         * @param points The points.
+         * @param type The requested range index type.
+         * @return LINEAR_SCAN.
+         */
+        static OPTICS::range_index_type::range_index_type range_index_for( const CachedPoints&, const OPTICS::range_index_type::range_index_type type) {
+            if( type != OPTICS::range_index_type::AUTO && type != OPTICS::range_index_type::LINEAR_SCAN)
+                LOG(notify) << "OPTICSClusterer: Using the linear scan instead of range index type " << type << ", since the distances are cached.";
+            return OPTICS::range_index_type::LINEAR_SCAN;
+        }
+
+        /// @see range_index_for( const CachedPoints&, const OPTICS::range_index_type::range_index_type)
+        template< typename Points>
+        static OPTICS::range_index_type::range_index_type range_index_for( const Points&, const OPTICS::range_index_type::range_index_type type) {
+            return type;
         }
 
 
         /** Given the OPTICS ordered output, finds the k most persistent maxima peaks 
          * of the reachability distances, which are presumably cluster-borders.
-         * @param reachabilities The OPTICS ordered reachability distances of the DataPoints 
+         * @param reachabilities The OPTICS ordered reachability distances of the points 
          *        that where the input of the OPTICS function.
          * @param n_clusters the number of clusters that shall is we want to extract.
          *        The n_clusters-1 most persistent histogram peaks are assumed to be their borders.
@@ -244,7 +539,7 @@ namespace app {
 
         /** Given the OPTICS ordered output, finds all maxima peaks with a persistence 
          * greater than a given threshold. These are presumably cluster-borders.
-         * @param reachabilities The OPTICS ordered reachability distances of the DataPoints 
+         * @param reachabilities The OPTICS ordered reachability distances of the points 
          *        that where the input of the OPTICS function.
          * @param persistence The persistence of the histogram peaks to retain.
          * @return All histogram peak indices that are above the given persistence threshold.
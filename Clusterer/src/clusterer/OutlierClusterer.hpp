@@ -1,9 +1,14 @@
 /******************************************************************************
 /* @file Outlier clusterer. Finds n feature vectors that are farthest away from
-/*       all other elements.
+/*       all other elements. Takes the nearest neighbor distances from the
+/*       distance cache, if one is configured, or searches them approximately,
+/*       if a recall is configured. Otherwise finds the outliers exactly with
+/*       the randomized, pruned nested loop of ORCA by Bay & Schwabacher:
+/*       "Mining Distance-Based Outliers in Near Linear Time with Randomization
+/*       and a Simple Pruning Rule".
 /*
 /* @author langenhagen
-/* @version 150127
+/* @version 150716
 /******************************************************************************/
 #pragma once
 
@@ -11,11 +16,14 @@
 // INCLUDES project headers
 
 #include "Clusterer.hpp"
+#include "DistanceCache.hpp"
+#include "NearestNeighborIndex.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
 
 #include <queue>
+#include <random>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
@@ -26,6 +34,22 @@ namespace app {
      */
     class OutlierClusterer : public Clusterer {
 
+    private: // types
+
+        /// A feature vector together with the distance to its nearest neighbor.
+        typedef std::pair<unsigned int /*index*/, app::real /*distance to nearest neighbor*/> Outlier;
+
+        /// Orders outliers so that the one closest to its nearest neighbor is on top of a priority queue.
+        struct OutlierGreater {
+            inline bool operator()(const Outlier &a, const Outlier &b) const { return a.second > b.second; }
+        };
+
+        /// Holds the outliers found so far, the weakest on top.
+        typedef std::priority_queue<Outlier, std::vector<Outlier>, OutlierGreater> OutlierPriorityQueue;
+
+        /// The maximum number of feature vectors whose scans run in parallel with the same pruning cutoff.
+        enum { BLOCK_SIZE = 1024 };
+
     public: // constructor & destructor
 
         /** Main constructor.
@@ -44,40 +68,39 @@ namespace app {
     public: // methods
 
         /** @see Clusterer::do_cluster()
+         * The distance of a feature vector to its nearest neighbor is looked up in the distance cache
+         * if a cache directory is given, searched on the nearest neighbor graph if an approximate
+         * nearest neighbor search recall is given and found exactly by find_outliers() otherwise.
          */
         virtual Mat1r do_cluster( const Mat1r& features) const {
-            typedef std::pair<unsigned int /*index*/, app::real /*distance to nearest neighbor*/> Outlier;
-            struct OutlierGreater {
-                inline bool operator()(const Outlier &a, const Outlier &b) const { return a.second > b.second; }
-            };
-            typedef std::priority_queue<Outlier, std::vector<Outlier>, OutlierGreater> OutlierPriorityQueue;
-            
             check_and_resolve_input_errors();
             Mat1r ret(features.rows, 2);
             ret.col(0) = 1;
             ret.col(1) = 0;
             const unsigned int n_outliers( static_cast<uint>(this->description.tweak_vector[0]));
             assert( n_outliers < static_cast<uint>(features.rows) && "The number of outliers must be smaller than the number of feature points");
-            
-            OutlierPriorityQueue outliers;
 
-            for( int i=0; i<features.rows; ++i) {
-                register Outlier o( i, std::numeric_limits<real>::max());
-                for( int j=i+1; j<features.rows; ++j) {
-       
-                    const real dist( static_cast<real>(norm( features.row(i), features.row(j), cv::NORM_L2)));
-                    if( dist < o.second)
-                        o.second = dist;
-                }
-                
-                outliers.push( o);
-
-                if( outliers.size() > n_outliers)
-                    outliers.pop();
-
-                if( i%1000 == 0) {
-                    LOG(info) << "OutlierClusterer: " << i << " / " << features.rows << " feature-vectors visited.";
-                }
+            OutlierPriorityQueue outliers;
+            DistanceCache cache;
+            const bool is_cached = load_or_build_distance_cache( this->description.distance_cache_directory,
+                                                                 this->description.distance_cache_neighbors,
+                                                                 features,
+                                                                 cache);
+            NearestNeighborIndex index( features);
+            const bool is_approximate = !is_cached && this->description.ann_recall > 0;
+            if( is_approximate)
+                index.prepare( this->description.ann_graph_file, this->description.ann_graph_neighbors, this->description.ann_recall, 1);
+
+            if( is_cached || is_approximate) {
+                Vec1r distances( features.rows);
+                parallel_for( features.rows, [&]( const std::size_t begin, const std::size_t end) {
+                    for( std::size_t i=begin; i<end; ++i)
+                        distances[i] = is_cached ? cache.nearest_neighbor_distance( i) : index.nearest_neighbor_distance( static_cast<int>(i));
+                });
+                for( int i=0; i<features.rows; ++i)
+                    push_outlier( Outlier( i, distances[i]), n_outliers, outliers);
+            } else {
+                find_outliers( features, n_outliers, outliers);
             }
 
             while( !outliers.empty()) {
@@ -93,6 +116,79 @@ namespace app {
 
     protected: // helpers
 
+        /** Finds the feature vectors with the largest distances to their nearest neighbors exactly.
+         * A feature vector whose nearest neighbor found so far is closer than the n-th largest nearest
+         * neighbor distance of the vectors processed before, the cutoff, cannot be an outlier, so its
+         * scan stops. Since the scans visit the vectors in random order, most vectors meet a neighbor
+         * closer than the cutoff after a few comparisons, and only the outliers need a full scan.
+         * The scans of a block of vectors run in parallel with the cutoff of the preceding blocks.
+         * The first block holds n_outliers vectors, which need full scans anyway; the following ones
+         * double in size up to BLOCK_SIZE, so that the cutoff rises early. The order is seeded with a constant, so runs are reproducible.
+         * @param features The row-wise feature vectors.
+         * @param n_outliers The number of outliers.
+         * @param[in,out] io_outliers Gets the outliers with their squared nearest neighbor distances.
+         */
+        static void find_outliers( const Mat1r& features, const uint n_outliers, OutlierPriorityQueue& io_outliers) {
+            const int n_features = features.rows;
+            if( n_outliers == 0 || n_features == 0)
+                return;
+
+            vector<int> order( n_features);
+            for( int i=0; i<n_features; ++i)
+                order[i] = i;
+            std::mt19937 rng( 5489u);
+            for( int i=n_features-1; i>0; --i)
+                std::swap( order[i], order[rng() % (i+1)]);
+
+            Vec1r squared_distances( BLOCK_SIZE);
+            vector<uint> n_comparisons( BLOCK_SIZE);
+            unsigned long long n_total_comparisons = 0;
+            int max_block_size = std::min( static_cast<int>(n_outliers), static_cast<int>(BLOCK_SIZE));
+            for( int block=0, i_block=0; block<n_features; block+=max_block_size, max_block_size=std::min( 2*max_block_size, static_cast<int>(BLOCK_SIZE)), ++i_block) {
+                const int block_size = std::min( max_block_size, n_features - block);
+                const real cutoff = io_outliers.size() == n_outliers ? io_outliers.top().second : 0;
+
+                parallel_for( block_size, [&]( const std::size_t begin, const std::size_t end) {
+                    for( std::size_t b=begin; b<end; ++b) {
+                        const int p = order[block + b];
+                        const real* feature = features[p];
+                        real nearest = std::numeric_limits<real>::max();
+                        int j = 0;
+                        for( ; j<n_features && nearest >= cutoff; ++j) {
+                            const int q = order[j];
+                            if( q != p)
+                                nearest = std::min( nearest, distances::squared_l2( feature, features[q], features.cols));
+                        }
+                        squared_distances[b] = nearest;
+                        n_comparisons[b] = j;
+                    }
+                });
+
+                for( int b=0; b<block_size; ++b) {
+                    if( squared_distances[b] >= cutoff)
+                        push_outlier( Outlier( order[block + b], squared_distances[b]), n_outliers, io_outliers);
+                    n_total_comparisons += n_comparisons[b];
+                }
+                if( i_block % 16 == 0)
+                    LOG(info) << "OutlierClusterer: " << block + block_size << " / " << n_features << " feature-vectors visited.";
+            }
+            LOG(info) << "OutlierClusterer: " << n_total_comparisons << " distance computations, "
+                      << 100.0 * n_total_comparisons / (static_cast<double>(n_features) * n_features) << "% of the full nested loop.";
+        }
+
+
+        /** Adds an outlier candidate and drops the weakest outlier if there are too many.
+         * @param o The candidate.
+         * @param n_outliers The number of outliers.
+         * @param[in,out] io_outliers The outliers found so far.
+         */
+        static void push_outlier( const Outlier& o, const uint n_outliers, OutlierPriorityQueue& io_outliers) {
+            io_outliers.push( o);
+            if( io_outliers.size() > n_outliers)
+                io_outliers.pop();
+        }
+
+
         /** Helper function that checks the description for errors 
          * and logs and corrects them.
          */
@@ -0,0 +1,319 @@
+/******************************************************************************
+/* @file Parallel kernels that assign feature vectors to cluster centers,
+/*       compute cluster means and hard membership probabilities.
+/*
+/* @author langenhagen
+/* @version 150703
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include <common.hpp>
+#include <quantization.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /** @brief Assigns blocks of feature vectors to their nearest centers.
+     * Uses the expansion ||x-c||² = ||x||² - 2x·c + ||c||², so that the dot products
+     * of a whole block of rows with all centers are one matrix product.
+     */
+    class NearestCenterAssigner : public cv::ParallelLoopBody {
+
+    public: // vars
+
+        /// The number of feature vectors per block.
+        enum { BLOCK_SIZE = 256 };
+
+    private: // vars
+
+        const Mat1r& _features;             ///< The row-wise feature vectors.
+        const Mat1r& _centers;              ///< The row-wise centers.
+        Mat1r _center_norms;                ///< The squared norms of the centers.
+        int* _labels;                       ///< Output: the index of the nearest center per feature vector.
+        real* _squared_distances;           ///< Output: the squared distance to the nearest center per feature vector, or nullptr.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param features The row-wise feature vectors.
+         * @param centers The row-wise centers. There must be at least one.
+         * @param[out] o_labels Buffer for the index of the nearest center per feature vector.
+         * @param[out] o_squared_distances Buffer for the squared distance to the nearest center
+         *             per feature vector, or nullptr.
+         */
+        NearestCenterAssigner( const Mat1r& features, const Mat1r& centers, int* o_labels, real* o_squared_distances)
+            : _features(features), _centers(centers), _labels(o_labels), _squared_distances(o_squared_distances) {
+            assert( centers.rows > 0 && features.cols == centers.cols && "centers must match the features");
+            cv::reduce( centers.mul( centers), _center_norms, 1, CV_REDUCE_SUM);
+        }
+
+    public: // methods
+
+        /** Assigns the feature vectors of the given blocks.
+         * @param range A range of block indices.
+         */
+        virtual void operator()( const cv::Range& range) const {
+            Mat1r dots;
+            for( int b=range.start; b<range.end; ++b) {
+                const int begin = b * BLOCK_SIZE;
+                const int end = std::min( begin + BLOCK_SIZE, _features.rows);
+                const Mat1r block = _features.rowRange( begin, end);
+                cv::gemm( block, _centers, 1, cv::noArray(), 0, dots, cv::GEMM_2_T);
+
+                for( int r=0; r<block.rows; ++r) {
+                    const real* dot = dots[r];
+                    real min_dist = _center_norms(0) - 2*dot[0];
+                    int nearest_center(0);
+                    for( int c=1; c<_centers.rows; ++c) {
+                        const real dist = _center_norms(c) - 2*dot[c];
+                        if( dist < min_dist) {
+                            min_dist = dist;
+                            nearest_center = c;
+                        }
+                    }
+                    _labels[begin+r] = nearest_center;
+                    if( _squared_distances != nullptr) {
+                        const real feature_norm = real( block.row(r).dot( block.row(r)));
+                        _squared_distances[begin+r] = std::max( real(0), feature_norm + min_dist);
+                    }
+                }
+            }
+        }
+
+    private: // helpers
+
+        /// Not assignable.
+        NearestCenterAssigner& operator=( const NearestCenterAssigner&);
+    };
+
+
+    /** Assigns every feature vector to its nearest center in parallel.
+     * @param features The row-wise feature vectors.
+     * @param centers The row-wise centers. There must be at least one.
+     * @param[out] o_labels The index of the nearest center per feature vector.
+     * @param[out] o_squared_distances If not nullptr, the squared distance to the nearest
+     *             center per feature vector.
+     */
+    inline void assign_to_nearest_centers( const Mat1r& features, const Mat1r& centers, vector<int>& o_labels, Vec1r* o_squared_distances = nullptr) {
+        o_labels.resize( features.rows);
+        if( o_squared_distances != nullptr)
+            o_squared_distances->resize( features.rows);
+        if( features.rows == 0)
+            return;
+
+        const int n_blocks = (features.rows + NearestCenterAssigner::BLOCK_SIZE - 1) / NearestCenterAssigner::BLOCK_SIZE;
+        cv::parallel_for_( cv::Range( 0, n_blocks),
+                           NearestCenterAssigner( features,
+                                                  centers,
+                                                  &o_labels[0],
+                                                  o_squared_distances != nullptr ? &(*o_squared_distances)[0] : nullptr));
+    }
+
+
+    /** Creates hard membership probabilities from cluster labels.
+     * @param labels The cluster index per feature vector.
+     * @param n_clusters The number of clusters.
+     * @return A matrix with one row per feature vector and one column per cluster
+     *         that is 1 at the feature vector's cluster and 0 elsewhere.
+     */
+    template< typename T>
+    inline Mat1r hard_membership_probabilities( const vector<T>& labels, const int n_clusters) {
+        Mat1r ret( static_cast<int>(labels.size()), n_clusters, real(0));
+        for( int r=0; r<ret.rows; ++r)
+            ret( r, static_cast<int>(labels[r])) = 1;
+        return ret;
+    }
+
+
+    /** @brief Finds the column with the maximum value in every row of a matrix.
+     */
+    class RowArgmax : public cv::ParallelLoopBody {
+
+    private: // vars
+
+        const Mat1r& _mat;                  ///< The matrix.
+        uint* _indices;                     ///< Output: the column index of the maximum per row.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param mat The matrix. Must have at least one column.
+         * @param[out] o_indices Buffer for the column index of the maximum per row.
+         */
+        RowArgmax( const Mat1r& mat, uint* o_indices)
+            : _mat(mat), _indices(o_indices)
+        {}
+
+    public: // methods
+
+        /** Processes the rows in the given range.
+         * @param range A range of row indices.
+         */
+        virtual void operator()( const cv::Range& range) const {
+            for( int r=range.start; r<range.end; ++r) {
+                const real* row = _mat[r];
+                _indices[r] = static_cast<uint>( std::max_element( row, row + _mat.cols) - row);
+            }
+        }
+
+    private: // helpers
+
+        /// Not assignable.
+        RowArgmax& operator=( const RowArgmax&);
+    };
+
+
+    /** Retrieves a feature vector.
+     * @param features The row-wise feature vectors.
+     * @param r The row index.
+     * @param buffer Unused.
+     * @return The feature vector.
+     */
+    inline const real* feature_row( const Mat1r& features, const int r, real* /*buffer*/) {
+        return features[r];
+    }
+
+
+    /** Retrieves a dequantized feature vector.
+     * @param features The row-wise quantized feature vectors.
+     * @param r The row index.
+     * @param buffer Buffer for the dequantized feature vector.
+     * @return The buffer.
+     */
+    inline const real* feature_row( const QuantizedMat& features, const int r, real* buffer) {
+        features.dequantize_row( r, buffer);
+        return buffer;
+    }
+
+
+    /** @brief Sums up the feature vectors of each cluster and counts them, for blocks of feature vectors.
+     * Every block has its own partial sums and counts, which are added up afterwards.
+     * @tparam Features Mat1r or QuantizedMat, see feature_row().
+     * @tparam T The label type.
+     */
+    template< typename Features, typename T>
+    class ClusterSums : public cv::ParallelLoopBody {
+
+    private: // vars
+
+        const Features& _features;          ///< The row-wise feature vectors.
+        const vector<T>& _labels;           ///< The cluster index per feature vector.
+        const int _n_rows;                  ///< The number of feature vectors.
+        const int _n_dims;                  ///< The dimensionality of the feature vectors.
+        const int _n_clusters;              ///< The number of clusters.
+        const int _block_size;              ///< The number of feature vectors per block.
+        double* _sums;                      ///< Output: the row-wise sums of the feature vectors per block and cluster.
+        uint* _counts;                      ///< Output: the number of feature vectors per block and cluster.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param features The row-wise feature vectors.
+         * @param labels The cluster index per feature vector.
+         * @param n_rows The number of feature vectors.
+         * @param n_dims The dimensionality of the feature vectors.
+         * @param n_clusters The number of clusters.
+         * @param block_size The number of feature vectors per block.
+         * @param[out] o_sums The row-wise sums of the feature vectors per block and cluster, preallocated with zeros.
+         * @param[out] o_counts The number of feature vectors per block and cluster, preallocated with zeros.
+         */
+        ClusterSums( const Features& features, const vector<T>& labels, const int n_rows, const int n_dims, const int n_clusters, const int block_size, double* o_sums, uint* o_counts)
+            : _features(features), _labels(labels), _n_rows(n_rows), _n_dims(n_dims), _n_clusters(n_clusters), _block_size(block_size), _sums(o_sums), _counts(o_counts)
+        {}
+
+    public: // methods
+
+        /** Sums up the feature vectors of the given blocks.
+         * @param range A range of block indices.
+         */
+        virtual void operator()( const cv::Range& range) const {
+            Vec1r buffer( std::max( _n_dims, 1));
+            for( int b=range.start; b<range.end; ++b) {
+                double* block_sums = _sums + static_cast<size_t>(b) * _n_clusters * _n_dims;
+                uint* block_counts = _counts + static_cast<size_t>(b) * _n_clusters;
+                const int end = std::min( (b+1) * _block_size, _n_rows);
+                for( int r=b*_block_size; r<end; ++r) {
+                    const int c = static_cast<int>(_labels[r]);
+                    const real* feature = feature_row( _features, r, &buffer[0]);
+                    double* sum = block_sums + static_cast<size_t>(c) * _n_dims;
+                    for( int d=0; d<_n_dims; ++d)
+                        sum[d] += feature[d];
+                    ++block_counts[c];
+                }
+            }
+        }
+
+    private: // helpers
+
+        /// Not assignable.
+        ClusterSums& operator=( const ClusterSums&);
+    };
+
+
+    /** Computes the mean of the feature vectors of every cluster in parallel.
+     * The feature vectors are summed up in a number of blocks that depends on the
+     * number of feature vectors only, so the result does not depend on the number of threads.
+     * @tparam Features Mat1r or QuantizedMat, see feature_row().
+     * @param features The row-wise feature vectors.
+     * @param n_rows The number of feature vectors.
+     * @param n_dims The dimensionality of the feature vectors.
+     * @param labels The cluster index per feature vector.
+     * @param n_clusters The number of clusters.
+     * @param[out] o_cluster_means The row-wise cluster means. Empty clusters get a zero mean.
+     */
+    template< typename Features, typename T>
+    inline void compute_cluster_means( const Features& features, const int n_rows, const int n_dims, const vector<T>& labels, const int n_clusters, Mat1r& o_cluster_means) {
+        const int max_sum_blocks = 64;
+        const size_t max_partial_sums = 1 << 24;
+        const size_t sums_per_block = std::max<size_t>( static_cast<size_t>(n_clusters) * n_dims, 1);
+
+        const int n_blocks = std::max( 1, std::min( max_sum_blocks, static_cast<int>( std::min<size_t>( n_rows, max_partial_sums / sums_per_block))));
+        const int block_size = (n_rows + n_blocks - 1) / n_blocks;
+        vector<double> partial_sums( n_blocks * sums_per_block, 0.0);
+        vector<uint> partial_counts( static_cast<size_t>(n_blocks) * n_clusters + 1, 0);
+        cv::parallel_for_( cv::Range( 0, n_blocks), ClusterSums<Features, T>( features, labels, n_rows, n_dims, n_clusters, block_size, &partial_sums[0], &partial_counts[0]));
+
+        o_cluster_means.create( n_clusters, n_dims);
+        for( int c=0; c<n_clusters; ++c) {
+            uint n_elems = 0;
+            for( int b=0; b<n_blocks; ++b)
+                n_elems += partial_counts[static_cast<size_t>(b) * n_clusters + c];
+            real* mean = o_cluster_means[c];
+            for( int d=0; d<n_dims; ++d) {
+                double sum = 0;
+                for( int b=0; b<n_blocks; ++b)
+                    sum += partial_sums[b * sums_per_block + static_cast<size_t>(c) * n_dims + d];
+                mean[d] = n_elems > 0 ? static_cast<real>(sum / n_elems) : real(0);
+            }
+        }
+    }
+
+
+    /** Computes the mean of the feature vectors of every cluster.
+     * @param features The row-wise feature vectors.
+     * @param labels The cluster index per feature vector.
+     * @param n_clusters The number of clusters.
+     * @param[out] o_cluster_means The row-wise cluster means. Empty clusters get a zero mean.
+     */
+    template< typename T>
+    inline void compute_cluster_means( const Mat1r& features, const vector<T>& labels, const int n_clusters, Mat1r& o_cluster_means) {
+        compute_cluster_means( features, features.rows, features.cols, labels, n_clusters, o_cluster_means);
+    }
+
+
+    /** Computes the mean of the dequantized feature vectors of every cluster.
+     * @param features The row-wise quantized feature vectors.
+     * @param labels The cluster index per feature vector.
+     * @param n_clusters The number of clusters.
+     * @param[out] o_cluster_means The row-wise cluster means. Empty clusters get a zero mean.
+     */
+    template< typename T>
+    inline void compute_cluster_means( const QuantizedMat& features, const vector<T>& labels, const int n_clusters, Mat1r& o_cluster_means) {
+        compute_cluster_means( features, features.rows(), features.cols(), labels, n_clusters, o_cluster_means);
+    }
+}
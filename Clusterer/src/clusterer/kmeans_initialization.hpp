@@ -0,0 +1,260 @@
+/******************************************************************************
+/* @file Center initializations shared by the k means clusterers.
+/*
+/* @author langenhagen
+/* @version 150704
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "assignment.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /// Possible center initializations wrapping namespace.
+    namespace center_initialization {
+        /// Possible center initializations.
+        enum center_initialization {
+            RANDOM          = 0,    ///< distinct random feature vectors
+            KMEANS_PARALLEL = 1     ///< k-means||, oversampled parallel seeding
+        };
+    }
+
+
+    /** Maps a feature vector index and a seed to a uniformly distributed number in [0,1[.
+     * Gives the same number regardless of which thread asks for it.
+     * @param seed A seed.
+     * @param index The index of the feature vector.
+     * @return A pseudo random number in [0,1[.
+     */
+    inline double uniform_hash( const uint64_t seed, const uint64_t index) {
+        uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL; // splitmix64
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        return (z >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+
+    /** Picks distinct random feature vectors as centers.
+     * @param features The row-wise feature vectors.
+     * @param n_clusters The number of centers. Must not exceed the number of feature vectors.
+     * @param rng The random number generator.
+     * @param[out] o_centers The row-wise centers.
+     */
+    inline void init_centers_randomly( const Mat1r& features, const int n_clusters, cv::RNG& rng, Mat1r& o_centers) {
+        vector<int> indices( features.rows);
+        for( int i=0; i<features.rows; ++i)
+            indices[i] = i;
+
+        o_centers.create( n_clusters, features.cols);
+        for( int c=0; c<n_clusters; ++c) {
+            std::swap( indices[c], indices[c + rng.uniform( 0, features.rows - c)]);
+            features.row( indices[c]).copyTo( o_centers.row(c));
+        }
+    }
+
+
+    /** @brief Samples every feature vector independently with a probability proportional to
+     * its squared distance to the nearest center so far.
+     */
+    class OversamplingRound : public cv::ParallelLoopBody {
+
+    private: // vars
+
+        const Vec1r& _squared_distances;    ///< The squared distance of every feature vector to its nearest center.
+        const double _scale;                ///< Oversampling factor divided by the sum of the squared distances.
+        const uint64_t _seed;               ///< The seed of the round.
+        vector<uchar>& _is_sampled;         ///< Output: whether a feature vector was sampled.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param squared_distances The squared distance of every feature vector to its nearest center.
+         * @param scale Oversampling factor divided by the sum of the squared distances.
+         * @param seed The seed of the round.
+         * @param[out] o_is_sampled Whether a feature vector was sampled.
+         */
+        OversamplingRound( const Vec1r& squared_distances, const double scale, const uint64_t seed, vector<uchar>& o_is_sampled)
+            : _squared_distances(squared_distances), _scale(scale), _seed(seed), _is_sampled(o_is_sampled)
+        {}
+
+    public: // methods
+
+        /** Samples the feature vectors in the given range.
+         * @param range A range of feature vector indices.
+         */
+        virtual void operator()( const cv::Range& range) const {
+            for( int i=range.start; i<range.end; ++i)
+                _is_sampled[i] = uniform_hash( _seed, i) < _scale * _squared_distances[i];
+        }
+
+    private: // helpers
+
+        /// Not assignable.
+        OversamplingRound& operator=( const OversamplingRound&);
+    };
+
+
+    /** Runs k means++ on weighted points, followed by a few weighted Lloyd iterations.
+     * @param points The row-wise points.
+     * @param weights The weight of every point.
+     * @param n_clusters The number of centers. Must not exceed the number of points.
+     * @param rng The random number generator.
+     * @param[out] o_centers The row-wise centers.
+     */
+    inline void weighted_kmeans_plus_plus( const Mat1r& points, const Vec1r& weights, const int n_clusters, cv::RNG& rng, Mat1r& o_centers) {
+        const int n_lloyd_iterations = 10;
+        const int n = points.rows;
+        o_centers.create( n_clusters, points.cols);
+
+        // weighted sampling with probability weight * squared distance to the nearest center
+        vector<double> squared_distances( n, 1.0);
+        Vec1r center_distances( n);
+        for( int c=0; c<n_clusters; ++c) {
+            double sum = 0;
+            for( int i=0; i<n; ++i)
+                sum += weights[i] * squared_distances[i];
+
+            int chosen = 0;
+            if( sum > 0) {
+                double threshold = rng.uniform( 0.0, sum);
+                for( chosen=0; chosen<n-1; ++chosen) {
+                    threshold -= weights[chosen] * squared_distances[chosen];
+                    if( threshold < 0)
+                        break;
+                }
+            } else {
+                chosen = rng.uniform( 0, n);
+            }
+            points.row( chosen).copyTo( o_centers.row(c));
+
+            distances::one_to_many( distances::metric::SQUARED_L2, o_centers[c], points[0], n, points.step1(), points.cols, &center_distances[0]);
+            for( int i=0; i<n; ++i)
+                squared_distances[i] = c == 0 ? center_distances[i] : std::min( squared_distances[i], static_cast<double>(center_distances[i]));
+        }
+
+        // weighted lloyd iterations on the points
+        vector<int> labels;
+        for( int it=0; it<n_lloyd_iterations; ++it) {
+            assign_to_nearest_centers( points, o_centers, labels);
+            cv::Mat1d sums = cv::Mat1d::zeros( n_clusters, points.cols);
+            vector<double> cluster_weights( n_clusters, 0.0);
+            for( int i=0; i<n; ++i) {
+                double* sum = sums[labels[i]];
+                const real* point = points[i];
+                for( int d=0; d<points.cols; ++d)
+                    sum[d] += weights[i] * point[d];
+                cluster_weights[labels[i]] += weights[i];
+            }
+            for( int c=0; c<n_clusters; ++c)
+                if( cluster_weights[c] > 0)
+                    sums.row(c).convertTo( o_centers.row(c), CV_32F, 1.0 / cluster_weights[c]);
+        }
+    }
+
+
+    /** Initializes the centers with k-means||.
+     * Starts with one random center and, in a few rounds, samples about oversampling * n_clusters
+     * feature vectors per round in parallel, each with a probability proportional to its squared
+     * distance to the nearest center so far. The candidates are weighted by the number of feature
+     * vectors closest to them and reduced to n_clusters centers with weighted k means++.
+     * @see B. Bahmani et al.: Scalable K-Means++. VLDB 2012.
+     * @param features The row-wise feature vectors.
+     * @param n_clusters The number of centers. Must not exceed the number of feature vectors.
+     * @param rng The random number generator.
+     * @param[out] o_centers The row-wise centers.
+     * @param n_rounds The number of oversampling rounds.
+     * @param oversampling The expected number of samples per round relative to n_clusters.
+     */
+    inline void init_centers_kmeans_parallel( const Mat1r& features,
+                                              const int n_clusters,
+                                              cv::RNG& rng,
+                                              Mat1r& o_centers,
+                                              const int n_rounds = 5,
+                                              const real oversampling = 2) {
+        const int n = features.rows;
+        vector<uchar> is_candidate( n, 0);
+        Mat1r candidates;
+        const int first = rng.uniform( 0, n);
+        candidates.push_back( features.row( first));
+        is_candidate[first] = 1;
+
+        vector<int> labels;
+        Vec1r squared_distances;
+        Vec1r new_squared_distances;
+        assign_to_nearest_centers( features, candidates, labels, &squared_distances);
+
+        vector<uchar> is_sampled( n);
+        for( int round=0; round<n_rounds; ++round) {
+            double sum = 0;
+            for( int i=0; i<n; ++i)
+                sum += squared_distances[i];
+            if( sum <= 0)
+                break;
+
+            cv::parallel_for_( cv::Range( 0, n), OversamplingRound( squared_distances, oversampling * n_clusters / sum, rng.next(), is_sampled));
+            Mat1r new_candidates;
+            for( int i=0; i<n; ++i) {
+                if( is_sampled[i]) {
+                    new_candidates.push_back( features.row(i));
+                    is_candidate[i] = 1;
+                }
+            }
+            if( new_candidates.empty())
+                continue;
+
+            assign_to_nearest_centers( features, new_candidates, labels, &new_squared_distances);
+            for( int i=0; i<n; ++i)
+                squared_distances[i] = std::min( squared_distances[i], new_squared_distances[i]);
+            candidates.push_back( new_candidates);
+        }
+
+        if( candidates.rows <= n_clusters) {
+            // too few candidates, fill up with distinct random feature vectors that are no candidates yet
+            candidates.copyTo( o_centers);
+            vector<int> others;
+            others.reserve( n - candidates.rows);
+            for( int i=0; i<n; ++i)
+                if( !is_candidate[i])
+                    others.push_back( i);
+            for( int i=0; o_centers.rows < n_clusters; ++i) {
+                std::swap( others[i], others[i + rng.uniform( 0, static_cast<int>(others.size()) - i)]);
+                o_centers.push_back( features.row( others[i]));
+            }
+            return;
+        }
+
+        // weight the candidates by the number of feature vectors closest to them
+        assign_to_nearest_centers( features, candidates, labels);
+        Vec1r weights( candidates.rows, real(0));
+        for( int i=0; i<n; ++i)
+            weights[labels[i]] += 1;
+
+        weighted_kmeans_plus_plus( candidates, weights, n_clusters, rng, o_centers);
+    }
+
+
+    /** Initializes the centers with the given method.
+     * @param features The row-wise feature vectors.
+     * @param n_clusters The number of centers. Must not exceed the number of feature vectors.
+     * @param method The initialization method.
+     * @param rng The random number generator.
+     * @param[out] o_centers The row-wise centers.
+     */
+    inline void init_centers( const Mat1r& features,
+                              const int n_clusters,
+                              const center_initialization::center_initialization method,
+                              cv::RNG& rng,
+                              Mat1r& o_centers) {
+        if( method == center_initialization::KMEANS_PARALLEL)
+            init_centers_kmeans_parallel( features, n_clusters, rng, o_centers);
+        else
+            init_centers_randomly( features, n_clusters, rng, o_centers);
+    }
+}
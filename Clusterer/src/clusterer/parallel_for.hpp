@@ -0,0 +1,57 @@
+/******************************************************************************
+/* @file Runs the parallel loops of the STL-only clustering modules,
+/*       e.g. OPTICS and HDBSCAN, with cv::parallel_for_.
+/*
+/* @author langenhagen
+/* @version 150714
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include <common.hpp>
+#include "OPTICS/poptics.hpp" // OPTICS::RangeBody, OPTICS::ParallelFor
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /// Runs a loop body on the ranges that cv::parallel_for_ hands out.
+    class ParallelRangeBody : public cv::ParallelLoopBody {
+
+        const OPTICS::RangeBody& _body; ///< The loop body.
+
+    public:
+
+        /** Main constructor.
+         * @param body The loop body. Must outlive the object.
+         */
+        ParallelRangeBody( const OPTICS::RangeBody& body)
+            : _body( body)
+        {}
+
+        /** Runs the loop body on the given range.
+         * @param range A range of indices.
+         */
+        virtual void operator()( const cv::Range& range) const {
+            _body( range.start, range.end);
+        }
+
+    private:
+        /// Not assignable.
+        ParallelRangeBody& operator=( const ParallelRangeBody&);
+    };
+
+
+    /** Runs a loop body with cv::parallel_for_.
+     * @param n The number of indices.
+     * @param body The loop body.
+     * @see OPTICS::ParallelFor
+     */
+    inline void parallel_for( const std::size_t n, const OPTICS::RangeBody& body) {
+        cv::parallel_for_( cv::Range( 0, static_cast<int>(n)), ParallelRangeBody( body));
+    }
+
+}
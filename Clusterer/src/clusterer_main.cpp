@@ -10,7 +10,11 @@
 
 #include <program_options.hpp>
 #include <input_request.hpp>
+#include <clusterer/ExactKMeansClusterer.hpp>
+#include <clusterer/HDBSCANClusterer.hpp>
+#include <clusterer/IsolationForestClusterer.hpp>
 #include <clusterer/KMeansClusterer.hpp>
+#include <clusterer/MiniBatchKMeansClusterer.hpp>
 #include <clusterer/OutlierClusterer.hpp>
 #include <clusterer/OPTICSClusterer.hpp>
 
@@ -66,25 +70,40 @@ int main(int argc, const char* argv[]) {
     create_directories( params.output_directory);
     
     
-    LOG(info) << "Loading feature vectors...";
     Mat1r features;
-    exit_if_false( from_file( params.features_file, features), RETURN_CODE::IO_ERROR);
+    QuantizedMat quantized_features;
+    const bool use_quantized_features = is_quantized_file( params.features_file);
+    if( use_quantized_features) {
+        LOG(info) << "Loading quantized feature vectors...";
+        exit_if_false( from_file( params.features_file, quantized_features), RETURN_CODE::IO_ERROR);
+    } else {
+        LOG(info) << "Loading feature vectors...";
+        exit_if_false( from_file( params.features_file, features), RETURN_CODE::IO_ERROR);
+    }
+    const int n_features = use_quantized_features ? quantized_features.rows() : features.rows;
+    const int n_dimensions = use_quantized_features ? quantized_features.cols() : features.cols;
+
     LOG(info) << "Loading image filenames...";
     Vec1str img_fnames;
     exit_if_false( from_file( params.images_file, img_fnames), RETURN_CODE::IO_ERROR);
-    if( features.rows !=  img_fnames.size()) {
-        LOG(error) << "The number of features (" << features.rows << ") does not match the number of image filenames (" << img_fnames.size() << ").";
+    if( n_features !=  img_fnames.size()) {
+        LOG(error) << "The number of features (" << n_features << ") does not match the number of image filenames (" << img_fnames.size() << ").";
     }
 
     // *** all clear up to here... features matrix created and valid ***
     
-    LOG(info) << "Clustering " << features.rows << " feature vectors with " << features.cols << " dimensions each...";
+    LOG(info) << "Clustering " << n_features << " feature vectors with " << n_dimensions << " dimensions each...";
+    if( !distances::check_kernels()) {
+        LOG(warn) << "The SIMD distance kernels deviate from the scalar ones. Falling back to the scalar kernels.";
+        distances::select_level( distances::simd_level::SCALAR);
+    }
+    LOG(info) << "Using the " << distances::level_name( distances::active_kernels().level) << " distance kernels.";
     Clusterer* clusterer = create_clusterer( params.cd);
 
     chrono::steady_clock::time_point timer_start = chrono::steady_clock::now();
     
-    const Mat1r membership_probabilities = clusterer->cluster( features);
-    assert( features.rows == membership_probabilities.rows && "Clusterer must assign probabilities to all input features");
+    const Mat1r membership_probabilities = use_quantized_features ? clusterer->cluster( quantized_features) : clusterer->cluster( features);
+    assert( n_features == membership_probabilities.rows && "Clusterer must assign probabilities to all input features");
 
     const timespan duration = chrono::round<timespan>(chrono::steady_clock::now() - timer_start);
     LOG(info) << "Clustering finished. Took " << duration << ".";
@@ -102,27 +121,25 @@ int main(int argc, const char* argv[]) {
     
     LOG(info) << "Writing membership probabilities to \"" << params.membership_probabilities_file << "\"...";
     to_file( params.membership_probabilities_file, membership_probabilities);
+    if( params.write_binary_sidecars)
+        to_binary_file( params.membership_probabilities_file + ".bin", membership_probabilities);
     
     LOG(info) << "Writing cluster membership mappings to \"" << params.membership_mappings_file << "\"...";
     to_file( params.membership_mappings_file, membership_mappings);
     
 
     LOG(info) << "Calculating cluster means...";
-    Mat1r cluster_means = Mat1r::zeros( n_clusters, features.cols);
-    vector<uint> n_elems_per_cluster( n_clusters, 0);
-    for( int i=0; i<features.rows; ++i) {
-        
-        const uint c = membership_mappings[i];
-        cluster_means.row(c) += features.row(i);
-        n_elems_per_cluster[c] += 1;
-    }
-    for( uint i=0; i<n_clusters; ++i) {
-        cluster_means.row(i) /= n_elems_per_cluster[i];
-    }
+    Mat1r cluster_means;
+    if( use_quantized_features)
+        compute_cluster_means( quantized_features, membership_mappings, n_clusters, cluster_means);
+    else
+        compute_cluster_means( features, membership_mappings, n_clusters, cluster_means);
 
 
     LOG(info) << "Writing Cluster means to \"" << params.cluster_means_file << "\"...";
     to_file( params.cluster_means_file, cluster_means);
+    if( params.write_binary_sidecars)
+        to_binary_file( params.cluster_means_file + ".bin", cluster_means);
     
     LOG(info) << "Writing clusters to files...";
     const vector<Vec1str> segmented_img_fnames = 
@@ -178,6 +195,18 @@ Clusterer* create_clusterer( clusterer_description& description) {
     case clusterer_type::OPTICS:
         ret = new OPTICSClusterer( description);
         break;
+    case clusterer_type::MINIBATCH_KMEANS:
+        ret = new MiniBatchKMeansClusterer( description);
+        break;
+    case clusterer_type::EXACT_KMEANS:
+        ret = new ExactKMeansClusterer( description);
+        break;
+    case clusterer_type::HDBSCAN:
+        ret = new HDBSCANClusterer( description);
+        break;
+    case clusterer_type::ISOLATION_FOREST:
+        ret = new IsolationForestClusterer( description);
+        break;
     default:
         LOG(error) << "Unsupported clusterer_type: " << description.type << " aka " << description.type_string << ".";
     }
@@ -29,7 +29,11 @@ namespace app {
             ERROR_TYPE,
             FLANNKMEANS,
             OUTLIER,
-            OPTICS
+            OPTICS,
+            MINIBATCH_KMEANS,
+            EXACT_KMEANS,
+            HDBSCAN,
+            ISOLATION_FOREST
         };
     }
     
@@ -51,6 +55,14 @@ namespace app {
             ret = clusterer_type::OUTLIER;
         else if( t.compare("optics") == 0)
             ret = clusterer_type::OPTICS;
+        else if( t.compare("minibatch_kmeans") == 0)
+            ret = clusterer_type::MINIBATCH_KMEANS;
+        else if( t.compare("exact_kmeans") == 0)
+            ret = clusterer_type::EXACT_KMEANS;
+        else if( t.compare("hdbscan") == 0)
+            ret = clusterer_type::HDBSCAN;
+        else if( t.compare("isolation_forest") == 0)
+            ret = clusterer_type::ISOLATION_FOREST;
         else {
             LOG( error) << FILE_LINE << "Given string \"" << type << "\" is not a supported clusterer type.";
         }
@@ -63,7 +75,7 @@ namespace app {
      * @return a string with the supported clusterer types.
      */
     inline string clusterer_types_string() {
-        return "FLANNKMEANS, OUTLIER, OPTICS";        
+        return "FLANNKMEANS, OUTLIER, OPTICS, MINIBATCH_KMEANS, EXACT_KMEANS, HDBSCAN, ISOLATION_FOREST";        
     }
 
 
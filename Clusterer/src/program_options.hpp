@@ -35,6 +35,15 @@ namespace app {
 
         string tweak_vector_string;
         Vec1r tweak_vector; ///< not further specified, may be used by the concrete clusterer implementations.
+
+        string model_file;  ///< if not empty, a file in which the concrete clusterer implementations may persist their model.
+
+        string distance_cache_directory;    ///< if not empty, a directory in which the concrete clusterer implementations may cache the pairwise distances of the features.
+        uint distance_cache_neighbors;      ///< the number of nearest neighbors per feature that the distance cache stores if the full distance matrix is too large.
+
+        real ann_recall;                    ///< if greater than 0, the concrete clusterer implementations may search nearest neighbors approximately with this targeted recall el. ]0,1].
+        uint ann_graph_neighbors;           ///< the number of neighbors per feature of the approximate nearest neighbor graph.
+        string ann_graph_file;              ///< if not empty, a file in which the approximate nearest neighbor graph is persisted across runs.
     };
 
 
@@ -52,6 +61,7 @@ namespace app {
         string membership_probabilities_file;
         string membership_mappings_file;
         string cluster_means_file;
+        bool write_binary_sidecars;
         string result_file_prefix;
         string result_fnames_file;
         bool symlink_results;
@@ -74,9 +84,16 @@ namespace app {
         LOG(info) << "\"path to images\"-file: " << p.images_file;
         LOG(info) << "Clusterer type: " << p.cd.type << " aka " << p.cd.type_string;
         LOG(info) << "Clusterer tweak vector: [" << to_string<real,vector>( p.cd.tweak_vector) << "]";
+        LOG(info) << "Clusterer model file: " << p.cd.model_file;
+        LOG(info) << "Distance cache directory: " << p.cd.distance_cache_directory;
+        LOG(info) << "Distance cache neighbors: " << p.cd.distance_cache_neighbors;
+        LOG(info) << "Approximate nearest neighbor search recall: " << p.cd.ann_recall;
+        LOG(info) << "Approximate nearest neighbor graph neighbors: " << p.cd.ann_graph_neighbors;
+        LOG(info) << "Approximate nearest neighbor graph file: " << p.cd.ann_graph_file;
         LOG(info) << "Membership probabilities file: " << p.membership_probabilities_file;
         LOG(info) << "Membership mappings file: " << p.membership_mappings_file;
         LOG(info) << "Cluster means file: " << p.cluster_means_file;
+        LOG(info) << "Write binary sidecar files: " << yes_no( p.write_binary_sidecars);
         LOG(info) << "Result file prefix: " << p.result_file_prefix;
         LOG(info) << "Result file paths file: " << p.result_fnames_file;
         LOG(info) << "Symlink results: " << yes_no( p.symlink_results);
@@ -118,6 +135,15 @@ namespace app {
 
         p.cd.tweak_vector = from_string<real,vector>( p.cd.tweak_vector_string);
 
+        if( p.cd.ann_recall > 1) {
+            LOG(warn) << "The approximate nearest neighbor search recall must be el. [0,1]. Setting it to 1.";
+            p.cd.ann_recall = 1;
+        }
+        if( p.cd.ann_recall > 0 && p.cd.ann_graph_neighbors == 0) {
+            LOG(warn) << "The approximate nearest neighbor graph needs at least one neighbor per feature. Setting it to 16.";
+            p.cd.ann_graph_neighbors = 16;
+        }
+
         if(ret==false) {
             LOG( error) << "Not correctable error in program options!";
         }
@@ -153,10 +179,17 @@ namespace app {
             ("images_file", value<string>(&p.images_file), "a file that stores the paths of the images")
             ("clusterer_type", value<string>(&p.cd.type_string), clusterer_types_string().c_str())
             ("clusterer_tweak_vector", value<string>(&p.cd.tweak_vector_string)->default_value(""), "real-numeric tweaks for the feature extractor separated by spaces \" \".")
+            ("clusterer_model_file", value<string>(&p.cd.model_file)->default_value(""), "a file in which the clusterer persists its model for later runs, e.g. the k means tree or the OPTICS cluster ordering. Empty for none.")
+            ("distance_cache_directory", value<string>(&p.cd.distance_cache_directory)->default_value(""), "a directory in which density based clusterers cache the pairwise distances of the features across runs, e.g. OPTICS and the outlier clusterer. Empty for none.")
+            ("distance_cache_neighbors", value<uint>(&p.cd.distance_cache_neighbors)->default_value(64), "the number of nearest neighbors per feature that the distance cache stores if the full distance matrix would be too large")
+            ("ann_recall", value<real>(&p.cd.ann_recall)->default_value(0), "if greater than 0, the targeted recall el. ]0,1] with which clusterers that support it, e.g. the outlier clusterer, search nearest neighbors approximately on a k-nearest-neighbor graph. 0 for exact search.")
+            ("ann_graph_neighbors", value<uint>(&p.cd.ann_graph_neighbors)->default_value(16), "the number of neighbors per feature of the approximate nearest neighbor graph. More neighbors raise the recall and the build time")
+            ("ann_graph_file", value<string>(&p.cd.ann_graph_file)->default_value(""), "a file in which the approximate nearest neighbor graph is persisted and reused by later runs on the same features. Empty for none.")
             ("output_directory", value<string>(&p.output_directory)->default_value("out"), "the output directory for output-files")
             ("membership_probabilities_file", value<string>(&p.membership_probabilities_file)->default_value("membership_probabilities.txt"), "Stores the probabilities of each feature to belong to each cluster")
             ("membership_mappings_file", value<string>(&p.membership_mappings_file)->default_value("membership_mappings.txt"), "Stores the index of the cluster with the highest membership-probability for each feature")
             ("cluster_means_file", value<string>(&p.cluster_means_file)->default_value("cluster_means.txt"), "Stores the centers of each cluster in this file")
+            ("write_binary_sidecars", value<bool>(&p.write_binary_sidecars)->default_value(0), "whether or not to additionally write the membership probabilities and the cluster means as binary .bin files")
             ("result_file_prefix", value<string>(&p.result_file_prefix)->default_value("class_"), "the prefix of the files that contain the classification results")
             ("result_filenames_file", value<string>(&p.result_fnames_file)->default_value("class_files"), "the file that stores the paths to all result files")
             ("symlink_results", value<bool>(&p.symlink_results)->default_value(0), "whether or not to symlink the images into folders named after their classes")
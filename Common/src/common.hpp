@@ -12,6 +12,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 // INCLUDES project headers
 
+#include <distances.hpp>
 #include <logging.hpp>
 #include <Gaussian.hpp>
 #include <return_error_code.hpp>
@@ -20,7 +21,12 @@
 //INCLUDES C/C++ standard library (and other external libraries)
 
 #include <algorithm>
+#include <clocale>
+#include <cmath>
 #include <conio.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <ostream>
@@ -29,6 +35,8 @@
 
 #include <boost/chrono.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/opencv.hpp>
@@ -55,6 +63,7 @@
 /// EXIT macro.
 #define EXIT(return_value)              \
     LOG(info) << "*** Program end ***"; \
+    logging::flush_log();               \
     CONSOLE_EXIT(return_value)
 
 
@@ -118,7 +127,7 @@ namespace app {
     
     //typedef unsigned char uchar;                    ///< Unsigned char.
     typedef unsigned int uint;                      ///< Unsigned int.
-    typedef float real;                             ///< The floating point value. Change at will.
+    typedef distances::real real;                   ///< The floating point value. Single precision, like the distance kernels.
     typedef boost::chrono::milliseconds timespan;   ///< The time granularity to which to round performance counters. Change at will.
     typedef std::vector<real> Vec1r;                ///< A vector of real-values.
     typedef std::vector<uint> Vec1UInt;             ///< A vector of unsigned integer values.
@@ -289,8 +298,234 @@ namespace app {
     }
 
 
+    /** Parses a decimal floating point number independently of the current C locale.
+     * Accepts an optional sign, digits with an optional decimal point and an optional exponent.
+     * The result is correctly rounded for up to 15 significant digits and exponents within [-22..22],
+     * and within a few ulp otherwise, which is still exact after conversion to float.
+     * @param[in,out] p The position in the buffer where the number begins.
+     *        Will be set behind the number in case of success.
+     * @param end The end of the buffer.
+     * @param[out] o_value The parsed number.
+     * @return TRUE if a number was parsed, FALSE otherwise.
+     */
+    inline bool parse_decimal( const char*& p, const char* const end, double& o_value) {
+        static const double powers_of_ten[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                                1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                                1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        const char* c = p;
+        bool negative = false;
+        if( c != end && (*c == '-' || *c == '+'))
+            negative = *c++ == '-';
+
+        uint64_t mantissa = 0;
+        int n_significant_digits = 0;
+        int exponent = 0;
+        bool has_digits = false;
+
+        for( ; c != end && *c >= '0' && *c <= '9'; ++c) {
+            has_digits = true;
+            if( n_significant_digits < 19) {
+                mantissa = mantissa * 10 + (*c - '0');
+                n_significant_digits += mantissa != 0;
+            } else {
+                ++exponent; // digit beyond the mantissa's precision
+            }
+        }
+        if( c != end && *c == '.') {
+            for( ++c; c != end && *c >= '0' && *c <= '9'; ++c) {
+                has_digits = true;
+                if( n_significant_digits < 19) {
+                    mantissa = mantissa * 10 + (*c - '0');
+                    n_significant_digits += mantissa != 0;
+                    --exponent;
+                }
+            }
+        }
+        if( !has_digits)
+            return false;
+
+        if( c != end && (*c == 'e' || *c == 'E')) {
+            const char* e = c + 1;
+            bool negative_exponent = false;
+            if( e != end && (*e == '-' || *e == '+'))
+                negative_exponent = *e++ == '-';
+            if( e == end || *e < '0' || *e > '9')
+                return false;
+            int explicit_exponent = 0;
+            for( ; e != end && *e >= '0' && *e <= '9'; ++e)
+                if( explicit_exponent < 100000)
+                    explicit_exponent = explicit_exponent * 10 + (*e - '0');
+            exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+            c = e;
+        }
+
+        double value = static_cast<double>(mantissa);
+        if( mantissa == 0) {
+            value = 0;
+        } else if( mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+            // exact operands, thus correctly rounded
+            value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+        } else {
+            value *= std::pow( 10.0, exponent);
+        }
+        o_value = negative ? -value : value;
+        p = c;
+        return true;
+    }
+
+
+    /** Checks whether a character separates the entries of a line in a plain matrix file.
+     * @param c A character.
+     * @return TRUE if the character is a blank, a tab or a carriage return.
+     */
+    inline bool is_matrix_entry_delimeter( const char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+
+    /** Parses one line of a plain matrix file.
+     * @param begin The beginning of the line.
+     * @param end The end of the line, without the newline character.
+     * @param[out] o_row Buffer for n_cols elements or nullptr if the entries are only to be counted.
+     * @param n_cols The expected number of entries.
+     * @return The number of entries in the line, or -1 if the line is malformed.
+     *         If o_row is given, a line with more than n_cols entries is reported as malformed.
+     */
+    template< typename T>
+    int parse_matrix_line( const char* begin, const char* const end, T* o_row, const int n_cols) {
+        int n = 0;
+        const char* p = begin;
+        for(;;) {
+            while( p != end && is_matrix_entry_delimeter( *p))
+                ++p;
+            if( p == end)
+                break;
+            double value;
+            if( !parse_decimal( p, end, value) || p != end && !is_matrix_entry_delimeter( *p))
+                return -1;
+            if( o_row != nullptr) {
+                if( n == n_cols)
+                    return -1;
+                o_row[n] = cv::saturate_cast<T>( value);
+            }
+            ++n;
+        }
+        return n;
+    }
+
+
+    /** Appends the representation of a value to a string buffer.
+     * Fallback for all types without a faster overload; uses the stream out operator.
+     * @param[in,out] buffer The buffer.
+     * @param value The value.
+     */
+    template< typename T>
+    inline void append_formatted( std::string& buffer, const T& value) {
+        std::ostringstream ss;
+        ss << value;
+        buffer += ss.str();
+    }
+
+
+    /** Appends a string to a string buffer.
+     * @param[in,out] buffer The buffer.
+     * @param value The string.
+     */
+    inline void append_formatted( std::string& buffer, const std::string& value) {
+        buffer += value;
+    }
+
+
+    /** Appends the decimal representation of an integer to a string buffer.
+     * @param[in,out] buffer The buffer.
+     * @param magnitude The absolute value of the integer.
+     * @param negative Whether the integer is negative.
+     */
+    inline void append_integer( std::string& buffer, uint64_t magnitude, const bool negative) {
+        char str[24];
+        char* p = str + sizeof(str);
+        do {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while( magnitude != 0);
+        if( negative)
+            *--p = '-';
+        buffer.append( p, str + sizeof(str));
+    }
+
+    /// @see append_integer()
+    inline void append_formatted( std::string& buffer, const int value) {
+        append_integer( buffer, value < 0 ? 0 - static_cast<uint64_t>(value) : value, value < 0);
+    }
+
+    /// @see append_integer()
+    inline void append_formatted( std::string& buffer, const unsigned int value) {
+        append_integer( buffer, value, false);
+    }
+
+    /// @see append_integer()
+    inline void append_formatted( std::string& buffer, const long long value) {
+        append_integer( buffer, value < 0 ? 0 - static_cast<uint64_t>(value) : value, value < 0);
+    }
+
+    /// @see append_integer()
+    inline void append_formatted( std::string& buffer, const unsigned long long value) {
+        append_integer( buffer, value, false);
+    }
+
+
+    /** Appends the shortest decimal representation of a floating point number
+     * that parses back to the same number to a string buffer.
+     * Always uses '.' as the decimal point, independent of the C locale.
+     * @param[in,out] buffer The buffer.
+     * @param value The number.
+     * @param min_precision The number of significant digits to start with.
+     * @param max_precision The number of significant digits that always suffices to restore the number.
+     */
+    template< typename F>
+    inline void append_shortest( std::string& buffer, const F value, const int min_precision, const int max_precision) {
+        const char decimal_point = *std::localeconv()->decimal_point;
+        char str[32];
+        for( int precision=min_precision; precision<=max_precision; ++precision) {
+            const int length = std::sprintf( str, "%.*g", precision, static_cast<double>(value));
+            if( decimal_point != '.')
+                std::replace( str, str + length, decimal_point, '.');
+
+            const char* p = str;
+            double parsed;
+            if( precision == max_precision || parse_decimal( p, str + length, parsed) && static_cast<F>(parsed) == value) {
+                buffer.append( str, length);
+                break;
+            }
+        }
+    }
+
+    /// @see append_shortest()
+    inline void append_formatted( std::string& buffer, const float value) {
+        append_shortest( buffer, value, 6, 9);
+    }
+
+    /// @see append_shortest()
+    inline void append_formatted( std::string& buffer, const double value) {
+        append_shortest( buffer, value, 15, 17);
+    }
+
+
+    /** Writes a string buffer to a stream.
+     * @param fstream The stream.
+     * @param buffer The buffer.
+     * @return TRUE in case of success, FALSE if the stream went bad.
+     */
+    inline bool write_buffer( std::ofstream& fstream, const std::string& buffer) {
+        fstream.write( buffer.data(), buffer.size());
+        return !fstream.bad();
+    }
+
+
     /** Convenience function that writes the contents of a container to a specified file.
      * Truncates all old entries in that given file. 
+     * The entries are formatted into a buffer that is written in large blocks,
+     * numbers with their shortest representation that restores their exact value.
      * Also does error handling via callbacks.
      * @param fname The name of the file to be written to.
      * @param container The stl-compliant container to be written to file.
@@ -308,31 +543,100 @@ namespace app {
                   const std::string& delimeter = "\n",
                   std::function< void(const std::string&) > error_open_callback = on_open_file_error,
                   std::function< void(const std::string&) > error_write_callback = on_write_file_error) {
+        const size_t buffer_size = 1 << 20;
         bool ret(true);
         std::ofstream fstream( fname, std::ios::out | std::ios::trunc);
         if(!fstream.is_open() || fstream.bad()) {
             error_open_callback(fname);
             ret = false;
         } else {
-            for( auto it=container.begin(); it!=container.end(); ++it) {
-                fstream << *it;
+            std::string buffer;
+            buffer.reserve( buffer_size + 256);
+            for( auto it=container.begin(); it!=container.end() && ret; ++it) {
+                append_formatted( buffer, *it);
                 if( std::next(it) != container.end())
-                        fstream << delimeter;
+                    buffer += delimeter;
 
-                if( fstream.bad()) {
-                    error_write_callback(fname);
-                    ret = false;
-                    break;
+                if( buffer.size() >= buffer_size) {
+                    ret = write_buffer( fstream, buffer);
+                    buffer.clear();
                 }
             }
+            if( ret)
+                ret = write_buffer( fstream, buffer);
+            if( !ret)
+                error_write_callback(fname);
         }
         return ret;
     }
 
 
+    /** @brief Formats chunks of consecutive matrix rows into string buffers.
+     */
+    template< class mat_type >
+    class MatrixRowFormatter : public cv::ParallelLoopBody {
+
+    private: // vars
+
+        const mat_type& _mat;                   ///< The matrix.
+        const int _first_row;                   ///< The first row of the first chunk.
+        const int _rows_per_chunk;              ///< The number of rows per chunk.
+        const std::string& _row_delimeter;      ///< The delimeter between each row.
+        const std::string& _col_delimeter;      ///< The delimeter between each column.
+        std::vector<std::string>& _chunks;      ///< The formatted chunks.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param mat The matrix.
+         * @param first_row The first row of the first chunk.
+         * @param rows_per_chunk The number of rows per chunk.
+         * @param row_delimeter The delimeter between each row.
+         * @param col_delimeter The delimeter between each column.
+         * @param[out] o_chunks The formatted chunks, one buffer per chunk.
+         */
+        MatrixRowFormatter( const mat_type& mat, const int first_row, const int rows_per_chunk,
+                            const std::string& row_delimeter, const std::string& col_delimeter,
+                            std::vector<std::string>& o_chunks)
+            : _mat(mat), _first_row(first_row), _rows_per_chunk(rows_per_chunk),
+            _row_delimeter(row_delimeter), _col_delimeter(col_delimeter), _chunks(o_chunks)
+        {}
+
+    public: // methods
+
+        /** Formats the chunks in the given range.
+         * @param range A range of chunk indices.
+         */
+        virtual void operator()( const cv::Range& range) const {
+            for( int i=range.start; i<range.end; ++i) {
+                std::string& chunk = _chunks[i];
+                chunk.clear();
+                const int begin = _first_row + i * _rows_per_chunk;
+                const int end = std::min( begin + _rows_per_chunk, _mat.rows);
+                for( int r=begin; r<end; ++r) {
+                    for( int c=0; c<_mat.cols; ++c) {
+                        append_formatted( chunk, _mat(r,c));
+                        if( c < _mat.cols-1)
+                            chunk += _col_delimeter;
+                    }
+                    if( r < _mat.rows-1)
+                        chunk += _row_delimeter;
+                }
+            }
+        }
+
+    private: // helpers
+
+        /// Not assignable.
+        MatrixRowFormatter& operator=( const MatrixRowFormatter&);
+    };
+
+
     /** Convenience function that writes the contents of a Mat_ to a specified file.
      * It writes the plain matrix to the file. For more complex data formats consider cv::FileStorage.
      * Truncates all old entries in that given file. 
+     * Chunks of rows are formatted in parallel, numbers with their shortest representation
+     * that restores their exact value, and written in file order.
      * Also does error handling via callbacks.
      * @param fname The name of the file to be written to.
      * @param mat The Mat_ that is to be written to file.
@@ -352,38 +656,119 @@ namespace app {
                   const std::string& col_delimeter = " ",
                   std::function< void(const std::string&) > error_open_callback = on_open_file_error,
                   std::function< void(const std::string&) > error_write_callback = on_write_file_error) {
+        const int rows_per_chunk = 1024;
+        const int chunks_per_batch = 64;
         bool ret(true);
         std::ofstream fstream( fname, std::ios::out | std::ios::trunc);
         if(!fstream.is_open() || fstream.bad()) {
             error_open_callback(fname);
             ret = false;
         } else {
-            for( int r=0; r<mat.rows; ++r) {
-                for( int c=0; c<mat.cols-1; ++c) {
-            
-                    fstream << mat(r,c) << col_delimeter;
-
-                    if( fstream.bad()) {
-                        error_write_callback(fname);
-                        ret = false;
-                        break;
-                    }
-                }
-                fstream << mat(r,mat.cols-1);
-                if( r < mat.rows-1)
-                    fstream << row_delimeter;
-
-                if( fstream.bad()) {
-                    error_write_callback(fname);
-                    ret = false;
-                    break;
-                }
+            std::vector<std::string> chunks( chunks_per_batch);
+            for( int first_row=0; first_row<mat.rows && ret; first_row+=rows_per_chunk*chunks_per_batch) {
+                const int n_chunks = std::min( chunks_per_batch, (mat.rows - first_row + rows_per_chunk - 1) / rows_per_chunk);
+                cv::parallel_for_( cv::Range( 0, n_chunks),
+                                   MatrixRowFormatter<mat_type>( mat, first_row, rows_per_chunk, row_delimeter, col_delimeter, chunks));
+
+                for( int i=0; i<n_chunks && ret; ++i)
+                    ret = write_buffer( fstream, chunks[i]);
             }
+            if( !ret)
+                error_write_callback(fname);
         }
         return ret;
     }
 
 
+    /// Magic number at the beginning of binary matrix files.
+    const char BINARY_MATRIX_FILE_MAGIC[4] = { 'A', 'M', 'F', '1' };
+
+
+    /** Writes a Mat_ to a binary file, e.g. as a sidecar of a plain matrix file that is faster to load.
+     * The format is: magic number, opencv type, rows and cols as 32 bit unsigned integers
+     * and the row-wise raw data.
+     * Truncates all old entries in that given file.
+     * @param fname The name of the file to be written to.
+     * @param mat The Mat_ that is to be written to file.
+     * @param error_open_callback The function that is called when opening the file fails.
+     *        It takes a string (the filename) as an argument.
+     * @param error_write_callback The function that is called when writing to the file fails.
+     *        It takes a string (the filename) as an argument.
+     * @return TRUE in case of success,
+     *         FALSE in case of error.
+     */
+    template< typename T>
+    bool to_binary_file( const std::string& fname,
+                         const cv::Mat_<T>& mat,
+                         std::function< void(const std::string&) > error_open_callback = on_open_file_error,
+                         std::function< void(const std::string&) > error_write_callback = on_write_file_error) {
+        std::ofstream fstream( fname, std::ios::out | std::ios::trunc | std::ios::binary);
+        if(!fstream.is_open() || fstream.bad()) {
+            error_open_callback(fname);
+            return false;
+        }
+        const uint32_t header[] = { static_cast<uint32_t>(mat.type()),
+                                    static_cast<uint32_t>(mat.rows),
+                                    static_cast<uint32_t>(mat.cols) };
+        fstream.write( BINARY_MATRIX_FILE_MAGIC, 4);
+        fstream.write( reinterpret_cast<const char*>(header), sizeof(header));
+        const size_t row_bytes = mat.cols * mat.elemSize();
+        for( int r=0; r<mat.rows && !fstream.bad(); ++r)
+            fstream.write( reinterpret_cast<const char*>(mat.ptr(r)), row_bytes);
+
+        if( fstream.bad()) {
+            error_write_callback(fname);
+            return false;
+        }
+        return true;
+    }
+
+
+    /** Reads a Mat_ from a binary file written by to_binary_file().
+     * @param fname The path to the file where the matrix is stored.
+     * @param[out] out_mat The matrix. Its type must match the stored type.
+     * @param error_open_callback The function that is to be called when the file could not be openend.
+     *        It takes a string as an argument which will be set to the original given filename.
+     * @param error_invalid_mat_callback The function that is called when the file is no valid matrix file.
+     *        It takes the filename and the line, i.e. the row at which the error occured (-1 for the header), as arguments.
+     * @return TRUE in case of success,
+     *         FALSE in case of error.
+     */
+    template< typename T>
+    bool from_binary_file( const std::string& fname,
+                           cv::Mat_<T>& out_mat,
+                           std::function< void(const std::string&) > error_open_callback = on_open_file_error,
+                           std::function< void(const std::string&, const int line) > error_invalid_mat_callback = on_invalid_mat) {
+        out_mat.release();
+        std::ifstream in_file( fname, std::ios::in | std::ios::binary);
+        if( !in_file.is_open()) {
+            error_open_callback( fname);
+            return false;
+        }
+
+        char magic[4];
+        uint32_t header[3]; // type, rows, cols
+        if( !in_file.read( magic, 4) ||
+            std::memcmp( magic, BINARY_MATRIX_FILE_MAGIC, 4) != 0 ||
+            !in_file.read( reinterpret_cast<char*>(header), sizeof(header)) ||
+            static_cast<int>(header[0]) != out_mat.type()) {
+
+            error_invalid_mat_callback( fname, -1);
+            return false;
+        }
+        cv::Mat_<T> mat( static_cast<int>(header[1]), static_cast<int>(header[2]));
+        const size_t row_bytes = mat.cols * mat.elemSize();
+        for( int r=0; r<mat.rows; ++r) {
+            if( !in_file.read( reinterpret_cast<char*>(mat.ptr(r)), row_bytes)) {
+                error_invalid_mat_callback( fname, r);
+                return false;
+            }
+        }
+        out_mat = mat;
+        return true;
+    }
+
+
     /** Convenience function that appends the given stl compliant container of type string 
      * with the lines found in the given file. In error case it calls the given callbacks.
      * @param fname The path to the file to be read.
@@ -593,30 +978,125 @@ namespace app {
     }
 
     
+    /** @brief Parses line-aligned chunks of a plain matrix file into the rows of a preallocated matrix.
+     * Lines that are malformed or do not have the matrix' number of columns are marked as invalid.
+     */
+    template< typename T>
+    class MatrixLineParser : public cv::ParallelLoopBody {
+
+    private: // vars
+
+        const char* _data;                      ///< The file contents.
+        const std::vector<size_t>& _line_starts; ///< Offset of every line and, at the end, of the end of the last line + 1.
+        cv::Mat_<T>& _mat;                      ///< The output matrix with one row per line.
+        std::vector<uchar>& _is_line_valid;     ///< Validity flag per line.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param data The file contents.
+         * @param line_starts Offset of every line and the offset of the end of the last line + 1.
+         * @param[out] o_mat Matrix with one row per line and the expected number of columns.
+         * @param[out] o_is_line_valid Validity flag per line.
+         */
+        MatrixLineParser( const char* data, const std::vector<size_t>& line_starts, cv::Mat_<T>& o_mat, std::vector<uchar>& o_is_line_valid)
+            : _data(data), _line_starts(line_starts), _mat(o_mat), _is_line_valid(o_is_line_valid)
+        {}
+
+    public: // methods
+
+        /** Parses the lines in the given range.
+         * @param range A range of line indices.
+         */
+        virtual void operator()( const cv::Range& range) const {
+            for( int i=range.start; i<range.end; ++i) {
+                const char* begin = _data + _line_starts[i];
+                const char* end = _data + _line_starts[i+1] - 1;
+                _is_line_valid[i] = parse_matrix_line( begin, end, _mat[i], _mat.cols) == _mat.cols;
+            }
+        }
+
+    private: // helpers
+
+        /// Not assignable.
+        MatrixLineParser& operator=( const MatrixLineParser&);
+    };
+
+    
     /** Loads a (one-dimensional) plain matrix from a file.
+     * The file is memory mapped, split into lines and the lines are parsed in parallel
+     * directly into the rows of a preallocated matrix. The number of columns is determined
+     * by the first line that is not empty. Malformed lines and lines with a different
+     * number of entries are reported and skipped.
      * For more complex data formats consider cv::FileStorage.
      * @param fname The path to the file where the matrix is stored.
      * @param[out] out_mat A reference to the matrix that shall store the matrix.
+     * @param error_invalid_mat_callback The function that is called for every invalid line.
+     *        It takes the filename and the line number (0-based indexing) as arguments.
      * @return TRUE in case of success.
-     *         FALSE, if there occured any file i/o related error.
+     *         FALSE, if there occured any file i/o related error or the matrix is invalid.
      */
     template< typename T>
     bool from_file( const std::string& fname, cv::Mat_<T>& out_mat,
                     std::function< void(const std::string&, const int line) > error_invalid_mat_callback = on_invalid_mat) {
-        bool ret;
+        namespace bip = boost::interprocess;
         out_mat.release();
-        ret = getlines_from_file(
-            fname,
-            [&]( string& line, uint line_nr) {
-                std::vector<T> v = from_string<T,vector>( line);
-                
-                if( v.size()==0 || out_mat.rows != 0 && v.size() != out_mat.cols) {
-                    error_invalid_mat_callback(fname, line_nr);
-                    ret = false;
-                } else {
-                    out_mat.push_back( cv::Mat_<T>(cv::Mat_<T>(v).t())); // not gonna love the MatExpr
-                }
-        });
+
+        boost::system::error_code ec;
+        const boost::uintmax_t file_size = boost::filesystem::file_size( fname, ec);
+        if( ec) {
+            on_open_file_error( fname);
+            return false;
+        } else if( file_size == 0) {
+            return true;
+        }
+
+        bip::mapped_region region;
+        try {
+            const bip::file_mapping mapping( fname.c_str(), bip::read_only);
+            bip::mapped_region( mapping, bip::read_only).swap( region);
+        } catch( const bip::interprocess_exception&) {
+            on_open_file_error( fname);
+            return false;
+        }
+        const char* const data = static_cast<const char*>( region.get_address());
+        const size_t size = region.get_size();
+
+        // split into lines; a last line without newline gets a virtual one
+        std::vector<size_t> line_starts( 1, 0);
+        for( const char* p = data; (p = static_cast<const char*>( std::memchr( p, '\n', data + size - p))) != nullptr; )
+            line_starts.push_back( ++p - data);
+        if( line_starts.back() != size)
+            line_starts.push_back( size + 1);
+        const int n_lines = static_cast<int>( line_starts.size()) - 1;
+
+        int n_cols = 0;
+        for( int i=0; i<n_lines && n_cols <= 0; ++i)
+            n_cols = parse_matrix_line<T>( data + line_starts[i], data + line_starts[i+1] - 1, nullptr, 0);
+        if( n_cols <= 0) {
+            for( int i=0; i<n_lines; ++i)
+                error_invalid_mat_callback( fname, i);
+            return false;
+        }
+
+        cv::Mat_<T> mat( n_lines, n_cols);
+        std::vector<uchar> is_line_valid( n_lines);
+        cv::parallel_for_( cv::Range( 0, n_lines), MatrixLineParser<T>( data, line_starts, mat, is_line_valid));
+
+        // report and drop invalid lines in file order
+        bool ret(true);
+        int n_valid_lines = 0;
+        for( int i=0; i<n_lines; ++i) {
+            if( is_line_valid[i]) {
+                if( n_valid_lines != i)
+                    mat.row(i).copyTo( mat.row(n_valid_lines));
+                ++n_valid_lines;
+            } else {
+                error_invalid_mat_callback( fname, i);
+                ret = false;
+            }
+        }
+        out_mat = n_valid_lines == n_lines ? mat : mat.rowRange( 0, n_valid_lines).clone();
         return ret;
     }
 
@@ -763,9 +1243,179 @@ namespace app {
     }
 
 
+    /** @brief Evaluation plan for normalized circular cross correlation series of fixed lengths.
+     * Holds the lengths of a batch of series and the DFT size used for them, so it can be
+     * created once and reused for every evaluation with the same lengths.
+     * Series with at least DIRECT_THRESHOLD elements are evaluated via the DFT:
+     * they are centered, zero-padded to a common size >= 2*length-1 that is cheap to 
+     * transform (see cv::getOptimalDFTSize()), correlated linearly in the frequency domain 
+     * in one batched cv::dft call (one row per series) and folded back to the circular result.
+     * This also works for bin counts that are not DFT friendly, e.g. primes.
+     * Shorter series are evaluated with the direct loop.
+     * The object keeps work buffers and is therefore not thread-safe.
+     * @see circular_cross_correlation_series()
+     */
+    template<typename R>
+    class CircularCorrelationPlan {
+
+    public: // constants
+
+        /// Series shorter than that are evaluated with the direct O(n*n) loop.
+        static const unsigned int DIRECT_THRESHOLD = 32;
+
+    private: // vars
+
+        std::vector<unsigned int> _lengths;   ///< The lengths of the series of one batch.
+        std::vector<int> _dft_rows;           ///< Row of each series in the dft buffers, -1 for direct evaluation.
+        int _n_dft_rows;                      ///< Number of series evaluated via the dft.
+        int _dft_size;                        ///< The zero-padded length of the dft evaluated series.
+
+        mutable cv::Mat_<R> _a_rows;          ///< Work buffer for the centered and padded a-series.
+        mutable cv::Mat_<R> _b_rows;          ///< Work buffer for the centered and padded b-series.
+        mutable cv::Mat_<R> _a_spectra;       ///< Work buffer for the spectra of the a-series.
+        mutable cv::Mat_<R> _b_spectra;       ///< Work buffer for the spectra of the b-series.
+        mutable cv::Mat_<R> _correlations;    ///< Work buffer for the linear correlations.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param lengths The lengths of the series of one batch, e.g. the number of bins of each histogram.
+         */
+        CircularCorrelationPlan( const std::vector<unsigned int>& lengths = std::vector<unsigned int>())
+            : _lengths(lengths), _dft_rows(lengths.size(), -1), _n_dft_rows(0), _dft_size(0) {
+
+            unsigned int max_length = 0;
+            for( unsigned int i=0; i<_lengths.size(); ++i) {
+                if( _lengths[i] >= DIRECT_THRESHOLD) {
+                    _dft_rows[i] = _n_dft_rows++;
+                    max_length = std::max( max_length, _lengths[i]);
+                }
+            }
+            if( _n_dft_rows > 0)
+                _dft_size = cv::getOptimalDFTSize( 2 * max_length - 1);
+        }
+
+    public: // methods
+
+        /** Retrieves the lengths of the series this plan was created for.
+         * @return The series lengths.
+         */
+        inline const std::vector<unsigned int>& lengths() const { return _lengths; }
+
+
+        /** Calculates the normalized circular delayed cross correlation series of a batch of vector pairs.
+         * @param a_series The first vectors, one for each length the plan was created for.
+         * @param b_series The second vectors. Each must have the same length as its counterpart in a_series.
+         *        Pass the same container as a_series to compute autocorrelations; this saves one dft.
+         * @param[out] o_series The cross correlation series for each pair with the index defining the delay.
+         *        Must not be the same container as a_series or b_series. Every series is half the size 
+         *        of its input vectors (rounded up) and its elements are within [-1;1].
+         * @see circular_cross_correlation_series( const std::vector<R>&, const std::vector<R>&)
+         */
+        void execute( const std::vector<std::vector<R>>& a_series, 
+                      const std::vector<std::vector<R>>& b_series, 
+                      std::vector<std::vector<R>>& o_series) const {
+            assert( a_series.size() == _lengths.size() && b_series.size() == _lengths.size() && "plan and batch must have same number of series");
+            const bool is_autocorrelation = &a_series == &b_series;
+            std::vector<R> denoms( _lengths.size(), 0);
+            o_series.resize( _lengths.size());
+
+            if( _n_dft_rows > 0) {
+                _a_rows.create( _n_dft_rows, _dft_size);
+                _a_rows = R(0);
+                if( !is_autocorrelation) {
+                    _b_rows.create( _n_dft_rows, _dft_size);
+                    _b_rows = R(0);
+                }
+            }
+
+            for( unsigned int i=0; i<_lengths.size(); ++i) {
+                const std::vector<R>& a = a_series[i];
+                const std::vector<R>& b = b_series[i];
+                assert( a.size() == _lengths[i] && b.size() == _lengths[i] && "series must have the planned length");
+                const unsigned int n = _lengths[i];
+                const unsigned int size = n/2 + n%2;
+                
+                // means & variances
+                R mean_a = 0;
+                R mean_b = 0;
+                R variance_a = 0;
+                R variance_b = 0;
+                for( unsigned int j=0; j<n; ++j) {
+                    mean_a += a[j];
+                    mean_b += b[j];
+                }
+                mean_a /= n;
+                mean_b /= n;
+                for( unsigned int j=0; j<n; ++j) {
+                    variance_a += (a[j] - mean_a) * (a[j] - mean_a);
+                    variance_b += (b[j] - mean_b) * (b[j] - mean_b);
+                }
+                denoms[i] = sqrt( variance_a * variance_b);
+
+                std::vector<R>& o = o_series[i];
+                if( denoms[i] == 0) {
+                    o.assign( size, 1);
+                } else if( _dft_rows[i] == -1) {
+                    // direct evaluation, the modulo is split into two loops
+                    o.resize( size);
+                    for( unsigned int delay=0; delay<size; ++delay) {
+                        R cross_correlation = 0;
+                        for( unsigned int idx_a=0; idx_a<n-delay; ++idx_a)
+                            cross_correlation += (a[idx_a] - mean_a) * (b[idx_a+delay] - mean_b);
+                        for( unsigned int idx_a=n-delay; idx_a<n; ++idx_a)
+                            cross_correlation += (a[idx_a] - mean_a) * (b[idx_a+delay-n] - mean_b);
+                        o[delay] = cross_correlation / denoms[i];
+                    }
+                } else {
+                    // centered & zero-padded rows for the dft
+                    R* a_row = _a_rows[_dft_rows[i]];
+                    for( unsigned int j=0; j<n; ++j)
+                        a_row[j] = a[j] - mean_a;
+                    if( !is_autocorrelation) {
+                        R* b_row = _b_rows[_dft_rows[i]];
+                        for( unsigned int j=0; j<n; ++j)
+                            b_row[j] = b[j] - mean_b;
+                    }
+                }
+            }
+
+            if( _n_dft_rows == 0)
+                return;
+
+            // linear correlation: idft( B * conj(A))
+            cv::dft( _a_rows, _a_spectra, cv::DFT_ROWS);
+            if( is_autocorrelation) {
+                cv::mulSpectrums( _a_spectra, _a_spectra, _correlations, cv::DFT_ROWS, true);
+            } else {
+                cv::dft( _b_rows, _b_spectra, cv::DFT_ROWS);
+                cv::mulSpectrums( _b_spectra, _a_spectra, _correlations, cv::DFT_ROWS, true);
+            }
+            cv::dft( _correlations, _correlations, cv::DFT_INVERSE | cv::DFT_ROWS | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+            // fold the positive and negative delays into the circular series
+            for( unsigned int i=0; i<_lengths.size(); ++i) {
+                if( _dft_rows[i] == -1 || denoms[i] == 0)
+                    continue;
+                const unsigned int n = _lengths[i];
+                const unsigned int size = n/2 + n%2;
+                const R* row = _correlations[_dft_rows[i]];
+                std::vector<R>& o = o_series[i];
+                o.resize( size);
+
+                o[0] = row[0] / denoms[i];
+                for( unsigned int delay=1; delay<size; ++delay)
+                    o[delay] = (row[delay] + row[_dft_size + delay - n]) / denoms[i];
+            }
+        }
+    };
+
+
     /** Retrieves the normalized circular delayed cross correlatipon series of two given vectors.
      * The function calculates means and deviations under the hood, so maybe, if you have
      * these values beforehand you should rather calculate your own correlation series inline.
+     * Long vectors are correlated via the DFT. When evaluating several series of the same 
+     * lengths repeatedly, rather keep a CircularCorrelationPlan and evaluate them batch-wise.
      * @param a The first vector.
      * @param b The second vector. Must have the same length as vector a.
      * @return The cross correlation series for both vectors with the index defining the delay.
@@ -773,50 +1423,21 @@ namespace app {
      * or, in other words, the cross correlation series is symmetric to delay = vector.size()/2,
      * The resulting vector will be half the size of the input vectors.
      * The vector elements are within [-1;1].
+     * @see CircularCorrelationPlan
      */
     template<typename R>
     std::vector<R> circular_cross_correlation_series( const std::vector<R>& a, const std::vector<R>& b) {
         assert( a.size() == b.size() && "a and b must have same length");
-        std::vector<R> ret;
-        unsigned int size = static_cast<unsigned int>(a.size()/2) + (a.size()%2 == 0 ? 0 : 1);
-        ret.reserve( size);
-
-        register R mean_a = 0;
-        register R mean_b = 0;
-        R variance_a = 0;
-        R variance_b = 0;
-        register R denom;
-
-        // calculate means
-        for( uint i=0; i<a.size(); ++i) {
-            mean_a += a[i];
-            mean_b += b[i];
-        }
-        mean_a /= a.size();
-        mean_b /= a.size();
-        // calculate variances
-        for( uint i=0; i<a.size(); ++i) {
-            variance_a += (a[i] - mean_a) * (a[i] - mean_a);
-            variance_b += (b[i] - mean_b) * (b[i] - mean_b);
-        }
-        denom = sqrt( variance_a * variance_b);
-    
-        // calculate correlation series
-        if( denom == 0) {
-            for( unsigned int delay=0; delay<size; ++delay) {
-                ret.push_back(1);
-            }
+        const CircularCorrelationPlan<R> plan( std::vector<unsigned int>( 1, static_cast<unsigned int>(a.size())));
+        std::vector<std::vector<R>> a_series( 1, a);
+        std::vector<std::vector<R>> ret;
+        if( &a == &b) {
+            plan.execute( a_series, a_series, ret);
         } else {
-            for( unsigned int delay=0; delay<size; ++delay) {
-                R cross_correlation = 0;
-                for( uint idx_a=0; idx_a<a.size(); ++idx_a) {
-                    int idx_b = (idx_a+delay) % a.size();
-                    cross_correlation += (a[idx_a] - mean_a) * (b[idx_b] - mean_b);
-                }
-                ret.push_back( cross_correlation / denom);
-            }
+            std::vector<std::vector<R>> b_series( 1, b);
+            plan.execute( a_series, b_series, ret);
         }
-        return ret;
+        return ret[0];
     }
 
 
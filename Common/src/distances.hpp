@@ -0,0 +1,781 @@
+/******************************************************************************
+/* @file Distance kernels shared by all clusterers: squared euclidean, L1,
+/*       chi-squared and cosine distances between single precision vectors,
+/*       plus one-to-many and many-to-many variants.
+/*
+/* Every kernel exists as scalar, SSE2, AVX, AVX2 (with FMA) and AVX-512
+/* version. The fastest version that both the compiler and the CPU support
+/* is selected at program start by CPU feature detection. Like the OPTICS,
+/* HDBSCAN and ANN modules, the kernels depend on nothing but the STL and
+/* the compiler intrinsics, so that those modules can use them.
+/*
+/*
+/* @author langenhagen
+/* @version 150716
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+// DEFINES and MACROS
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #include <immintrin.h>
+        /// MSVC allows intrinsics of any instruction set in any function.
+        #define DISTANCES_TARGET(instruction_sets)
+        #define DISTANCES_HAS_SSE2      1
+        #define DISTANCES_HAS_AVX       (_MSC_FULL_VER >= 160040219) // VS2010 SP1
+        #define DISTANCES_HAS_AVX2      (_MSC_VER >= 1700)           // VS2012
+        #define DISTANCES_HAS_AVX512    (_MSC_VER >= 1911)           // VS2017 15.3
+    #elif defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 7)
+        #include <cpuid.h>
+        #include <immintrin.h>
+        /// GCC and clang need the instruction sets of the intrinsics enabled per function.
+        #define DISTANCES_TARGET(instruction_sets) __attribute__((target(instruction_sets)))
+        #define DISTANCES_HAS_SSE2      1
+        #define DISTANCES_HAS_AVX       1
+        #define DISTANCES_HAS_AVX2      1
+        #define DISTANCES_HAS_AVX512    1
+    #endif
+
+#endif
+
+#ifndef DISTANCES_HAS_SSE2
+    #define DISTANCES_TARGET(instruction_sets)
+    #define DISTANCES_HAS_SSE2      0
+    #define DISTANCES_HAS_AVX       0
+    #define DISTANCES_HAS_AVX2      0
+    #define DISTANCES_HAS_AVX512    0
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+/// Namespace of the distance kernels.
+namespace distances {
+
+    /// The floating point type of the kernels.
+    typedef float real;
+
+
+    /// Instruction set levels wrapping namespace.
+    namespace simd_level {
+        /// The instruction sets of the kernel versions, each one a superset of the previous.
+        enum simd_level {
+            SCALAR  = 0,    ///< plain C++
+            SSE2    = 1,    ///< 4 floats per instruction
+            AVX     = 2,    ///< 8 floats per instruction
+            AVX2    = 3,    ///< 8 floats per instruction, fused multiply-add
+            AVX512  = 4     ///< 16 floats per instruction, fused multiply-add, masked tails
+        };
+    }
+
+
+    /// Distance metrics wrapping namespace.
+    namespace metric {
+        /// The supported distance metrics.
+        enum metric {
+            SQUARED_L2  = 0,    ///< sum (a-b)²
+            L1          = 1,    ///< sum |a-b|
+            CHI_SQUARED = 2,    ///< sum (a-b)² / (a+b) over the dimensions with a+b > 0, for histograms
+            COSINE      = 3     ///< 1 - a·b / (|a| |b|); 0 for two zero vectors, 1 for one zero vector
+        };
+    }
+
+    /// The number of distance metrics.
+    const int N_METRICS = 4;
+
+    /// Vectors with fewer dimensions are compared by the scalar kernels, which spares the indirect call.
+    const std::size_t MIN_SIMD_DIMS = 8;
+
+    /// The number of rows of the second matrix that many_to_many() compares with all rows of the first one at a time.
+    const std::size_t MANY_TO_MANY_TILE_ROWS = 64;
+
+
+    /// A distance kernel between two vectors with n_dims dimensions.
+    typedef real (*kernel)( const real* a, const real* b, const std::size_t n_dims);
+
+
+    /** @brief The kernels of all metrics for one instruction set level.
+     */
+    struct kernel_table {
+        simd_level::simd_level level;   ///< The instruction set level of the kernels.
+        kernel kernels[N_METRICS];      ///< The kernels, indexed by the metric.
+    };
+
+
+    /** Turns the sums of a cosine kernel into the cosine distance.
+     * @param dot The dot product of the vectors.
+     * @param squared_norm_a The squared norm of the one vector.
+     * @param squared_norm_b The squared norm of the other vector.
+     * @return The cosine distance el. [0,2].
+     */
+    inline real finish_cosine( const real dot, const real squared_norm_a, const real squared_norm_b) {
+        if( squared_norm_a <= 0 || squared_norm_b <= 0)
+            return squared_norm_a == squared_norm_b ? real(0) : real(1);
+        const real ret = real(1) - dot / std::sqrt( squared_norm_a * squared_norm_b);
+        return std::min( std::max( ret, real(0)), real(2));
+    }
+
+
+    /// Plain C++ kernels. Also compute the tails of the SIMD kernels.
+    namespace scalar {
+
+        /// @see metric::SQUARED_L2
+        inline real squared_l2( const real* a, const real* b, const std::size_t n_dims) {
+            real ret(0);
+            for( std::size_t i=0; i<n_dims; ++i) {
+                const real d = a[i] - b[i];
+                ret += d*d;
+            }
+            return ret;
+        }
+
+        /// @see metric::L1
+        inline real l1( const real* a, const real* b, const std::size_t n_dims) {
+            real ret(0);
+            for( std::size_t i=0; i<n_dims; ++i)
+                ret += std::abs( a[i] - b[i]);
+            return ret;
+        }
+
+        /// @see metric::CHI_SQUARED
+        inline real chi_squared( const real* a, const real* b, const std::size_t n_dims) {
+            real ret(0);
+            for( std::size_t i=0; i<n_dims; ++i) {
+                const real s = a[i] + b[i];
+                if( s > 0) {
+                    const real d = a[i] - b[i];
+                    ret += d*d / s;
+                }
+            }
+            return ret;
+        }
+
+        /** Accumulates the sums of the cosine distance.
+         * @param a The one vector.
+         * @param b The other vector.
+         * @param n_dims The number of dimensions.
+         * @param[in,out] io_dot The dot product.
+         * @param[in,out] io_squared_norm_a The squared norm of the one vector.
+         * @param[in,out] io_squared_norm_b The squared norm of the other vector.
+         */
+        inline void cosine_sums( const real* a, const real* b, const std::size_t n_dims, real& io_dot, real& io_squared_norm_a, real& io_squared_norm_b) {
+            for( std::size_t i=0; i<n_dims; ++i) {
+                io_dot += a[i] * b[i];
+                io_squared_norm_a += a[i] * a[i];
+                io_squared_norm_b += b[i] * b[i];
+            }
+        }
+
+        /// @see metric::COSINE
+        inline real cosine( const real* a, const real* b, const std::size_t n_dims) {
+            real dot(0), squared_norm_a(0), squared_norm_b(0);
+            cosine_sums( a, b, n_dims, dot, squared_norm_a, squared_norm_b);
+            return finish_cosine( dot, squared_norm_a, squared_norm_b);
+        }
+
+    } // END namespace scalar
+
+
+#if DISTANCES_HAS_SSE2
+    /// SSE2 kernels, 4 floats per instruction.
+    namespace sse2 {
+
+        /// Sums the elements of a register.
+        DISTANCES_TARGET("sse2") inline real horizontal_sum( const __m128 v) {
+            const __m128 high = _mm_movehl_ps( v, v);
+            const __m128 pairs = _mm_add_ps( v, high);
+            return _mm_cvtss_f32( _mm_add_ss( pairs, _mm_shuffle_ps( pairs, pairs, 1)));
+        }
+
+        /// @see metric::SQUARED_L2
+        DISTANCES_TARGET("sse2") inline real squared_l2( const real* a, const real* b, const std::size_t n_dims) {
+            __m128 sum0 = _mm_setzero_ps();
+            __m128 sum1 = _mm_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+8<=n_dims; i+=8) {
+                const __m128 d0 = _mm_sub_ps( _mm_loadu_ps( a+i), _mm_loadu_ps( b+i));
+                const __m128 d1 = _mm_sub_ps( _mm_loadu_ps( a+i+4), _mm_loadu_ps( b+i+4));
+                sum0 = _mm_add_ps( sum0, _mm_mul_ps( d0, d0));
+                sum1 = _mm_add_ps( sum1, _mm_mul_ps( d1, d1));
+            }
+            return horizontal_sum( _mm_add_ps( sum0, sum1)) + scalar::squared_l2( a+i, b+i, n_dims-i);
+        }
+
+        /// @see metric::L1
+        DISTANCES_TARGET("sse2") inline real l1( const real* a, const real* b, const std::size_t n_dims) {
+            const __m128 sign = _mm_set1_ps( -0.0f);
+            __m128 sum0 = _mm_setzero_ps();
+            __m128 sum1 = _mm_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+8<=n_dims; i+=8) {
+                sum0 = _mm_add_ps( sum0, _mm_andnot_ps( sign, _mm_sub_ps( _mm_loadu_ps( a+i), _mm_loadu_ps( b+i))));
+                sum1 = _mm_add_ps( sum1, _mm_andnot_ps( sign, _mm_sub_ps( _mm_loadu_ps( a+i+4), _mm_loadu_ps( b+i+4))));
+            }
+            return horizontal_sum( _mm_add_ps( sum0, sum1)) + scalar::l1( a+i, b+i, n_dims-i);
+        }
+
+        /// @see metric::CHI_SQUARED
+        DISTANCES_TARGET("sse2") inline real chi_squared( const real* a, const real* b, const std::size_t n_dims) {
+            const __m128 zero = _mm_setzero_ps();
+            __m128 sum = _mm_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+4<=n_dims; i+=4) {
+                const __m128 va = _mm_loadu_ps( a+i);
+                const __m128 vb = _mm_loadu_ps( b+i);
+                const __m128 s = _mm_add_ps( va, vb);
+                const __m128 d = _mm_sub_ps( va, vb);
+                // dimensions with s <= 0 give NaN or garbage, which the mask clears
+                sum = _mm_add_ps( sum, _mm_and_ps( _mm_cmpgt_ps( s, zero), _mm_div_ps( _mm_mul_ps( d, d), s)));
+            }
+            return horizontal_sum( sum) + scalar::chi_squared( a+i, b+i, n_dims-i);
+        }
+
+        /// @see metric::COSINE
+        DISTANCES_TARGET("sse2") inline real cosine( const real* a, const real* b, const std::size_t n_dims) {
+            __m128 dot = _mm_setzero_ps();
+            __m128 norm_a = _mm_setzero_ps();
+            __m128 norm_b = _mm_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+4<=n_dims; i+=4) {
+                const __m128 va = _mm_loadu_ps( a+i);
+                const __m128 vb = _mm_loadu_ps( b+i);
+                dot = _mm_add_ps( dot, _mm_mul_ps( va, vb));
+                norm_a = _mm_add_ps( norm_a, _mm_mul_ps( va, va));
+                norm_b = _mm_add_ps( norm_b, _mm_mul_ps( vb, vb));
+            }
+            real sum_dot = horizontal_sum( dot), sum_norm_a = horizontal_sum( norm_a), sum_norm_b = horizontal_sum( norm_b);
+            scalar::cosine_sums( a+i, b+i, n_dims-i, sum_dot, sum_norm_a, sum_norm_b);
+            return finish_cosine( sum_dot, sum_norm_a, sum_norm_b);
+        }
+
+    } // END namespace sse2
+#endif
+
+
+#if DISTANCES_HAS_AVX
+    /** AVX kernels, 8 floats per instruction.
+     * Clear the upper register halves before returning, so that subsequent SSE code does not stall.
+     */
+    namespace avx {
+
+        /// Sums the elements of a register.
+        DISTANCES_TARGET("avx") inline real horizontal_sum( const __m256 v) {
+            const __m128 quad = _mm_add_ps( _mm256_castps256_ps128( v), _mm256_extractf128_ps( v, 1));
+            const __m128 pairs = _mm_add_ps( quad, _mm_movehl_ps( quad, quad));
+            return _mm_cvtss_f32( _mm_add_ss( pairs, _mm_shuffle_ps( pairs, pairs, 1)));
+        }
+
+        /// @see metric::SQUARED_L2
+        DISTANCES_TARGET("avx") inline real squared_l2( const real* a, const real* b, const std::size_t n_dims) {
+            __m256 sum0 = _mm256_setzero_ps();
+            __m256 sum1 = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+16<=n_dims; i+=16) {
+                const __m256 d0 = _mm256_sub_ps( _mm256_loadu_ps( a+i), _mm256_loadu_ps( b+i));
+                const __m256 d1 = _mm256_sub_ps( _mm256_loadu_ps( a+i+8), _mm256_loadu_ps( b+i+8));
+                sum0 = _mm256_add_ps( sum0, _mm256_mul_ps( d0, d0));
+                sum1 = _mm256_add_ps( sum1, _mm256_mul_ps( d1, d1));
+            }
+            if( i+8 <= n_dims) {
+                const __m256 d = _mm256_sub_ps( _mm256_loadu_ps( a+i), _mm256_loadu_ps( b+i));
+                sum0 = _mm256_add_ps( sum0, _mm256_mul_ps( d, d));
+                i += 8;
+            }
+            const real ret = horizontal_sum( _mm256_add_ps( sum0, sum1));
+            _mm256_zeroupper();
+            return ret + scalar::squared_l2( a+i, b+i, n_dims-i);
+        }
+
+        /// @see metric::L1
+        DISTANCES_TARGET("avx") inline real l1( const real* a, const real* b, const std::size_t n_dims) {
+            const __m256 sign = _mm256_set1_ps( -0.0f);
+            __m256 sum0 = _mm256_setzero_ps();
+            __m256 sum1 = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+16<=n_dims; i+=16) {
+                sum0 = _mm256_add_ps( sum0, _mm256_andnot_ps( sign, _mm256_sub_ps( _mm256_loadu_ps( a+i), _mm256_loadu_ps( b+i))));
+                sum1 = _mm256_add_ps( sum1, _mm256_andnot_ps( sign, _mm256_sub_ps( _mm256_loadu_ps( a+i+8), _mm256_loadu_ps( b+i+8))));
+            }
+            if( i+8 <= n_dims) {
+                sum0 = _mm256_add_ps( sum0, _mm256_andnot_ps( sign, _mm256_sub_ps( _mm256_loadu_ps( a+i), _mm256_loadu_ps( b+i))));
+                i += 8;
+            }
+            const real ret = horizontal_sum( _mm256_add_ps( sum0, sum1));
+            _mm256_zeroupper();
+            return ret + scalar::l1( a+i, b+i, n_dims-i);
+        }
+
+        /// @see metric::CHI_SQUARED
+        DISTANCES_TARGET("avx") inline real chi_squared( const real* a, const real* b, const std::size_t n_dims) {
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 sum = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+8<=n_dims; i+=8) {
+                const __m256 va = _mm256_loadu_ps( a+i);
+                const __m256 vb = _mm256_loadu_ps( b+i);
+                const __m256 s = _mm256_add_ps( va, vb);
+                const __m256 d = _mm256_sub_ps( va, vb);
+                sum = _mm256_add_ps( sum, _mm256_and_ps( _mm256_cmp_ps( s, zero, _CMP_GT_OQ), _mm256_div_ps( _mm256_mul_ps( d, d), s)));
+            }
+            const real ret = horizontal_sum( sum);
+            _mm256_zeroupper();
+            return ret + scalar::chi_squared( a+i, b+i, n_dims-i);
+        }
+
+        /// @see metric::COSINE
+        DISTANCES_TARGET("avx") inline real cosine( const real* a, const real* b, const std::size_t n_dims) {
+            __m256 dot = _mm256_setzero_ps();
+            __m256 norm_a = _mm256_setzero_ps();
+            __m256 norm_b = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+8<=n_dims; i+=8) {
+                const __m256 va = _mm256_loadu_ps( a+i);
+                const __m256 vb = _mm256_loadu_ps( b+i);
+                dot = _mm256_add_ps( dot, _mm256_mul_ps( va, vb));
+                norm_a = _mm256_add_ps( norm_a, _mm256_mul_ps( va, va));
+                norm_b = _mm256_add_ps( norm_b, _mm256_mul_ps( vb, vb));
+            }
+            real sum_dot = horizontal_sum( dot), sum_norm_a = horizontal_sum( norm_a), sum_norm_b = horizontal_sum( norm_b);
+            _mm256_zeroupper();
+            scalar::cosine_sums( a+i, b+i, n_dims-i, sum_dot, sum_norm_a, sum_norm_b);
+            return finish_cosine( sum_dot, sum_norm_a, sum_norm_b);
+        }
+
+    } // END namespace avx
+#endif
+
+
+#if DISTANCES_HAS_AVX2
+    /** AVX2 kernels, the AVX kernels with fused multiply-adds.
+     * L1 and chi-squared have no multiply-add to fuse and use the AVX kernels.
+     */
+    namespace avx2 {
+
+        /// @see metric::SQUARED_L2
+        DISTANCES_TARGET("avx2,fma") inline real squared_l2( const real* a, const real* b, const std::size_t n_dims) {
+            __m256 sum0 = _mm256_setzero_ps();
+            __m256 sum1 = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+16<=n_dims; i+=16) {
+                const __m256 d0 = _mm256_sub_ps( _mm256_loadu_ps( a+i), _mm256_loadu_ps( b+i));
+                const __m256 d1 = _mm256_sub_ps( _mm256_loadu_ps( a+i+8), _mm256_loadu_ps( b+i+8));
+                sum0 = _mm256_fmadd_ps( d0, d0, sum0);
+                sum1 = _mm256_fmadd_ps( d1, d1, sum1);
+            }
+            if( i+8 <= n_dims) {
+                const __m256 d = _mm256_sub_ps( _mm256_loadu_ps( a+i), _mm256_loadu_ps( b+i));
+                sum0 = _mm256_fmadd_ps( d, d, sum0);
+                i += 8;
+            }
+            const real ret = avx::horizontal_sum( _mm256_add_ps( sum0, sum1));
+            _mm256_zeroupper();
+            return ret + scalar::squared_l2( a+i, b+i, n_dims-i);
+        }
+
+        /// @see metric::COSINE
+        DISTANCES_TARGET("avx2,fma") inline real cosine( const real* a, const real* b, const std::size_t n_dims) {
+            __m256 dot = _mm256_setzero_ps();
+            __m256 norm_a = _mm256_setzero_ps();
+            __m256 norm_b = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+8<=n_dims; i+=8) {
+                const __m256 va = _mm256_loadu_ps( a+i);
+                const __m256 vb = _mm256_loadu_ps( b+i);
+                dot = _mm256_fmadd_ps( va, vb, dot);
+                norm_a = _mm256_fmadd_ps( va, va, norm_a);
+                norm_b = _mm256_fmadd_ps( vb, vb, norm_b);
+            }
+            real sum_dot = avx::horizontal_sum( dot), sum_norm_a = avx::horizontal_sum( norm_a), sum_norm_b = avx::horizontal_sum( norm_b);
+            _mm256_zeroupper();
+            scalar::cosine_sums( a+i, b+i, n_dims-i, sum_dot, sum_norm_a, sum_norm_b);
+            return finish_cosine( sum_dot, sum_norm_a, sum_norm_b);
+        }
+
+    } // END namespace avx2
+#endif
+
+
+#if DISTANCES_HAS_AVX512
+    /** AVX-512 kernels, 16 floats per instruction.
+     * The tails are processed with masked loads instead of scalar code.
+     * Uses AVX-512F instructions only.
+     */
+    namespace avx512 {
+
+        /// Sums the elements of a register.
+        DISTANCES_TARGET("avx512f") inline real horizontal_sum( const __m512 v) {
+            const __m256 high = _mm256_castpd_ps( _mm512_extractf64x4_pd( _mm512_castps_pd( v), 1));
+            const __m256 octet = _mm256_add_ps( _mm512_castps512_ps256( v), high);
+            const __m128 quad = _mm_add_ps( _mm256_castps256_ps128( octet), _mm256_extractf128_ps( octet, 1));
+            const __m128 pairs = _mm_add_ps( quad, _mm_movehl_ps( quad, quad));
+            return _mm_cvtss_f32( _mm_add_ss( pairs, _mm_shuffle_ps( pairs, pairs, 1)));
+        }
+
+        /** Creates the mask of the dimensions that remain after the last full register.
+         * @param n_remaining The number of remaining dimensions el. [0,16[.
+         * @return The mask of the lowest n_remaining lanes.
+         */
+        inline __mmask16 tail_mask( const std::size_t n_remaining) {
+            return static_cast<__mmask16>((1u << n_remaining) - 1);
+        }
+
+        /// Clears the sign bits.
+        DISTANCES_TARGET("avx512f") inline __m512 absolute( const __m512 v) {
+            return _mm512_castsi512_ps( _mm512_and_si512( _mm512_castps_si512( v), _mm512_set1_epi32( 0x7fffffff)));
+        }
+
+        /// @see metric::SQUARED_L2
+        DISTANCES_TARGET("avx512f") inline real squared_l2( const real* a, const real* b, const std::size_t n_dims) {
+            __m512 sum0 = _mm512_setzero_ps();
+            __m512 sum1 = _mm512_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+32<=n_dims; i+=32) {
+                const __m512 d0 = _mm512_sub_ps( _mm512_loadu_ps( a+i), _mm512_loadu_ps( b+i));
+                const __m512 d1 = _mm512_sub_ps( _mm512_loadu_ps( a+i+16), _mm512_loadu_ps( b+i+16));
+                sum0 = _mm512_fmadd_ps( d0, d0, sum0);
+                sum1 = _mm512_fmadd_ps( d1, d1, sum1);
+            }
+            for( ; i<n_dims; i+=16) {
+                const __mmask16 mask = tail_mask( std::min<std::size_t>( n_dims-i, 16));
+                const __m512 d = _mm512_sub_ps( _mm512_maskz_loadu_ps( mask, a+i), _mm512_maskz_loadu_ps( mask, b+i));
+                sum0 = _mm512_fmadd_ps( d, d, sum0);
+            }
+            const real ret = horizontal_sum( _mm512_add_ps( sum0, sum1));
+            _mm256_zeroupper();
+            return ret;
+        }
+
+        /// @see metric::L1
+        DISTANCES_TARGET("avx512f") inline real l1( const real* a, const real* b, const std::size_t n_dims) {
+            __m512 sum0 = _mm512_setzero_ps();
+            __m512 sum1 = _mm512_setzero_ps();
+            std::size_t i = 0;
+            for( ; i+32<=n_dims; i+=32) {
+                sum0 = _mm512_add_ps( sum0, absolute( _mm512_sub_ps( _mm512_loadu_ps( a+i), _mm512_loadu_ps( b+i))));
+                sum1 = _mm512_add_ps( sum1, absolute( _mm512_sub_ps( _mm512_loadu_ps( a+i+16), _mm512_loadu_ps( b+i+16))));
+            }
+            for( ; i<n_dims; i+=16) {
+                const __mmask16 mask = tail_mask( std::min<std::size_t>( n_dims-i, 16));
+                sum0 = _mm512_add_ps( sum0, absolute( _mm512_sub_ps( _mm512_maskz_loadu_ps( mask, a+i), _mm512_maskz_loadu_ps( mask, b+i))));
+            }
+            const real ret = horizontal_sum( _mm512_add_ps( sum0, sum1));
+            _mm256_zeroupper();
+            return ret;
+        }
+
+        /// @see metric::CHI_SQUARED
+        DISTANCES_TARGET("avx512f") inline real chi_squared( const real* a, const real* b, const std::size_t n_dims) {
+            const __m512 zero = _mm512_setzero_ps();
+            __m512 sum = _mm512_setzero_ps();
+            for( std::size_t i=0; i<n_dims; i+=16) {
+                const __mmask16 mask = tail_mask( std::min<std::size_t>( n_dims-i, 16));
+                const __m512 va = _mm512_maskz_loadu_ps( mask, a+i);
+                const __m512 vb = _mm512_maskz_loadu_ps( mask, b+i);
+                const __m512 s = _mm512_add_ps( va, vb);
+                const __m512 d = _mm512_sub_ps( va, vb);
+                // divides only where s > 0, which excludes the lanes behind the tail as well
+                sum = _mm512_add_ps( sum, _mm512_maskz_div_ps( _mm512_cmp_ps_mask( s, zero, _CMP_GT_OQ), _mm512_mul_ps( d, d), s));
+            }
+            const real ret = horizontal_sum( sum);
+            _mm256_zeroupper();
+            return ret;
+        }
+
+        /// @see metric::COSINE
+        DISTANCES_TARGET("avx512f") inline real cosine( const real* a, const real* b, const std::size_t n_dims) {
+            __m512 dot = _mm512_setzero_ps();
+            __m512 norm_a = _mm512_setzero_ps();
+            __m512 norm_b = _mm512_setzero_ps();
+            for( std::size_t i=0; i<n_dims; i+=16) {
+                const __mmask16 mask = tail_mask( std::min<std::size_t>( n_dims-i, 16));
+                const __m512 va = _mm512_maskz_loadu_ps( mask, a+i);
+                const __m512 vb = _mm512_maskz_loadu_ps( mask, b+i);
+                dot = _mm512_fmadd_ps( va, vb, dot);
+                norm_a = _mm512_fmadd_ps( va, va, norm_a);
+                norm_b = _mm512_fmadd_ps( vb, vb, norm_b);
+            }
+            const real sum_dot = horizontal_sum( dot), sum_norm_a = horizontal_sum( norm_a), sum_norm_b = horizontal_sum( norm_b);
+            _mm256_zeroupper();
+            return finish_cosine( sum_dot, sum_norm_a, sum_norm_b);
+        }
+
+    } // END namespace avx512
+#endif
+
+
+    /** Detects the highest instruction set level that both the compiler and the CPU, including the operating system, support.
+     * @return The instruction set level.
+     */
+    inline simd_level::simd_level supported_level() {
+        simd_level::simd_level ret = simd_level::SCALAR;
+#if DISTANCES_HAS_SSE2
+        unsigned int leaf1[4] = {0,0,0,0};  // eax, ebx, ecx, edx
+        unsigned int leaf7[4] = {0,0,0,0};
+        unsigned int n_leaves = 0;
+        unsigned long long xcr0 = 0;
+    #if defined(_MSC_VER)
+        int info[4];
+        __cpuid( info, 0);
+        n_leaves = static_cast<unsigned int>(info[0]);
+        __cpuid( info, 1);
+        std::copy( info, info+4, leaf1);
+        if( n_leaves >= 7) {
+            __cpuidex( info, 7, 0);
+            std::copy( info, info+4, leaf7);
+        }
+        #if DISTANCES_HAS_AVX
+        if( leaf1[2] & (1u << 27)) // OSXSAVE: the operating system saves the extended registers
+            xcr0 = _xgetbv( 0);
+        #endif
+    #else
+        n_leaves = __get_cpuid_max( 0, nullptr);
+        __get_cpuid( 1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+        if( n_leaves >= 7)
+            __get_cpuid_count( 7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+        if( leaf1[2] & (1u << 27)) { // OSXSAVE: the operating system saves the extended registers
+            unsigned int eax, edx;
+            __asm__ __volatile__( "xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+        }
+    #endif
+        const bool os_saves_ymm = (xcr0 & 0x06) == 0x06;    // XMM and YMM state
+        const bool os_saves_zmm = (xcr0 & 0xe6) == 0xe6;    // XMM, YMM, opmask and ZMM state
+
+        if( leaf1[3] & (1u << 26))
+            ret = simd_level::SSE2;
+        if( ret == simd_level::SSE2 && DISTANCES_HAS_AVX && os_saves_ymm && (leaf1[2] & (1u << 28)))
+            ret = simd_level::AVX;
+        if( ret == simd_level::AVX && DISTANCES_HAS_AVX2 && (leaf7[1] & (1u << 5)) && (leaf1[2] & (1u << 12)))  // AVX2 and FMA
+            ret = simd_level::AVX2;
+        if( ret == simd_level::AVX2 && DISTANCES_HAS_AVX512 && os_saves_zmm && (leaf7[1] & (1u << 16)))         // AVX-512F
+            ret = simd_level::AVX512;
+#endif
+        return ret;
+    }
+
+
+    /** Assembles the kernels of an instruction set level.
+     * @param level The instruction set level. Levels that the compiler does not support fall back to lower ones.
+     * @return The kernels.
+     */
+    inline kernel_table kernels_for( const simd_level::simd_level level) {
+        kernel_table ret = { simd_level::SCALAR, { &scalar::squared_l2, &scalar::l1, &scalar::chi_squared, &scalar::cosine } };
+#if DISTANCES_HAS_SSE2
+        if( level >= simd_level::SSE2) {
+            const kernel_table k = { simd_level::SSE2, { &sse2::squared_l2, &sse2::l1, &sse2::chi_squared, &sse2::cosine } };
+            ret = k;
+        }
+#endif
+#if DISTANCES_HAS_AVX
+        if( level >= simd_level::AVX) {
+            const kernel_table k = { simd_level::AVX, { &avx::squared_l2, &avx::l1, &avx::chi_squared, &avx::cosine } };
+            ret = k;
+        }
+#endif
+#if DISTANCES_HAS_AVX2
+        if( level >= simd_level::AVX2) {
+            const kernel_table k = { simd_level::AVX2, { &avx2::squared_l2, &avx::l1, &avx::chi_squared, &avx2::cosine } };
+            ret = k;
+        }
+#endif
+#if DISTANCES_HAS_AVX512
+        if( level >= simd_level::AVX512) {
+            const kernel_table k = { simd_level::AVX512, { &avx512::squared_l2, &avx512::l1, &avx512::chi_squared, &avx512::cosine } };
+            ret = k;
+        }
+#endif
+        return ret;
+    }
+
+
+    /** @brief Holds the kernels in use.
+     * A static member of a class template has exactly one instance across all translation units
+     * and is initialized at program start, before main() and thus before any thread is started.
+     * Do not compute distances during the initialization of other static objects.
+     */
+    template< typename T>
+    struct active_kernels_holder {
+        static kernel_table table;      ///< The kernels in use.
+    };
+
+    template< typename T>
+    kernel_table active_kernels_holder<T>::table = kernels_for( supported_level());
+
+
+    /** Retrieves the kernels in use.
+     * @return The kernels of the highest supported instruction set level, unless another level was selected.
+     */
+    inline const kernel_table& active_kernels() {
+        return active_kernels_holder<void>::table;
+    }
+
+
+    /** Selects the kernels of an instruction set level, e.g. to compare the levels.
+     * Not thread-safe: do not call while distances are computed.
+     * @param level The wanted instruction set level.
+     * @return The selected level, which is lower than the wanted one if the CPU or the compiler does not support it.
+     */
+    inline simd_level::simd_level select_level( const simd_level::simd_level level) {
+        active_kernels_holder<void>::table = kernels_for( std::min( level, supported_level()));
+        return active_kernels_holder<void>::table.level;
+    }
+
+
+    /** Retrieves the name of an instruction set level.
+     * @param level The instruction set level.
+     * @return The name of the level.
+     */
+    inline const char* level_name( const simd_level::simd_level level) {
+        static const char* const names[] = { "SCALAR", "SSE2", "AVX", "AVX2", "AVX512" };
+        return names[level];
+    }
+
+
+    /** Retrieves the kernel of a metric.
+     * Fetch the kernel once when comparing many pairs of vectors.
+     * @param m The metric.
+     * @return The kernel in use.
+     */
+    inline kernel kernel_of( const metric::metric m) {
+        return active_kernels().kernels[m];
+    }
+
+
+    /// Computes the squared euclidean distance between two vectors with n_dims dimensions. @see metric::SQUARED_L2
+    inline real squared_l2( const real* a, const real* b, const std::size_t n_dims) {
+        return n_dims < MIN_SIMD_DIMS ? scalar::squared_l2( a, b, n_dims) : active_kernels().kernels[metric::SQUARED_L2]( a, b, n_dims);
+    }
+
+    /// Computes the L1 distance between two vectors with n_dims dimensions. @see metric::L1
+    inline real l1( const real* a, const real* b, const std::size_t n_dims) {
+        return n_dims < MIN_SIMD_DIMS ? scalar::l1( a, b, n_dims) : active_kernels().kernels[metric::L1]( a, b, n_dims);
+    }
+
+    /// Computes the chi-squared distance between two histograms with n_dims bins. @see metric::CHI_SQUARED
+    inline real chi_squared( const real* a, const real* b, const std::size_t n_dims) {
+        return n_dims < MIN_SIMD_DIMS ? scalar::chi_squared( a, b, n_dims) : active_kernels().kernels[metric::CHI_SQUARED]( a, b, n_dims);
+    }
+
+    /// Computes the cosine distance between two vectors with n_dims dimensions. @see metric::COSINE
+    inline real cosine( const real* a, const real* b, const std::size_t n_dims) {
+        return n_dims < MIN_SIMD_DIMS ? scalar::cosine( a, b, n_dims) : active_kernels().kernels[metric::COSINE]( a, b, n_dims);
+    }
+
+
+    /** Computes the distances of one vector to many row-wise stored vectors.
+     * @param m The metric.
+     * @param query The one vector.
+     * @param rows The first element of the first of the many vectors.
+     * @param n_rows The number of the many vectors.
+     * @param stride The distance between the first elements of two subsequent rows, in elements.
+     * @param n_dims The number of dimensions.
+     * @param[out] o_distances Buffer for the n_rows distances.
+     */
+    inline void one_to_many( const metric::metric m,
+                             const real* query,
+                             const real* rows,
+                             const std::size_t n_rows,
+                             const std::size_t stride,
+                             const std::size_t n_dims,
+                             real* o_distances) {
+        const kernel k = kernel_of( m);
+        for( std::size_t r=0; r<n_rows; ++r)
+            o_distances[r] = k( query, rows + r*stride, n_dims);
+    }
+
+
+    /** Computes the distances between all pairs of row-wise stored vectors of two sets.
+     * The second set is processed in tiles of MANY_TO_MANY_TILE_ROWS rows, which stay in the cache
+     * while they are compared with all rows of the first set.
+     * @param m The metric.
+     * @param a The first element of the first vector of the one set.
+     * @param n_a The number of vectors of the one set.
+     * @param stride_a The distance between the first elements of two subsequent rows of the one set, in elements.
+     * @param b The first element of the first vector of the other set.
+     * @param n_b The number of vectors of the other set.
+     * @param stride_b The distance between the first elements of two subsequent rows of the other set, in elements.
+     * @param n_dims The number of dimensions.
+     * @param[out] o_distances Buffer for the n_a x n_b distances; the distance between a[i] and b[j] goes to o_distances[i*out_stride + j].
+     * @param out_stride The distance between the first elements of two subsequent rows of the output, in elements.
+     */
+    inline void many_to_many( const metric::metric m,
+                              const real* a,
+                              const std::size_t n_a,
+                              const std::size_t stride_a,
+                              const real* b,
+                              const std::size_t n_b,
+                              const std::size_t stride_b,
+                              const std::size_t n_dims,
+                              real* o_distances,
+                              const std::size_t out_stride) {
+        const kernel k = kernel_of( m);
+        for( std::size_t tile=0; tile<n_b; tile+=MANY_TO_MANY_TILE_ROWS) {
+            const std::size_t tile_end = std::min( tile + MANY_TO_MANY_TILE_ROWS, n_b);
+            for( std::size_t i=0; i<n_a; ++i) {
+                const real* row_a = a + i*stride_a;
+                real* out = o_distances + i*out_stride;
+                for( std::size_t j=tile; j<tile_end; ++j)
+                    out[j] = k( row_a, b + j*stride_b, n_dims);
+            }
+        }
+    }
+
+
+    /** Checks the one-to-many and many-to-many distances of all metrics against the scalar kernels,
+     * on every instruction set level the CPU and the compiler support.
+     * Covers all tail lengths of the SIMD kernels, empty histogram bins and zero vectors.
+     * Not thread-safe: do not call while distances are computed.
+     * @return TRUE if all levels compute the scalar distances up to rounding, FALSE otherwise.
+     */
+    inline bool check_kernels() {
+        const std::size_t n_rows = MANY_TO_MANY_TILE_ROWS + 3;  // more than one tile
+        const std::size_t max_dims = 67;                        // all tails of the 32 floats wide loops
+        const std::size_t stride = max_dims + 1;
+
+        // pseudo-random non-negative vectors; every fifth dimension is an empty bin
+        // in all rows and the last row is the zero vector
+        real rows[n_rows * stride];
+        unsigned int state = 12345u;
+        for( std::size_t i=0; i<n_rows*stride; ++i) {
+            state = state * 1664525u + 1013904223u;
+            rows[i] = i%5 == 0 || i/stride == n_rows-1 ? real(0) : static_cast<real>(state >> 8) / real(1 << 24);
+        }
+
+        const simd_level::simd_level previous = active_kernels().level;
+        bool ret = true;
+        real distances[n_rows * n_rows];
+        for( int l=simd_level::SCALAR; l<=supported_level(); ++l) {
+            select_level( static_cast<simd_level::simd_level>(l));
+            for( int m=0; m<N_METRICS; ++m) {
+                const kernel reference = kernels_for( simd_level::SCALAR).kernels[m];
+                for( std::size_t n_dims=1; n_dims<=max_dims; ++n_dims) {
+                    many_to_many( static_cast<metric::metric>(m), rows, n_rows, stride, rows, n_rows, stride, n_dims, distances, n_rows);
+                    for( std::size_t i=0; i<n_rows; ++i) {
+                        real one_to_many_distances[n_rows];
+                        one_to_many( static_cast<metric::metric>(m), rows + i*stride, rows, n_rows, stride, n_dims, one_to_many_distances);
+                        for( std::size_t j=0; j<n_rows; ++j) {
+                            const real expected = reference( rows + i*stride, rows + j*stride, n_dims);
+                            const real tolerance = real(1e-4) * (real(1) + std::abs( expected));
+                            ret = ret && std::abs( distances[i*n_rows + j] - expected) <= tolerance
+                                      && std::abs( one_to_many_distances[j] - expected) <= tolerance;
+                        }
+                    }
+                }
+            }
+        }
+        select_level( previous);
+        return ret;
+    }
+
+} // END namespace distances
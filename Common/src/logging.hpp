@@ -5,30 +5,44 @@
 /*          - boost.log      for logging
 /*          - rlutil         for console coloring       
 /*
-/* TODO could be optimized, aka deepder understanding of boost log.
+/* Both sinks are asynchronous: records are handed over to a lock-free queue
+/* and formatted and written by a dedicated thread per sink.
 /*
 /* @author barn
-/* @version 141008
+/* @version 150703
 /******************************************************************************/
 #pragma once
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
 
+#include <cstdlib>
 #include <fstream>
+#include <iostream>
 #include <rlutil/rlutil.h>
 
+#include <boost/chrono.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/log/common.hpp>
+#include <boost/log/core.hpp>
 #include <boost/log/expressions.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/basic_sink_backend.hpp>
+#include <boost/log/sinks/text_file_backend.hpp>
 #include <boost/log/sources/logger.hpp>
 #include <boost/log/support/date_time.hpp>
-#include <boost/log/utility/setup/file.hpp>
-#include <boost/log/utility/setup/console.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
 
 ///////////////////////////////////////////////////////////////////////////////
 // DEFINES and MACROS
 
+/// Records below this level are compiled out entirely. Define it before including this file to change it.
+#ifndef LOG_MIN_LEVEL
+    #define LOG_MIN_LEVEL logging::info
+#endif
+
+
 /// Logs something.
 #define LOG(level) LOG_NO_BEEP(level)
 
@@ -40,19 +54,20 @@
 
 
 // Logs something without a beep.
+// The stream expression is only evaluated if the record passes the compile-time
+// and the runtime severity filter. The console sink sets the color itself.
 #define LOG_NO_BEEP( level) \
-    logging::set_log_color( level); \
+    if( (level) < LOG_MIN_LEVEL) {} else \
     BOOST_LOG_SEV( logging::my_global_logger::get(), level)
 
 
-/// Logs something, also beeps in error, exception and beep_notification cases.
+/// Logs something, also beeps in error, exception and beep_notify cases.
 #define LOG_BEEP(level) \
-    set_log_color( level); \
-    if( level == logging::error || \
-        level == logging::exception || \
-        level == logging::beep_notification) \
+    if( (level) == logging::error || \
+        (level) == logging::exception || \
+        (level) == logging::beep_notify) \
             printf("\a"); \
-    BOOST_LOG_SEV( logging::my_global_logger::get(), level)
+    LOG_NO_BEEP(level)
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -71,6 +86,10 @@ namespace logging {
     };
 
 
+    /// Severity attribute keyword, used by filters and sinks.
+    BOOST_LOG_ATTRIBUTE_KEYWORD(severity, "Severity", log_level)
+
+
     /** Changes the console font colors according to the log_level.
      * @param level the log_level to set.
      */
@@ -131,34 +150,176 @@ namespace logging {
     }
 
 
+    /** @brief Sink backend that writes formatted records to the console
+     * in the color of their severity level.
+     */
+    class colored_console_backend : 
+        public boost::log::sinks::basic_formatted_sink_backend< char, 
+                                                                boost::log::sinks::combine_requirements< boost::log::sinks::synchronized_feeding, 
+                                                                                                         boost::log::sinks::flushing >::type > {
+    public: // methods
+
+        /** Writes a formatted record.
+         * @param rec The record.
+         * @param formatted The formatted record.
+         */
+        void consume( const boost::log::record_view& rec, const string_type& formatted) {
+            boost::log::value_ref< log_level, tag::severity > level = rec[severity];
+            set_log_color( level ? level.get() : info);
+            std::clog << formatted << '\n';
+        }
+
+        /** Flushes the console.
+         */
+        void flush() {
+            std::clog.flush();
+        }
+    };
+
+
+    /** @brief Sink backend that writes formatted records to a file.
+     * The file is flushed right after error and exception records
+     * and otherwise at least every max_flush_latency.
+     */
+    class file_backend : 
+        public boost::log::sinks::basic_formatted_sink_backend< char, 
+                                                                boost::log::sinks::combine_requirements< boost::log::sinks::synchronized_feeding, 
+                                                                                                         boost::log::sinks::flushing >::type > {
+    private: // vars
+
+        std::ofstream _fstream;                                         ///< The log file.
+        boost::chrono::milliseconds _max_flush_latency;                 ///< Maximum time between two flushes while records are written.
+        boost::chrono::steady_clock::time_point _last_flush;            ///< Time of the last flush.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param fname The name of the log file. Old contents are truncated.
+         * @param max_flush_latency Maximum time between two flushes while records are written.
+         */
+        file_backend( const std::string& fname, const boost::chrono::milliseconds max_flush_latency)
+            : _fstream( fname.c_str(), std::ios::out | std::ios::trunc),
+            _max_flush_latency( max_flush_latency),
+            _last_flush( boost::chrono::steady_clock::now())
+        {}
+
+    public: // methods
+
+        /** Writes a formatted record.
+         * @param rec The record.
+         * @param formatted The formatted record.
+         */
+        void consume( const boost::log::record_view& rec, const string_type& formatted) {
+            _fstream << formatted << '\n';
+
+            boost::log::value_ref< log_level, tag::severity > level = rec[severity];
+            const boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+            if( level && level.get() >= error || now - _last_flush >= _max_flush_latency) {
+                _fstream.flush();
+                _last_flush = now;
+            }
+        }
+
+        /** Flushes the log file.
+         */
+        void flush() {
+            _fstream.flush();
+            _last_flush = boost::chrono::steady_clock::now();
+        }
+    };
+
+
+    /// Asynchronous console sink.
+    typedef boost::log::sinks::asynchronous_sink< colored_console_backend > console_sink;
+    /// Asynchronous file sink.
+    typedef boost::log::sinks::asynchronous_sink< file_backend > file_sink;
+
+
+    /// @return The console sink, if the log is initialized.
+    inline boost::shared_ptr< console_sink >& get_console_sink() {
+        static boost::shared_ptr< console_sink > sink;
+        return sink;
+    }
+
+    /// @return The file sink, if the log is initialized.
+    inline boost::shared_ptr< file_sink >& get_file_sink() {
+        static boost::shared_ptr< file_sink > sink;
+        return sink;
+    }
+
+
+    /** Sets the minimum severity level of records to be logged at runtime.
+     * Records below the level are discarded before their messages are formatted.
+     * @param min_level The minimum log_level.
+     */
+    inline void set_min_log_level( const log_level min_level) {
+        boost::log::core::get()->set_filter( severity >= min_level);
+    }
+
+
+    /** Waits until all records that are logged so far are written and flushes the sinks.
+     */
+    inline void flush_log() {
+        if( get_console_sink())
+            get_console_sink()->flush();
+        if( get_file_sink())
+            get_file_sink()->flush();
+    }
+
+
+    /** Writes all pending records and stops the sinks' threads.
+     * Is called automatically at program exit.
+     */
+    inline void stop_log() {
+        boost::shared_ptr< boost::log::core > core = boost::log::core::get();
+        if( get_console_sink()) {
+            core->remove_sink( get_console_sink());
+            get_console_sink()->stop();
+            get_console_sink()->flush();
+            get_console_sink().reset();
+            reset_console_colors();
+        }
+        if( get_file_sink()) {
+            core->remove_sink( get_file_sink());
+            get_file_sink()->stop();
+            get_file_sink()->flush();
+            get_file_sink().reset();
+        }
+    }
+
+
     /** Initializes the log. Should be called at startup.
      * @param fname The name of the log-file.
+     * @param min_level The minimum severity level of records to be logged.
+     * @param max_flush_latency_ms Maximum time in milliseconds that a record may stay unflushed 
+     *        in the log file while records are written. Errors and exceptions are flushed immediately.
      */
-    void init_log( const std::string& fname) {
+    void init_log( const std::string& fname, const log_level min_level = info, const int max_flush_latency_ms = 1000) {
         using namespace boost;
         using namespace boost::posix_time;
         using namespace boost::log; // keywords
         using namespace boost::log::expressions; // stream, format_date_time, attr, message
-        using namespace boost::log::keywords; // format, file_name
 
         // console logging sink
-        boost::log::add_console_log (
-            std::clog, 
-            keywords::format = stream << "[" << format_date_time< ptime >("TimeStamp", "%H:%M:%S") << "]" <<
-                                         //"[" << attr< log_level >("Severity") << "]:" <<
-                                         " " << message);
+        get_console_sink() = boost::make_shared< console_sink >();
+        get_console_sink()->set_formatter( stream << "[" << format_date_time< ptime >("TimeStamp", "%H:%M:%S") << "]" <<
+                                                     //"[" << attr< log_level >("Severity") << "]:" <<
+                                                     " " << message);
+        boost::log::core::get()->add_sink( get_console_sink());
 
         // file logging sink
-        auto file_sink = boost::log::add_file_log (
-            keywords::file_name = fname,
-            keywords::auto_flush = true,
-            //keywords::filter = expr::attr< log_level >("Severity") >= warning,
-            keywords::format = stream << "[" << format_date_time< ptime >("TimeStamp", "%y-%m-%d, %H:%M:%S") << "]"
-                                         "[" << attr< log_level >("Severity") << "]:" <<
-                                         " " << message);
+        get_file_sink() = boost::make_shared< file_sink >( boost::make_shared< file_backend >( fname, chrono::milliseconds( max_flush_latency_ms)));
+        get_file_sink()->set_formatter( stream << "[" << format_date_time< ptime >("TimeStamp", "%y-%m-%d, %H:%M:%S") << "]"
+                                                  "[" << attr< log_level >("Severity") << "]:" <<
+                                                  " " << message);
+        boost::log::core::get()->add_sink( get_file_sink());
+
+        set_min_log_level( min_level);
 
         // add some commonly used attributes, like timestamp
         boost::log::add_common_attributes();
+
+        std::atexit( stop_log);
     
         BOOST_LOG_FUNCTION();
     }
@@ -167,4 +328,4 @@ namespace logging {
     // initializes the global logger
     BOOST_LOG_INLINE_GLOBAL_LOGGER_DEFAULT(my_global_logger, boost::log::sources::severity_logger_mt< log_level >)
 
-} // END namespace log
\ No newline at end of file
+} // END namespace log
@@ -0,0 +1,459 @@
+/******************************************************************************
+/* @file Quantized storage of row-wise feature vectors as 8 bit codes
+/*       or half precision floats, with matching distance kernels and a
+/*       binary file format.
+/*
+/* @author langenhagen
+/* @version 150703
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include <common.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <climits>
+#include <cstdint>
+#include <cstring> // memcpy
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /// Quantization types wrapping namespace.
+    namespace quantization_type {
+        /// Supported quantizations of feature vectors.
+        enum quantization_type {
+            NONE    = 0,    ///< full precision reals, no quantization
+            INT8    = 1,    ///< 8 bit codes with per-dimension scale and offset
+            FLOAT16 = 2     ///< IEEE 754 half precision floats
+        };
+    }
+
+
+    /** Retrieves a quantization_type from a given string.
+     * The check with the given string is not case sensitive.
+     * Logs an error message if the string is not a supported quantization_type.
+     * @param type A string containing a quantization_type member as a written string.
+     * @param[out] o_type The quantization type, if the string is supported.
+     * @return TRUE if the string is a supported quantization type, FALSE otherwise.
+     */
+    inline bool quantization_type_from_string( const string& type, quantization_type::quantization_type& o_type) {
+        const string t = to_lower( type);
+        if( t.compare("none") == 0 || t.empty())
+            o_type = quantization_type::NONE;
+        else if( t.compare("int8") == 0)
+            o_type = quantization_type::INT8;
+        else if( t.compare("float16") == 0)
+            o_type = quantization_type::FLOAT16;
+        else {
+            LOG( error) << FILE_LINE << "Given string \"" << type << "\" is not a supported quantization type.";
+            return false;
+        }
+        return true;
+    }
+
+
+    /** Generates a string with the names of the supported quantization types.
+     * @return a string with the supported quantization types.
+     */
+    inline string quantization_types_string() {
+        return "NONE, INT8, FLOAT16";
+    }
+
+
+    /** Converts a single precision float to a half precision float.
+     * Rounds to nearest even, handles subnormals, infinities and NaNs.
+     * @param f A float.
+     * @return The bit pattern of the half precision float.
+     */
+    inline std::uint16_t float_to_half( const float f) {
+        std::uint32_t x;
+        std::memcpy( &x, &f, sizeof(x));
+        const std::uint32_t sign = (x >> 16) & 0x8000;
+        const int exponent = static_cast<int>((x >> 23) & 0xff) - 127 + 15;
+        std::uint32_t mantissa = x & 0x7fffff;
+
+        if( (x & 0x7fffffff) > 0x7f800000)      // NaN
+            return static_cast<std::uint16_t>(sign | 0x7e00);
+        if( exponent >= 31)                     // overflow and infinity
+            return static_cast<std::uint16_t>(sign | 0x7c00);
+        if( exponent <= 0) {                    // subnormal half or zero
+            if( exponent < -10)
+                return static_cast<std::uint16_t>(sign);
+            mantissa |= 0x800000;
+            const std::uint32_t shift = 14 - exponent;
+            std::uint32_t h = mantissa >> shift;
+            const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+            const std::uint32_t halfway = 1u << (shift - 1);
+            if( remainder > halfway || remainder == halfway && (h & 1))
+                ++h;
+            return static_cast<std::uint16_t>(sign | h);
+        }
+        std::uint32_t h = sign | (exponent << 10) | (mantissa >> 13);
+        const std::uint32_t remainder = mantissa & 0x1fff;
+        if( remainder > 0x1000 || remainder == 0x1000 && (h & 1))
+            ++h; // a carry into the exponent yields the correct result, up to infinity
+        return static_cast<std::uint16_t>(h);
+    }
+
+
+    /** Converts a half precision float to a single precision float.
+     * @param h The bit pattern of a half precision float.
+     * @return The exactly corresponding float.
+     */
+    inline float half_to_float( const std::uint16_t h) {
+        const std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+        int exponent = (h >> 10) & 0x1f;
+        std::uint32_t mantissa = h & 0x3ff;
+        std::uint32_t x;
+
+        if( exponent == 0) {
+            if( mantissa == 0) {
+                x = sign;
+            } else {
+                // normalize subnormal half
+                exponent = 1;
+                while( !(mantissa & 0x400)) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                mantissa &= 0x3ff;
+                x = sign | (static_cast<std::uint32_t>(exponent + 127 - 15) << 23) | (mantissa << 13);
+            }
+        } else if( exponent == 31) {
+            x = sign | 0x7f800000 | (mantissa << 13);
+        } else {
+            x = sign | (static_cast<std::uint32_t>(exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+        float f;
+        std::memcpy( &f, &x, sizeof(f));
+        return f;
+    }
+
+
+    /** @brief Row-wise feature vectors in a quantized representation.
+     * INT8 stores each value as an 8 bit code c with value = offset[d] + scale[d] * c,
+     * where scale and offset span the range of dimension d.
+     * FLOAT16 stores each value as a half precision float; scale and offset are 1 and 0.
+     * The distance kernels work directly on the codes.
+     */
+    class QuantizedMat {
+
+    private: // vars
+
+        quantization_type::quantization_type _type; ///< The quantization type.
+        cv::Mat _codes;                             ///< rows x cols codes, CV_8U for INT8, CV_16U for FLOAT16.
+        Vec1r _scale;                               ///< Per-dimension scale.
+        Vec1r _offset;                              ///< Per-dimension offset.
+
+    public: // constructor & destructor
+
+        /** Default constructor. Creates an empty matrix.
+         */
+        QuantizedMat()
+            : _type( quantization_type::NONE)
+        {}
+
+        /** Main constructor. Quantizes the given features.
+         * @param features Row-wise feature vectors.
+         * @param type The quantization type. Must not be NONE.
+         */
+        QuantizedMat( const Mat1r& features, const quantization_type::quantization_type type)
+            : _type( type),
+            _scale( features.cols, real(1)),
+            _offset( features.cols, real(0)) {
+            assert( type != quantization_type::NONE && "a quantized matrix needs a quantization type");
+
+            if( _type == quantization_type::INT8) {
+                _codes.create( features.rows, features.cols, CV_8U);
+                for( int c=0; c<features.cols; ++c) {
+                    double min, max;
+                    cv::minMaxLoc( features.col(c), &min, &max);
+                    _offset[c] = static_cast<real>(min);
+                    _scale[c] = max > min ? static_cast<real>((max - min) / 255) : 1;
+                }
+                for( int r=0; r<features.rows; ++r) {
+                    const real* f = features[r];
+                    uchar* code = _codes.ptr<uchar>(r);
+                    for( int c=0; c<features.cols; ++c)
+                        code[c] = cv::saturate_cast<uchar>( (f[c] - _offset[c]) / _scale[c]);
+                }
+            } else {
+                _codes.create( features.rows, features.cols, CV_16U);
+                for( int r=0; r<features.rows; ++r) {
+                    const real* f = features[r];
+                    std::uint16_t* code = _codes.ptr<std::uint16_t>(r);
+                    for( int c=0; c<features.cols; ++c)
+                        code[c] = float_to_half( f[c]);
+                }
+            }
+        }
+
+        /** Constructor from already quantized data, e.g. from a file.
+         * @param type The quantization type. Must not be NONE.
+         * @param codes The codes, CV_8U for INT8 and CV_16U for FLOAT16.
+         * @param scale The per-dimension scale.
+         * @param offset The per-dimension offset.
+         */
+        QuantizedMat( const quantization_type::quantization_type type, const cv::Mat& codes, const Vec1r& scale, const Vec1r& offset)
+            : _type( type),
+            _codes( codes),
+            _scale( scale),
+            _offset( offset) {
+            assert( codes.depth() == (type == quantization_type::INT8 ? CV_8U : CV_16U) && "codes must match the quantization type");
+            assert( scale.size() == codes.cols && offset.size() == codes.cols && "scale and offset need one value per dimension");
+        }
+
+    public: // methods
+
+        /// @return The quantization type.
+        quantization_type::quantization_type type() const { return _type; }
+
+        /// @return The number of feature vectors.
+        int rows() const { return _codes.rows; }
+
+        /// @return The dimensionality of the feature vectors.
+        int cols() const { return _codes.cols; }
+
+        /// @return TRUE if the matrix holds no feature vectors.
+        bool empty() const { return _codes.empty(); }
+
+        /// @return The codes.
+        const cv::Mat& codes() const { return _codes; }
+
+        /// @return The per-dimension scale.
+        const Vec1r& scale() const { return _scale; }
+
+        /// @return The per-dimension offset.
+        const Vec1r& offset() const { return _offset; }
+
+
+        /** Reconstructs one feature vector.
+         * @param r The row index.
+         * @param[out] o_features Buffer of at least cols() elements.
+         */
+        void dequantize_row( const int r, real* o_features) const {
+            const int n = _codes.cols;
+            if( _type == quantization_type::INT8) {
+                const uchar* code = _codes.ptr<uchar>(r);
+                for( int c=0; c<n; ++c)
+                    o_features[c] = _offset[c] + _scale[c] * code[c];
+            } else {
+                const std::uint16_t* code = _codes.ptr<std::uint16_t>(r);
+                for( int c=0; c<n; ++c)
+                    o_features[c] = half_to_float( code[c]);
+            }
+        }
+
+
+        /** Reconstructs one element of a feature vector.
+         * @param r The row index.
+         * @param c The column index.
+         * @return The reconstructed element.
+         */
+        real dequantize( const int r, const int c) const {
+            if( _type == quantization_type::INT8)
+                return _offset[c] + _scale[c] * _codes.ptr<uchar>(r)[c];
+            else
+                return half_to_float( _codes.ptr<std::uint16_t>(r)[c]);
+        }
+
+
+        /** Reconstructs all feature vectors.
+         * @param[out] o_features The row-wise feature vectors.
+         */
+        void dequantize( Mat1r& o_features) const {
+            o_features.create( _codes.rows, _codes.cols);
+            for( int r=0; r<_codes.rows; ++r)
+                dequantize_row( r, o_features[r]);
+        }
+
+
+        /** Asymmetric squared euclidean distance between a quantized feature vector
+         * and a full precision vector, e.g. a cluster center.
+         * @param r The row index of the quantized feature vector.
+         * @param x A full precision vector with cols() elements.
+         * @return The squared euclidean distance.
+         */
+        real squared_distance( const int r, const real* x) const {
+            const int n = _codes.cols;
+            real ret(0);
+            if( _type == quantization_type::INT8) {
+                const uchar* code = _codes.ptr<uchar>(r);
+                const real* scale = &_scale[0];
+                const real* offset = &_offset[0];
+                for( int c=0; c<n; ++c) {
+                    const real d = offset[c] + scale[c] * code[c] - x[c];
+                    ret += d*d;
+                }
+            } else {
+                const std::uint16_t* code = _codes.ptr<std::uint16_t>(r);
+                for( int c=0; c<n; ++c) {
+                    const real d = half_to_float( code[c]) - x[c];
+                    ret += d*d;
+                }
+            }
+            return ret;
+        }
+
+
+        /** Symmetric squared euclidean distance between two quantized feature vectors.
+         * For INT8, only the code differences are scaled, the offsets cancel out.
+         * @param a The row index of the first feature vector.
+         * @param b The row index of the second feature vector.
+         * @return The squared euclidean distance.
+         */
+        real squared_distance( const int a, const int b) const {
+            const int n = _codes.cols;
+            real ret(0);
+            if( _type == quantization_type::INT8) {
+                const uchar* code_a = _codes.ptr<uchar>(a);
+                const uchar* code_b = _codes.ptr<uchar>(b);
+                const real* scale = &_scale[0];
+                for( int c=0; c<n; ++c) {
+                    const real d = scale[c] * (static_cast<int>(code_a[c]) - static_cast<int>(code_b[c]));
+                    ret += d*d;
+                }
+            } else {
+                const std::uint16_t* code_a = _codes.ptr<std::uint16_t>(a);
+                const std::uint16_t* code_b = _codes.ptr<std::uint16_t>(b);
+                for( int c=0; c<n; ++c) {
+                    const real d = half_to_float( code_a[c]) - half_to_float( code_b[c]);
+                    ret += d*d;
+                }
+            }
+            return ret;
+        }
+    };
+
+
+    /// Magic number at the beginning of quantized feature files.
+    const char QUANTIZED_FILE_MAGIC[4] = { 'A', 'Q', 'F', '1' };
+
+
+    /** Checks whether the given file is a quantized feature file.
+     * @param fname The path to the file.
+     * @return TRUE if the file starts with the quantized feature file magic number, FALSE otherwise.
+     */
+    inline bool is_quantized_file( const std::string& fname) {
+        std::ifstream in_file( fname, std::ios::in | std::ios::binary);
+        char magic[4];
+        return in_file.read( magic, 4) && std::memcmp( magic, QUANTIZED_FILE_MAGIC, 4) == 0;
+    }
+
+
+    /** Writes a quantized matrix to a binary file.
+     * The format is: magic number, type, rows and cols as 32 bit unsigned integers,
+     * cols scale values, cols offset values as floats and the row-wise codes.
+     * Truncates all old entries in that given file.
+     * @param fname The name of the file to be written to.
+     * @param mat The quantized matrix.
+     * @param error_open_callback The function that is called when opening the file fails.
+     *        It takes a string (the filename) as an argument.
+     * @param error_write_callback The function that is called when writing to the file fails.
+     *        It takes a string (the filename) as an argument.
+     * @return TRUE in case of success,
+     *         FALSE in case of error.
+     */
+    inline bool to_file( const std::string& fname,
+                         const QuantizedMat& mat,
+                         std::function< void(const std::string&) > error_open_callback = on_open_file_error,
+                         std::function< void(const std::string&) > error_write_callback = on_write_file_error) {
+        std::ofstream fstream( fname, std::ios::out | std::ios::trunc | std::ios::binary);
+        if(!fstream.is_open() || fstream.bad()) {
+            error_open_callback(fname);
+            return false;
+        }
+        const std::uint32_t header[] = { static_cast<std::uint32_t>(mat.type()),
+                                         static_cast<std::uint32_t>(mat.rows()),
+                                         static_cast<std::uint32_t>(mat.cols()) };
+        fstream.write( QUANTIZED_FILE_MAGIC, 4);
+        fstream.write( reinterpret_cast<const char*>(header), sizeof(header));
+        fstream.write( reinterpret_cast<const char*>(&mat.scale()[0]), mat.cols() * sizeof(real));
+        fstream.write( reinterpret_cast<const char*>(&mat.offset()[0]), mat.cols() * sizeof(real));
+        const std::size_t row_bytes = mat.cols() * mat.codes().elemSize();
+        for( int r=0; r<mat.rows() && !fstream.bad(); ++r)
+            fstream.write( reinterpret_cast<const char*>(mat.codes().ptr(r)), row_bytes);
+
+        if( fstream.bad()) {
+            error_write_callback(fname);
+            return false;
+        }
+        return true;
+    }
+
+
+    /** Reads a quantized matrix from a binary file written by to_file().
+     * Rejects files whose size does not match the header.
+     * @param fname The path to the file where the matrix is stored.
+     * @param[out] out_mat The quantized matrix.
+     * @param error_open_callback The function that is to be called when the file could not be openend.
+     *        It takes a string as an argument which will be set to the original given filename.
+     * @param error_invalid_mat_callback The function that is called when the file is no valid quantized matrix file.
+     *        It takes the filename and the line, i.e. the row at which the error occured (-1 for the header), as arguments.
+     * @return TRUE in case of success,
+     *         FALSE in case of error.
+     */
+    inline bool from_file( const std::string& fname,
+                           QuantizedMat& out_mat,
+                           std::function< void(const std::string&) > error_open_callback = on_open_file_error,
+                           std::function< void(const std::string&, const int line) > error_invalid_mat_callback = on_invalid_mat) {
+        out_mat = QuantizedMat();
+        std::ifstream in_file( fname, std::ios::in | std::ios::binary);
+        if( !in_file.is_open()) {
+            error_open_callback( fname);
+            return false;
+        }
+
+        char magic[4];
+        std::uint32_t header[3]; // type, rows, cols
+        if( !in_file.read( magic, 4) ||
+            std::memcmp( magic, QUANTIZED_FILE_MAGIC, 4) != 0 ||
+            !in_file.read( reinterpret_cast<char*>(header), sizeof(header)) ||
+            header[0] != quantization_type::INT8 && header[0] != quantization_type::FLOAT16) {
+
+            error_invalid_mat_callback( fname, -1);
+            return false;
+        }
+        const quantization_type::quantization_type type = static_cast<quantization_type::quantization_type>(header[0]);
+
+        // the sizes must fit into ints and account for the whole file, before anything is allocated
+        const std::uint64_t code_size = type == quantization_type::INT8 ? sizeof(uchar) : sizeof(std::uint16_t);
+        in_file.seekg( 0, std::ios::end);
+        const std::uint64_t actual_size = static_cast<std::uint64_t>(in_file.tellg());
+        in_file.seekg( static_cast<std::streamoff>(4 + sizeof(header)), std::ios::beg);
+        if( header[1] > INT_MAX || header[2] > INT_MAX ||
+            actual_size != 4 + sizeof(header) + std::uint64_t(header[2]) * (2 * sizeof(real) + std::uint64_t(header[1]) * code_size)) {
+
+            error_invalid_mat_callback( fname, -1);
+            return false;
+        }
+        const int rows = static_cast<int>(header[1]);
+        const int cols = static_cast<int>(header[2]);
+
+        Vec1r scale( cols), offset( cols);
+        cv::Mat codes( rows, cols, type == quantization_type::INT8 ? CV_8U : CV_16U);
+        if( cols > 0 &&
+            (!in_file.read( reinterpret_cast<char*>(&scale[0]), cols * sizeof(real)) ||
+             !in_file.read( reinterpret_cast<char*>(&offset[0]), cols * sizeof(real)))) {
+
+            error_invalid_mat_callback( fname, -1);
+            return false;
+        }
+        const std::size_t row_bytes = cols * codes.elemSize();
+        for( int r=0; r<rows; ++r) {
+            if( !in_file.read( reinterpret_cast<char*>(codes.ptr(r)), row_bytes)) {
+                error_invalid_mat_callback( fname, r);
+                return false;
+            }
+        }
+        out_mat = QuantizedMat( type, codes, scale, offset);
+        return true;
+    }
+}
@@ -0,0 +1,222 @@
+/******************************************************************************
+/* @file Per-image context that is shared between the saliency detector
+/*       and the feature extractors.
+/*
+/* @author langenhagen
+/* @version 150701
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include <common.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /** @brief Holds one image and everything that is derived from it during processing.
+     * Color space conversions, the region of interest and contour properties are
+     * computed on their first use and memoized, so that the saliency detector and all
+     * feature extractors share them instead of computing them again.
+     * The lazy getters are thread safe, so composed feature extractors may run
+     * their sub-extractors concurrently on the same context.
+     */
+    class ImageContext {
+
+    private: // vars
+
+        Mat3b _image;                           ///< The original BGR image.
+        Mat1b _saliency_map;                    ///< The grayscale saliency map.
+        Mat1b _saliency_mask;                   ///< The b/w mask of the salient regions.
+        vector<Contour> _contours;              ///< The contours of the salient regions.
+        mutable vector<double> _contour_areas;  ///< The areas of the contours.
+
+        mutable Mat3r _float_image;             ///< BGR image with float values in [0..255].
+        mutable Mat3r _unit_float_image;        ///< BGR image with float values in [0..1].
+        mutable Mat3r _lab_image;               ///< Lab image, converted from the unit float image.
+        mutable Mat3r _hsv_image;               ///< HSV image, converted from the float image.
+        mutable cv::Rect _roi;                  ///< Bounding box of all contours.
+        mutable bool _has_roi;                  ///< Whether _roi has been computed yet.
+        mutable vector<cv::Moments> _contour_moments; ///< The moments of the contours.
+        mutable int _biggest_contour_index;     ///< Index of the contour with the biggest area or -1 if not computed yet.
+
+        mutable boost::mutex _mutex;            ///< Guards the memoized members.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param image The BGR image to process. The data is shared, not copied.
+         */
+        explicit ImageContext( const Mat3b& image)
+            : _image(image),
+            _has_roi(false),
+            _biggest_contour_index(-1)
+        {}
+
+    private: // constructor & destructor
+
+        /// Not copyable.
+        ImageContext( const ImageContext&);
+        /// Not assignable.
+        ImageContext& operator=( const ImageContext&);
+
+    public: // methods
+
+        /** Sets the saliency map of the image.
+         * @param saliency_map A grayscale saliency map of the same dimensions as the image.
+         */
+        void set_saliency_map( const Mat1b& saliency_map) {
+            assert( saliency_map.size() == _image.size() && "image and saliency map must have same dimensions");
+            _saliency_map = saliency_map;
+        }
+
+        /** Sets the saliency mask and its contours. Invalidates everything derived from the contours.
+         * @param saliency_mask A b/w mask of the smoothed and thresholded saliency map.
+         * @param contours Contours that match the saliency_mask.
+         * @param contour_areas The areas of the contours. If it does not match the contours,
+         *        the areas will be computed on their first use.
+         */
+        void set_salient_regions( const Mat1b& saliency_mask, const vector<Contour>& contours, const vector<double>& contour_areas) {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            _saliency_mask = saliency_mask;
+            _contours = contours;
+            _contour_areas = contour_areas.size() == contours.size() ? contour_areas : vector<double>();
+            _contour_moments.clear();
+            _has_roi = false;
+            _biggest_contour_index = -1;
+        }
+
+        /// @return The original BGR image.
+        const Mat3b& image() const { return _image; }
+
+        /// @return The grayscale saliency map.
+        const Mat1b& saliency_map() const { return _saliency_map; }
+
+        /// @return The b/w mask of the salient regions.
+        const Mat1b& saliency_mask() const { return _saliency_mask; }
+
+        /// @return The contours of the salient regions.
+        const vector<Contour>& contours() const { return _contours; }
+
+
+        /** @return The BGR image with float values in [0..255].
+         */
+        const Mat3r& float_image() const {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            return get_float_image();
+        }
+
+        /** @return The BGR image with float values in [0..1].
+         */
+        const Mat3r& unit_float_image() const {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            return get_unit_float_image();
+        }
+
+        /** @return The image in the Lab color space, converted from the unit float image.
+         */
+        const Mat3r& lab_image() const {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            if( _lab_image.empty())
+                cv::cvtColor( get_unit_float_image(), _lab_image, CV_BGR2Lab);
+            return _lab_image;
+        }
+
+        /** @return The image in the HSV color space, converted from the float image.
+         *          Thus, h is in [0..360], s in [0..1] and v in [0..255].
+         */
+        const Mat3r& hsv_image() const {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            if( _hsv_image.empty())
+                cv::cvtColor( get_float_image(), _hsv_image, CV_BGR2HSV);
+            return _hsv_image;
+        }
+
+        /** @return The bounding box of all contours.
+         *          An empty rectangle if there are no contours.
+         */
+        const cv::Rect& roi() const {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            if( !_has_roi) {
+                _roi = cv::Rect();
+                for( auto it=_contours.begin(); it!=_contours.end(); ++it)
+                    _roi = _roi.area() == 0 ? cv::boundingRect( *it) : _roi | cv::boundingRect( *it);
+                _has_roi = true;
+            }
+            return _roi;
+        }
+
+        /** @return The areas of the contours.
+         */
+        const vector<double>& contour_areas() const {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            return get_contour_areas();
+        }
+
+        /** @return The moments of the contours.
+         */
+        const vector<cv::Moments>& contour_moments() const {
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            if( _contour_moments.size() != _contours.size()) {
+                _contour_moments.clear();
+                for( auto it=_contours.begin(); it!=_contours.end(); ++it)
+                    _contour_moments.push_back( cv::moments( *it));
+            }
+            return _contour_moments;
+        }
+
+        /** Retrieves the biggest contour. There must be at least one contour.
+         * @return A reference to the contour with the biggest area.
+         */
+        const Contour& biggest_contour() const {
+            assert( !_contours.empty() && "there must be at least one contour");
+            boost::lock_guard<boost::mutex> lock( _mutex);
+            if( _biggest_contour_index < 0) {
+                const vector<double>& areas = get_contour_areas();
+                _biggest_contour_index = static_cast<int>(std::max_element( areas.begin(), areas.end()) - areas.begin());
+            }
+            return _contours[_biggest_contour_index];
+        }
+
+    private: // helpers
+
+        /** Computes the float image if necessary. The mutex must be held.
+         * @return The BGR image with float values in [0..255].
+         */
+        const Mat3r& get_float_image() const {
+            if( _float_image.empty())
+                _image.convertTo( _float_image, CV_32F);
+            return _float_image;
+        }
+
+        /** Computes the unit float image if necessary. The mutex must be held.
+         * @return The BGR image with float values in [0..1].
+         */
+        const Mat3r& get_unit_float_image() const {
+            if( _unit_float_image.empty())
+                _image.convertTo( _unit_float_image, CV_32F, 1.0/255);
+            return _unit_float_image;
+        }
+
+        /** Computes the contour areas if necessary. The mutex must be held.
+         * @return The areas of the contours.
+         */
+        const vector<double>& get_contour_areas() const {
+            if( _contour_areas.size() != _contours.size()) {
+                _contour_areas.clear();
+                for( auto it=_contours.begin(); it!=_contours.end(); ++it)
+                    _contour_areas.push_back( cv::contourArea( *it));
+            }
+            return _contour_areas;
+        }
+    };
+}
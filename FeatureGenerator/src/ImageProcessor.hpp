@@ -11,10 +11,12 @@
 
 #include <program_options.hpp>
 #include <global_stats.hpp>
+#include <ImageContext.hpp>
 #include <saliency/SaliencyFilters.hpp>
 #include <extractor/HistogramExtractor.hpp>
 #include <extractor/ContourExtractor.hpp>
 #include <extractor/ContourHistogramExtractor.hpp>
+#include <extractor/StaticFeatureExtractor.hpp>
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
@@ -47,6 +49,8 @@ namespace app {
         SaliencyDetector* _saliency_detector;
         /// The feature extractor.
         FeatureExtractor* _feature_extractor;
+        /// Feature vector buffer. Reused for every image, so that it is allocated only once.
+        Vec1r _features;
 
         /// Feature vector file stream. Remains open for the whole lifetime of the ProcessingChain object.
         std::ofstream _features_fstream;
@@ -77,18 +81,24 @@ namespace app {
                 
                 _saliency_detector = new SaliencyFilters(params.sdd);
                 
-                switch( params.fed.type) {
-                case extractor_type::HISTOGRAM:
-                    _feature_extractor = new HistogramExtractor( params.fed);
-                    break;
-                case extractor_type::CONTOUR:
-                    _feature_extractor = new ContourExtractor( params.fed);
-                    break;
-                case extractor_type::CONTOUR_HISTOGRAM:
-                    _feature_extractor = new ContourHistogramExtractor( params.fed);
-                    break;
-                default:
-                    LOG(error) << FILE_LINE << "Unsupported feature_type " << params.fed.type << " aka " << params.fed.type_string << "!";
+                // prefer a compiled pipeline, fall back to the configurable extractors otherwise
+                _feature_extractor = create_static_feature_extractor( params.fed);
+                if( _feature_extractor != nullptr) {
+                    LOG(info) << "Using compiled feature extractor pipeline for " << params.fed.type_string << " \"" << params.fed.tweak_vector_string << "\".";
+                } else {
+                    switch( params.fed.type) {
+                    case extractor_type::HISTOGRAM:
+                        _feature_extractor = new HistogramExtractor( params.fed);
+                        break;
+                    case extractor_type::CONTOUR:
+                        _feature_extractor = new ContourExtractor( params.fed);
+                        break;
+                    case extractor_type::CONTOUR_HISTOGRAM:
+                        _feature_extractor = new ContourHistogramExtractor( params.fed);
+                        break;
+                    default:
+                        LOG(error) << FILE_LINE << "Unsupported feature_type " << params.fed.type << " aka " << params.fed.type_string << "!";
+                    }
                 }
 
                 if(!_features_fstream.is_open() || _features_fstream.bad()) {
@@ -123,6 +133,16 @@ namespace app {
 
     public: // methods
 
+        /** Flushes all output file streams, e.g. before their files are read again.
+         */
+        void flush() {
+            _features_fstream.flush();
+            _processed_images_fstream.flush();
+            _garbage_images_fstream.flush();
+            _saliency_maps_fstream.flush();
+            _saliency_masks_fstream.flush();
+        }
+
         /** Starts the processing chain for one image file.
          * It calculates the salient region, extracts a salient object feature vector 
          * and stores it on the hard disk.
@@ -134,17 +154,21 @@ namespace app {
             bool ret(true);
             Mat1b saliency_map, saliency_mask;
             vector<Contour> contours;
-            Vec1r features;
+            vector<double> contour_areas;
+            Vec1r& features = _features;
+            ImageContext context( image);  // shares memoized image representations between all processing steps
 
             try {
-                saliency_map = _saliency_detector->saliency(image);
+                saliency_map = _saliency_detector->saliency(context);
             } catch( std::exception& e) {
                 saliency_map = Mat1b::zeros(image.rows, image.cols);
                 LOG(exception) << "Failed to extract saliency map!\n" << 
                                   e.what();
             }
 
-            saliency_mask = generate_saliency_mask( image, saliency_map, contours);
+            saliency_mask = generate_saliency_mask( image, saliency_map, contours, contour_areas);
+            context.set_saliency_map( saliency_map);
+            context.set_salient_regions( saliency_mask, contours, contour_areas);
             
             if(contours.size() == 0) {
                 // *** no salient region found ***
@@ -154,7 +178,7 @@ namespace app {
                 // *** salient regions found ***
                 return_error_code::return_error_code ec = return_error_code::UNSPECIFIED_ERROR;
                 try {
-                    ec = _feature_extractor->extract(image, saliency_map, saliency_mask, contours, features);
+                    ec = _feature_extractor->extract(context, features);
                 } catch( std::exception& e) {
                     LOG(exception) << "Failed to extract feature vector!\n" << 
                                       e.what();
@@ -287,9 +311,10 @@ namespace app {
          * @param image The original image.
          * @param saliency_map A grayscale image.
          * @param[out] o_contours Reference to a variable that shall store the saliency_masks contours.
+         * @param[out] o_contour_areas Reference to a variable that shall store the areas of the contours.
          * @return Returns a simplified saliency 8 bit Uchar b/w mask.
          */
-        Mat1b generate_saliency_mask( const Mat3b& image, const Mat1b& saliency_map, vector<Contour>& o_contours) {
+        Mat1b generate_saliency_mask( const Mat3b& image, const Mat1b& saliency_map, vector<Contour>& o_contours, vector<double>& o_contour_areas) {
             using namespace cv;
             Mat1b ret;
 
@@ -305,7 +330,7 @@ namespace app {
             }
 
             // *** smoothed top-level contours left ***            
-            o_contours = generate_contours( ret);
+            o_contours = generate_contours( ret, o_contour_areas);
             ret = Mat::zeros(ret.rows, ret.cols, CV_8UC1);
             drawContours(ret, o_contours, -1, cv::Scalar(255), CV_FILLED);
             return ret;
@@ -345,19 +370,29 @@ namespace app {
         /** Generates top level contours from the saliency mask and the values specified 
          * in the member variable params.
          * @param saliency_mask The saliency mask from which to derive the contours.
+         * @param[out] o_contour_areas Reference to a variable that shall store the areas of the returned contours,
+         *             so that they need not be computed again by the feature extractors.
          * @return A vector of all top-level contours of a sufficient size.
          */
-        vector<Contour> generate_contours( const Mat1b& saliency_mask) {
+        vector<Contour> generate_contours( const Mat1b& saliency_mask, vector<double>& o_contour_areas) {
             using namespace cv;
             vector<Contour> ret;
+            vector<Contour> all_contours;
+            o_contour_areas.clear();
             
             vector<Vec4i> hierarchy;
-            findContours( saliency_mask, ret, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0) );
-            for( int i=static_cast<int>(ret.size()-1); i >=0; --i) {
+            findContours( saliency_mask, all_contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0) );
+            for( uint i=0; i<all_contours.size(); ++i) {
                 // just keep top-level contours of sufficient size
-                if( parent(hierarchy, i) != -1 || contourArea( ret[i]) < params.min_salient_region_size) {
-                    ret.erase( ret.begin() + i);
-                }
+                if( parent(hierarchy, i) != -1)
+                    continue;
+                const double area = contourArea( all_contours[i]);
+                if( area < params.min_salient_region_size)
+                    continue;
+
+                ret.push_back( Contour());
+                ret.back().swap( all_contours[i]);
+                o_contour_areas.push_back( area);
             }
             return ret;
         }
@@ -30,21 +30,33 @@ namespace app {
                 check_and_resolve_input_errors();
         }
 
-    private: // methods
+    public: // static kernels
 
-        /// @see FeatureExtractor::do_extract()
-        /// Creates a normalized fourier descriptor and uses that as the feature vector.
-        virtual return_error_code::return_error_code do_extract( const Mat3r& original_image, const Mat1b& saliency_map, const Mat1b& saliency_mask, const vector<Contour>& contours, Vec1r& o_features) const {
-            using namespace cv;
-            assert( original_image.size() == saliency_map.size() && "original image and saliency map must have same dimensions");
+        /** Computes the number of features that fourier_descriptor_features() writes.
+         * @param n_frequencies The number of frequencies stored in the descriptor.
+         * @return The number of features.
+         */
+        static uint n_features( const uint n_frequencies) {
+            return n_frequencies + n_frequencies%2 - 2;
+        }
+
+
+        /** Creates a normalized fourier descriptor of the biggest contour of an image context 
+         * and writes it to a preallocated feature buffer.
+         * Shared by the ContourExtractor and the compile-time extractor pipeline.
+         * @param context The image context. Must contain at least one contour.
+         * @param n_frequencies The number of frequencies to store in the descriptor.
+         * @param n_resampling_points The number of points to resample the contour to, 0 disables resampling.
+         * @param[out] o_features Buffer of at least n_features( n_frequencies) elements.
+         * @return A return error code.
+         */
+        static return_error_code::return_error_code fourier_descriptor_features( const ImageContext& context, const uint n_frequencies, const uint n_resampling_points, real* o_features) {
             return_error_code::return_error_code ret( return_error_code::SUCCESS);
-            o_features.clear();
-            
-            const uint n_frequencies = static_cast<uint>(description.tweak_vector[0]);
-            const Contour& biggest_contour = find_biggest_contour( contours);
+            const Contour& biggest_contour = context.biggest_contour();
             
-            Mat1r fd = normalized_fourier_descriptor( biggest_contour, n_frequencies);
-            // copy fourier descriptor to output-vector
+            Mat1r fd = n_resampling_points == 0 ? normalized_fourier_descriptor( biggest_contour, n_frequencies)
+                                                : resampled_fourier_descriptor( biggest_contour, n_frequencies, n_resampling_points);
+            // copy fourier descriptor to output-buffer
             // since the first two elements of fd are really just normalized to 0 and 1 we can really just skip them
             for(int c=2; c<fd.cols; ++c) {
 
@@ -54,31 +66,25 @@ namespace app {
                 if( is_inf(v))  ret = return_error_code::INFINITE_NUMBER_ERROR;
                 if( is_nan(v))  ret = return_error_code::NAN_ERROR;
 
-                o_features.push_back(v);
+                o_features[c-2] = v;
             }
             return ret;
         }
 
-        
-    protected: // helpers
+    private: // methods
 
-        /** Retrieves the biggest contour of a vector of contours.
-         * @param contours A vector of contours.
-         * @return A reference to the biggest contour.
-         */
-        const Contour& find_biggest_contour( const vector<Contour>& contours) const {
-            vector<Contour>::const_iterator biggest_contour_it = contours.begin();
-            double biggest_contour_area = cv::contourArea( *biggest_contour_it);
-            for( auto contour_it=contours.begin()+1; contour_it!=contours.end(); ++contour_it) {
-                double area = contourArea( *contour_it);
-                if( area > biggest_contour_area) {
-                    biggest_contour_area = area;
-                    biggest_contour_it = contour_it;
-                }
-            }
-            return *biggest_contour_it;
+        /// @see FeatureExtractor::do_extract()
+        /// Creates a normalized fourier descriptor and uses that as the feature vector.
+        virtual return_error_code::return_error_code do_extract( const ImageContext& context, Vec1r& o_features) const {
+            const uint n_frequencies = static_cast<uint>(description.tweak_vector[0]);
+            const uint n_resampling_points = static_cast<uint>(description.tweak_vector[1]);
+
+            o_features.resize( n_features( n_frequencies));
+            return fourier_descriptor_features( context, n_frequencies, n_resampling_points, &o_features[0]);
         }
 
+        
+    protected: // helpers
 
         /** Creates a normalized fourier descriptor from a given contour.
          * The descriptor will be made translation invariant, scale-invariant.
@@ -88,11 +94,11 @@ namespace app {
          * @param contour The contour from which to generate the descriptor.
          * @param n_frequencies The number of frequencies to store in the descriptor.
          */
-        Mat1r normalized_fourier_descriptor( const Contour& contour, uint n_frequencies) const {
+        static Mat1r normalized_fourier_descriptor( const Contour& contour, uint n_frequencies) {
             if (n_frequencies%2 != 0)
 		        n_frequencies++;
             Mat2r fd(1, static_cast<int>(contour.size()));
-            Mat2r normalized_fd( 1, n_frequencies);
+            Mat2r normalized_fd = Mat2r::zeros( 1, n_frequencies);
     
             for( int c=0; c<fd.cols; ++c) {
                 fd(0, c)[0] = (float)contour[c].x;
@@ -114,6 +120,55 @@ namespace app {
                 normalized_fd(0, n_frequencies-1 - i)[1] = fd(0, fd.cols-1 - i)[1] / radius;
             }
 
+            return rotation_invariant_descriptor( normalized_fd);
+        }
+
+
+        /** Creates a normalized fourier descriptor from a given contour like normalized_fourier_descriptor(),
+         * but resamples the contour to a fixed number of points equally spaced by arc length first and
+         * evaluates only the frequencies that are kept in the descriptor (with the Goertzel algorithm).
+         * Thus, the cost does not depend on the number of contour points anymore and the descriptor
+         * does not depend on the contour's point density.
+         * @param contour The contour from which to generate the descriptor.
+         * @param n_frequencies The number of frequencies to store in the descriptor.
+         * @param n_resampling_points The number of points to resample the contour to. 
+         *        Should be a power of two and at least n_frequencies.
+         * @see normalized_fourier_descriptor()
+         */
+        static Mat1r resampled_fourier_descriptor( const Contour& contour, uint n_frequencies, const uint n_resampling_points) {
+            if (n_frequencies%2 != 0)
+		        n_frequencies++;
+            Mat2r normalized_fd = Mat2r::zeros( 1, n_frequencies);
+            vector<cv::Point2d> samples;
+            resample_by_arc_length( contour, n_resampling_points, samples);
+
+            const cv::Point2d first = goertzel( samples, 1);
+            const double radius = sqrt( first.x*first.x + first.y*first.y);
+
+            // take only low frequencies into account  +  normalize scale
+            // bin 0 is skipped, since it will be set to 0 for translation invariance anyway
+            for (uint i=0; i< n_frequencies>>2; ++i) {
+                // positive
+                const cv::Point2d positive = i == 1 ? first : goertzel( samples, i);
+                normalized_fd(0, i)[0] = static_cast<real>(positive.x / radius);
+                normalized_fd(0, i)[1] = static_cast<real>(positive.y / radius);
+
+                // negative
+                const cv::Point2d negative = goertzel( samples, n_resampling_points-1 - i);
+                normalized_fd(0, n_frequencies-1 - i)[0] = static_cast<real>(negative.x / radius);
+                normalized_fd(0, n_frequencies-1 - i)[1] = static_cast<real>(negative.y / radius);
+            }
+
+            return rotation_invariant_descriptor( normalized_fd);
+        }
+
+
+        /** Makes a scale normalized fourier descriptor translation and rotation invariant.
+         * @param normalized_fd A scale normalized fourier descriptor with the positive frequencies 
+         *        at its beginning and the negative frequencies at its end.
+         * @return The magnitudes of the fourier descriptor, with the first element set to 0.
+         */
+        static Mat1r rotation_invariant_descriptor( Mat2r& normalized_fd) {
             // translation invariance
 	        normalized_fd(0,0)[0] = 0;
 	        normalized_fd(0,0)[1] = 0;
@@ -130,6 +185,67 @@ namespace app {
         }
 
 
+        /** Resamples a closed contour to a given number of points that are equally spaced by arc length.
+         * @param contour The closed contour to resample.
+         * @param n_samples The number of points to resample the contour to.
+         * @param[out] o_samples The resampled points, starting at the contour's first point.
+         */
+        static void resample_by_arc_length( const Contour& contour, const uint n_samples, vector<cv::Point2d>& o_samples) {
+            const uint n_points = static_cast<uint>(contour.size());
+            o_samples.clear();
+            o_samples.reserve( n_samples);
+            
+            // cumulative arc length at each point, the last entry closes the contour
+            vector<double> arc_length( n_points+1, 0);
+            for( uint i=0; i<n_points; ++i) {
+                const cv::Point2i d = contour[(i+1) % n_points] - contour[i];
+                arc_length[i+1] = arc_length[i] + sqrt( static_cast<double>(d.x*d.x + d.y*d.y));
+            }
+            const double step = arc_length[n_points] / n_samples;
+
+            uint segment = 0;
+            for( uint k=0; k<n_samples; ++k) {
+                const double t = k * step;
+                while( segment < n_points-1 && arc_length[segment+1] <= t)
+                    ++segment;
+
+                const double segment_length = arc_length[segment+1] - arc_length[segment];
+                const double fraction = segment_length > 0 ? (t - arc_length[segment]) / segment_length : 0;
+                const cv::Point2d a = contour[segment];
+                const cv::Point2d b = contour[(segment+1) % n_points];
+                o_samples.push_back( a + (b - a) * fraction);
+            }
+        }
+
+
+        /** Evaluates one bin of the discrete fourier transform of a complex signal with the Goertzel algorithm.
+         * The signal's x-coordinates are interpreted as the real parts, the y-coordinates as the imaginary parts.
+         * @param signal The complex signal.
+         * @param k The index of the frequency bin to evaluate.
+         * @return The complex dft coefficient X_k = sum_n signal[n] * exp(-2*pi*i*k*n/N),
+         *         x holding the real part and y holding the imaginary part.
+         */
+        static cv::Point2d goertzel( const vector<cv::Point2d>& signal, const uint k) {
+            const double omega = 2 * CV_PI * k / signal.size();
+            const double coeff = 2 * cos( omega);
+            cv::Point2d s_prev( 0, 0);
+            cv::Point2d s_prev2( 0, 0);
+
+            for( auto it=signal.begin(); it!=signal.end(); ++it) {
+                const cv::Point2d s = *it + coeff * s_prev - s_prev2;
+                s_prev2 = s_prev;
+                s_prev = s;
+            }
+            const cv::Point2d s_last = coeff * s_prev - s_prev2;
+
+            // X_k = s_last - exp(-i*omega) * s_prev
+            const double c = cos( omega);
+            const double sn = sin( omega);
+            return cv::Point2d( s_last.x - (c * s_prev.x + sn * s_prev.y),
+                                s_last.y - (c * s_prev.y - sn * s_prev.x));
+        }
+
+
         /** Helper function that checks the description for errors
          * and logs and corrects them.
          */
@@ -137,19 +253,40 @@ namespace app {
             Vec1r& tweak = this->description.tweak_vector;
 
             if( tweak.size() < 1 || 
-                tweak[0] <= 2        // n_fourier_components (el. N+)
+                tweak[0] <= 2 ||                    // n_fourier_components (el. N+)
+                tweak.size() > 1 && tweak[1] < 0    // n_resampling_points (el. N, optional)
                 ) {
             
-                LOG(warn) << "ContourExtractor: Tweak vector must contain 1 parameter:\n"
-                             " 0: number of superpixels > 2 (since the first two fourier components are discarded)\n";
+                LOG(warn) << "ContourExtractor: Tweak vector must contain 1 or 2 parameters:\n"
+                             " 0: number of superpixels > 2 (since the first two fourier components are discarded)\n"
+                             " 1: optional number of points to resample the contour to by arc length el. N, 0 disables resampling\n";
                          
-                tweak.resize(1, -1);  // if too few parameters where given
+                tweak.resize( std::max<size_t>( tweak.size(), 1), -1);  // if too few parameters where given
 
                 // n_frequencies
                 if( tweak[0] <= 2) {
                     tweak[0] = 10;
                     LOG(notify) << "Setting n_frequencies to " << tweak[0] << ".";
                 }
+                // n_resampling_points
+                if( tweak.size() > 1 && tweak[1] < 0) {
+                    tweak[1] = 0;
+                    LOG(notify) << "Setting n_resampling_points to " << tweak[1] << ".";
+                }
+            }
+
+            if( tweak.size() < 2) {
+                tweak.push_back( 0);  // no resampling by default
+            }
+            // resampling needs a power of two that is big enough to hold all kept frequencies
+            if( tweak[1] > 0) {
+                uint n_resampling_points = 1;
+                while( n_resampling_points < tweak[1] || n_resampling_points < tweak[0])
+                    n_resampling_points <<= 1;
+                if( n_resampling_points != tweak[1]) {
+                    tweak[1] = static_cast<real>(n_resampling_points);
+                    LOG(notify) << "Setting n_resampling_points to the power of two " << tweak[1] << ".";
+                }
             }
         }
 
@@ -24,6 +24,35 @@ namespace app {
      */
     class ContourHistogramExtractor : public FeatureExtractor {
 
+    private: // types
+
+        /// Runs several feature extractors on the same image context in parallel.
+        class ParallelExtraction : public cv::ParallelLoopBody {
+
+            const FeatureExtractor* const* _extractors;                 ///< The extractors to run.
+            const ImageContext& _context;                               ///< The shared image context.
+            Vec1r* _features;                                           ///< One output feature vector per extractor.
+            return_error_code::return_error_code* _return_codes;        ///< One output return code per extractor.
+
+        public:
+
+            /** Main constructor.
+             * @param extractors The extractors to run.
+             * @param context The image context that is shared by all extractors.
+             * @param[out] o_features One feature vector per extractor.
+             * @param[out] o_return_codes One return code per extractor.
+             */
+            ParallelExtraction( const FeatureExtractor* const* extractors, const ImageContext& context, Vec1r* o_features, return_error_code::return_error_code* o_return_codes)
+                : _extractors(extractors), _context(context), _features(o_features), _return_codes(o_return_codes)
+            {}
+
+            /// Runs the extractors in the given range.
+            virtual void operator()( const cv::Range& range) const {
+                for( int i=range.start; i<range.end; ++i)
+                    _return_codes[i] = _extractors[i]->extract( _context, _features[i]);
+            }
+        };
+
     private: // vars
 
         feature_extractor_description _contour_description;
@@ -35,7 +64,9 @@ namespace app {
     public: // constructor & destructor
 
         /** Main constructor.
-         * @param d The object's description.
+         * @param d The object's description. 
+         *        Parameter 0 is passed to the ContourExtractor, parameters 1 to 5 to the HistogramExtractor.
+         *        The optional parameter 6 is passed to the ContourExtractor as its number of resampling points.
          */
         ContourHistogramExtractor( feature_extractor_description& d)
             : FeatureExtractor(d), 
@@ -46,12 +77,14 @@ namespace app {
 
                 _contour_description.tweak_vector.clear();
                 _contour_description.tweak_vector.push_back( description.tweak_vector[0]);
+                if( description.tweak_vector.size() > 6)
+                    _contour_description.tweak_vector.push_back( description.tweak_vector[6]);  // n_resampling_points
 
                 _histogram_description.tweak_vector.clear();
                 _histogram_description.tweak_vector.insert( 
                     _histogram_description.tweak_vector.end(), 
                     d.tweak_vector.begin()+1, 
-                    d.tweak_vector.end());
+                    d.tweak_vector.begin() + std::min<size_t>( d.tweak_vector.size(), 6));
 
                 _contour_extractor   = new ContourExtractor( _contour_description); 
                 _histogram_extractor = new HistogramExtractor( _histogram_description); 
@@ -68,21 +101,23 @@ namespace app {
     private: // methods
 
         /// @see FeatureExtractor::do_extract()
+        /// Runs the contour and the histogram extractor concurrently on the shared image context.
+        /// Returns the first return code that is not SUCCESS, contour first, or SUCCESS, like Concat.
         // TODO scale the contour parts / histogram parts maybe
-        virtual return_error_code::return_error_code do_extract( const Mat3r& original_image, const Mat1b& saliency_map, const Mat1b& saliency_mask, const vector<Contour>& contours, Vec1r& o_features) const {
+        virtual return_error_code::return_error_code do_extract( const ImageContext& context, Vec1r& o_features) const {
             using namespace cv;
-            assert( original_image.size() == saliency_map.size() && "original_image and saliency map must have same dimensions");
-            return_error_code::return_error_code ret_contour, ret_histogram;
             o_features.clear();
 
-            Vec1r contour_features, histogram_features;
-            ret_contour   = _contour_extractor->extract( original_image, saliency_map, saliency_mask, contours, contour_features);
-            ret_histogram = _histogram_extractor->extract( original_image, saliency_map, saliency_mask, contours, histogram_features);
+            const FeatureExtractor* extractors[] = { _contour_extractor, _histogram_extractor };
+            vector<Vec1r> features( 2);  // 0: contour, 1: histogram
+            return_error_code::return_error_code ret[] = { return_error_code::UNSPECIFIED_ERROR, return_error_code::UNSPECIFIED_ERROR };
+
+            parallel_for_( Range( 0, 2), ParallelExtraction( extractors, context, &features[0], ret));
             
-            o_features.reserve( contour_features.size() + histogram_features.size());
-            o_features.insert(o_features.end(), contour_features.begin(), contour_features.end());
-            o_features.insert(o_features.end(), histogram_features.begin(), histogram_features.end());
-            return ret_contour;
+            o_features.reserve( features[0].size() + features[1].size());
+            o_features.insert(o_features.end(), features[0].begin(), features[0].end());
+            o_features.insert(o_features.end(), features[1].begin(), features[1].end());
+            return ret[0] != return_error_code::SUCCESS ? ret[0] : ret[1];
         }
 
         protected: // helpers
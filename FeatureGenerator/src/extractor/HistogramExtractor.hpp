@@ -21,6 +21,11 @@ namespace app {
     /// Feature Extractor that generates HSV histograms as feature vectors.
     class HistogramExtractor : public FeatureExtractor {
 
+    private: // vars
+
+        /// Plan for the channel-wise autocorrelation of the h, s and v histograms.
+        CircularCorrelationPlan<real> _autocorrelation_plan;
+
     public: // constructor & destructor
 
         /** Main constructor.
@@ -30,72 +35,116 @@ namespace app {
             : FeatureExtractor(d) {
 
             check_and_resolve_input_errors();
+
+            Vec1UInt n_bins;
+            n_bins.push_back( static_cast<uint>(description.tweak_vector[0]));
+            n_bins.push_back( static_cast<uint>(description.tweak_vector[1]));
+            n_bins.push_back( static_cast<uint>(description.tweak_vector[2]));
+            _autocorrelation_plan = CircularCorrelationPlan<real>( n_bins);
         }
 
-    private: // methods
+    public: // static kernels
 
-        /// @see FeatureExtractor::do_extract()
-        virtual return_error_code::return_error_code do_extract( const Mat3r& original_image, const Mat1b& saliency_map, const Mat1b& saliency_mask, const vector<Contour>& contours, Vec1r& o_features) const {
+        /** Computes the number of features of the histogram kernel.
+         * The autocorrelation series of a histogram is half as long as the histogram, rounded up.
+         * @param h_bins The number of hue histogram bins.
+         * @param s_bins The number of saturation histogram bins.
+         * @param v_bins The number of value histogram bins.
+         * @param use_autocorrelation Whether channel-wise autocorrelation is used.
+         * @return The number of features.
+         * @see histogram_features()
+         */
+        static int n_features( const int h_bins, const int s_bins, const int v_bins, const bool use_autocorrelation) {
+            if( use_autocorrelation)
+                return (h_bins+1)/2 + (s_bins+1)/2 + (v_bins+1)/2;
+            return h_bins + s_bins + v_bins;
+        }
+
+
+        /** Computes max-normalized h, s and v histograms of an image context
+         * and writes them to a preallocated feature buffer.
+         * Shared by the HistogramExtractor and the compile-time extractor pipeline.
+         * @param context The image context.
+         * @param h_bins The number of hue histogram bins.
+         * @param s_bins The number of saturation histogram bins.
+         * @param v_bins The number of value histogram bins.
+         * @param autocorrelation_plan A correlation plan for histograms of the given lengths
+         *        if channel-wise autocorrelation is to be used, nullptr otherwise.
+         * @param use_whole_image_as_mask Whether to use the whole image instead of the saliency mask.
+         * @param[out] o_features Buffer of at least n_features() elements. Gets the histograms
+         *        or, with autocorrelation, only their autocorrelation series.
+         * @return A return error code.
+         */
+        static return_error_code::return_error_code histogram_features( const ImageContext& context, 
+                                                                        const int h_bins, 
+                                                                        const int s_bins, 
+                                                                        const int v_bins, 
+                                                                        const CircularCorrelationPlan<real>* autocorrelation_plan, 
+                                                                        const bool use_whole_image_as_mask, 
+                                                                        real* o_features) {
             using namespace cv;
-            assert( original_image.size() == saliency_map.size() && "original_image and saliency_map must have same dimensions");
-            o_features.clear();
-            
-            // create and split hsv image from original image
-            Mat3r hsv_image;
-            Mat hsv_planes[3];
-            Mat1r h_hist, s_hist, v_hist;
-            cvtColor(original_image, hsv_image, CV_BGR2HSV);
-            split( hsv_image, hsv_planes); 
-            
-            // quantisation values are determined by description:
-            const int h_bins = static_cast<int>(description.tweak_vector[0]),
-                      s_bins = static_cast<int>(description.tweak_vector[1]), 
-                      v_bins = static_cast<int>(description.tweak_vector[2]);
+
+            // use the shared hsv image; restricted to the salient regions' bounding box
+            // if a mask is used, since the mask is 0 outside of it anyway
+            const Mat3r& hsv_image = context.hsv_image();
+            const Rect roi = use_whole_image_as_mask ? Rect( 0, 0, hsv_image.cols, hsv_image.rows) : context.roi();
+            const Mat1b mask = use_whole_image_as_mask ? Mat1b() : context.saliency_mask()( roi);
+            const Mat hsv_roi = hsv_image( roi);
             
             const real h_range[] = { 0, 360 };
             const real s_range[] = { 0, 1 };
             const real v_range[] = { 0, 256 };
             
-            const real* h_ranges[] = { h_range };
-            const real* s_ranges[] = { s_range };
-            const real* v_ranges[] = { v_range };
+            const real* ranges[] = { h_range, s_range, v_range };
+            const int bins[] = { h_bins, s_bins, v_bins };
+
+            // histogram of each channel, normalized by its maximum;
+            // goes to the buffer directly or, for the autocorrelation, to one vector per channel
+            vector<Vec1r> histvecs( autocorrelation_plan != nullptr ? 3 : 0);  // 0: h, 1: s, 2: v
+            real* histogram = o_features;
+            for( int channel=0; channel<3; ++channel) {
+                Mat1r hist;
+                double max;
+                calcHist( &hsv_roi, 1, &channel, mask, hist, 1, &bins[channel], &ranges[channel]);
+                minMaxLoc( hist, nullptr, &max);
+                if( autocorrelation_plan != nullptr) {
+                    histvecs[channel].resize( bins[channel]);
+                    histogram = &histvecs[channel][0];
+                }
+                for( int i=0; i<bins[channel]; ++i)
+                    histogram[i] = hist(i) / static_cast<real>(max);
+                histogram += bins[channel];
+            }
 
-            // use whole image for histogram calculation?
-            const bool use_whole_image_as_mask = description.tweak_vector[4] == 0 ? 0 : 1;
-            const Mat1b& mask = use_whole_image_as_mask ? Mat1b() : saliency_mask;
+            if( autocorrelation_plan != nullptr) {
+                //channel-wise auto correlation, all three channels in one batch
+                vector<Vec1r> correlations;
+                autocorrelation_plan->execute( histvecs, histvecs, correlations);
+                histogram = o_features;
+                for( int channel=0; channel<3; ++channel)
+                    histogram = std::copy( correlations[channel].begin(), correlations[channel].end(), histogram);
+            }
 
-            calcHist( &hsv_planes[0], 1, nullptr, mask, h_hist, 1, &h_bins, h_ranges);
-            calcHist( &hsv_planes[1], 1, nullptr, mask, s_hist, 1, &s_bins, s_ranges);
-            calcHist( &hsv_planes[2], 1, nullptr, mask, v_hist, 1, &v_bins, v_ranges);
-            
+            return return_error_code::SUCCESS;
+        }
 
-            Vec1r h_histvec, s_histvec, v_histvec;
-            double max;
-            
-            minMaxLoc( h_hist, nullptr, &max);
-            for( int i=0; i<h_bins; ++i)
-                h_histvec.push_back( h_hist(i) / static_cast<real>(max)); 
-            
-            minMaxLoc( s_hist, nullptr, &max);
-            for( int i=0; i<s_bins; ++i)
-                s_histvec.push_back( s_hist(i) / static_cast<real>(max));
-            
-            minMaxLoc( v_hist, nullptr, &max);
-            for( int i=0; i<v_bins; ++i)
-                v_histvec.push_back( v_hist(i) / static_cast<real>(max));
-
-            if( this->description.tweak_vector[3] > 0) {
-                //channel-wise auto correlation
-                h_histvec = circular_cross_correlation_series( h_histvec, h_histvec);
-                s_histvec = circular_cross_correlation_series( s_histvec, s_histvec);
-                v_histvec = circular_cross_correlation_series( v_histvec, v_histvec);
-            }
+    private: // methods
 
-            o_features.insert( o_features.end(), h_histvec.begin(), h_histvec.end());
-            o_features.insert( o_features.end(), s_histvec.begin(), s_histvec.end());
-            o_features.insert( o_features.end(), v_histvec.begin(), v_histvec.end());
+        /// @see FeatureExtractor::do_extract()
+        virtual return_error_code::return_error_code do_extract( const ImageContext& context, Vec1r& o_features) const {
+            // quantisation values are determined by description:
+            const int h_bins = static_cast<int>(description.tweak_vector[0]),
+                      s_bins = static_cast<int>(description.tweak_vector[1]), 
+                      v_bins = static_cast<int>(description.tweak_vector[2]);
+            const bool use_autocorrelation = this->description.tweak_vector[3] > 0;
+            const bool use_whole_image_as_mask = description.tweak_vector[4] == 0 ? 0 : 1;
 
-            return return_error_code::SUCCESS;
+            o_features.resize( n_features( h_bins, s_bins, v_bins, use_autocorrelation));
+            return histogram_features( context, 
+                                       h_bins, s_bins, v_bins, 
+                                       use_autocorrelation ? &_autocorrelation_plan : nullptr, 
+                                       use_whole_image_as_mask, 
+                                       &o_features[0]);
         }
 
     protected: // helpers
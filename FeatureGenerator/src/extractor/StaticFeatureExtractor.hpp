@@ -0,0 +1,260 @@
+/******************************************************************************
+/* @file Compile-time composable feature extractor pipeline.
+/*       Stages know their output dimensionality at compile time and
+/*       write directly into a preallocated feature buffer.
+/*
+/* @author langenhagen
+/* @version 150702
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "FeatureExtractor.hpp"
+#include "ContourExtractor.hpp"
+#include "HistogramExtractor.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace app {
+
+    /** @brief Pipeline stage: normalized fourier descriptor of the biggest contour.
+     * Equivalent to the ContourExtractor with the tweak vector { N_FREQUENCIES, N_RESAMPLING_POINTS }.
+     * @tparam N_FREQUENCIES The number of frequencies to store in the descriptor.
+     * @tparam N_RESAMPLING_POINTS The number of points to resample the contour to, 0 disables resampling.
+     */
+    template<uint N_FREQUENCIES, uint N_RESAMPLING_POINTS=0>
+    class ContourFD {
+
+        static_assert( N_FREQUENCIES > 2, "the first two fourier components are discarded");
+        static_assert( N_RESAMPLING_POINTS == 0 ||
+                       (N_RESAMPLING_POINTS & (N_RESAMPLING_POINTS-1)) == 0 && N_RESAMPLING_POINTS >= N_FREQUENCIES,
+                       "the number of resampling points must be 0 or a power of two >= N_FREQUENCIES");
+
+    public: // vars
+
+        /// The number of features the stage writes.
+        enum { dims = N_FREQUENCIES + N_FREQUENCIES%2 - 2 };
+
+    public: // methods
+
+        /** Writes the stage's features.
+         * @param context The image context.
+         * @param[out] o_features Buffer of at least dims elements.
+         * @return A return error code.
+         */
+        return_error_code::return_error_code extract( const ImageContext& context, real* o_features) const {
+            return ContourExtractor::fourier_descriptor_features( context, N_FREQUENCIES, N_RESAMPLING_POINTS, o_features);
+        }
+    };
+
+
+    /** @brief Pipeline stage: max-normalized h, s and v histograms.
+     * Equivalent to the HistogramExtractor with the tweak vector { H_BINS, S_BINS, V_BINS, AUTOCORRELATION, WHOLE_IMAGE }.
+     * @tparam H_BINS The number of hue histogram bins.
+     * @tparam S_BINS The number of saturation histogram bins.
+     * @tparam V_BINS The number of value histogram bins.
+     * @tparam AUTOCORRELATION Whether to use channel-wise autocorrelation.
+     * @tparam WHOLE_IMAGE Whether to use the whole image instead of the saliency mask.
+     */
+    template<uint H_BINS, uint S_BINS, uint V_BINS, bool AUTOCORRELATION=false, bool WHOLE_IMAGE=false>
+    class HSVHist {
+
+        static_assert( H_BINS > 0 && S_BINS > 0 && V_BINS > 0, "histograms need at least one bin");
+
+    public: // vars
+
+        /// The number of features the stage writes, see HistogramExtractor::n_features().
+        enum { dims = AUTOCORRELATION ? (H_BINS+1)/2 + (S_BINS+1)/2 + (V_BINS+1)/2
+                                      : H_BINS + S_BINS + V_BINS };
+
+    private: // vars
+
+        /// Plan for the channel-wise autocorrelation, only used if AUTOCORRELATION is set.
+        CircularCorrelationPlan<real> _autocorrelation_plan;
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         */
+        HSVHist() {
+            assert( dims == HistogramExtractor::n_features( H_BINS, S_BINS, V_BINS, AUTOCORRELATION) && "the stage must match the HistogramExtractor");
+            if( AUTOCORRELATION) {
+                Vec1UInt n_bins;
+                n_bins.push_back( H_BINS);
+                n_bins.push_back( S_BINS);
+                n_bins.push_back( V_BINS);
+                _autocorrelation_plan = CircularCorrelationPlan<real>( n_bins);
+            }
+        }
+
+    public: // methods
+
+        /** Writes the stage's features.
+         * @param context The image context.
+         * @param[out] o_features Buffer of at least dims elements.
+         * @return A return error code.
+         */
+        return_error_code::return_error_code extract( const ImageContext& context, real* o_features) const {
+            return HistogramExtractor::histogram_features( context,
+                                                           H_BINS, S_BINS, V_BINS,
+                                                           AUTOCORRELATION ? &_autocorrelation_plan : nullptr,
+                                                           WHOLE_IMAGE,
+                                                           o_features);
+        }
+    };
+
+
+    /** @brief Pipeline stage: concatenation of the features of two other stages.
+     * The two stages run concurrently, like the extractors of the ContourHistogramExtractor.
+     * @tparam A The stage whose features come first.
+     * @tparam B The stage whose features come second.
+     */
+    template<class A, class B>
+    class Concat {
+
+    private: // types
+
+        /// Runs the two stages of a Concat in parallel.
+        class ParallelStages : public cv::ParallelLoopBody {
+
+            const Concat& _concat;                                  ///< The concatenation whose stages to run.
+            const ImageContext& _context;                           ///< The shared image context.
+            real* _features;                                        ///< Output: the buffer of the concatenation.
+            return_error_code::return_error_code* _return_codes;    ///< Output: one return code per stage.
+
+        public:
+
+            /** Main constructor.
+             * @param concat The concatenation whose stages to run.
+             * @param context The image context that is shared by both stages.
+             * @param[out] o_features Buffer of at least Concat::dims elements.
+             * @param[out] o_return_codes One return code per stage.
+             */
+            ParallelStages( const Concat& concat, const ImageContext& context, real* o_features, return_error_code::return_error_code* o_return_codes)
+                : _concat(concat), _context(context), _features(o_features), _return_codes(o_return_codes)
+            {}
+
+            /// Runs the stages in the given range, 0 being A and 1 being B.
+            virtual void operator()( const cv::Range& range) const {
+                for( int i=range.start; i<range.end; ++i)
+                    _return_codes[i] = i == 0 ? _concat._a.extract( _context, _features)
+                                              : _concat._b.extract( _context, _features + A::dims);
+            }
+
+        private:
+            /// Not assignable.
+            ParallelStages& operator=( const ParallelStages&);
+        };
+
+    public: // vars
+
+        /// The number of features the stage writes.
+        enum { dims = A::dims + B::dims };
+
+    private: // vars
+
+        A _a; ///< The first stage.
+        B _b; ///< The second stage.
+
+    public: // methods
+
+        /** Writes the features of both stages, each into its own part of the buffer.
+         * @param context The image context.
+         * @param[out] o_features Buffer of at least dims elements.
+         * @return The first return error code that is not SUCCESS, in stage order, or SUCCESS.
+         */
+        return_error_code::return_error_code extract( const ImageContext& context, real* o_features) const {
+            return_error_code::return_error_code ret[] = { return_error_code::UNSPECIFIED_ERROR, return_error_code::UNSPECIFIED_ERROR };
+            cv::parallel_for_( cv::Range( 0, 2), ParallelStages( *this, context, o_features, ret));
+            return ret[0] != return_error_code::SUCCESS ? ret[0] : ret[1];
+        }
+    };
+
+
+    /** @brief Feature extractor that runs a compile-time composed pipeline.
+     * The pipeline writes directly into the feature buffer, which keeps its capacity
+     * between calls, so no temporaries are allocated and concatenated per image.
+     * @tparam Pipeline A pipeline stage, e.g. Concat<ContourFD<40>, HSVHist<10,10,10>>.
+     */
+    template<class Pipeline>
+    class StaticFeatureExtractor : public FeatureExtractor {
+
+        static_assert( Pipeline::dims > 0, "the pipeline must produce features");
+
+    private: // vars
+
+        Pipeline _pipeline; ///< The pipeline.
+
+    public: // constructor & destructor
+
+        /** Main constructor.
+         * @param d The object's description. Its tweak vector is expected to match the pipeline.
+         */
+        StaticFeatureExtractor( feature_extractor_description& d)
+            : FeatureExtractor(d)
+        {}
+
+    private: // methods
+
+        /// @see FeatureExtractor::do_extract()
+        virtual return_error_code::return_error_code do_extract( const ImageContext& context, Vec1r& o_features) const {
+            o_features.resize( Pipeline::dims);
+            return _pipeline.extract( context, &o_features[0]);
+        }
+    };
+
+
+    /** Checks whether a tweak vector equals the given values.
+     * @param tweak A tweak vector.
+     * @param values An array of n values.
+     * @param n The number of values.
+     * @return TRUE if the tweak vector contains exactly the given values, FALSE otherwise.
+     */
+    inline bool tweak_vector_equals( const Vec1r& tweak, const real* values, const uint n) {
+        return tweak.size() == n && std::equal( tweak.begin(), tweak.end(), values);
+    }
+
+
+    /** Creates a feature extractor with a compiled pipeline if the description's type
+     * and tweak vector match one of the precompiled instantiations.
+     * These are the default parametrizations and the shipped configuration.
+     * @param d The description of the feature extractor.
+     * @return A new StaticFeatureExtractor or nullptr if no instantiation matches.
+     *         The caller takes ownership.
+     */
+    inline FeatureExtractor* create_static_feature_extractor( feature_extractor_description& d) {
+        typedef HSVHist<10,10,10,false,false> DefaultHSVHist;
+        const Vec1r& tweak = d.tweak_vector;
+
+        switch( d.type) {
+        case extractor_type::CONTOUR: {
+            const real contour_default[] = { 10 };
+            const real contour_default_resolved[] = { 10, 0 };
+            if( tweak_vector_equals( tweak, contour_default, 1) || tweak_vector_equals( tweak, contour_default_resolved, 2))
+                return new StaticFeatureExtractor< ContourFD<10> >( d);
+            break;
+        }
+        case extractor_type::HISTOGRAM: {
+            const real histogram_default[] = { 10, 10, 10, 0, 0 };
+            if( tweak_vector_equals( tweak, histogram_default, 5))
+                return new StaticFeatureExtractor< DefaultHSVHist >( d);
+            break;
+        }
+        case extractor_type::CONTOUR_HISTOGRAM: {
+            const real contour_histogram_default[] = { 10, 10, 10, 10, 0, 0 };
+            const real contour_histogram_shipped[] = { 40, 10, 10, 10, 0, 0 };
+            if( tweak_vector_equals( tweak, contour_histogram_default, 6))
+                return new StaticFeatureExtractor< Concat< ContourFD<10>, DefaultHSVHist > >( d);
+            if( tweak_vector_equals( tweak, contour_histogram_shipped, 6))
+                return new StaticFeatureExtractor< Concat< ContourFD<40>, DefaultHSVHist > >( d);
+            break;
+        }
+        default:
+            break;
+        }
+        return nullptr;
+    }
+}
@@ -121,6 +121,18 @@ int main(int argc, const char* argv[]) {
         LOG(notify) << "Processing finished.";
     }
 
+    if( params.features_quantization != quantization_type::NONE) {
+        // per dimension value ranges are known only for the complete set of feature vectors
+        LOG(info) << "Writing quantized feature vectors...";
+        image_processor.flush();
+        Mat1r features;
+        if( from_file( params.features_file, features) && !features.empty()) {
+            const QuantizedMat quantized_features( features, params.features_quantization);
+            if( to_file( params.quantized_features_file, quantized_features))
+                LOG(info) << "Wrote " << quantized_features.rows() << " quantized feature vectors to \"" << params.quantized_features_file << "\".";
+        }
+    }
+
     log(stats);
 
     EXIT(0);
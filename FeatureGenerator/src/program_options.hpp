@@ -14,6 +14,7 @@
 
 #include <detector_type.hpp>
 #include <extractor_type.hpp>
+#include <quantization.hpp>
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
@@ -58,6 +59,9 @@ namespace app {
         string directories_file;
         string output_directory;
         string features_file;
+        string features_quantization_string;
+        quantization_type::quantization_type features_quantization; ///< adjusted features_quantization_string.
+        string quantized_features_file;
         string processed_images_file;
         string garbage_file;
         bool delete_old_features;
@@ -94,6 +98,8 @@ namespace app {
         LOG(info) << "Output directory: " << p.output_directory;
         LOG(info) << "Include subdirectories: " << yes_no(p.include_subdirs);
         LOG(info) << "Featuer vector file: " << p.features_file;
+        LOG(info) << "Feature vector quantization: " << p.features_quantization << " aka " << p.features_quantization_string;
+        LOG(info) << "Quantized feature vector file: " << p.quantized_features_file;
         LOG(info) << "Processed files file: " << p.processed_images_file;
         LOG(info) << "\"No saliency found in\"-file: " << p.garbage_file;
         LOG(info) << "Discard feature vectors from previous run: " << yes_no(p.delete_old_features);
@@ -156,6 +162,9 @@ namespace app {
             ret = false;
         p.fed.tweak_vector = from_string<real,vector>( p.fed.tweak_vector_string);
 
+        if( !quantization_type_from_string( p.features_quantization_string, p.features_quantization))
+            ret = false;
+
         if(ret==false) {
             LOG( error) << "Not correctable error in program options!";
         }
@@ -191,6 +200,8 @@ namespace app {
             ("include_subdirs", value<bool>(&p.include_subdirs)->default_value(1), "whether or not to include subdirectories in looking through the image databases")
             ("output_directory", value<string>(&p.output_directory)->default_value("out"), "the output directory for eventual output-files")
             ("features_file", value<string>(&p.features_file)->default_value("features.desc"), "a file that stores the salient object feature vectors")
+            ("features_quantization", value<string>(&p.features_quantization_string)->default_value("NONE"), ("quantization of the additionally written quantized feature vector file; " + quantization_types_string()).c_str())
+            ("quantized_features_file", value<string>(&p.quantized_features_file)->default_value("features.q"), "a file that stores the quantized salient object feature vectors, if a features_quantization other than NONE is given")
             ("processed_images_file", value<string>(&p.processed_images_file)->default_value("processed_files.txt"), "a file that stores the paths of the already processed images")
             ("garbage_file", value<string>(&p.garbage_file)->default_value("files_with_no_salient_regions.txt"), "a file that stores the paths images in which no salient region was found")
             ("delete_old_features", value<bool>(&p.delete_old_features)->default_value(false), "whether or not to delete/reuse the feature vectors generated in a previous run")
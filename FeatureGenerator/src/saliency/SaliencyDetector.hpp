@@ -10,6 +10,7 @@
 // INCLUDES project headers
 
 #include <program_options.hpp>
+#include <ImageContext.hpp>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
@@ -45,21 +46,34 @@ namespace app {
          * Calls do_saliency() internally.
          * @param image An image.
          * @return A grayscale image containing the saliency map of the given image.
-         * @see SaliencyDetector::do_saliency(const Mat3b&)
+         * @see SaliencyDetector::do_saliency(const ImageContext&)
          */
         Mat1b saliency( const Mat3b& image) const {
-            return this->do_saliency( image);            
+            ImageContext context( image);
+            return this->do_saliency( context);            
+        }
+
+
+        /** Calculates the saliency map of the image of a given image context.
+         * Calls do_saliency() internally.
+         * Color space conversions that are memoized in the context are shared with later processing steps.
+         * @param context The image context.
+         * @return A grayscale image containing the saliency map of the context's image.
+         * @see SaliencyDetector::do_saliency(const ImageContext&)
+         */
+        Mat1b saliency( const ImageContext& context) const {
+            return this->do_saliency( context);            
         }
 
 
     private: // virtual interface
 
         /** Does the actual saliency computation. 
-         * @param image An image.
-         * @return A grayscale image containing the saliency map of the given image.
-         * @see SaliencyDetector::saliency(const Mat3b&)
+         * @param context The image context.
+         * @return A grayscale image containing the saliency map of the context's image.
+         * @see SaliencyDetector::saliency(const ImageContext&)
          */
-        virtual Mat1b do_saliency( const Mat3b& image) const = 0;
+        virtual Mat1b do_saliency( const ImageContext& context) const = 0;
 
     };
 }
\ No newline at end of file
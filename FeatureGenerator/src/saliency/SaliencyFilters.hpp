@@ -65,12 +65,12 @@ namespace app {
 
     private: // methods
         
-        /// @see SaliencyDetector::do_saliency( const Mat3b&).
-        virtual Mat1b do_saliency( const Mat3b& image) const {
+        /// @see SaliencyDetector::do_saliency( const ImageContext&).
+        virtual Mat1b do_saliency( const ImageContext& context) const {
             Mat1b ret;
 
             Saliency s(_settings);
-            Mat1r saliency_mat = s.saliency( image);
+            Mat1r saliency_mat = s.saliency( context.image(), context.lab_image());
             saliency_mat.convertTo(ret, CV_8UC1, 255);
 
             return ret;
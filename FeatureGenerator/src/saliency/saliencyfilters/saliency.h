@@ -293,12 +293,21 @@ public:
     /** saliency
      */
     cv::Mat_<float>saliency( const cv::Mat_< cv::Vec3b >& im )  {
-        using namespace cv;
-
 	    // Convert the image to the lab space
 	    cv::Mat_<cv::Vec3f> rgbim, labim;
 	    im.convertTo( rgbim, CV_32F, 1.0/255. );
 	    cv::cvtColor( rgbim, labim, CV_BGR2Lab );
+
+        return saliency( im, labim );
+    }
+
+
+    /** saliency with an already converted lab image
+     * @param im The bgr image.
+     * @param labim im converted to float in [0..1] and then to the lab space.
+     */
+    cv::Mat_<float>saliency( const cv::Mat_< cv::Vec3b >& im, const cv::Mat_< cv::Vec3f >& labim )  {
+        using namespace cv;
 	
         //std::cout << "\n\n" << "Doe abstract.";
         //Mat_<int> segmentation = this->do_gSLIC(rgbim);